@@ -28,6 +28,7 @@
 // BTrack includes
 #include "../../src/BTrack.h"
 #include "../../src/OnsetDetectionFunction.h"
+#include <thread>
 
 //===========================================================================
 // struct to represent the object's state
@@ -203,8 +204,14 @@ void btrack_dsp(t_btrack *x, t_signal **sp, short *count)
     int hopSize = (int) sp[0]->s_n;
     int frameSize = hopSize*2;
     
-    // initialise the beat tracker
-    x->b->updateHopAndFrameSize(hopSize, frameSize);
+    // prepare the beat tracker for the new sizes - they are swapped in on the audio
+    // thread without resetting the tracker's tempo and beat history
+    while (!x->b->prepareHopAndFrameSize(hopSize, frameSize))
+    {
+        // only fails while the audio thread is swapping in an earlier change, so
+        // give it the processor to finish that rather than spinning
+        std::this_thread::yield();
+    }
     
     // set up dsp
 	dsp_add(btrack_perform, 3, x, sp[0]->s_vec, sp[0]->s_n);
@@ -220,8 +227,14 @@ void btrack_dsp64(t_btrack *x, t_object *dsp64, short *count, double samplerate,
     int hopSize = (int) maxvectorsize;
     int frameSize = hopSize*2;
     
-    // initialise the beat tracker
-    x->b->updateHopAndFrameSize(hopSize, frameSize);
+    // prepare the beat tracker for the new sizes - they are swapped in on the audio
+    // thread without resetting the tracker's tempo and beat history
+    while (!x->b->prepareHopAndFrameSize(hopSize, frameSize))
+    {
+        // only fails while the audio thread is swapping in an earlier change, so
+        // give it the processor to finish that rather than spinning
+        std::this_thread::yield();
+    }
 		
     // set up dsp
 	object_method(dsp64, gensym("dsp_add64"), x, btrack_perform64, 0, NULL);
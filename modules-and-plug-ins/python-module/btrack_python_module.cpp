@@ -3,6 +3,7 @@
 #include "../../src/OnsetDetectionFunction.h"
 #include "../../src/BTrack.h"
 #include <numpy/arrayobject.h>
+#include <vector>
 
 //=======================================================================
 static PyObject * btrack_trackBeats(PyObject *dummy, PyObject *args)
@@ -141,7 +142,6 @@ static PyObject * btrack_calculateOnsetDF(PyObject *dummy, PyObject *args)
     int frameSize = 1024;
     int df_type = 6;
     int numframes;
-    double buffer[hopSize];	// buffer to hold one hopsize worth of audio samples
 
     
     // get number of audio frames, given the hop size and signal length
@@ -156,17 +156,10 @@ static PyObject * btrack_calculateOnsetDF(PyObject *dummy, PyObject *args)
     ///////////////////////////////////////////
 	//////// Begin Processing Loop ////////////
 	
-	for (int i=0;i < numframes;i++)
-	{		
-		// add new samples to frame
-		for (int n = 0;n < hopSize;n++)
-		{
-			buffer[n] = data[(i*hopSize)+n];
-		}
-		
-		df[i] = onset.calculateOnsetDetectionFunctionSample(buffer);
-		
-	}
+	// the whole signal is available, so transform it in blocks of frames
+	onset.prepareBlockProcessing(64);
+	
+	onset.calculateBlock(data, numframes, df);
 	
 	///////// End Processing Loop /////////////
 	///////////////////////////////////////////
@@ -283,11 +276,110 @@ static PyObject * btrack_trackBeatsFromOnsetDF(PyObject *dummy, PyObject *args)
     return (PyObject *)c;
 }
 
+//=======================================================================
+static PyObject * btrack_estimateTempo(PyObject *dummy, PyObject *args)
+{
+    PyObject *arg1=NULL;
+    PyObject *arr1=NULL;
+    int hopsBetweenTempoUpdates = 43;
+    
+    if (!PyArg_ParseTuple(args, "O|i", &arg1, &hopsBetweenTempoUpdates))
+    {
+        return NULL;
+    }
+    
+    arr1 = PyArray_FROM_OTF(arg1, NPY_DOUBLE, NPY_IN_ARRAY);
+    if (arr1 == NULL)
+    {
+        return NULL;
+    }
+    
+    
+    
+    ////////// GET INPUT DATA ///////////////////
+    
+    // get data as array
+    double* data = (double*) PyArray_DATA(arr1);
+    
+    // get array size
+    long signal_length = PyArray_Size((PyObject*)arr1);
+    
+    
+    ////////// BEGIN PROCESS ///////////////////
+    int hopSize = 512;
+    int frameSize = 1024;
+    
+    if (hopsBetweenTempoUpdates < 1)
+    {
+        hopsBetweenTempoUpdates = 1;
+    }
+    
+    int numframes;
+    double buffer[hopSize];	// buffer to hold one hopsize worth of audio samples
+    
+    
+    // get number of audio frames, given the hop size and signal length
+	numframes = (int) floor(((double) signal_length) / ((double) hopSize));
+    
+    
+    BTrack b(hopSize,frameSize);
+    
+    // we only want the tempo, so skip beat tracking and update the tempo on a fixed clock
+    b.enableTempoOnlyMode(hopsBetweenTempoUpdates);
+    
+    std::vector<double> tempi;
+    
+    ///////////////////////////////////////////
+	//////// Begin Processing Loop ////////////
+	
+	for (int i=0;i < numframes;i++)
+	{
+		// add new samples to frame
+		for (int n = 0;n < hopSize;n++)
+		{
+			buffer[n] = data[(i*hopSize)+n];
+		}
+		
+        // process the current audio frame
+        b.processAudioFrame(buffer);
+        
+        // record the tempo each time it is updated
+		if (((i+1) % hopsBetweenTempoUpdates) == 0)
+		{
+			tempi.push_back(b.getCurrentTempoEstimate());
+		}
+		
+	}
+	
+	///////// End Processing Loop /////////////
+	///////////////////////////////////////////
+    
+    
+    ////////// CREATE ARRAY AND RETURN IT ///////////////////
+    int nd=1;
+    npy_intp m= tempi.size();
+    
+    PyObject* c=PyArray_SimpleNew(nd, &m, NPY_DOUBLE);
+    
+    void *arr_data = PyArray_DATA((PyArrayObject*)c);
+    
+    if (m > 0)
+    {
+        memcpy(arr_data, &tempi[0], PyArray_ITEMSIZE((PyArrayObject*) c) * m);
+    }
+    
+    
+    Py_DECREF(arr1);
+    
+    return (PyObject *)c;
+}
+
 //=======================================================================
 static PyMethodDef btrack_methods[] = {
     { "calculateOnsetDF",btrack_calculateOnsetDF,METH_VARARGS,"Calculate the onset detection function"},
     { "trackBeats",btrack_trackBeats,METH_VARARGS,"Track beats from audio"},
     { "trackBeatsFromOnsetDF",btrack_trackBeatsFromOnsetDF,METH_VARARGS,"Track beats from an onset detection function"},
+    { "estimateTempo",btrack_estimateTempo,METH_VARARGS,"Estimate the tempo of audio at regular intervals, without tracking beats"},
     {NULL, NULL, 0, NULL} /* Sentinel */
 };
 
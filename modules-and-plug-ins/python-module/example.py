@@ -26,3 +26,7 @@ onsetDF = btrack.calculateOnsetDF(audioData)
 # ==========================================
 # Usage C: track beats from the onset detection function (calculated in Usage B)
 ODFbeats = btrack.trackBeatsFromOnsetDF(onsetDF)
+
+# ==========================================
+# Usage D: estimate the tempo without tracking beats, updated every 43 hops (~0.5 seconds)
+tempi = btrack.estimateTempo(audioData, 43)
@@ -4,7 +4,7 @@ from numpy.distutils.core import setup, Extension
 import os, numpy
 
 name = 'btrack'
-sources = ['btrack_python_module.cpp','../../src/OnsetDetectionFunction.cpp','../../src/BTrack.cpp']
+sources = ['btrack_python_module.cpp','../../src/OnsetDetectionFunction.cpp','../../src/BTrack.cpp','../../src/DSPKernels.cpp','../../src/FFT.cpp','../../src/BeatSynchronousFeatures.cpp','../../src/OnsetPicker.cpp','../../src/SlidingDFT.cpp']
 
 sources.append ('../../libs/kiss_fft130/kiss_fft.c')
 
@@ -213,17 +213,9 @@ BTrackVamp::reset()
 BTrackVamp::FeatureSet
 BTrackVamp::process(const float *const *inputBuffers, Vamp::RealTime timestamp)
 {
-    // create an array to hold our audio frame
-    double frame[m_blockSize];
-    
-    // copy samples into our frame
-    for (int i = 0;i < m_blockSize;i++)
-    {
-        frame[i] = (double) inputBuffers[0][i];
-    }
-    
-    // process the frame in the beat tracker
-    b.processAudioFrame(frame);
+    // the host has already framed the audio, overlapping by the step size,
+    // so it can be analysed in place
+    b.processOverlappingFrame(inputBuffers[0]);
     
     // create a FeatureSet
     FeatureSet featureSet;
@@ -21,48 +21,225 @@
 
 #include <cmath>
 #include <algorithm>
+#include <chrono>
 #include "BTrack.h"
+#include "DSPKernels.h"
+#include "BeatTracking.h"
+#include "BeatSynchronousFeatures.h"
+#include "ScopedNoDenormals.h"
 #include "samplerate.h"
 #include <iostream>
 
 //=======================================================================
 BTrack::BTrack()
- :  odf (512, 1024, ComplexSpectralDifferenceHWR, HanningWindow)
+ :  odf (512, 1024, ComplexSpectralDifferenceHWR, HanningWindow),
+    reconfigurationState (NoReconfiguration),
+    memory (MemoryResource::getDefault()),
+    pendingODF (NULL),
+    tempoEstimation (NULL),
+    governor (NumQualityLevels),
+    beatFeatures (NULL),
+    onsetDetection (false),
+    onsetDueInFrame (false),
+    onsetDelay (0)
 {
     initialise (512, 1024);
 }
 
 //=======================================================================
 BTrack::BTrack (int hopSize_)
- :  odf(hopSize_, 2*hopSize_, ComplexSpectralDifferenceHWR, HanningWindow)
+ :  odf(hopSize_, 2*hopSize_, ComplexSpectralDifferenceHWR, HanningWindow),
+    reconfigurationState (NoReconfiguration),
+    memory (MemoryResource::getDefault()),
+    pendingODF (NULL),
+    tempoEstimation (NULL),
+    governor (NumQualityLevels),
+    beatFeatures (NULL),
+    onsetDetection (false),
+    onsetDueInFrame (false),
+    onsetDelay (0)
 {	
     initialise (hopSize_, 2*hopSize_);
 }
 
 //=======================================================================
-BTrack::BTrack (int hopSize_, int frameSize_)
- : odf (hopSize_, frameSize_, ComplexSpectralDifferenceHWR, HanningWindow)
+BTrack::BTrack (int hopSize_, int frameSize_, MemoryResource* memory_)
+ : odf (hopSize_, frameSize_, ComplexSpectralDifferenceHWR, HanningWindow, memory_),
+    onsetDF (odf.getMemoryResource()),
+    cumulativeScore (odf.getMemoryResource()),
+    skippedScores (odf.getMemoryResource()),
+    reconfigurationState (NoReconfiguration),
+    memory (odf.getMemoryResource()),
+    pendingODF (NULL),
+    pendingOnsetDF (memory),
+    pendingCumulativeScore (memory),
+    pendingSkippedScores (memory),
+    tempoEstimation (NULL),
+    governor (NumQualityLevels),
+    beatFeatures (NULL),
+    onsetPicker (memory),
+    onsetDetection (false),
+    onsetDueInFrame (false),
+    onsetDelay (0)
 {
     initialise (hopSize_, frameSize_);
 }
 
+//=======================================================================
+BTrack::BTrack (BTrack&& other)
+ :  odf (std::move (other.odf)),
+    reconfigurationState (NoReconfiguration),
+    memory (other.memory),
+    pendingODF (NULL),
+    tempoEstimation (NULL),
+    governor (other.governor),
+    beatFeatures (NULL),
+    onsetDetection (false),
+    onsetDueInFrame (false),
+    onsetDelay (0)
+{
+    takeStateFrom (other);
+}
+
 //=======================================================================
 BTrack::~BTrack()
 {
-#ifdef USE_FFTW
-    // destroy fft plan
-    fftw_destroy_plan (acfForwardFFT);
-    fftw_destroy_plan (acfBackwardFFT);
-    fftw_free (complexIn);
-    fftw_free (complexOut);
-#endif
+    deletePendingODF();
+    deleteTempoEstimationBuffers();
+}
+
+//=======================================================================
+BTrack& BTrack::operator= (BTrack&& other)
+{
+    if (this != &other)
+    {
+        deletePendingODF();
+        deleteTempoEstimationBuffers();
+        
+        odf = std::move (other.odf);
+        memory = other.memory;
+        governor = other.governor;
+        
+        takeStateFrom (other);
+    }
+    
+    return *this;
+}
+
+//=======================================================================
+void BTrack::takeStateFrom (BTrack& other)
+{
+    // the buffers are moved along with the memory they were allocated from, so nothing is copied
+    onsetDF = std::move (other.onsetDF);
+    cumulativeScore = std::move (other.cumulativeScore);
+    skippedScores = std::move (other.skippedScores);
+    
+    tightness = other.tightness;
+    alpha = other.alpha;
+    beatPeriod = other.beatPeriod;
+    latestCumulativeScoreValue = other.latestCumulativeScoreValue;
+    m0 = other.m0;
+    beatCounter = other.beatCounter;
+    hopSize = other.hopSize;
+    onsetDFBufferSize = other.onsetDFBufferSize;
+    tempoUpdateInterval = other.tempoUpdateInterval;
+    hopsSinceTempoUpdate = other.hopsSinceTempoUpdate;
+    tempoOnly = other.tempoOnly;
+    tempoLocked = other.tempoLocked;
+    beatDueInFrame = other.beatDueInFrame;
+    qualityLevelChanged = other.qualityLevelChanged;
+    holdOnsetDetectionFunctionSample = other.holdOnsetDetectionFunctionSample;
+    
+    // a prepared change goes with the instance it was prepared for
+    reconfigurationState.store (other.reconfigurationState.load());
+    other.reconfigurationState.store (NoReconfiguration);
+    pendingODF = other.pendingODF;
+    other.pendingODF = NULL;
+    pendingOnsetDF = std::move (other.pendingOnsetDF);
+    pendingCumulativeScore = std::move (other.pendingCumulativeScore);
+    pendingSkippedScores = std::move (other.pendingSkippedScores);
+    pendingHopSize = other.pendingHopSize;
+    windowType = other.windowType;
+    fftBackend = other.fftBackend;
+    silenceThreshold = other.silenceThreshold;
+    phaseMagnitudeFloor = other.phaseMagnitudeFloor;
+    slidingDFTEnabled = other.slidingDFTEnabled;
+    firstBin = other.firstBin;
+    lastBin = other.lastBin;
+    binRangeFrameSize = other.binRangeFrameSize;
+    
+    tempoEstimation = other.tempoEstimation;
+    other.tempoEstimation = NULL;
+    tempo = other.tempo;
+    estimatedTempo = other.estimatedTempo;
+    tempoToLagFactor = other.tempoToLagFactor;
+    tempoFixed = other.tempoFixed;
+    lockedTempo = other.lockedTempo;
+    FFTLengthForACFCalculation = other.FFTLengthForACFCalculation;
+    acfFFT = std::move (other.acfFFT);
+    
+    fullQualityOnsetDetectionFunctionType = other.fullQualityOnsetDetectionFunctionType;
+    resamplerType = other.resamplerType;
+    beatsPerTempoUpdate = other.beatsPerTempoUpdate;
+    beatsSinceTempoUpdate = other.beatsSinceTempoUpdate;
+    
+    beatFeatures = other.beatFeatures;
+    
+    onsetPicker = std::move (other.onsetPicker);
+    onsetDetection = other.onsetDetection;
+    onsetDueInFrame = other.onsetDueInFrame;
+    onsetDelay = other.onsetDelay;
+}
+
+//=======================================================================
+void BTrack::deletePendingODF()
+{
+    if (pendingODF != NULL)
+    {
+        pendingODF->~OnsetDetectionFunction();
+        memory->deallocate (pendingODF, sizeof (OnsetDetectionFunction));
+        pendingODF = NULL;
+    }
+}
+
+//=======================================================================
+void BTrack::deleteTempoEstimationBuffers()
+{
+    if (tempoEstimation != NULL)
+    {
+        tempoEstimation->~TempoEstimationBuffers();
+        memory->deallocate (tempoEstimation, sizeof (TempoEstimationBuffers));
+        tempoEstimation = NULL;
+    }
+}
+
+//=======================================================================
+size_t BTrack::memoryFootprint() const
+{
+    // the onset detection function counts its own object, which is already part of ours
+    size_t bytes = sizeof (BTrack) - sizeof (OnsetDetectionFunction) + odf.memoryFootprint();
+    
+    bytes += onsetDF.memoryFootprint() + cumulativeScore.memoryFootprint();
+    bytes += pendingOnsetDF.memoryFootprint() + pendingCumulativeScore.memoryFootprint();
+    bytes += (skippedScores.capacity() + pendingSkippedScores.capacity()) * sizeof (double);
+    bytes += onsetPicker.memoryFootprint();
     
-#ifdef USE_KISS_FFT
-    free (cfgForwards);
-    free (cfgBackwards);
-    delete [] fftIn;
-    delete [] fftOut;
-#endif
+    if (pendingODF != NULL)
+    {
+        bytes += pendingODF->memoryFootprint();
+    }
+    
+    if (tempoEstimation != NULL)
+    {
+        bytes += sizeof (TempoEstimationBuffers);
+    }
+    
+    if (acfFFT)
+    {
+        bytes += acfFFT->memoryFootprint();
+    }
+    
+    return bytes;
 }
 
 //=======================================================================
@@ -88,10 +265,6 @@ double BTrack::getBeatTimeInSeconds (int frameNumber, int hopSize, int fs)
 //=======================================================================
 void BTrack::initialise (int hopSize_, int frameSize_)
 {
-    double rayparam = 43;
-	double pi = 3.14159265;
-	
-	
 	// initialise parameters
 	tightness = 5;
 	alpha = 0.9;
@@ -103,38 +276,54 @@ void BTrack::initialise (int hopSize_, int frameSize_)
 	beatCounter = -1;
 	
 	beatDueInFrame = false;
+    
+    holdOnsetDetectionFunctionSample = false;
 	
+    // the buffers for tempo estimation are allocated alongside the others
+    void* place = memory->allocate (sizeof (TempoEstimationBuffers));
+    tempoEstimation = new (place) TempoEstimationBuffers();
 
 	// create rayleigh weighting vector
-	for (int n = 0; n < 128; n++)
-	{
-		weightingVector[n] = ((double) n / pow(rayparam,2)) * exp((-1*pow((double)-n,2)) / (2*pow(rayparam,2)));
-	}
+	BeatTracking::calculateWeightingVector (tempoEstimation->weightingVector);
 	
 	// initialise prev_delta
 	for (int i = 0; i < 41; i++)
 	{
-		prevDelta[i] = 1;
+		tempoEstimation->prevDelta[i] = 1;
 	}
 	
-	double t_mu = 41/2;
-	double m_sig;
-	double x;
 	// create tempo transition matrix
-	m_sig = 41/8;
-	for (int i = 0;i < 41;i++)
-	{
-		for (int j = 0;j < 41;j++)
-		{
-			x = j+1;
-			t_mu = i+1;
-			tempoTransitionMatrix[i][j] = (1 / (m_sig * sqrt(2*pi))) * exp( (-1*pow((x-t_mu),2)) / (2*pow(m_sig,2)) );
-		}
-	}
+	BeatTracking::calculateTempoTransitionMatrix (tempoEstimation->tempoTransitionMatrix);
 	
 	// tempo is not fixed
 	tempoFixed = false;
     
+    // tempo is not locked
+    tempoLocked = false;
+    lockedTempo = tempo;
+    
+    // beats are tracked
+    tempoOnly = false;
+    tempoUpdateInterval = 1;
+    hopsSinceTempoUpdate = 0;
+    
+    // start at full quality with no processing budget
+    fullQualityOnsetDetectionFunctionType = odf.getOnsetDetectionFunctionType();
+    
+    // the settings that a hop and frame size change carries over
+    windowType = odf.getWindowType();
+    fftBackend = odf.getFFTBackend();
+    silenceThreshold = odf.getSilenceThreshold();
+    phaseMagnitudeFloor = odf.getPhaseMagnitudeFloor();
+    slidingDFTEnabled = odf.isSlidingDFTEnabled();
+    firstBin = odf.getFirstBin();
+    lastBin = odf.getLastBin();
+    binRangeFrameSize = odf.getFrameSize();
+    resamplerType = SRC_SINC_BEST_QUALITY;
+    beatsPerTempoUpdate = 1;
+    beatsSinceTempoUpdate = 0;
+    qualityLevelChanged = false;
+    
     // initialise latest cumulative score value
     // in case it is requested before any processing takes place
     latestCumulativeScoreValue = 0;
@@ -146,20 +335,8 @@ void BTrack::initialise (int hopSize_, int frameSize_)
     // Set up FFT for calculating the auto-correlation function
     FFTLengthForACFCalculation = 1024;
     
-#ifdef USE_FFTW
-    complexIn = (fftw_complex*) fftw_malloc (sizeof(fftw_complex) * FFTLengthForACFCalculation);		// complex array to hold fft data
-    complexOut = (fftw_complex*) fftw_malloc (sizeof(fftw_complex) * FFTLengthForACFCalculation);	// complex array to hold fft data
-    
-    acfForwardFFT = fftw_plan_dft_1d (FFTLengthForACFCalculation, complexIn, complexOut, FFTW_FORWARD, FFTW_ESTIMATE);	// FFT plan initialisation
-    acfBackwardFFT = fftw_plan_dft_1d (FFTLengthForACFCalculation, complexOut, complexIn, FFTW_BACKWARD, FFTW_ESTIMATE);	// FFT plan initialisation
-#endif
-    
-#ifdef USE_KISS_FFT
-    fftIn = new kiss_fft_cpx[FFTLengthForACFCalculation];
-    fftOut = new kiss_fft_cpx[FFTLengthForACFCalculation];
-    cfgForwards = kiss_fft_alloc (FFTLengthForACFCalculation, 0, 0, 0);
-    cfgBackwards = kiss_fft_alloc (FFTLengthForACFCalculation, 1, 0, 0);
-#endif
+    // use the same FFT implementation as the onset detection function
+    acfFFT = FFTBackend::createFFTForSize (*odf.getFFTBackend(), FFTLengthForACFCalculation, memory);
 }
 
 //=======================================================================
@@ -173,69 +350,542 @@ void BTrack::setHopSize (int hopSize_)
     // set size of onset detection function buffer
     onsetDF.resize (onsetDFBufferSize);
     
-    // set size of cumulative score buffer
-    cumulativeScore.resize (onsetDFBufferSize);
-	
-	// initialise df_buffer to zeros
-	for (int i = 0; i < onsetDFBufferSize; i++)
-	{
-		onsetDF[i] = 0;
-		cumulativeScore[i] = 0;
-		
-		if ((i %  ((int) round(beatPeriod))) == 0)
-		{
-			onsetDF[i] = 1;
-		}
-	}
+    // set size of cumulative score buffer
+    cumulativeScore.resize (onsetDFBufferSize);
+    skippedScores.assign (onsetDFBufferSize, 0.0);
+	
+	// initialise df_buffer to zeros
+	for (int i = 0; i < onsetDFBufferSize; i++)
+	{
+		onsetDF.setSample (i, 0);
+		cumulativeScore.setSample (i, 0);
+		
+		if ((i %  ((int) round(beatPeriod))) == 0)
+		{
+			onsetDF.setSample (i, 1);
+		}
+	}
+}
+
+//=======================================================================
+void BTrack::updateHopAndFrameSize (int hopSize_, int frameSize_)
+{
+    // make sure nothing is left over from an earlier prepared change
+    applyPendingReconfiguration();
+    
+    if (prepareHopAndFrameSize (hopSize_, frameSize_))
+    {
+        applyPendingReconfiguration();
+    }
+}
+
+//=======================================================================
+bool BTrack::prepareHopAndFrameSize (int hopSize_, int frameSize_)
+{
+    int expected = NoReconfiguration;
+    
+    if (!reconfigurationState.compare_exchange_strong (expected, PreparingReconfiguration))
+    {
+        // a change that the audio thread hasn't picked up yet can be replaced, but one that
+        // it is currently applying (or that another thread is preparing) can't be touched
+        expected = ReconfigurationReady;
+        
+        if (!reconfigurationState.compare_exchange_strong (expected, PreparingReconfiguration))
+        {
+            return false;
+        }
+    }
+    
+    // this also frees the detection function retired by the previous change
+    deletePendingODF();
+    
+    // the bin range covers the same frequencies at the new frame size
+    firstBin = (firstBin * frameSize_) / binRangeFrameSize;
+    lastBin = (lastBin * frameSize_) / binRangeFrameSize;
+    binRangeFrameSize = frameSize_;
+    
+    // the detection function itself is allocated alongside its buffers. The audio thread may be
+    // using the current one, so only the copies of its settings are read here, and the type (which
+    // the quality level changes) is carried over when the change is applied
+    void* place = memory->allocate (sizeof (OnsetDetectionFunction));
+    pendingODF = new (place) OnsetDetectionFunction (hopSize_, frameSize_, fullQualityOnsetDetectionFunctionType, windowType, memory);
+    pendingODF->setFFTBackend (fftBackend);
+    pendingODF->setSilenceThreshold (silenceThreshold);
+    pendingODF->setPhaseMagnitudeFloor (phaseMagnitudeFloor);
+    pendingODF->setSlidingDFT (slidingDFTEnabled);
+    pendingODF->setBinRange (firstBin, lastBin);
+    
+    pendingHopSize = hopSize_;
+    
+    int bufferSize = (512*512)/pendingHopSize;
+    pendingOnsetDF.resize (bufferSize);
+    pendingCumulativeScore.resize (bufferSize);
+    pendingSkippedScores.assign (bufferSize, 0.0);
+    
+    reconfigurationState.store (ReconfigurationReady, std::memory_order_release);
+    
+    return true;
+}
+
+//=======================================================================
+void BTrack::applyPendingReconfiguration()
+{
+    // cheap check first, as this is called for every hop
+    if (reconfigurationState.load (std::memory_order_relaxed) != ReconfigurationReady)
+    {
+        return;
+    }
+    
+    int expected = ReconfigurationReady;
+    
+    // claim the prepared change so that it can't be replaced while we are swapping it in
+    if (!reconfigurationState.compare_exchange_strong (expected, ApplyingReconfiguration, std::memory_order_acquire))
+    {
+        return;
+    }
+    
+    // carry the audio that is already in the frame over to the new detection function
+    pendingODF->copyAudioHistory (odf);
+    pendingODF->setOnsetDetectionFunctionType (odf.getOnsetDetectionFunctionType());
+    odf.swap (*pendingODF);
+    
+    // both buffers span the same period of time, so resample the history rather than resetting it
+    resampleHistory (onsetDF, pendingOnsetDF);
+    resampleHistory (cumulativeScore, pendingCumulativeScore);
+    onsetDF.swap (pendingOnsetDF);
+    cumulativeScore.swap (pendingCumulativeScore);
+    skippedScores.swap (pendingSkippedScores);
+    
+    // convert the beat timing state to detection function samples at the new hop size
+    double ratio = ((double) hopSize) / ((double) pendingHopSize);
+    
+    beatPeriod = round (beatPeriod * ratio);
+    
+    int newM0 = (int) round (m0 * ratio);
+    int newBeatCounter = (int) round (beatCounter * ratio);
+    
+    // don't let an upcoming event round away to a time that has already passed
+    m0 = (m0 > 0) ? std::max (newM0, 1) : newM0;
+    beatCounter = (beatCounter > 0) ? std::max (newBeatCounter, 1) : newBeatCounter;
+    
+    hopSize = pendingHopSize;
+    onsetDFBufferSize = onsetDF.size();
+    
+    // recalculate a locked beat period exactly rather than accumulating rounding errors
+    if (tempoLocked)
+    {
+        lockTempo (lockedTempo);
+    }
+    
+    // the first spectral difference from the new detection function is measured against an
+    // empty previous spectrum, so it would produce a false onset
+    holdOnsetDetectionFunctionSample = true;
+    
+    reconfigurationState.store (NoReconfiguration, std::memory_order_release);
+}
+
+//=======================================================================
+void BTrack::resampleHistory (const CircularBuffer<double>& source, CircularBuffer<double>& destination)
+{
+    int sourceSize = source.size();
+    int destinationSize = destination.size();
+    
+    const double* input = source.data();
+    
+    // map the oldest and newest samples of both buffers onto each other
+    double step = ((double) (sourceSize - 1)) / ((double) std::max (destinationSize - 1, 1));
+    
+    for (int i = 0; i < destinationSize; i++)
+    {
+        double position = i * step;
+        int index = std::min ((int) position, sourceSize - 1);
+        int nextIndex = std::min (index + 1, sourceSize - 1);
+        double fraction = position - index;
+        
+        destination.setSample (i, input[index] + fraction * (input[nextIndex] - input[index]));
+    }
+}
+
+//=======================================================================
+bool BTrack::beatDueInCurrentFrame()
+{
+    return beatDueInFrame;
+}
+
+//=======================================================================
+double BTrack::getCurrentTempoEstimate()
+{
+    return estimatedTempo;
+}
+
+//=======================================================================
+int BTrack::getHopSize()
+{
+    return hopSize;
+}
+
+//=======================================================================
+double BTrack::getLatestCumulativeScoreValue()
+{
+    return latestCumulativeScoreValue;
+}
+
+//=======================================================================
+void BTrack::processAudioFrame (double* frame)
+{
+    processFrame (&OnsetDetectionFunction::calculateOnsetDetectionFunctionSample, frame);
+}
+
+//=======================================================================
+template <typename... Args>
+void BTrack::processFrame (double (OnsetDetectionFunction::*calculate) (Args...), Args... args)
+{
+    ScopedNoDenormals noDenormals;
+    
+    startFrameMeasurement();
+    
+    // pick up any hop and frame size change before the frame is analysed
+    applyPendingReconfiguration();
+    
+    // calculate the onset detection function sample for the frame
+    double sample = (odf.*calculate) (args...);
+    
+    // process the new onset detection function sample in the beat tracking algorithm
+    processCalculatedOnsetDetectionFunctionSample (sample);
+    
+    finishFrameMeasurement();
+}
+
+//=======================================================================
+void BTrack::startFrameMeasurement()
+{
+    qualityLevelChanged = false;
+    
+    if (governor.getBudget() > 0)
+    {
+        frameStartTime = std::chrono::steady_clock::now();
+    }
+}
+
+//=======================================================================
+void BTrack::finishFrameMeasurement()
+{
+    if (governor.getBudget() <= 0)
+    {
+        return;
+    }
+    
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - frameStartTime;
+    
+    if (governor.addMeasurement (elapsed.count()))
+    {
+        applyQualityLevel (governor.getLevel());
+        qualityLevelChanged = true;
+    }
+}
+
+//=======================================================================
+void BTrack::setProcessingBudget (double secondsPerHop)
+{
+    governor.setBudget (secondsPerHop);
+    applyQualityLevel (governor.getLevel());
+}
+
+//=======================================================================
+void BTrack::setQualityLevel (int level)
+{
+    governor.setLevel (level);
+    applyQualityLevel (governor.getLevel());
+}
+
+//=======================================================================
+int BTrack::getQualityLevel()
+{
+    return governor.getLevel();
+}
+
+//=======================================================================
+bool BTrack::qualityLevelChangedInCurrentFrame()
+{
+    return qualityLevelChanged;
+}
+
+//=======================================================================
+void BTrack::applyQualityLevel (int level)
+{
+    int onsetDetectionFunctionType = fullQualityOnsetDetectionFunctionType;
+    
+    if (level >= EnergyDifferenceQuality)
+    {
+        onsetDetectionFunctionType = EnergyDifference;
+    }
+    else if (level >= SpectralDifferenceQuality)
+    {
+        onsetDetectionFunctionType = SpectralDifferenceHWR;
+    }
+    
+    if (onsetDetectionFunctionType != odf.getOnsetDetectionFunctionType())
+    {
+        odf.setOnsetDetectionFunctionType (onsetDetectionFunctionType);
+        
+        // the new detection function has no valid previous frame to compare against
+        holdOnsetDetectionFunctionSample = true;
+    }
+    
+    if (level >= ReducedTempoUpdateQuality)
+    {
+        resamplerType = SRC_LINEAR;
+    }
+    else if (level >= FastResamplingQuality)
+    {
+        resamplerType = SRC_SINC_FASTEST;
+    }
+    else
+    {
+        resamplerType = SRC_SINC_BEST_QUALITY;
+    }
+    
+    if (level >= EnergyDifferenceQuality)
+    {
+        beatsPerTempoUpdate = 4;
+    }
+    else if (level >= ReducedTempoUpdateQuality)
+    {
+        beatsPerTempoUpdate = 2;
+    }
+    else
+    {
+        beatsPerTempoUpdate = 1;
+    }
+}
+
+//=======================================================================
+void BTrack::processOverlappingFrame (const double* frame)
+{
+    processFrame (&OnsetDetectionFunction::calculateFromFrame, frame);
+}
+
+//=======================================================================
+void BTrack::processOverlappingFrame (const float* frame)
+{
+    processFrame (&OnsetDetectionFunction::calculateFromFrame, frame);
+}
+
+//=======================================================================
+void BTrack::processCalculatedOnsetDetectionFunctionSample (double sample)
+{
+    if (holdOnsetDetectionFunctionSample)
+    {
+        sample = onsetDF[onsetDFBufferSize - 1];
+        holdOnsetDetectionFunctionSample = false;
+    }
+    
+    if (odf.frameWasSilent())
+    {
+        // nothing to analyse, so skip straight over the frame
+        advanceFrames (1, sample);
+    }
+    else
+    {
+        // process the new onset detection function sample in the beat tracking algorithm
+        processOnsetDetectionFunctionSample (sample);
+    }
+    
+    if (beatFeatures != NULL)
+    {
+        // the frame that a beat falls in starts the next beat
+        if (beatDueInFrame)
+        {
+            beatFeatures->endBeat();
+        }
+        
+        const double* spectrum = odf.getCurrentSpectrum();
+        
+        if (odf.getFrameSize() != beatFeatures->getFrameSize())
+        {
+            spectrum = NULL;
+        }
+        
+        beatFeatures->addFrame (spectrum, sample);
+    }
+}
+
+//=======================================================================
+void BTrack::processSpectrumFrame (const double* real, const double* imag)
+{
+    processFrame (&OnsetDetectionFunction::calculateOnsetDetectionFunctionSampleFromSpectrum, real, imag);
+}
+
+//=======================================================================
+void BTrack::processPolarSpectrumFrame (const double* magnitude, const double* phase)
+{
+    processFrame (&OnsetDetectionFunction::calculateOnsetDetectionFunctionSampleFromPolarSpectrum, magnitude, phase);
+}
+
+//=======================================================================
+int BTrack::advanceFrames (int numFrames, double sample)
+{
+    ScopedNoDenormals noDenormals;
+    
+    applyPendingReconfiguration();
+    
+    holdOnsetDetectionFunctionSample = false;
+    beatDueInFrame = false;
+    
+    if (numFrames <= 0)
+    {
+        return 0;
+    }
+    
+    // match the conditioning applied in processOnsetDetectionFunctionSample()
+    sample = fabs (sample) + 0.0001;
+    
+    pickOnsets (numFrames, sample);
+    
+    if (tempoOnly)
+    {
+        addTempoOnlySamples (numFrames, sample);
+        return 0;
+    }
+    
+    int period = std::max ((int) beatPeriod, 1);
+    int halfPeriod = (int) round (beatPeriod / 2);
+    
+    /////////// CUMULATIVE SCORE //////////////////
+    
+    // with constant input the past window is dominated by its peak, one beat period back, so
+    // the recursion becomes c[t] = (1 - alpha) * sample + alpha * c[t - period]. Unrolled, each new
+    // value decays from the value m beat periods earlier that is still in the buffer
+    int numToWrite = std::min (numFrames, onsetDFBufferSize);
+    int firstToWrite = numFrames - numToWrite;
+    double* newScores = &skippedScores[0];
+    
+    const double* history = cumulativeScore.data();
+    
+    for (int i = 0; i < numToWrite; i++)
+    {
+        int j = firstToWrite + i;
+        int m = (j / period) + 1;
+        int index = onsetDFBufferSize + j - (m * period);
+        
+        // the buffer is always longer than a beat period, but guard against reading before it
+        index = std::max (index, 0);
+        
+        newScores[i] = sample + pow (alpha, m) * (history[index] - sample);
+    }
+    
+    for (int i = 0; i < numToWrite; i++)
+    {
+        onsetDF.addSampleToEnd (sample);
+        cumulativeScore.addSampleToEnd (newScores[i]);
+    }
+    
+    latestCumulativeScoreValue = newScores[numToWrite - 1];
+    
+    /////////// BEAT TIMING //////////////////
+    
+    // find the frame (counting the first skipped frame as 1) of the next beat. If it hasn't been
+    // predicted yet, the prediction halfway between beats would place it a period after the last beat
+    int nextBeat = (beatCounter > 0) ? beatCounter : std::max (m0, 1) + (period - halfPeriod);
+    
+    int numBeats = 0;
+    
+    if (nextBeat <= numFrames)
+    {
+        numBeats = 1 + ((numFrames - nextBeat) / period);
+        
+        int lastBeat = nextBeat + ((numBeats - 1) * period);
+        
+        beatDueInFrame = (lastBeat == numFrames);
+        
+        if ((lastBeat + halfPeriod) > numFrames)
+        {
+            // still waiting for the prediction after the last beat
+            beatCounter = lastBeat - numFrames;
+            m0 = lastBeat + halfPeriod - numFrames;
+        }
+        else
+        {
+            // the prediction for the following beat has been passed
+            beatCounter = lastBeat + period - numFrames;
+            m0 = beatCounter + halfPeriod;
+        }
+    }
+    else if ((beatCounter <= 0) && (m0 <= numFrames))
+    {
+        // the prediction for the next beat has been passed
+        beatCounter = nextBeat - numFrames;
+        m0 = beatCounter + halfPeriod;
+    }
+    else
+    {
+        beatCounter = beatCounter - numFrames;
+        m0 = m0 - numFrames;
+    }
+    
+    return numBeats;
 }
 
 //=======================================================================
-void BTrack::updateHopAndFrameSize (int hopSize_, int frameSize_)
+void BTrack::setSilenceThreshold (double meanSquareThreshold)
 {
-    // update the onset detection function object
-    odf.initialise (hopSize_, frameSize_);
-    
-    // update the hop size being used by the beat tracker
-    setHopSize (hopSize_);
+    silenceThreshold = meanSquareThreshold;
+    odf.setSilenceThreshold (meanSquareThreshold);
 }
 
 //=======================================================================
-bool BTrack::beatDueInCurrentFrame()
+void BTrack::setPhaseMagnitudeFloor (double relativeFloor)
 {
-    return beatDueInFrame;
+    phaseMagnitudeFloor = relativeFloor;
+    odf.setPhaseMagnitudeFloor (relativeFloor);
 }
 
 //=======================================================================
-double BTrack::getCurrentTempoEstimate()
+void BTrack::setSlidingDFT (bool enabled)
 {
-    return estimatedTempo;
+    slidingDFTEnabled = enabled;
+    odf.setSlidingDFT (enabled);
 }
 
 //=======================================================================
-int BTrack::getHopSize()
+void BTrack::setBinRange (int firstBin_, int lastBin_)
 {
-    return hopSize;
+    odf.setBinRange (firstBin_, lastBin_);
+    
+    firstBin = odf.getFirstBin();
+    lastBin = odf.getLastBin();
+    binRangeFrameSize = odf.getFrameSize();
 }
 
 //=======================================================================
-double BTrack::getLatestCumulativeScoreValue()
+void BTrack::setFFTBackend (std::shared_ptr<FFTBackend> backend)
 {
-    return latestCumulativeScoreValue;
+    if (!backend)
+    {
+        return;
+    }
+    
+    fftBackend = backend;
+    odf.setFFTBackend (backend);
+    acfFFT = FFTBackend::createFFTForSize (*backend, FFTLengthForACFCalculation, memory);
 }
 
 //=======================================================================
-void BTrack::processAudioFrame (double* frame)
+void BTrack::setBeatSynchronousFeatures (BeatSynchronousFeatures* features)
 {
-    // calculate the onset detection function sample for the frame
-    double sample = odf.calculateOnsetDetectionFunctionSample (frame);
-    
-    // process the new onset detection function sample in the beat tracking algorithm
-    processOnsetDetectionFunctionSample (sample);
+    beatFeatures = features;
 }
 
 //=======================================================================
 void BTrack::processOnsetDetectionFunctionSample (double newSample)
 {
+    ScopedNoDenormals noDenormals;
+    
+    applyPendingReconfiguration();
+    
+    // a held sample only applies to audio input, which has already been handled by now
+    holdOnsetDetectionFunctionSample = false;
+    
     // we need to ensure that the onset
     // detection function sample is positive
     newSample = fabs (newSample);
@@ -244,9 +894,18 @@ void BTrack::processOnsetDetectionFunctionSample (double newSample)
     // to zero. this is to avoid problems further down the line
     newSample = newSample + 0.0001;
     
+    beatDueInFrame = false;
+    
+    pickOnsets (1, newSample);
+    
+    if (tempoOnly)
+    {
+        addTempoOnlySamples (1, newSample);
+        return;
+    }
+    
 	m0--;
 	beatCounter--;
-	beatDueInFrame = false;
 		
 	// add new sample at the end
     onsetDF.addSampleToEnd (newSample);
@@ -265,9 +924,18 @@ void BTrack::processOnsetDetectionFunctionSample (double newSample)
 	{
 		beatDueInFrame = true;	// indicate a beat should be output
 		
-		// recalculate the tempo
-		resampleOnsetDetectionFunction();
-		calculateTempo();
+		// recalculate the tempo, unless it is locked
+		if (!tempoLocked)
+		{
+			beatsSinceTempoUpdate++;
+			
+			if (beatsSinceTempoUpdate >= beatsPerTempoUpdate)
+			{
+				resampleOnsetDetectionFunction();
+				calculateTempo();
+				beatsSinceTempoUpdate = 0;
+			}
+		}
 	}
 }
 
@@ -294,11 +962,11 @@ void BTrack::setTempo (double tempo)
 	// now set previous tempo observations to zero
 	for (int i=0;i < 41;i++)
 	{
-		prevDelta[i] = 0;
+		tempoEstimation->prevDelta[i] = 0;
 	}
 	
 	// set desired tempo index to 1
-	prevDelta[tempo_index] = 1;
+	tempoEstimation->prevDelta[tempo_index] = 1;
 	
 	
 	/////////// CUMULATIVE SCORE ARTIFICAL TEMPO UPDATE //////////////////
@@ -312,13 +980,13 @@ void BTrack::setTempo (double tempo)
 	{
 		if (bcounter == 1)
 		{
-			cumulativeScore[i] = 150;
-			onsetDF[i] = 150;
+			cumulativeScore.setSample (i, 150);
+			onsetDF.setSample (i, 150);
 		}
 		else
 		{
-			cumulativeScore[i] = 10;
-			onsetDF[i] = 10;
+			cumulativeScore.setSample (i, 10);
+			onsetDF.setSample (i, 10);
 		}
 		
 		bcounter++;
@@ -358,11 +1026,11 @@ void BTrack::fixTempo (double tempo)
 	// now set previous fixed previous tempo observation values to zero
 	for (int i=0;i < 41;i++)
 	{
-		prevDeltaFixed[i] = 0;
+		tempoEstimation->prevDeltaFixed[i] = 0;
 	}
 	
 	// set desired tempo index to 1
-	prevDeltaFixed[tempo_index] = 1;
+	tempoEstimation->prevDeltaFixed[tempo_index] = 1;
 		
 	// set the tempo fix flag
 	tempoFixed = true;
@@ -375,6 +1043,114 @@ void BTrack::doNotFixTempo()
 	tempoFixed = false;
 }
 
+//=======================================================================
+void BTrack::lockTempo (double tempo)
+{
+    if (tempo <= 0)
+    {
+        return;
+    }
+    
+    lockedTempo = tempo;
+    tempoLocked = true;
+    
+    // the cumulative score looks back two beat periods, so the period must fit in the buffer
+    beatPeriod = std::min (round (60/((((double) hopSize)/44100)*lockedTempo)), (double) ((onsetDFBufferSize - 1) / 2));
+    beatPeriod = std::max (beatPeriod, 1.0);
+    
+    estimatedTempo = 60.0/((((double) hopSize) / 44100.0) * beatPeriod);
+}
+
+//=======================================================================
+void BTrack::unlockTempo()
+{
+    tempoLocked = false;
+}
+
+//=======================================================================
+void BTrack::enableTempoOnlyMode (int hopsBetweenTempoUpdates)
+{
+    tempoOnly = true;
+    tempoUpdateInterval = std::max (hopsBetweenTempoUpdates, 1);
+    hopsSinceTempoUpdate = 0;
+}
+
+//=======================================================================
+void BTrack::disableTempoOnlyMode()
+{
+    tempoOnly = false;
+}
+
+//=======================================================================
+void BTrack::enableOnsetDetection (int lookAheadFrames, double relativeThreshold)
+{
+    onsetPicker.setWindow (lookAheadFrames, 8);
+    onsetPicker.setThreshold (relativeThreshold, 0.0);
+    onsetDetection = true;
+    onsetDueInFrame = false;
+}
+
+//=======================================================================
+void BTrack::disableOnsetDetection()
+{
+    onsetDetection = false;
+    onsetDueInFrame = false;
+}
+
+//=======================================================================
+bool BTrack::onsetDueInCurrentFrame()
+{
+    return onsetDueInFrame;
+}
+
+//=======================================================================
+int BTrack::getOnsetDelay()
+{
+    return onsetDueInFrame ? onsetDelay : onsetPicker.getLookAhead();
+}
+
+//=======================================================================
+void BTrack::pickOnsets (int numFrames, double sample)
+{
+    onsetDueInFrame = false;
+    
+    if (!onsetDetection)
+    {
+        return;
+    }
+    
+    // a constant can't be a peak, so only the first few frames of a long run can find an onset,
+    // confirming a peak from before the run. it is reported at the end of the run, the frames
+    // after the one that confirmed it adding to its delay
+    for (int i = 0; i < std::min (numFrames, onsetDFBufferSize); i++)
+    {
+        if (onsetPicker.processSample (sample))
+        {
+            onsetDueInFrame = true;
+            onsetDelay = onsetPicker.getLookAhead() + (numFrames - 1 - i);
+        }
+    }
+}
+
+//=======================================================================
+void BTrack::addTempoOnlySamples (int numFrames, double sample)
+{
+    // beyond the length of the buffer, earlier samples would only be pushed out again
+    for (int i = 0; i < std::min (numFrames, onsetDFBufferSize); i++)
+    {
+        onsetDF.addSampleToEnd (sample);
+    }
+    
+    hopsSinceTempoUpdate += numFrames;
+    
+    if ((hopsSinceTempoUpdate >= tempoUpdateInterval) && !tempoLocked)
+    {
+        resampleOnsetDetectionFunction();
+        calculateTempo();
+        hopsSinceTempoUpdate = 0;
+    }
+}
+
 //=======================================================================
 void BTrack::resampleOnsetDetectionFunction()
 {
@@ -382,9 +1158,12 @@ void BTrack::resampleOnsetDetectionFunction()
     
     float input[onsetDFBufferSize];
     
+    // the buffer history is contiguous, so read it directly without wrapping
+    const double* history = onsetDF.data();
+    
     for (int i = 0;i < onsetDFBufferSize;i++)
     {
-        input[i] = (float) onsetDF[i];
+        input[i] = (float) history[i];
     }
         
     double src_ratio = 512.0/((double) onsetDFBufferSize);
@@ -403,11 +1182,11 @@ void BTrack::resampleOnsetDetectionFunction()
     src_data.data_out = output;
     src_data.output_frames = output_len;
     
-    src_simple (&src_data, SRC_SINC_BEST_QUALITY, 1);
+    src_simple (&src_data, resamplerType, 1);
             
     for (int i = 0;i < output_len;i++)
     {
-        resampledOnsetDF[i] = (double) src_data.data_out[i];
+        tempoEstimation->resampledOnsetDF[i] = (double) src_data.data_out[i];
     }
 }
 
@@ -415,148 +1194,44 @@ void BTrack::resampleOnsetDetectionFunction()
 void BTrack::calculateTempo()
 {
 	// adaptive threshold on input
-	adaptiveThreshold (resampledOnsetDF,512);
+	BeatTracking::adaptiveThreshold<512> (tempoEstimation->resampledOnsetDF);
 		
 	// calculate auto-correlation function of detection function
-	calculateBalancedACF (resampledOnsetDF);
+	calculateBalancedACF (tempoEstimation->resampledOnsetDF);
 	
 	// calculate output of comb filterbank
 	calculateOutputOfCombFilterBank();
 	
 	// adaptive threshold on rcf
-	adaptiveThreshold (combFilterBankOutput,128);
-
+	BeatTracking::adaptiveThreshold<128> (tempoEstimation->combFilterBankOutput);
 	
-	int t_index;
-	int t_index2;
 	// calculate tempo observation vector from beat period observation vector
-	for (int i = 0;i < 41;i++)
-	{
-		t_index = (int) round (tempoToLagFactor / ((double) ((2*i)+80)));
-		t_index2 = (int) round (tempoToLagFactor / ((double) ((4*i)+160)));
-
-		
-		tempoObservationVector[i] = combFilterBankOutput[t_index-1] + combFilterBankOutput[t_index2-1];
-	}
-	
-	
-	double maxval;
-	double maxind;
-	double curval;
+	BeatTracking::calculateTempoObservationVector (tempoEstimation->combFilterBankOutput, tempoToLagFactor, tempoEstimation->tempoObservationVector);
 	
 	// if tempo is fixed then always use a fixed set of tempi as the previous observation probability function
 	if (tempoFixed)
 	{
 		for (int k = 0;k < 41;k++)
 		{
-			prevDelta[k] = prevDeltaFixed[k];
+			tempoEstimation->prevDelta[k] = tempoEstimation->prevDeltaFixed[k];
 		}
 	}
-		
-	for (int j=0;j < 41;j++)
-	{
-		maxval = -1;
-		for (int i = 0;i < 41;i++)
-		{
-			curval = prevDelta[i] * tempoTransitionMatrix[i][j];
-			
-			if (curval > maxval)
-			{
-				maxval = curval;
-			}
-		}
-		
-		delta[j] = maxval * tempoObservationVector[j];
-	}
-	
-
-	normaliseArray(delta,41);
-	
-	maxind = -1;
-	maxval = -1;
 	
-	for (int j=0;j < 41;j++)
-	{
-		if (delta[j] > maxval)
-		{
-			maxval = delta[j];
-			maxind = j;
-		}
-		
-		prevDelta[j] = delta[j];
-	}
+	int maxind = BeatTracking::updateTempoProbabilities (tempoEstimation->prevDelta, tempoEstimation->tempoTransitionMatrix, tempoEstimation->tempoObservationVector, tempoEstimation->delta);
 	
-	beatPeriod = round ((60.0*44100.0)/(((2*maxind)+80)*((double) hopSize)));
+	beatPeriod = BeatTracking::beatPeriodForTempoIndex (maxind, hopSize);
 	
 	if (beatPeriod > 0)
 	{
-		estimatedTempo = 60.0/((((double) hopSize) / 44100.0) * beatPeriod);
-	}
-}
-
-//=======================================================================
-void BTrack::adaptiveThreshold (double* x, int N)
-{
-	int i = 0;
-	int k,t = 0;
-	double x_thresh[N];
-	
-	int p_post = 7;
-	int p_pre = 8;
-	
-	t = std::min(N,p_post);	// what is smaller, p_post of df size. This is to avoid accessing outside of arrays
-	
-	// find threshold for first 't' samples, where a full average cannot be computed yet 
-	for (i = 0;i <= t;i++)
-	{	
-		k = std::min ((i+p_pre),N);
-		x_thresh[i] = calculateMeanOfArray (x,1,k);
-	}
-	// find threshold for bulk of samples across a moving average from [i-p_pre,i+p_post]
-	for (i = t+1;i < N-p_post;i++)
-	{
-		x_thresh[i] = calculateMeanOfArray (x,i-p_pre,i+p_post);
-	}
-	// for last few samples calculate threshold, again, not enough samples to do as above
-	for (i = N-p_post;i < N;i++)
-	{
-		k = std::max ((i-p_post),1);
-		x_thresh[i] = calculateMeanOfArray (x,k,N);
-	}
-	
-	// subtract the threshold from the detection function and check that it is not less than 0
-	for (i = 0; i < N; i++)
-	{
-		x[i] = x[i] - x_thresh[i];
-		if (x[i] < 0)
-		{
-			x[i] = 0;
-		}
+		estimatedTempo = BeatTracking::tempoForBeatPeriod (beatPeriod, hopSize);
 	}
 }
 
 //=======================================================================
 void BTrack::calculateOutputOfCombFilterBank()
 {
-	int numelem;
-	
-	for (int i = 0;i < 128;i++)
-	{
-		combFilterBankOutput[i] = 0;
-	}
-	
-	numelem = 4;
-	
-	for (int i = 2; i <= 127; i++) // max beat period
-	{
-		for (int a = 1; a <= numelem; a++) // number of comb elements
-		{
-			for (int b = 1-a; b <= a-1; b++) // general state using normalisation of comb elements
-			{
-				combFilterBankOutput[i-1] = combFilterBankOutput[i-1] + (acf[(a*i+b)-1]*weightingVector[i-1])/(2*a-1);	// calculate value for comb filter row
-			}
-		}
-	}
+    // 128 comb filters (the maximum beat period), each with 4 elements
+    DSPKernels::combFilterBank (tempoEstimation->acf, tempoEstimation->weightingVector, tempoEstimation->combFilterBankOutput, 128, 4);
 }
 
 //=======================================================================
@@ -564,175 +1239,36 @@ void BTrack::calculateBalancedACF (double* onsetDetectionFunction)
 {
     int onsetDetectionFunctionLength = 512;
     
-#ifdef USE_FFTW
-    // copy into complex array and zero pad
-    for (int i = 0;i < FFTLengthForACFCalculation;i++)
-    {
-        if (i < onsetDetectionFunctionLength)
-        {
-            complexIn[i][0] = onsetDetectionFunction[i];
-            complexIn[i][1] = 0.0;
-        }
-        else
-        {
-            complexIn[i][0] = 0.0;
-            complexIn[i][1] = 0.0;
-        }
-    }
-    
-    // perform the fft
-    fftw_execute (acfForwardFFT);
-    
-    // multiply by complex conjugate
-    for (int i = 0;i < FFTLengthForACFCalculation;i++)
-    {
-        complexOut[i][0] = complexOut[i][0]*complexOut[i][0] + complexOut[i][1]*complexOut[i][1];
-        complexOut[i][1] = 0.0;
-    }
+    double* acfSignal = acfFFT->getTimeDomainBuffer();
+    double* acfSpectrum = acfFFT->getSpectrumBuffer();
     
-    // perform the ifft
-    fftw_execute (acfBackwardFFT);
-    
-#endif
-    
-#ifdef USE_KISS_FFT
-    // copy into complex array and zero pad
+    // copy and zero pad
     for (int i = 0;i < FFTLengthForACFCalculation;i++)
     {
-        if (i < onsetDetectionFunctionLength)
-        {
-            fftIn[i].r = onsetDetectionFunction[i];
-            fftIn[i].i = 0.0;
-        }
-        else
-        {
-            fftIn[i].r = 0.0;
-            fftIn[i].i = 0.0;
-        }
+        acfSignal[i] = i < onsetDetectionFunctionLength ? onsetDetectionFunction[i] : 0.0;
     }
     
-    // execute kiss fft
-    kiss_fft (cfgForwards, fftIn, fftOut);
+    // perform the fft
+    acfFFT->performForwardTransform();
     
     // multiply by complex conjugate
-    for (int i = 0;i < FFTLengthForACFCalculation;i++)
-    {
-        fftOut[i].r = fftOut[i].r * fftOut[i].r + fftOut[i].i * fftOut[i].i;
-        fftOut[i].i = 0.0;
-    }
-    
-    // perform the ifft
-    kiss_fft (cfgBackwards, fftOut, fftIn);
+    BeatTracking::calculatePowerSpectrum (acfSpectrum, (FFTLengthForACFCalculation / 2) + 1);
     
-#endif
+    // perform the ifft, whose output is real
+    acfFFT->performInverseTransform();
     
-    double lag = 512;
-    
-    for (int i = 0; i < 512; i++)
-    {
-#ifdef USE_FFTW
-        // calculate absolute value of result
-        double absValue = sqrt (complexIn[i][0]*complexIn[i][0] + complexIn[i][1]*complexIn[i][1]);
-#endif
-        
-#ifdef USE_KISS_FFT
-        // calculate absolute value of result
-        double absValue = sqrt (fftIn[i].r * fftIn[i].r + fftIn[i].i * fftIn[i].i);
-#endif
-        // divide by inverse lad to deal with scale bias towards small lags
-        acf[i] = absValue / lag;
-        
-        // this division by 1024 is technically unnecessary but it ensures the algorithm produces
-        // exactly the same ACF output as the old time domain implementation. The time difference is
-        // minimal so I decided to keep it
-        acf[i] = acf[i] / 1024.;
-        
-        lag = lag - 1.;
-    }
-}
-
-//=======================================================================
-double BTrack::calculateMeanOfArray (double* array, int startIndex, int endIndex)
-{
-	int i;
-	double sum = 0;
-
-    int length = endIndex - startIndex;
-	
-	// find sum
-	for (i = startIndex; i < endIndex; i++)
-	{
-		sum = sum + array[i];
-	}
-	
-    if (length > 0)
-    {
-        return sum / length;	// average and return
-    }
-    else
-    {
-        return 0;
-    }
-}
-
-//=======================================================================
-void BTrack::normaliseArray (double* array, int N)
-{
-	double sum = 0;
-	
-	for (int i = 0; i < N; i++)
-	{
-		if (array[i] > 0)
-		{
-			sum = sum + array[i];
-		}
-	}
-	
-	if (sum > 0)
-	{
-		for (int i = 0; i < N; i++)
-		{
-			array[i] = array[i] / sum;
-		}
-	}
+    // divide by the number of overlapping samples to deal with the bias towards small lags
+    BeatTracking::balanceAutocorrelation (acfSignal, tempoEstimation->acf);
 }
 
 //=======================================================================
 void BTrack::updateCumulativeScore (double odfSample)
-{	 
-	int start, end, winsize;
-	double max;
-	
-	start = onsetDFBufferSize - round (2 * beatPeriod);
-	end = onsetDFBufferSize - round (beatPeriod / 2);
-	winsize = end-start+1;
-	
-	double w1[winsize];
-	double v = -2*beatPeriod;
-	double wcumscore;
-	
-	// create window
-	for (int i = 0; i < winsize; i++)
-	{
-		w1[i] = exp((-1 * pow (tightness * log (-v / beatPeriod), 2)) / 2);
-		v = v+1;
-	}	
+{
+	double pastWeights[onsetDFBufferSize];
+	int numPastWeights = BeatTracking::calculatePastWeights (pastWeights, beatPeriod, tightness);
 	
 	// calculate new cumulative score value
-	max = 0;
-	int n = 0;
-	for (int i=start; i <= end; i++)
-	{
-			wcumscore = cumulativeScore[i]*w1[n];
-		
-			if (wcumscore > max)
-			{
-				max = wcumscore;
-			}
-		n++;
-	}
-	
-    latestCumulativeScoreValue = ((1 - alpha) * odfSample) + (alpha * max);
+	latestCumulativeScoreValue = BeatTracking::calculateCumulativeScore (cumulativeScore.data(), onsetDFBufferSize, beatPeriod, pastWeights, numPastWeights, odfSample, alpha);
     
     cumulativeScore.addSampleToEnd (latestCumulativeScoreValue);
 }
@@ -742,77 +1278,18 @@ void BTrack::predictBeat()
 {	 
 	int windowSize = (int) beatPeriod;
 	double futureCumulativeScore[onsetDFBufferSize + windowSize];
-	double w2[windowSize];
+	double futureWeights[windowSize];
+	double pastWeights[onsetDFBufferSize];
     
 	// copy cumscore to first part of fcumscore
-	for (int i = 0;i < onsetDFBufferSize;i++)
-	{
-		futureCumulativeScore[i] = cumulativeScore[i];
-	}
-	
-	// create future window
-	double v = 1;
-	for (int i = 0; i < windowSize; i++)
-	{
-		w2[i] = exp((-1*pow((v - (beatPeriod/2)),2))   /  (2*pow((beatPeriod/2) ,2)));
-		v++;
-	}
-	
-	// create past window
-	v = -2*beatPeriod;
-	int start = onsetDFBufferSize - round(2*beatPeriod);
-	int end = onsetDFBufferSize - round(beatPeriod/2);
-	int pastwinsize = end-start+1;
-	double w1[pastwinsize];
-
-	for (int i = 0;i < pastwinsize;i++)
-	{
-		w1[i] = exp((-1*pow(tightness*log(-v/beatPeriod),2))/2);
-		v = v+1;
-	}
-
-	// calculate future cumulative score
-	double max;
-	int n;
-	double wcumscore;
-	for (int i = onsetDFBufferSize; i < (onsetDFBufferSize + windowSize); i++)
-	{
-		start = i - round (2*beatPeriod);
-		end = i - round (beatPeriod/2);
-		
-		max = 0;
-		n = 0;
-		for (int k=start;k <= end;k++)
-		{
-			wcumscore = futureCumulativeScore[k]*w1[n];
-			
-			if (wcumscore > max)
-			{
-				max = wcumscore;
-			}
-			n++;
-		}
-		
-		futureCumulativeScore[i] = max;
-	}
+	std::copy (cumulativeScore.data(), cumulativeScore.data() + onsetDFBufferSize, futureCumulativeScore);
 	
-	// predict beat
-	max = 0;
-	n = 0;
+	// create the future and past windows
+	BeatTracking::calculateFutureWeights (futureWeights, beatPeriod);
+	int numPastWeights = BeatTracking::calculatePastWeights (pastWeights, beatPeriod, tightness);
 	
-	for (int i = onsetDFBufferSize; i < (onsetDFBufferSize + windowSize); i++)
-	{
-		wcumscore = futureCumulativeScore[i]*w2[n];
-		
-		if (wcumscore > max)
-		{
-			max = wcumscore;
-			beatCounter = n;
-		}	
-		
-		n++;
-	}
+	beatCounter = BeatTracking::predictBeat (futureCumulativeScore, onsetDFBufferSize, beatPeriod, pastWeights, numPastWeights, futureWeights, beatCounter);
 		
 	// set next prediction time
 	m0 = beatCounter + round (beatPeriod / 2);
-}
\ No newline at end of file
+}
@@ -24,7 +24,26 @@
 
 #include "OnsetDetectionFunction.h"
 #include "CircularBuffer.h"
+#include "CPUBudgetGovernor.h"
+#include "OnsetPicker.h"
 #include <vector>
+#include <atomic>
+#include <chrono>
+
+class BeatSynchronousFeatures;
+
+//=======================================================================
+/** The quality levels that the beat tracker steps through when processing to a
+ * CPU budget. Each level is cheaper than the one before it */
+enum QualityLevel
+{
+    FullQuality,                        /**< the configured detection function, best quality resampling and a tempo update at every beat */
+    FastResamplingQuality,              /**< faster resampling of the onset detection function for tempo estimation */
+    SpectralDifferenceQuality,          /**< the half-wave rectified spectral difference detection function, which needs no phase calculations */
+    ReducedTempoUpdateQuality,          /**< linear resampling and a tempo update at every second beat */
+    EnergyDifferenceQuality,            /**< the energy difference detection function, which needs no FFT, and a tempo update at every fourth beat */
+    NumQualityLevels
+};
 
 //=======================================================================
 /** The main beat tracking class and the interface to the BTrack
@@ -48,12 +67,25 @@ public:
     /** Constructor taking both hopSize and frameSize
      * @param hopSize the hop size in audio samples
      * @param frameSize the frame size in audio samples
+     * @param memory_ where to allocate all of the buffers from (e.g. a MemoryArena, so that
+     * the buffers of many instances sit together in one block), or NULL for the heap. The
+     * resource must outlive this instance
      */
-    BTrack (int hopSize_, int frameSize_);
+    BTrack (int hopSize_, int frameSize_, MemoryResource* memory_ = NULL);
+    
+    /** Move constructor. The moved from instance can only be destroyed or assigned to afterwards
+     * @param other the instance to take the state, buffers and FFTs of
+     */
+    BTrack (BTrack&& other);
     
     /** Destructor */
     ~BTrack();
     
+    /** Move assignment. The moved from instance can only be destroyed or assigned to afterwards
+     * @param other the instance to take the state, buffers and FFTs of
+     */
+    BTrack& operator= (BTrack&& other);
+    
     //=======================================================================
     /** Updates the hop and frame size used by the beat tracker 
      * @param hopSize the hop size in audio samples
@@ -61,6 +93,19 @@ public:
      */
     void updateHopAndFrameSize (int hopSize_, int frameSize_);
     
+    /** Prepares a change of hop and frame size without interrupting beat tracking. All memory
+     * is allocated here, so this should be called away from the audio thread. The change is then
+     * applied at the start of the next call to processAudioFrame() or
+     * processOnsetDetectionFunctionSample(), where the existing onset detection function and
+     * cumulative score history is resampled to the new hop size rather than being reset
+     * @param hopSize the hop size in audio samples
+     * @param frameSize the frame size in audio samples
+     * @returns false if the audio thread is in the middle of applying a previously prepared change,
+     * in which case this can simply be called again. A prepared change that has not yet been
+     * applied is replaced
+     */
+    bool prepareHopAndFrameSize (int hopSize_, int frameSize_);
+    
     //=======================================================================
     /** Process a single audio frame 
      * @param frame a pointer to an array containing an audio frame. The number of samples should 
@@ -68,10 +113,96 @@ public:
      */
     void processAudioFrame (double* frame);
     
+    /** Process a complete, overlapping audio frame, as delivered by hosts that do their own
+     * framing (such as Vamp hosts). Consecutive frames should overlap so that they advance by
+     * the hop size, and each frame should contain the frame size in samples
+     * @param frame a pointer to an array containing a complete audio frame
+     */
+    void processOverlappingFrame (const double* frame);
+    
+    /** Process a complete, overlapping audio frame (see processOverlappingFrame())
+     * @param frame a pointer to an array containing a complete audio frame
+     */
+    void processOverlappingFrame (const float* frame);
+    
+    /** Process the spectrum of an audio frame that has already been computed, so that the FFT
+     * can be shared with other analysis. Only the onset detection function difference stage is run
+     * (see OnsetDetectionFunction::calculateOnsetDetectionFunctionSampleFromSpectrum())
+     * @param real the real parts of the first (frameSize/2)+1 bins of the FFT of a windowed frame
+     * @param imag the imaginary parts of the first (frameSize/2)+1 bins of the FFT of a windowed frame
+     */
+    void processSpectrumFrame (const double* real, const double* imag);
+    
+    /** Process the spectrum of an audio frame, given in magnitude and phase form (see processSpectrumFrame())
+     * @param magnitude the magnitudes of the first (frameSize/2)+1 bins of the FFT of a windowed frame
+     * @param phase the phases, in radians, of the first (frameSize/2)+1 bins of the FFT of a windowed frame
+     */
+    void processPolarSpectrumFrame (const double* magnitude, const double* phase);
+    
     /** Add new onset detection function sample to buffer and apply beat tracking 
      * @param sample an onset detection function sample
      */
     void processOnsetDetectionFunctionSample (double sample);
+    
+    /** Advances the beat tracker over a run of frames in which the onset detection function
+     * is constant, such as silence or a gap left by dropped audio. Rather than processing each
+     * frame, the cumulative score is extrapolated in closed form, beats continue at the current
+     * beat period and the tempo is left unchanged
+     * @param numFrames the number of frames to advance by
+     * @param sample the onset detection function value throughout those frames
+     * @returns the number of beats that fell within the skipped frames. If the last of them fell
+     * on the final frame then beatDueInCurrentFrame() will return true
+     */
+    int advanceFrames (int numFrames, double sample = 0.0);
+    
+    /** Set the level below which audio passed to processAudioFrame() is treated as silence.
+     * Silent frames skip the onset detection function and are passed to advanceFrames(), so
+     * idle input costs almost nothing to process
+     * @param meanSquareThreshold the mean squared sample value at or below which a hop is
+     * silent, or zero (the default) to process all audio normally
+     */
+    void setSilenceThreshold (double meanSquareThreshold);
+    
+    /** Skip the phase calculations of bins that are far below the loudest bin of each frame,
+     * which add almost nothing to the complex spectral difference (see
+     * OnsetDetectionFunction::setPhaseMagnitudeFloor())
+     * @param relativeFloor the fraction of the largest magnitude in a frame below which a bin's
+     * phase isn't calculated, or zero (the default) to calculate every phase
+     */
+    void setPhaseMagnitudeFloor (double relativeFloor);
+    
+    /** Calculate the spectrum of each hop with a sliding DFT rather than an FFT of the whole
+     * frame, which is quicker for very small hop sizes (see OnsetDetectionFunction::setSlidingDFT()).
+     * This allocates memory, so it should not be called on the audio thread
+     * @param enabled true to use the sliding DFT, false (the default) to use an FFT every hop
+     */
+    void setSlidingDFT (bool enabled);
+    
+    /** Calculate the onset detection function from a range of FFT bins only, e.g. the low
+     * frequencies of kick drums, which for a narrow range also avoids most of the transform (see
+     * OnsetDetectionFunction::setBinRange()). When the frame size changes the range is scaled to
+     * cover the same frequencies. This allocates memory, so it should not be called on the audio thread
+     * @param firstBin the lowest bin to include, from 0 (DC) upwards
+     * @param lastBin the highest bin to include, up to frameSize/2
+     */
+    void setBinRange (int firstBin_, int lastBin_);
+    
+    /** Set the FFT implementation used for both the onset detection function and the tempo
+     * estimate. The backend can be shared with other instances. This creates new FFTs, so it
+     * should not be called on the audio thread
+     * @param backend the backend to create FFTs from (see FFTBackend)
+     */
+    void setFFTBackend (std::shared_ptr<FFTBackend> backend);
+    
+    /** Accumulate features of the spectrum of each frame, which the onset detection function
+     * has already calculated, and average them over each beat. Whenever beatDueInCurrentFrame()
+     * returns true the features of the beat that has just ended are ready. Only frames that
+     * BTrack analyses itself are accumulated, so this has no effect when onset detection function
+     * samples are passed in directly. Spectra are left out while the frame size differs from the
+     * one the features were set up for
+     * @param features the features to accumulate, which must outlive this instance, or NULL to stop
+     */
+    void setBeatSynchronousFeatures (BeatSynchronousFeatures* features);
    
     //=======================================================================
     /** @returns the current hop size being used by the beat tracker */
@@ -86,6 +217,11 @@ public:
     /** @returns the most recent value of the cumulative score function */
     double getLatestCumulativeScoreValue();
     
+    /** @returns the number of bytes used by this instance, counting the object itself and all of
+     * the buffers and FFTs that it has allocated, including those of a prepared hop and frame size change
+     */
+    size_t memoryFootprint() const;
+    
     //=======================================================================
     /** Set the tempo of the beat tracker 
      * @param tempo the tempo in beats per minute (bpm)
@@ -101,6 +237,75 @@ public:
     /** Tell the algorithm to not fix the tempo anymore */
     void doNotFixTempo();
     
+    /** Lock the beat tracker to exactly the given tempo. Unlike fixTempo(), the tempo is not
+     * estimated at all while locked, so only the beat phase is tracked and no tempo calculation
+     * takes place when a beat is due
+     * @param tempo the tempo in beats per minute (bpm)
+     */
+    void lockTempo (double tempo);
+    
+    /** Stop locking the tempo and return to estimating it from the input */
+    void unlockTempo();
+    
+    //=======================================================================
+    /** Only estimate the tempo. The cumulative score and beat prediction are skipped entirely,
+     * so no beats are reported, and the tempo is re-estimated on a fixed clock instead of
+     * whenever a beat occurs
+     * @param hopsBetweenTempoUpdates the number of onset detection function samples between tempo estimates
+     */
+    void enableTempoOnlyMode (int hopsBetweenTempoUpdates);
+    
+    /** Return to tracking beats, with the tempo re-estimated at each beat */
+    void disableTempoOnlyMode();
+    
+    //=======================================================================
+    /** Pick onsets from the onset detection function as well as tracking beats. Each sample is
+     * compared with the mean of the samples around it, as in the adaptive threshold used for
+     * tempo estimation, so an onset is only reported once a few more frames have come in (see
+     * getOnsetDelay()). This allocates memory, so it should not be called on the audio thread
+     * @param lookAheadFrames the number of frames after an onset that are waited for before reporting it
+     * @param relativeThreshold how far above the local mean of the onset detection function an
+     * onset has to be, as a multiple of the mean
+     */
+    void enableOnsetDetection (int lookAheadFrames = 2, double relativeThreshold = 1.0);
+    
+    /** Stop picking onsets */
+    void disableOnsetDetection();
+    
+    /** @returns true if an onset was found in the current audio frame. The onset itself happened
+     * getOnsetDelay() frames before the current one */
+    bool onsetDueInCurrentFrame();
+    
+    /** @returns the number of frames between an onset and onsetDueInCurrentFrame() reporting it,
+     * so that an onset reported in frame n happened in frame n - getOnsetDelay(). This is the look
+     * ahead, except for an onset found while advanceFrames() skipped several frames, which is
+     * reported at the end of them with the skipped frames after it added to its delay */
+    int getOnsetDelay();
+    
+    //=======================================================================
+    /** Set a CPU budget for processing audio. The time taken by each call to processAudioFrame(),
+     * processOverlappingFrame(), processSpectrumFrame() or processPolarSpectrumFrame() is measured
+     * and the tracker steps through the quality levels (see QualityLevel) to keep the average
+     * within the budget, trading tracking accuracy for processing time. Onset detection function
+     * samples passed to processOnsetDetectionFunctionSample() aren't measured
+     * @param secondsPerHop the average time that processing a frame should take, or zero to
+     * disable the budget and return to full quality
+     */
+    void setProcessingBudget (double secondsPerHop);
+    
+    /** Set the quality level directly. If a processing budget is set, the level may later
+     * be changed again to keep to the budget
+     * @param level the quality level (see QualityLevel)
+     */
+    void setQualityLevel (int level);
+    
+    /** @returns the current quality level (see QualityLevel) */
+    int getQualityLevel();
+    
+    /** @returns true if the quality level was changed to keep to the processing budget
+     * during the current audio frame */
+    bool qualityLevelChangedInCurrentFrame();
+    
     //=======================================================================
     /** Calculates a beat time in seconds, given the frame number, hop size and sampling frequency.
      * This version uses a long to represent the frame number
@@ -134,6 +339,68 @@ private:
      */
     void setHopSize (int hopSize_);
     
+    /** Swaps in a hop and frame size change prepared by prepareHopAndFrameSize(), if
+     * there is one. This does not allocate any memory
+     */
+    void applyPendingReconfiguration();
+    
+    /** Linearly resamples the contents of one buffer to fill another buffer of a different
+     * size, so that both cover the same period of time
+     * @param source the buffer to read from
+     * @param destination the buffer to write to
+     */
+    void resampleHistory (const CircularBuffer<double>& source, CircularBuffer<double>& destination);
+    
+    /** Destroy the pending onset detection function, returning its memory to the resource it came from */
+    void deletePendingODF();
+    
+    /** Destroy the tempo estimation buffers, returning their memory to the resource they came from */
+    void deleteTempoEstimationBuffers();
+    
+    /** Takes everything apart from the onset detection function from another instance,
+     * leaving it with no pending onset detection function or tempo estimation buffers
+     * @param other the instance being moved from
+     */
+    void takeStateFrom (BTrack& other);
+    
+    /** Calculates the onset detection function sample for a frame of input and passes it on to
+     * the beat tracker. Every frame input goes through here, so that each one picks up a pending
+     * reconfiguration and is measured against the processing budget in the same way
+     * @param calculate the OnsetDetectionFunction function that calculates the sample
+     * @param args the frame of input to pass to it
+     */
+    template <typename... Args>
+    void processFrame (double (OnsetDetectionFunction::*calculate) (Args...), Args... args);
+    
+    /** Passes a newly calculated onset detection function sample on to the beat tracker,
+     * taking account of reconfiguration and silence
+     * @param sample the onset detection function sample
+     */
+    void processCalculatedOnsetDetectionFunctionSample (double sample);
+    
+    /** Passes onset detection function samples on to the onset picker, if onsets are being picked
+     * @param numFrames the number of frames that the sample was constant for
+     * @param sample the conditioned onset detection function sample
+     */
+    void pickOnsets (int numFrames, double sample);
+    
+    /** Adds onset detection function samples in tempo only mode, estimating the tempo when it is due
+     * @param numFrames the number of frames that the sample was constant for
+     * @param sample the conditioned onset detection function sample
+     */
+    void addTempoOnlySamples (int numFrames, double sample);
+    
+    /** Starts timing a frame for the processing budget, if one is set */
+    void startFrameMeasurement();
+    
+    /** Passes the time taken by a frame to the governor, changing the quality level if it asks to */
+    void finishFrameMeasurement();
+    
+    /** Applies the settings for a quality level (see QualityLevel)
+     * @param level the quality level
+     */
+    void applyQualityLevel (int level);
+    
     /** Resamples the onset detection function from an arbitrary number of samples to 512 */
     void resampleOnsetDetectionFunction();
     
@@ -148,27 +415,6 @@ private:
     /** Calculates the current tempo expressed as the beat period in detection function samples */
     void calculateTempo();
     
-    /** Calculates an adaptive threshold which is used to remove low level energy from detection
-     * function and emphasise peaks 
-     * @param x a pointer to an array containing onset detection function samples
-     * @param N the length of the array, x
-     */
-    void adaptiveThreshold (double* x, int N);
-    
-    /** Calculates the mean of values in an array between index locations [startIndex,endIndex]
-     * @param array a pointer to an array that contains the values we wish to find the mean from
-     * @param startIndex the start index from which we would like to calculate the mean
-     * @param endIndex the final index to which we would like to calculate the mean
-     * @returns the mean of the sub-section of the array
-     */
-    double calculateMeanOfArray (double* array, int startIndex, int endIndex);
-    
-    /** Normalises a given array
-     * @param array a pointer to the array we wish to normalise
-     * @param N the length of the array
-     */
-    void normaliseArray (double* array, int N);
-    
     /** Calculates the balanced autocorrelation of the smoothed onset detection function
      * @param onsetDetectionFunction a pointer to an array containing the onset detection function
      */
@@ -183,52 +429,110 @@ private:
     OnsetDetectionFunction odf;
     
     //=======================================================================
-	// buffers
-    
-    CircularBuffer onsetDF;                 /**< to hold onset detection function */
-    CircularBuffer cumulativeScore;         /**< to hold cumulative score */
-    
-    double resampledOnsetDF[512];           /**< to hold resampled detection function */
-    double acf[512];                        /**<  to hold autocorrelation function */
-    double weightingVector[128];            /**<  to hold weighting vector */
-    double combFilterBankOutput[128];       /**<  to hold comb filter output */
-    double tempoObservationVector[41];      /**<  to hold tempo version of comb filter output */
-    double delta[41];                       /**<  to hold final tempo candidate array */
-    double prevDelta[41];                   /**<  previous delta */
-    double prevDeltaFixed[41];              /**<  fixed tempo version of previous delta */
-    double tempoTransitionMatrix[41][41];   /**<  tempo transition matrix */
+    // state used at every hop, kept together at the front of the object
     
-	//=======================================================================
-    // parameters
+    CircularBuffer<double> onsetDF;         /**< to hold onset detection function */
+    CircularBuffer<double> cumulativeScore; /**< to hold cumulative score */
+    ArenaVector<double> skippedScores;      /**< to hold the cumulative score values calculated by advanceFrames() */
     
     double tightness;                       /**< the tightness of the weighting used to calculate cumulative score */
     double alpha;                           /**< the mix between the current detection function sample and the cumulative score's "momentum" */
     double beatPeriod;                      /**< the beat period, in detection function samples */
-    double tempo;                           /**< the tempo in beats per minute */
-    double estimatedTempo;                  /**< the current tempo estimation being used by the algorithm */
     double latestCumulativeScoreValue;      /**< holds the latest value of the cumulative score function */
-    double tempoToLagFactor;                /**< factor for converting between lag and tempo */
     int m0;                                 /**< indicates when the next point to predict the next beat is */
     int beatCounter;                        /**< keeps track of when the next beat is - will be zero when the beat is due, and is set elsewhere in the algorithm to be positive once a beat prediction is made */
     int hopSize;                            /**< the hop size being used by the algorithm */
     int onsetDFBufferSize;                  /**< the onset detection function buffer size */
-    bool tempoFixed;                        /**< indicates whether the tempo should be fixed or not */
+    int tempoUpdateInterval;                /**< the number of hops between tempo estimates in tempo only mode */
+    int hopsSinceTempoUpdate;               /**< the number of hops since the tempo was last estimated in tempo only mode */
+    bool tempoOnly;                         /**< indicates that only the tempo is being estimated */
+    bool tempoLocked;                       /**< indicates whether the tempo is locked, skipping tempo estimation */
     bool beatDueInFrame;                    /**< indicates whether a beat is due in the current frame */
+    bool qualityLevelChanged;               /**< indicates that the quality level changed in the current frame */
+    bool holdOnsetDetectionFunctionSample;  /**< indicates that the first sample after a reconfiguration should repeat the last one */
+    
+    //=======================================================================
+    // reconfiguration
+    
+    /** The states of a hop and frame size change */
+    enum ReconfigurationState
+    {
+        NoReconfiguration,
+        PreparingReconfiguration,
+        ReconfigurationReady,
+        ApplyingReconfiguration
+    };
+    
+    std::atomic<int> reconfigurationState;  /**< the state of any pending hop and frame size change */
+    MemoryResource* memory;                 /**< where the buffers are allocated from */
+    OnsetDetectionFunction* pendingODF;     /**< the onset detection function to swap in, which holds the retired one afterwards */
+    CircularBuffer<double> pendingOnsetDF;  /**< onset detection function buffer at the pending hop size */
+    CircularBuffer<double> pendingCumulativeScore; /**< cumulative score buffer at the pending hop size */
+    ArenaVector<double> pendingSkippedScores; /**< advanceFrames() scratch buffer at the pending hop size */
+    int pendingHopSize;                     /**< the pending hop size */
+    
+    // copies of the detection function's settings, so that a change can be prepared
+    // without reading the detection function that the audio thread is using
+    int windowType;                         /**< the window type of the onset detection function */
+    std::shared_ptr<FFTBackend> fftBackend; /**< the FFT backend of the onset detection function */
+    double silenceThreshold;                /**< the silence threshold of the onset detection function */
+    double phaseMagnitudeFloor;             /**< the phase magnitude floor of the onset detection function */
+    bool slidingDFTEnabled;                 /**< indicates that the onset detection function uses a sliding DFT */
+    int firstBin;                           /**< the first bin of the onset detection function's bin range */
+    int lastBin;                            /**< the last bin of the onset detection function's bin range */
+    int binRangeFrameSize;                  /**< the frame size that the bin range is for */
+    
+    //=======================================================================
+    // tempo estimation
+    
+    /** The buffers that are only used when the tempo is estimated. These are allocated
+     * separately so that they don't come between the state used at every hop, and so that
+     * moving a BTrack doesn't copy them */
+    struct TempoEstimationBuffers
+    {
+        double resampledOnsetDF[512];           /**< to hold resampled detection function */
+        double acf[512];                        /**<  to hold autocorrelation function */
+        double weightingVector[128];            /**<  to hold weighting vector */
+        double combFilterBankOutput[128];       /**<  to hold comb filter output */
+        double tempoObservationVector[41];      /**<  to hold tempo version of comb filter output */
+        double delta[41];                       /**<  to hold final tempo candidate array */
+        double prevDelta[41];                   /**<  previous delta */
+        double prevDeltaFixed[41];              /**<  fixed tempo version of previous delta */
+        double tempoTransitionMatrix[41][41];   /**<  tempo transition matrix */
+    };
+    
+    TempoEstimationBuffers* tempoEstimation; /**< the buffers used to estimate the tempo */
+    
+    double tempo;                           /**< the tempo in beats per minute */
+    double estimatedTempo;                  /**< the current tempo estimation being used by the algorithm */
+    double tempoToLagFactor;                /**< factor for converting between lag and tempo */
+    bool tempoFixed;                        /**< indicates whether the tempo should be fixed or not */
+    double lockedTempo;                     /**< the tempo in beats per minute that the tracker is locked to */
     int FFTLengthForACFCalculation;         /**< the FFT length for the auto-correlation function calculation */
+    std::unique_ptr<RealFFT> acfFFT;        /**< real FFT for calculating auto-correlation function */
     
-#ifdef USE_FFTW
-    fftw_plan acfForwardFFT;                /**< forward fftw plan for calculating auto-correlation function */
-    fftw_plan acfBackwardFFT;               /**< inverse fftw plan for calculating auto-correlation function */
-    fftw_complex* complexIn;                /**< to hold complex fft values for input */
-    fftw_complex* complexOut;               /**< to hold complex fft values for output */
-#endif
+    //=======================================================================
+    // processing budget
     
-#ifdef USE_KISS_FFT
-    kiss_fft_cfg cfgForwards;               /**< Kiss FFT configuration */
-    kiss_fft_cfg cfgBackwards;              /**< Kiss FFT configuration */
-    kiss_fft_cpx* fftIn;                    /**< FFT input samples, in complex form */
-    kiss_fft_cpx* fftOut;                   /**< FFT output samples, in complex form */
-#endif
+    CPUBudgetGovernor governor;             /**< chooses the quality level from measured processing times */
+    std::chrono::steady_clock::time_point frameStartTime; /**< when processing of the current frame started */
+    int fullQualityOnsetDetectionFunctionType; /**< the onset detection function type used at full quality */
+    int resamplerType;                      /**< the libsamplerate converter used to resample the onset detection function */
+    int beatsPerTempoUpdate;                /**< the number of beats between tempo estimates */
+    int beatsSinceTempoUpdate;              /**< the number of beats since the tempo was last estimated */
+    
+    //=======================================================================
+    // beat synchronous features
+    
+    BeatSynchronousFeatures* beatFeatures;  /**< accumulates features of each frame over each beat, if set */
+    
+    //=======================================================================
+    // onset picking
+    
+    OnsetPicker onsetPicker;                /**< finds onsets in the onset detection function */
+    bool onsetDetection;                    /**< indicates that onsets are being picked */
+    bool onsetDueInFrame;                   /**< indicates whether an onset was found in the current frame */
+    int onsetDelay;                         /**< the number of frames before the current one that the onset found in it happened */
 
 };
 
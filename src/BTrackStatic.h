@@ -0,0 +1,386 @@
+//=======================================================================
+/** @file BTrackStatic.h
+ *  @brief A version of BTrack whose hop and frame size are fixed at compile time
+ *  @author Adam Stark
+ *  @copyright Copyright (C) 2008-2014  Queen Mary University of London
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+//=======================================================================
+
+#ifndef BTrackStatic_h
+#define BTrackStatic_h
+
+#include <math.h>
+#include <array>
+#include <algorithm>
+#include "BeatTracking.h"
+#include "BuiltinFFT.h"
+#include "CircularBuffer.h"
+#include "DSPKernels.h"
+#include "ScopedNoDenormals.h"
+
+//=======================================================================
+/** The BTrack algorithm for a hop size and frame size that are fixed at compile
+ * time, for embedded and plugin builds. Every buffer is a std::array held in
+ * the object itself, so nothing is ever allocated and there are no variable
+ * length arrays, and the windows are calculated once in the constructor.
+ * The tempo estimation and beat prediction are BTrack's own (see BeatTracking),
+ * and the inner loops are the DSPKernels used by OnsetDetectionFunction, so the
+ * detection function is the same as BTrack's to the last bit.
+ *
+ * The onset detection function is the complex spectral difference (half wave
+ * rectified) of Hanning windowed frames, as in BTrack's default, calculated
+ * with the built in FFT. Unlike BTrack, the detection function is resampled
+ * linearly for tempo estimation, which is an identity at a hop size of 512.
+ *
+ * Instances can be copied and moved, so they can be kept in containers.
+ */
+template <int HopSize, int FrameSize>
+class BTrackStatic
+{
+public:
+
+    static const int hopSize = HopSize;                         /**< the hop size in audio samples */
+    static const int frameSize = FrameSize;                     /**< the frame size in audio samples */
+    static const int onsetDFBufferSize = (512 * 512) / HopSize; /**< the onset detection function buffer size */
+
+    static_assert (HopSize > 0 && HopSize <= FrameSize, "the hop size must be between 1 and the frame size");
+    static_assert (FrameSize >= 4 && (FrameSize & (FrameSize - 1)) == 0, "the frame size must be a power of two of at least 4");
+    static_assert (onsetDFBufferSize >= 256, "the hop size is too large to hold two beat periods at the slowest tempo");
+
+    //=======================================================================
+    /** Constructor */
+    BTrackStatic()
+     :  tightness (5),
+        alpha (0.9),
+        estimatedTempo (120.0),
+        latestCumulativeScoreValue (0),
+        weightsBeatPeriod (0),
+        m0 (10),
+        beatCounter (-1),
+        beatDueInFrame (false)
+    {
+        double pi = 3.14159265358979;
+        double N = (double) (FrameSize - 1);
+
+        // Hanning window, as calculated by OnsetDetectionFunction
+        for (int n = 0; n < FrameSize; n++)
+        {
+            window[n] = 0.5 * (1 - cos (2 * pi * (n / N)));
+        }
+
+        frame.fill (0);
+        magSpec.fill (0);
+        prevMagSpec.fill (0);
+        phaseDeviations.fill (0);
+        prevPhase.fill (0);
+        prevPhase2.fill (0);
+
+        BeatTracking::calculateWeightingVector (&weightingVector[0]);
+        BeatTracking::calculateTempoTransitionMatrix (tempoTransitionMatrix);
+        prevDelta.fill (1);
+
+        // start with a click at every beat of 120 bpm
+        beatPeriod = round (60 / ((((double) HopSize) / 44100) * 120));
+
+        for (int i = 0; i < onsetDFBufferSize; i++)
+        {
+            if ((i % ((int) beatPeriod)) == 0)
+            {
+                onsetDF.setSample (i, 1);
+            }
+        }
+    }
+
+    //=======================================================================
+    /** Process a hop of audio
+     * @param hop a pointer to an array containing HopSize audio samples
+     */
+    void processAudioFrame (const double* hop)
+    {
+        ScopedNoDenormals noDenormals;
+
+        processOnsetDetectionFunctionSample (calculateOnsetDetectionFunctionSample (hop));
+    }
+
+    /** Add new onset detection function sample to buffer and apply beat tracking
+     * @param sample an onset detection function sample
+     */
+    void processOnsetDetectionFunctionSample (double sample)
+    {
+        ScopedNoDenormals noDenormals;
+
+        // keep the sample positive and away from zero, as BTrack does
+        sample = fabs (sample) + 0.0001;
+
+        beatDueInFrame = false;
+
+        m0--;
+        beatCounter--;
+
+        onsetDF.addSampleToEnd (sample);
+
+        updateCumulativeScore (sample);
+
+        // if we are halfway between beats
+        if (m0 == 0)
+        {
+            predictBeat();
+        }
+
+        // if we are at a beat
+        if (beatCounter == 0)
+        {
+            beatDueInFrame = true;
+
+            resampleOnsetDetectionFunction();
+            calculateTempo();
+        }
+    }
+
+    /** Calculate the onset detection function sample for a hop of audio, without tracking beats
+     * @param hop a pointer to an array containing HopSize audio samples
+     * @returns the complex spectral difference (half wave rectified) of the frame ending with the hop
+     */
+    double calculateOnsetDetectionFunctionSample (const double* hop)
+    {
+        ScopedNoDenormals noDenormals;
+
+        // shift audio samples back in frame by hop size and add the new ones
+        std::copy (frame.begin() + HopSize, frame.end(), frame.begin());
+        std::copy (hop, hop + HopSize, frame.begin() + (FrameSize - HopSize));
+
+        // window frame, swapping the first and second half of the signal
+        const int fsize2 = FrameSize / 2;
+        DSPKernels::applyWindow (&frame[fsize2], &window[fsize2], &fftIn[0], fsize2);
+        DSPKernels::applyWindow (&frame[0], &window[0], &fftIn[fsize2], fsize2);
+
+        // only the first (N/2)+1 bins are calculated, which is all the detection function reads
+        fft.performRealFFT (&fftIn[0], &spectrum[0]);
+
+        return complexSpectralDifferenceHWR();
+    }
+
+    //=======================================================================
+    /** @returns the hop size being used by the beat tracker */
+    int getHopSize() const
+    {
+        return HopSize;
+    }
+
+    /** @returns true if a beat should occur in the current audio frame */
+    bool beatDueInCurrentFrame() const
+    {
+        return beatDueInFrame;
+    }
+
+    /** @returns the current tempo estimate being used by the beat tracker */
+    double getCurrentTempoEstimate() const
+    {
+        return estimatedTempo;
+    }
+
+    /** @returns the most recent value of the cumulative score function */
+    double getLatestCumulativeScoreValue() const
+    {
+        return latestCumulativeScoreValue;
+    }
+
+private:
+
+    //=======================================================================
+    /** Calculate the complex spectral difference (half wave rectified) from the spectrum of the current frame */
+    double complexSpectralDifferenceHWR()
+    {
+        const int numBins = (FrameSize / 2) + 1;
+
+        // the bins above FrameSize/2 mirror those below, so as in OnsetDetectionFunction
+        // only the lower half is analysed, and the upper half is summed from its mirror image
+        DSPKernels::magnitudes (&spectrum[0], &magSpec[0], numBins);
+
+        for (int i = 0; i < numBins; i++)
+        {
+            double phase = atan2 (spectrum[2 * i + 1], spectrum[2 * i]);
+
+            phaseDeviations[i] = cos (phase - (2 * prevPhase[i]) + prevPhase2[i]);
+
+            prevPhase2[i] = prevPhase[i];
+            prevPhase[i] = phase;
+        }
+
+        DSPKernels::complexSpectralDifference (&magSpec[0], &prevMagSpec[0], &phaseDeviations[0], &phaseDeviations[0], numBins, true);
+
+        return DSPKernels::sumMirroredSpectrum (&phaseDeviations[0], FrameSize);
+    }
+
+    //=======================================================================
+    /** Calculates the windows used by the cumulative score and beat prediction, if the beat period has changed */
+    void calculateBeatPeriodWeights()
+    {
+        if (beatPeriod == weightsBeatPeriod)
+        {
+            return;
+        }
+
+        weightsBeatPeriod = beatPeriod;
+
+        pastWindowSize = BeatTracking::calculatePastWeights (&pastWeights[0], beatPeriod, tightness);
+        BeatTracking::calculateFutureWeights (&futureWeights[0], beatPeriod);
+    }
+
+    /** Updates the cumulative score function with a new onset detection function sample
+     * @param odfSample an onset detection function sample
+     */
+    void updateCumulativeScore (double odfSample)
+    {
+        calculateBeatPeriodWeights();
+
+        latestCumulativeScoreValue = BeatTracking::calculateCumulativeScore (cumulativeScore.data(), onsetDFBufferSize, beatPeriod, &pastWeights[0], pastWindowSize, odfSample, alpha);
+
+        cumulativeScore.addSampleToEnd (latestCumulativeScoreValue);
+    }
+
+    /** Predicts the next beat, based upon the internal program state */
+    void predictBeat()
+    {
+        calculateBeatPeriodWeights();
+
+        std::copy (cumulativeScore.data(), cumulativeScore.data() + onsetDFBufferSize, futureCumulativeScore.begin());
+
+        beatCounter = BeatTracking::predictBeat (&futureCumulativeScore[0], onsetDFBufferSize, beatPeriod, &pastWeights[0], pastWindowSize, &futureWeights[0], beatCounter);
+
+        // set next prediction time
+        m0 = beatCounter + round (beatPeriod / 2);
+    }
+
+    //=======================================================================
+    /** Resamples the onset detection function to 512 samples, linearly */
+    void resampleOnsetDetectionFunction()
+    {
+        const double* history = onsetDF.data();
+
+        if (onsetDFBufferSize == 512)
+        {
+            std::copy (history, history + 512, resampledOnsetDF.begin());
+            return;
+        }
+
+        // with the first and last samples of both lined up
+        for (int i = 0; i < 512; i++)
+        {
+            double position = (i * (onsetDFBufferSize - 1)) / 511.;
+            int index = std::min ((int) position, onsetDFBufferSize - 2);
+            double fraction = position - index;
+
+            resampledOnsetDF[i] = history[index] + ((history[index + 1] - history[index]) * fraction);
+        }
+    }
+
+    /** Calculates the current tempo expressed as the beat period in detection function samples */
+    void calculateTempo()
+    {
+        BeatTracking::adaptiveThreshold<512> (&resampledOnsetDF[0]);
+
+        calculateBalancedACF();
+
+        // 128 comb filters (the maximum beat period), each with 4 elements
+        DSPKernels::combFilterBank (&acf[0], &weightingVector[0], &combFilterBankOutput[0], 128, 4);
+
+        BeatTracking::adaptiveThreshold<128> (&combFilterBankOutput[0]);
+
+        BeatTracking::calculateTempoObservationVector (&combFilterBankOutput[0], 60. * 44100. / 512., &tempoObservationVector[0]);
+
+        int maxind = BeatTracking::updateTempoProbabilities (&prevDelta[0], tempoTransitionMatrix, &tempoObservationVector[0], &delta[0]);
+
+        beatPeriod = BeatTracking::beatPeriodForTempoIndex (maxind, HopSize);
+
+        if (beatPeriod > 0)
+        {
+            estimatedTempo = BeatTracking::tempoForBeatPeriod (beatPeriod, HopSize);
+        }
+    }
+
+    /** Calculates the balanced autocorrelation of the resampled onset detection function */
+    void calculateBalancedACF()
+    {
+        // copy and zero pad
+        std::copy (resampledOnsetDF.begin(), resampledOnsetDF.end(), acfSignal.begin());
+        std::fill (acfSignal.begin() + 512, acfSignal.end(), 0.0);
+
+        acfFFT.performRealFFT (&acfSignal[0], &acfSpectrum[0]);
+
+        // multiply by complex conjugate
+        BeatTracking::calculatePowerSpectrum (&acfSpectrum[0], 513);
+
+        acfFFT.performInverseRealFFT (&acfSpectrum[0], &acfSignal[0]);
+
+        BeatTracking::balanceAutocorrelation (&acfSignal[0], &acf[0]);
+    }
+
+    //=======================================================================
+    std::array<double, FrameSize> frame;            /**< the most recent frame of audio */
+    std::array<double, FrameSize> window;           /**< the Hanning window */
+    std::array<double, FrameSize> fftIn;            /**< the windowed frame, with its halves swapped */
+    std::array<double, FrameSize + 2> spectrum;     /**< the interleaved spectrum of the frame, up to FrameSize/2 */
+    std::array<double, (FrameSize / 2) + 1> magSpec;          /**< magnitude spectrum */
+    std::array<double, (FrameSize / 2) + 1> prevMagSpec;      /**< previous magnitude spectrum */
+    std::array<double, (FrameSize / 2) + 1> phaseDeviations;  /**< the cosine of each bin's phase deviation, then its complex spectral difference */
+    std::array<double, (FrameSize / 2) + 1> prevPhase;        /**< previous phase values */
+    std::array<double, (FrameSize / 2) + 1> prevPhase2;       /**< second order previous phase values */
+    StaticBuiltinFFT<FrameSize> fft;                /**< the FFT of a single frame */
+
+    //=======================================================================
+    StaticCircularBuffer<double, onsetDFBufferSize> onsetDF;         /**< to hold onset detection function */
+    StaticCircularBuffer<double, onsetDFBufferSize> cumulativeScore; /**< to hold cumulative score */
+    std::array<double, onsetDFBufferSize> pastWeights;               /**< log-Gaussian weighting of past cumulative score values */
+    std::array<double, onsetDFBufferSize> futureWeights;             /**< Gaussian weighting of predicted cumulative score values */
+    std::array<double, 2 * onsetDFBufferSize> futureCumulativeScore; /**< to hold the cumulative score followed by its prediction */
+
+    //=======================================================================
+    std::array<double, 512> resampledOnsetDF;       /**< to hold resampled detection function */
+    std::array<double, 512> acf;                    /**< to hold autocorrelation function */
+    std::array<double, 1024> acfSignal;             /**< the zero padded detection function and its autocorrelation */
+    std::array<double, 1026> acfSpectrum;           /**< the power spectrum of the detection function */
+    StaticBuiltinFFT<1024> acfFFT;                  /**< the FFT used to calculate the autocorrelation */
+    std::array<double, 128> weightingVector;        /**< to hold weighting vector */
+    std::array<double, 128> combFilterBankOutput;   /**< to hold comb filter output */
+    std::array<double, 41> tempoObservationVector;  /**< to hold tempo version of comb filter output */
+    std::array<double, 41> delta;                   /**< to hold final tempo candidate array */
+    std::array<double, 41> prevDelta;               /**< previous delta */
+    double tempoTransitionMatrix[41][41];           /**< tempo transition matrix */
+
+    //=======================================================================
+    double tightness;                   /**< the tightness of the weighting used to calculate cumulative score */
+    double alpha;                       /**< the mix between the current detection function sample and the cumulative score's "momentum" */
+    double beatPeriod;                  /**< the beat period, in detection function samples */
+    double estimatedTempo;              /**< the current tempo estimation being used by the algorithm */
+    double latestCumulativeScoreValue;  /**< holds the latest value of the cumulative score function */
+    double weightsBeatPeriod;           /**< the beat period that the weights were last calculated for */
+    int pastWindowSize;                 /**< the number of past weights */
+    int m0;                             /**< indicates when the next point to predict the next beat is */
+    int beatCounter;                    /**< keeps track of when the next beat is - will be zero when the beat is due */
+    bool beatDueInFrame;                /**< indicates whether a beat is due in the current frame */
+};
+
+template <int HopSize, int FrameSize>
+const int BTrackStatic<HopSize, FrameSize>::hopSize;
+
+template <int HopSize, int FrameSize>
+const int BTrackStatic<HopSize, FrameSize>::frameSize;
+
+template <int HopSize, int FrameSize>
+const int BTrackStatic<HopSize, FrameSize>::onsetDFBufferSize;
+
+#endif /* BTrackStatic_h */
@@ -0,0 +1,246 @@
+//=======================================================================
+/** @file BeatSynchronousFeatures.cpp
+ *  @brief Per beat averages of features of the spectra calculated by the onset detection function
+ *  @author Adam Stark
+ *  @copyright Copyright (C) 2008-2014  Queen Mary University of London
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+//=======================================================================
+
+#include <math.h>
+#include <algorithm>
+#include "BeatSynchronousFeatures.h"
+#include "DSPKernels.h"
+
+//=======================================================================
+BeatSynchronousFeatures::BeatSynchronousFeatures (int frameSize_, double sampleRate_)
+ :  frameSize (frameSize_),
+    sampleRate (sampleRate_),
+    filterStarts (1, 0),
+    needsMagnitudes (false),
+    numFrames (0),
+    numSpectrumFrames (0),
+    numFramesInBeat (0)
+{
+
+}
+
+//=======================================================================
+int BeatSynchronousFeatures::addBand (double lowFrequency, double highFrequency)
+{
+    std::vector<int> bins;
+
+    for (int k = 0; k <= frameSize / 2; k++)
+    {
+        double frequency = (k * sampleRate) / frameSize;
+
+        if ((frequency >= lowFrequency) && (frequency < highFrequency))
+        {
+            bins.push_back (k);
+        }
+    }
+
+    return addFilter (bins, std::vector<double> (bins.size(), 1.0));
+}
+
+//=======================================================================
+int BeatSynchronousFeatures::addChroma (double lowFrequency, double highFrequency)
+{
+    std::vector<int> bins[12];
+
+    // the DC bin has no pitch, so start from the first bin above it
+    for (int k = 1; k <= frameSize / 2; k++)
+    {
+        double frequency = (k * sampleRate) / frameSize;
+
+        if ((frequency >= lowFrequency) && (frequency < highFrequency))
+        {
+            // MIDI note 60 is a C, so the note number modulo 12 counts up from C. notes below
+            // MIDI note 0 (about 8 Hz) are negative, so wrap the pitch class into 0 to 11
+            int note = (int) floor (69 + (12 * log2 (frequency / 440.0)) + 0.5);
+            bins[((note % 12) + 12) % 12].push_back (k);
+        }
+    }
+
+    int firstFeature = getNumFeatures();
+
+    for (int i = 0; i < 12; i++)
+    {
+        addFilter (bins[i], std::vector<double> (bins[i].size(), 1.0));
+    }
+
+    return firstFeature;
+}
+
+//=======================================================================
+int BeatSynchronousFeatures::addFilter (const std::vector<int>& bins, const std::vector<double>& weights)
+{
+    int numEntries = (int) std::min (bins.size(), weights.size());
+
+    for (int i = 0; i < numEntries; i++)
+    {
+        // bins outside the lower half of the spectrum are left out
+        if ((bins[i] >= 0) && (bins[i] <= frameSize / 2))
+        {
+            filterBins.push_back (bins[i]);
+            filterWeights.push_back (weights[i]);
+        }
+    }
+
+    filterStarts.push_back ((int) filterBins.size());
+    filterFeatures.push_back (getNumFeatures());
+
+    return addFeature (FilterFeature);
+}
+
+//=======================================================================
+int BeatSynchronousFeatures::addMeanMagnitude()
+{
+    needsMagnitudes = true;
+    magnitudes.resize ((frameSize / 2) + 1);
+
+    return addFeature (MeanMagnitudeFeature);
+}
+
+//=======================================================================
+int BeatSynchronousFeatures::addOnsetDetectionFunctionStrength()
+{
+    return addFeature (OnsetDetectionFunctionFeature);
+}
+
+//=======================================================================
+int BeatSynchronousFeatures::addFeature (int type)
+{
+    featureTypes.push_back (type);
+    sums.push_back (0.0);
+    beatFeatures.push_back (0.0);
+
+    return getNumFeatures() - 1;
+}
+
+//=======================================================================
+void BeatSynchronousFeatures::addFrame (const double* spectrum, double onsetDetectionFunctionSample)
+{
+    numFrames++;
+
+    int numFeatures = getNumFeatures();
+
+    for (int i = 0; i < numFeatures; i++)
+    {
+        if (featureTypes[i] == OnsetDetectionFunctionFeature)
+        {
+            sums[i] += onsetDetectionFunctionSample;
+        }
+    }
+
+    if (spectrum == NULL)
+    {
+        return;
+    }
+
+    numSpectrumFrames++;
+
+    // each filter only reads its own bins, so the power is calculated as it is needed
+    int numFilters = (int) filterFeatures.size();
+
+    for (int f = 0; f < numFilters; f++)
+    {
+        double sum = 0;
+
+        for (int i = filterStarts[f]; i < filterStarts[f + 1]; i++)
+        {
+            const double* bin = spectrum + (2 * filterBins[i]);
+            sum += filterWeights[i] * ((bin[0] * bin[0]) + (bin[1] * bin[1]));
+        }
+
+        sums[filterFeatures[f]] += sum;
+    }
+
+    if (needsMagnitudes)
+    {
+        int numBins = (frameSize / 2) + 1;
+        DSPKernels::magnitudes (spectrum, &magnitudes[0], numBins);
+
+        double meanMagnitude = 0;
+
+        for (int k = 0; k < numBins; k++)
+        {
+            meanMagnitude += magnitudes[k];
+        }
+
+        meanMagnitude /= numBins;
+
+        for (int i = 0; i < numFeatures; i++)
+        {
+            if (featureTypes[i] == MeanMagnitudeFeature)
+            {
+                sums[i] += meanMagnitude;
+            }
+        }
+    }
+}
+
+//=======================================================================
+void BeatSynchronousFeatures::endBeat()
+{
+    int numFeatures = getNumFeatures();
+
+    for (int i = 0; i < numFeatures; i++)
+    {
+        int count = (featureTypes[i] == OnsetDetectionFunctionFeature) ? numFrames : numSpectrumFrames;
+
+        beatFeatures[i] = (count > 0) ? (sums[i] / count) : 0.0;
+        sums[i] = 0.0;
+    }
+
+    numFramesInBeat = numFrames;
+    numFrames = 0;
+    numSpectrumFrames = 0;
+}
+
+//=======================================================================
+void BeatSynchronousFeatures::reset()
+{
+    std::fill (sums.begin(), sums.end(), 0.0);
+    std::fill (beatFeatures.begin(), beatFeatures.end(), 0.0);
+
+    numFrames = 0;
+    numSpectrumFrames = 0;
+    numFramesInBeat = 0;
+}
+
+//=======================================================================
+const std::vector<double>& BeatSynchronousFeatures::getBeatFeatures() const
+{
+    return beatFeatures;
+}
+
+//=======================================================================
+int BeatSynchronousFeatures::getNumFramesInBeat() const
+{
+    return numFramesInBeat;
+}
+
+//=======================================================================
+int BeatSynchronousFeatures::getNumFeatures() const
+{
+    return (int) featureTypes.size();
+}
+
+//=======================================================================
+int BeatSynchronousFeatures::getFrameSize() const
+{
+    return frameSize;
+}
@@ -0,0 +1,147 @@
+//=======================================================================
+/** @file BeatSynchronousFeatures.h
+ *  @brief Per beat averages of features of the spectra calculated by the onset detection function
+ *  @author Adam Stark
+ *  @copyright Copyright (C) 2008-2014  Queen Mary University of London
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+//=======================================================================
+
+#ifndef BeatSynchronousFeatures_h
+#define BeatSynchronousFeatures_h
+
+#include <vector>
+
+//=======================================================================
+/** Averages features of each frame over the frames of a beat, reusing the spectrum
+ * that the onset detection function has already calculated rather than transforming
+ * the audio again. Give one to BTrack::setBeatSynchronousFeatures() and, whenever
+ * BTrack::beatDueInCurrentFrame() returns true, getBeatFeatures() holds the averages
+ * over the beat that has just ended. The frame in which a beat falls is the first
+ * frame of the next beat.
+ *
+ * The features are chosen before processing starts. Each band or filter is a sparse
+ * weighted sum of the power in a few FFT bins, so a whole filterbank costs about as
+ * much as reading the spectrum once. The order in which the features are added is
+ * the order in which they appear in the feature vector.
+ */
+class BeatSynchronousFeatures
+{
+public:
+
+    /** Constructor
+     * @param frameSize_ the frame size of the onset detection function, which is also the FFT size
+     * @param sampleRate_ the sampling frequency in Hz
+     */
+    BeatSynchronousFeatures (int frameSize_, double sampleRate_ = 44100);
+
+    //=======================================================================
+    /** Add a feature that is the power in a band of frequencies
+     * @param lowFrequency the lowest frequency in the band in Hz
+     * @param highFrequency the frequency in Hz that the band ends below
+     * @returns the index of the feature
+     */
+    int addBand (double lowFrequency, double highFrequency);
+
+    /** Add twelve features holding the power in each pitch class, starting at C
+     * @param lowFrequency the lowest frequency in Hz to include
+     * @param highFrequency the frequency in Hz that the included bins end below
+     * @returns the index of the first of the twelve features
+     */
+    int addChroma (double lowFrequency = 55, double highFrequency = 3520);
+
+    /** Add a feature that is a weighted sum of the power in some FFT bins
+     * @param bins the bins, between 0 and frameSize/2
+     * @param weights the weight of each bin
+     * @returns the index of the feature
+     */
+    int addFilter (const std::vector<int>& bins, const std::vector<double>& weights);
+
+    /** Add a feature that is the mean magnitude of the bins from 0 to frameSize/2
+     * @returns the index of the feature
+     */
+    int addMeanMagnitude();
+
+    /** Add a feature that is the onset detection function, which measures how strongly
+     * the beat is articulated
+     * @returns the index of the feature
+     */
+    int addOnsetDetectionFunctionStrength();
+
+    //=======================================================================
+    /** Accumulate the features of a frame into the current beat
+     * @param spectrum the interleaved real and imaginary parts of the spectrum of the frame
+     * (see OnsetDetectionFunction::getCurrentSpectrum()), or NULL if there isn't one, in which
+     * case only the onset detection function is accumulated
+     * @param onsetDetectionFunctionSample the onset detection function sample of the frame
+     */
+    void addFrame (const double* spectrum, double onsetDetectionFunctionSample);
+
+    /** Finish the current beat, averaging its features into getBeatFeatures(), and start the next one */
+    void endBeat();
+
+    /** Clear the current beat and the features of the last one */
+    void reset();
+
+    //=======================================================================
+    /** @returns the averaged features of the most recently ended beat. The spectral features
+     * are averaged over the frames that had a spectrum, and are zero if none did */
+    const std::vector<double>& getBeatFeatures() const;
+
+    /** @returns the number of frames in the most recently ended beat */
+    int getNumFramesInBeat() const;
+
+    /** @returns the number of features */
+    int getNumFeatures() const;
+
+    /** @returns the frame size that the features were set up for */
+    int getFrameSize() const;
+
+private:
+
+    /** The kinds of feature */
+    enum FeatureType
+    {
+        FilterFeature,
+        MeanMagnitudeFeature,
+        OnsetDetectionFunctionFeature
+    };
+
+    /** Adds a feature, making room for it in the accumulators
+     * @param type the kind of feature (see FeatureType)
+     * @returns the index of the feature
+     */
+    int addFeature (int type);
+
+    int frameSize;                          /**< the FFT size */
+    double sampleRate;                      /**< the sampling frequency in Hz */
+
+    std::vector<int> featureTypes;          /**< the kind of each feature */
+    std::vector<int> filterFeatures;        /**< the feature index of each filter */
+    std::vector<int> filterStarts;          /**< the first entry of each filter in filterBins, followed by the total number of entries */
+    std::vector<int> filterBins;            /**< the bins of all of the filters, one filter after another */
+    std::vector<double> filterWeights;      /**< the weight of each entry in filterBins */
+    bool needsMagnitudes;                   /**< indicates that a feature needs the magnitude spectrum */
+    std::vector<double> magnitudes;         /**< to hold the magnitude spectrum */
+
+    std::vector<double> sums;               /**< the sum of each feature over the current beat */
+    int numFrames;                          /**< the number of frames in the current beat */
+    int numSpectrumFrames;                  /**< the number of frames in the current beat that had a spectrum */
+
+    std::vector<double> beatFeatures;       /**< the averaged features of the last beat */
+    int numFramesInBeat;                    /**< the number of frames in the last beat */
+};
+
+#endif /* BeatSynchronousFeatures_h */
@@ -0,0 +1,362 @@
+//=======================================================================
+/** @file BeatTracking.h
+ *  @brief The tempo estimation and beat prediction steps shared by BTrack and BTrackStatic
+ *  @author Adam Stark
+ *  @copyright Copyright (C) 2008-2014  Queen Mary University of London
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+//=======================================================================
+
+#ifndef BeatTracking_h
+#define BeatTracking_h
+
+#include <math.h>
+#include <algorithm>
+#include "DSPKernels.h"
+
+//=======================================================================
+/** The steps of the beat tracking algorithm that don't depend on how its buffers
+ * are held, so that BTrack (whose buffers are sized at runtime) and BTrackStatic
+ * (whose buffers are sized at compile time) give the same results from the same
+ * code. Everything here is inline, and the lengths that are the same for every
+ * hop size (the 512 sample resampled detection function, the 128 comb filters
+ * and the 41 tempi) are constants.
+ */
+class BeatTracking
+{
+public:
+
+    static const int resampledLength = 512;     /**< the length that the onset detection function is resampled to for tempo estimation */
+    static const int numCombFilters = 128;      /**< the number of comb filters, which is the longest beat period considered */
+    static const int numTempi = 41;             /**< the number of tempi considered, in steps of 2 bpm from 80 bpm */
+
+    //=======================================================================
+    /** Calculate the Rayleigh weighting of the comb filter bank outputs
+     * @param weightingVector an array to hold numCombFilters weights
+     */
+    static void calculateWeightingVector (double* weightingVector)
+    {
+        double rayparam = 43;
+
+        for (int n = 0; n < numCombFilters; n++)
+        {
+            weightingVector[n] = ((double) n / pow (rayparam, 2)) * exp ((-1 * pow ((double) -n, 2)) / (2 * pow (rayparam, 2)));
+        }
+    }
+
+    /** Calculate the Gaussian probability of moving from each tempo to each other tempo
+     * @param tempoTransitionMatrix the matrix to fill
+     */
+    static void calculateTempoTransitionMatrix (double tempoTransitionMatrix[numTempi][numTempi])
+    {
+        double pi = 3.14159265;
+        double m_sig = 41/8;
+
+        for (int i = 0; i < numTempi; i++)
+        {
+            for (int j = 0; j < numTempi; j++)
+            {
+                double x = j + 1;
+                double t_mu = i + 1;
+                tempoTransitionMatrix[i][j] = (1 / (m_sig * sqrt (2 * pi))) * exp ((-1 * pow ((x - t_mu), 2)) / (2 * pow (m_sig, 2)));
+            }
+        }
+    }
+
+    //=======================================================================
+    /** Calculate the log-Gaussian weighting of the past cumulative score values, from
+     * two beat periods ago to half a beat period ago
+     * @param pastWeights an array to hold the weights, which needs (3 * beatPeriod / 2) + 2 elements
+     * @param beatPeriod the beat period in detection function samples
+     * @param tightness the tightness of the weighting
+     * @returns the number of weights
+     */
+    static int calculatePastWeights (double* pastWeights, double beatPeriod, double tightness)
+    {
+        int windowSize = (int) (round (2 * beatPeriod) - round (beatPeriod / 2)) + 1;
+        double v = -2 * beatPeriod;
+
+        for (int i = 0; i < windowSize; i++)
+        {
+            pastWeights[i] = exp ((-1 * pow (tightness * log (-v / beatPeriod), 2)) / 2);
+            v = v + 1;
+        }
+
+        return windowSize;
+    }
+
+    /** Calculate the Gaussian weighting of the predicted cumulative score values over the next beat period
+     * @param futureWeights an array to hold (int) beatPeriod weights
+     * @param beatPeriod the beat period in detection function samples
+     */
+    static void calculateFutureWeights (double* futureWeights, double beatPeriod)
+    {
+        double v = 1;
+
+        for (int i = 0; i < (int) beatPeriod; i++)
+        {
+            futureWeights[i] = exp ((-1 * pow ((v - (beatPeriod / 2)), 2)) / (2 * pow ((beatPeriod / 2), 2)));
+            v++;
+        }
+    }
+
+    /** Calculate the next cumulative score value
+     * @param cumulativeScore the cumulative score history, oldest first
+     * @param length the number of values in the history
+     * @param beatPeriod the beat period in detection function samples
+     * @param pastWeights the weights calculated by calculatePastWeights()
+     * @param numPastWeights the number of weights
+     * @param odfSample the new onset detection function sample
+     * @param alpha the mix between the onset detection function sample and the cumulative score's "momentum"
+     * @returns the new cumulative score value
+     */
+    static double calculateCumulativeScore (const double* cumulativeScore, int length, double beatPeriod, const double* pastWeights, int numPastWeights, double odfSample, double alpha)
+    {
+        int start = length - round (2 * beatPeriod);
+        double max = DSPKernels::weightedMaximum (&cumulativeScore[start], pastWeights, numPastWeights);
+
+        return ((1 - alpha) * odfSample) + (alpha * max);
+    }
+
+    /** Predict the cumulative score over the next beat period and find the most likely beat in it
+     * @param futureCumulativeScore the cumulative score history (length values, oldest first),
+     * followed by room for (int) beatPeriod predicted values
+     * @param length the number of values in the history
+     * @param beatPeriod the beat period in detection function samples
+     * @param pastWeights the weights calculated by calculatePastWeights()
+     * @param numPastWeights the number of weights
+     * @param futureWeights the weights calculated by calculateFutureWeights()
+     * @param beatCounter the number of samples until the currently predicted beat
+     * @returns the number of samples until the predicted beat, which is beatCounter if no
+     * predicted value is above zero
+     */
+    static int predictBeat (double* futureCumulativeScore, int length, double beatPeriod, const double* pastWeights, int numPastWeights, const double* futureWeights, int beatCounter)
+    {
+        int windowSize = (int) beatPeriod;
+
+        // calculate future cumulative score
+        for (int i = length; i < (length + windowSize); i++)
+        {
+            int start = i - round (2 * beatPeriod);
+            futureCumulativeScore[i] = DSPKernels::weightedMaximum (&futureCumulativeScore[start], pastWeights, numPastWeights);
+        }
+
+        // predict beat
+        double max = 0;
+
+        for (int n = 0; n < windowSize; n++)
+        {
+            double wcumscore = futureCumulativeScore[length + n] * futureWeights[n];
+
+            if (wcumscore > max)
+            {
+                max = wcumscore;
+                beatCounter = n;
+            }
+        }
+
+        return beatCounter;
+    }
+
+    //=======================================================================
+    /** Calculates an adaptive threshold which is used to remove low level energy from detection
+     * function and emphasise peaks
+     * @param x the array of N values to threshold
+     */
+    template <int N>
+    static void adaptiveThreshold (double* x)
+    {
+        double x_thresh[N];
+
+        const int p_post = 7;
+        const int p_pre = 8;
+        const int t = std::min (N, p_post);	// to avoid accessing outside of arrays
+
+        // find threshold for first 't' samples, where a full average cannot be computed yet
+        for (int i = 0; i <= t; i++)
+        {
+            x_thresh[i] = calculateMeanOfArray (x, 1, std::min ((i + p_pre), N));
+        }
+
+        // find threshold for bulk of samples across a moving average from [i-p_pre,i+p_post]
+        const int numMovingAverages = (N - p_post) - (t + 1);
+
+        if (numMovingAverages > 0)
+        {
+            DSPKernels::movingMean (&x[t + 1 - p_pre], &x_thresh[t + 1], numMovingAverages, p_pre + p_post);
+        }
+
+        // for last few samples calculate threshold, again, not enough samples to do as above
+        for (int i = N - p_post; i < N; i++)
+        {
+            x_thresh[i] = calculateMeanOfArray (x, std::max ((i - p_post), 1), N);
+        }
+
+        // subtract the threshold from the detection function and check that it is not less than 0
+        DSPKernels::subtractThreshold (x, x_thresh, N);
+    }
+
+    /** Replace a spectrum with its power, leaving the imaginary parts zero, as is done
+     * to calculate an autocorrelation
+     * @param spectrum the interleaved spectrum
+     * @param numBins the number of bins in the spectrum
+     */
+    static void calculatePowerSpectrum (double* spectrum, int numBins)
+    {
+        for (int i = 0; i < numBins; i++)
+        {
+            spectrum[2*i] = spectrum[2*i]*spectrum[2*i] + spectrum[2*i+1]*spectrum[2*i+1];
+            spectrum[2*i+1] = 0.0;
+        }
+    }
+
+    /** Divide the autocorrelation by the number of overlapping samples at each lag, to remove
+     * the bias towards small lags
+     * @param autocorrelation the inverse transform of the power spectrum of the zero padded,
+     * resampled detection function
+     * @param acf an array to hold the resampledLength values of the balanced autocorrelation
+     */
+    static void balanceAutocorrelation (const double* autocorrelation, double* acf)
+    {
+        double lag = resampledLength;
+
+        for (int i = 0; i < resampledLength; i++)
+        {
+            // this division by 1024 is technically unnecessary but it ensures the algorithm produces
+            // exactly the same ACF output as the old time domain implementation
+            acf[i] = (fabs (autocorrelation[i]) / lag) / 1024.;
+
+            lag = lag - 1.;
+        }
+    }
+
+    //=======================================================================
+    /** Calculate how strongly each tempo is observed from the output of the comb filter bank
+     * @param combFilterBankOutput the numCombFilters outputs of the comb filter bank
+     * @param tempoToLagFactor the factor for converting between tempo and lag
+     * @param tempoObservationVector an array to hold numTempi observations
+     */
+    static void calculateTempoObservationVector (const double* combFilterBankOutput, double tempoToLagFactor, double* tempoObservationVector)
+    {
+        for (int i = 0; i < numTempi; i++)
+        {
+            int t_index = (int) round (tempoToLagFactor / ((double) ((2*i)+80)));
+            int t_index2 = (int) round (tempoToLagFactor / ((double) ((4*i)+160)));
+
+            tempoObservationVector[i] = combFilterBankOutput[t_index-1] + combFilterBankOutput[t_index2-1];
+        }
+    }
+
+    /** Update the probability of each tempo from the previous probabilities and a new observation
+     * @param prevDelta the previous probability of each tempo, which is replaced by the new one
+     * @param tempoTransitionMatrix the matrix calculated by calculateTempoTransitionMatrix()
+     * @param tempoObservationVector the observation calculated by calculateTempoObservationVector()
+     * @param delta an array to hold the new probability of each tempo
+     * @returns the index of the most likely tempo, or -1 if there is none
+     */
+    static int updateTempoProbabilities (double* prevDelta, const double tempoTransitionMatrix[numTempi][numTempi], const double* tempoObservationVector, double* delta)
+    {
+        for (int j = 0; j < numTempi; j++)
+        {
+            double maxval = -1;
+
+            for (int i = 0; i < numTempi; i++)
+            {
+                double curval = prevDelta[i] * tempoTransitionMatrix[i][j];
+
+                if (curval > maxval)
+                {
+                    maxval = curval;
+                }
+            }
+
+            delta[j] = maxval * tempoObservationVector[j];
+        }
+
+        normaliseArray (delta, numTempi);
+
+        int maxind = -1;
+        double maxval = -1;
+
+        for (int j = 0; j < numTempi; j++)
+        {
+            if (delta[j] > maxval)
+            {
+                maxval = delta[j];
+                maxind = j;
+            }
+
+            prevDelta[j] = delta[j];
+        }
+
+        return maxind;
+    }
+
+    /** @returns the beat period in detection function samples of the tempo with the given index
+     * @param tempoIndex the index of the tempo, as returned by updateTempoProbabilities()
+     * @param hopSize the hop size in audio samples
+     */
+    static double beatPeriodForTempoIndex (int tempoIndex, int hopSize)
+    {
+        return round ((60.0*44100.0)/(((2*tempoIndex)+80)*((double) hopSize)));
+    }
+
+    /** @returns the tempo in beats per minute of a beat period
+     * @param beatPeriod the beat period in detection function samples
+     * @param hopSize the hop size in audio samples
+     */
+    static double tempoForBeatPeriod (double beatPeriod, int hopSize)
+    {
+        return 60.0/((((double) hopSize) / 44100.0) * beatPeriod);
+    }
+
+    //=======================================================================
+    /** Calculates the mean of values in an array between index locations [startIndex,endIndex) */
+    static double calculateMeanOfArray (const double* array, int startIndex, int endIndex)
+    {
+        double sum = 0;
+
+        for (int i = startIndex; i < endIndex; i++)
+        {
+            sum = sum + array[i];
+        }
+
+        return (endIndex > startIndex) ? sum / (endIndex - startIndex) : 0;
+    }
+
+    /** Normalises an array of values by the sum of its positive elements */
+    static void normaliseArray (double* array, int N)
+    {
+        double sum = 0;
+
+        for (int i = 0; i < N; i++)
+        {
+            if (array[i] > 0)
+            {
+                sum = sum + array[i];
+            }
+        }
+
+        if (sum > 0)
+        {
+            for (int i = 0; i < N; i++)
+            {
+                array[i] = array[i] / sum;
+            }
+        }
+    }
+};
+
+#endif /* BeatTracking_h */
@@ -0,0 +1,389 @@
+//=======================================================================
+/** @file BuiltinFFT.h
+ *  @brief A real FFT for the power of two sizes used by BTrack
+ *  @author Adam Stark
+ *  @copyright Copyright (C) 2008-2014  Queen Mary University of London
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+//=======================================================================
+
+#ifndef BuiltinFFT_h
+#define BuiltinFFT_h
+
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include <array>
+#include "MemoryArena.h"
+
+#if defined (__SSE2__) || defined (_M_X64) || (defined (_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BTRACK_BUILTIN_FFT_SSE2 1
+#endif
+
+//=======================================================================
+/** The tables and working memory of a BuiltinFFT, held in vectors so that the
+ * size can be chosen at run time */
+class BuiltinFFTDynamicStorage
+{
+public:
+
+    /** Constructor
+     * @param memory where to allocate the tables and working memory from, or NULL for the heap
+     */
+    BuiltinFFTDynamicStorage (MemoryResource* memory)
+     :  bitReversed (memory),
+        stageTwiddles (memory),
+        realTwiddles (memory),
+        work (memory)
+    {
+
+    }
+
+    /** Allocate the tables and working memory for a transform size */
+    void resize (int size)
+    {
+        int halfSize = size / 2;
+
+        bitReversed.resize (halfSize);
+        stageTwiddles.resize (2 * std::max (halfSize - 1, 1));
+        realTwiddles.resize (2 * halfSize);
+        work.resize (2 * halfSize);
+    }
+
+    ArenaVector<int> bitReversed;       /**< the bit reversed index of each complex sample */
+    ArenaVector<double> stageTwiddles;  /**< the interleaved twiddle factors for each stage of the complex FFT */
+    ArenaVector<double> realTwiddles;   /**< the interleaved twiddle factors used to separate the even and odd spectra */
+    ArenaVector<double> work;           /**< the interleaved complex values being transformed */
+};
+
+//=======================================================================
+/** The tables and working memory of a BuiltinFFT of a size fixed at compile
+ * time, held in arrays so that nothing is allocated */
+template <int Size>
+class BuiltinFFTStaticStorage
+{
+public:
+
+    /** Constructor. The memory resource is not used */
+    BuiltinFFTStaticStorage (MemoryResource*)
+    {
+
+    }
+
+    /** Nothing to allocate, as the arrays are already the right size */
+    void resize (int)
+    {
+
+    }
+
+    std::array<int, Size / 2> bitReversed;  /**< the bit reversed index of each complex sample */
+    std::array<double, 2 * ((Size / 2) > 1 ? (Size / 2) - 1 : 1)> stageTwiddles; /**< the interleaved twiddle factors for each stage of the complex FFT */
+    std::array<double, Size> realTwiddles;  /**< the interleaved twiddle factors used to separate the even and odd spectra */
+    std::array<double, Size> work;          /**< the interleaved complex values being transformed */
+};
+
+//=======================================================================
+/** A forward and inverse FFT of real signals whose length is a power of two.
+ * A real signal of length N is transformed as a complex signal of length N/2,
+ * so only half the work of a complex FFT is needed. All of the tables and the
+ * working memory are set up in initialise(), so transforms never allocate.
+ *
+ * Spectra are stored as the interleaved real and imaginary parts of the first
+ * (N/2)+1 bins, the rest being given by conjugate symmetry. As with FFTW, the
+ * transforms are unnormalised, so an inverse transform of a forward transform
+ * returns the signal multiplied by N.
+ *
+ * The tables are held by the Storage type (see BuiltinFFT and StaticBuiltinFFT).
+ */
+template <typename Storage>
+class BasicBuiltinFFT
+{
+public:
+
+    /** Constructor. initialise() must be called before any transforms are performed
+     * @param memory where to allocate the tables and working memory from, or NULL for the heap
+     */
+    BasicBuiltinFFT (MemoryResource* memory = NULL)
+     :  size (0),
+        halfSize (0),
+        tables (memory)
+    {
+
+    }
+
+    /** @returns true if the transform can be of this size, which has to be a power of two of at least 4
+     * @param size_ the number of real samples in each transform
+     */
+    static bool supportsSize (int size_)
+    {
+        return (size_ >= 4) && ((size_ & (size_ - 1)) == 0);
+    }
+
+    /** Set up the tables for a transform size. The tables are laid out for powers of two, so
+     * any other size leaves the FFT with a size of zero, and no transforms can be performed
+     * @param size_ the number of real samples in each transform, which must be a power of two of at least 4
+     * (see supportsSize())
+     */
+    void initialise (int size_)
+    {
+        if (!supportsSize (size_))
+        {
+            size = 0;
+            halfSize = 0;
+            return;
+        }
+
+        size = size_;
+        halfSize = size / 2;
+
+        const double pi = 3.14159265358979323846;
+
+        // the bit reversed order of the complex samples
+        int numBits = 0;
+
+        while ((1 << numBits) < halfSize)
+        {
+            numBits++;
+        }
+
+        tables.resize (size);
+
+        for (int i = 0; i < halfSize; i++)
+        {
+            int reversed = 0;
+
+            for (int b = 0; b < numBits; b++)
+            {
+                reversed |= ((i >> b) & 1) << (numBits - 1 - b);
+            }
+
+            tables.bitReversed[i] = reversed;
+        }
+
+        // the twiddle factors for each stage of the complex FFT, stored one stage after
+        // another so that each stage reads its twiddles contiguously
+        for (int span = 1; span < halfSize; span *= 2)
+        {
+            for (int j = 0; j < span; j++)
+            {
+                double angle = -pi * j / span;
+                tables.stageTwiddles[2 * (span - 1 + j)] = cos (angle);
+                tables.stageTwiddles[2 * (span - 1 + j) + 1] = sin (angle);
+            }
+        }
+
+        // the twiddle factors that separate the spectra of the even and odd samples
+        for (int k = 0; k < halfSize; k++)
+        {
+            double angle = -2. * pi * k / size;
+            tables.realTwiddles[2 * k] = cos (angle);
+            tables.realTwiddles[2 * k + 1] = sin (angle);
+        }
+    }
+
+    /** @returns the number of real samples in each transform */
+    int getSize() const
+    {
+        return size;
+    }
+
+    /** Perform a forward transform
+     * @param input getSize() real samples
+     * @param spectrum an array to hold the interleaved real and imaginary parts of (getSize()/2)+1 bins
+     */
+    void performRealFFT (const double* input, double* spectrum)
+    {
+        // treat the even and odd samples as the real and imaginary parts of a complex signal of half the length
+        for (int i = 0; i < halfSize; i++)
+        {
+            int j = tables.bitReversed[i];
+            tables.work[2 * j] = input[2 * i];
+            tables.work[2 * j + 1] = input[2 * i + 1];
+        }
+
+        performComplexFFT();
+
+        // the first and middle bins are real
+        spectrum[0] = tables.work[0] + tables.work[1];
+        spectrum[1] = 0;
+        spectrum[2 * halfSize] = tables.work[0] - tables.work[1];
+        spectrum[2 * halfSize + 1] = 0;
+
+        for (int k = 1; k < halfSize; k++)
+        {
+            double zr = tables.work[2 * k];
+            double zi = tables.work[2 * k + 1];
+            double cr = tables.work[2 * (halfSize - k)];
+            double ci = -tables.work[2 * (halfSize - k) + 1];
+
+            // the spectra of the even and odd samples
+            double evenR = 0.5 * (zr + cr);
+            double evenI = 0.5 * (zi + ci);
+            double oddR = 0.5 * (zi - ci);
+            double oddI = -0.5 * (zr - cr);
+
+            double wr = tables.realTwiddles[2 * k];
+            double wi = tables.realTwiddles[2 * k + 1];
+
+            spectrum[2 * k] = evenR + (wr * oddR - wi * oddI);
+            spectrum[2 * k + 1] = evenI + (wr * oddI + wi * oddR);
+        }
+    }
+
+    /** Perform an inverse transform
+     * @param spectrum the interleaved real and imaginary parts of (getSize()/2)+1 bins
+     * @param output an array to hold getSize() real samples, multiplied by getSize()
+     */
+    void performInverseRealFFT (const double* spectrum, double* output)
+    {
+        // recombine the spectra of the even and odd samples into the spectrum of a complex
+        // signal of half the length, conjugated so that the forward FFT can be used
+        for (int k = 0; k < halfSize; k++)
+        {
+            double xr = spectrum[2 * k];
+            double xi = spectrum[2 * k + 1];
+            double cr = spectrum[2 * (halfSize - k)];
+            double ci = -spectrum[2 * (halfSize - k) + 1];
+
+            double evenR = xr + cr;
+            double evenI = xi + ci;
+            double diffR = xr - cr;
+            double diffI = xi - ci;
+
+            // multiply the difference by the conjugate twiddle to get the spectrum of the odd samples
+            double wr = tables.realTwiddles[2 * k];
+            double wi = -tables.realTwiddles[2 * k + 1];
+            double oddR = diffR * wr - diffI * wi;
+            double oddI = diffR * wi + diffI * wr;
+
+            int j = tables.bitReversed[k];
+            tables.work[2 * j] = evenR - oddI;
+            tables.work[2 * j + 1] = -(evenI + oddR);
+        }
+
+        performComplexFFT();
+
+        // conjugate again to complete the inverse, and unpack the even and odd samples
+        for (int i = 0; i < halfSize; i++)
+        {
+            output[2 * i] = tables.work[2 * i];
+            output[2 * i + 1] = -tables.work[2 * i + 1];
+        }
+    }
+
+protected:
+
+    /** Perform an in place radix 2 FFT on the complex values in tables.work, which must already be in bit reversed order */
+    void performComplexFFT()
+    {
+        double* z = &tables.work[0];
+
+        for (int span = 1; span < halfSize; span *= 2)
+        {
+            const double* twiddles = &tables.stageTwiddles[2 * (span - 1)];
+
+            for (int start = 0; start < halfSize; start += 2 * span)
+            {
+                for (int j = 0; j < span; j++)
+                {
+                    double* a = z + 2 * (start + j);
+                    double* b = a + 2 * span;
+                    butterfly (a, b, twiddles + 2 * j);
+                }
+            }
+        }
+    }
+
+    /** Replace a with a + wb and b with a - wb */
+    static inline void butterfly (double* a, double* b, const double* w)
+    {
+#ifdef BTRACK_BUILTIN_FFT_SSE2
+        __m128d va = _mm_loadu_pd (a);
+        __m128d vb = _mm_loadu_pd (b);
+
+        // complex multiply: [br*wr, bi*wr] + [-bi*wi, br*wi]
+        __m128d swapped = _mm_shuffle_pd (vb, vb, 1);
+        __m128d product = _mm_add_pd (_mm_mul_pd (vb, _mm_set1_pd (w[0])), _mm_mul_pd (swapped, _mm_set_pd (w[1], -w[1])));
+
+        _mm_storeu_pd (a, _mm_add_pd (va, product));
+        _mm_storeu_pd (b, _mm_sub_pd (va, product));
+#else
+        double pr = b[0] * w[0] - b[1] * w[1];
+        double pi = b[0] * w[1] + b[1] * w[0];
+
+        b[0] = a[0] - pr;
+        b[1] = a[1] - pi;
+        a[0] = a[0] + pr;
+        a[1] = a[1] + pi;
+#endif
+    }
+
+    int size;                           /**< the number of real samples in each transform */
+    int halfSize;                       /**< the number of complex samples in the half length transform */
+    Storage tables;                     /**< the tables and working memory */
+};
+
+//=======================================================================
+/** The built in FFT, for sizes chosen at run time */
+class BuiltinFFT : public BasicBuiltinFFT<BuiltinFFTDynamicStorage>
+{
+public:
+
+    /** Constructor. initialise() must be called before any transforms are performed
+     * @param memory where to allocate the tables and working memory from, or NULL for the heap
+     */
+    BuiltinFFT (MemoryResource* memory = NULL)
+     :  BasicBuiltinFFT<BuiltinFFTDynamicStorage> (memory)
+    {
+
+    }
+
+    /** @returns the number of bytes allocated for the tables and working memory */
+    size_t memoryFootprint() const
+    {
+        return (tables.bitReversed.capacity() * sizeof (int))
+             + ((tables.stageTwiddles.capacity() + tables.realTwiddles.capacity() + tables.work.capacity()) * sizeof (double));
+    }
+
+    /** Exchange the tables and working memory of this FFT with another */
+    void swap (BuiltinFFT& other)
+    {
+        std::swap (size, other.size);
+        std::swap (halfSize, other.halfSize);
+        tables.bitReversed.swap (other.tables.bitReversed);
+        tables.stageTwiddles.swap (other.tables.stageTwiddles);
+        tables.realTwiddles.swap (other.tables.realTwiddles);
+        tables.work.swap (other.tables.work);
+    }
+};
+
+//=======================================================================
+/** The built in FFT for a size fixed at compile time, with its tables held in
+ * the object itself so that nothing is allocated
+ */
+template <int Size>
+class StaticBuiltinFFT : public BasicBuiltinFFT<BuiltinFFTStaticStorage<Size> >
+{
+public:
+
+    /** Constructor, which sets up the tables */
+    StaticBuiltinFFT()
+    {
+        this->initialise (Size);
+    }
+};
+
+#endif /* BuiltinFFT_h */
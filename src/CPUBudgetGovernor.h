@@ -0,0 +1,173 @@
+//=======================================================================
+/** @file CPUBudgetGovernor.h
+ *  @brief A class for choosing a processing quality level from measured processing times
+ *  @author Adam Stark
+ *  @copyright Copyright (C) 2008-2014  Queen Mary University of London
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+//=======================================================================
+
+#ifndef CPUBudgetGovernor_h
+#define CPUBudgetGovernor_h
+
+//=======================================================================
+/** Keeps a smoothed average of the time taken to process each hop and steps
+ * through quality levels (0 being the highest quality) to keep that average
+ * within a budget. Moving to a cheaper level happens quickly, while moving
+ * back to a more expensive level requires a long run of hops well under the
+ * budget, so that the level doesn't oscillate around the budget.
+ */
+class CPUBudgetGovernor
+{
+public:
+
+    /** Constructor
+     * @param numLevels_ the number of quality levels available
+     */
+    CPUBudgetGovernor (int numLevels_)
+     :  numLevels (numLevels_),
+        level (0),
+        budget (0),
+        averageTime (0),
+        averageIsSeeded (false),
+        hopsOverBudget (0),
+        hopsUnderBudget (0)
+    {
+
+    }
+
+    /** Set the processing budget
+     * @param secondsPerHop the average time that processing a hop should take, or zero
+     * to disable the governor and return to the highest quality level
+     */
+    void setBudget (double secondsPerHop)
+    {
+        budget = secondsPerHop;
+        averageTime = 0;
+        averageIsSeeded = false;
+        hopsOverBudget = 0;
+        hopsUnderBudget = 0;
+
+        if (budget <= 0)
+        {
+            level = 0;
+        }
+    }
+
+    /** @returns the processing budget in seconds per hop, or zero if the governor is disabled */
+    double getBudget() const
+    {
+        return budget;
+    }
+
+    /** Add the time taken to process a hop
+     * @param secondsForHop the time taken
+     * @returns true if the quality level has changed
+     */
+    bool addMeasurement (double secondsForHop)
+    {
+        if (budget <= 0)
+        {
+            return false;
+        }
+
+        // the first measurement at each level starts the average afresh, so that
+        // times measured at the previous level don't move the level on again
+        if (averageIsSeeded)
+        {
+            averageTime = averageTime + smoothing * (secondsForHop - averageTime);
+        }
+        else
+        {
+            averageTime = secondsForHop;
+            averageIsSeeded = true;
+        }
+
+        if (averageTime > budget)
+        {
+            hopsUnderBudget = 0;
+            hopsOverBudget++;
+
+            if ((hopsOverBudget >= hopsBeforeDecrease) && (level < (numLevels - 1)))
+            {
+                setLevel (level + 1);
+                return true;
+            }
+        }
+        else if (averageTime < (budget * headroom))
+        {
+            hopsOverBudget = 0;
+            hopsUnderBudget++;
+
+            if ((hopsUnderBudget >= hopsBeforeIncrease) && (level > 0))
+            {
+                setLevel (level - 1);
+                return true;
+            }
+        }
+        else
+        {
+            hopsOverBudget = 0;
+            hopsUnderBudget = 0;
+        }
+
+        return false;
+    }
+
+    /** @returns the current quality level, where 0 is the highest quality */
+    int getLevel() const
+    {
+        return level;
+    }
+
+    /** Set the quality level directly
+     * @param level_ the quality level, where 0 is the highest quality
+     */
+    void setLevel (int level_)
+    {
+        level = level_;
+
+        if (level < 0)
+        {
+            level = 0;
+        }
+
+        if (level > (numLevels - 1))
+        {
+            level = numLevels - 1;
+        }
+
+        averageIsSeeded = false;
+        hopsOverBudget = 0;
+        hopsUnderBudget = 0;
+    }
+
+private:
+
+    static constexpr double smoothing = 0.05;       /**< the weight given to each new measurement in the average */
+    static constexpr double headroom = 0.6;         /**< the fraction of the budget the average must be under to increase quality */
+    static const int hopsBeforeDecrease = 8;        /**< the number of consecutive hops over budget before reducing quality */
+    static const int hopsBeforeIncrease = 256;      /**< the number of consecutive hops under budget before increasing quality */
+
+    int numLevels;              /**< the number of quality levels */
+    int level;                  /**< the current quality level */
+    double budget;              /**< the budget in seconds per hop */
+    double averageTime;         /**< the smoothed time taken per hop */
+    bool averageIsSeeded;       /**< indicates that averageTime holds a measurement made at the current level */
+    int hopsOverBudget;         /**< the number of consecutive hops with the average over budget */
+    int hopsUnderBudget;        /**< the number of consecutive hops with the average comfortably under budget */
+};
+
+#endif /* CPUBudgetGovernor_h */
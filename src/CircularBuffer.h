@@ -1,6 +1,6 @@
 //=======================================================================
 /** @file CircularBuffer.h
- *  @brief A class for calculating onset detection functions
+ *  @brief A circular buffer for holding onset detection function history
  *  @author Adam Stark
  *  @copyright Copyright (C) 2008-2014  Queen Mary University of London
  *
@@ -23,48 +23,200 @@
 #define CircularBuffer_h
 
 #include <vector>
+#include <algorithm>
+#include <array>
+#include "MemoryArena.h"
 
 //=======================================================================
 /** A circular buffer that allows you to add new samples to the end
  * whilst removing them from the beginning. This is implemented in an
- * efficient way which doesn't involve any memory allocation
+ * efficient way which doesn't involve any memory allocation.
+ *
+ * The storage is rounded up to a power of two so that wrapping is a
+ * mask rather than a modulo, and every sample is written twice (once in
+ * each half of the storage) so that the most recent size() samples are
+ * always available as one contiguous block, oldest sample first.
  */
+template <typename T>
 class CircularBuffer
 {
 public:
-    
-    /** Constructor */
-    CircularBuffer()
-     :  writeIndex (0)
+
+    /** Constructor
+     * @param memory where to allocate the samples from, or NULL for the heap
+     */
+    CircularBuffer (MemoryResource* memory = NULL)
+     :  buffer (memory),
+        readIndex (0),
+        writeIndex (0),
+        length (0),
+        capacity (0),
+        mask (0)
     {
-        
+
     }
-    
-    /** Access the ith element in the buffer */
-    double &operator[] (int i)
+
+    /** Access the ith element in the buffer, where 0 is the oldest sample */
+    const T& operator[] (int i) const
     {
-        int index = (i + writeIndex) % buffer.size();
-        return buffer[index];
+        return buffer[readIndex + i];
     }
-    
+
+    /** Set the value of the ith element in the buffer, where 0 is the oldest sample */
+    void setSample (int i, T v)
+    {
+        int index = (readIndex + i) & mask;
+        buffer[index] = v;
+        buffer[index + capacity] = v;
+    }
+
     /** Add a new sample to the end of the buffer */
-    void addSampleToEnd (double v)
+    void addSampleToEnd (T v)
     {
         buffer[writeIndex] = v;
-        writeIndex = (writeIndex + 1) % buffer.size();
+        buffer[writeIndex + capacity] = v;
+        writeIndex = (writeIndex + 1) & mask;
+        readIndex = (readIndex + 1) & mask;
     }
-    
-    /** Resize the buffer */
+
+    /** @returns a pointer to size() contiguous samples, oldest sample first. The
+     * pointer is invalidated by the next call to addSampleToEnd() or resize()
+     */
+    const T* data() const
+    {
+        return &buffer[readIndex];
+    }
+
+    /** @returns the number of samples held in the buffer */
+    int size() const
+    {
+        return length;
+    }
+
+    /** @returns the number of bytes allocated for the samples */
+    size_t memoryFootprint() const
+    {
+        return buffer.capacity() * sizeof (T);
+    }
+
+    /** Resize the buffer, setting all samples to zero */
     void resize (int size)
     {
-        buffer.resize (size);
-        writeIndex = 0;
+        length = size;
+
+        capacity = 1;
+
+        while (capacity < length)
+        {
+            capacity = capacity * 2;
+        }
+
+        mask = capacity - 1;
+
+        buffer.assign (2 * capacity, T());
+        readIndex = 0;
+        writeIndex = length & mask;
+    }
+
+    /** Exchange the contents of this buffer with another. This never allocates, so it
+     * can be used to swap in a buffer that was prepared on another thread
+     */
+    void swap (CircularBuffer& other)
+    {
+        buffer.swap (other.buffer);
+        std::swap (readIndex, other.readIndex);
+        std::swap (writeIndex, other.writeIndex);
+        std::swap (length, other.length);
+        std::swap (capacity, other.capacity);
+        std::swap (mask, other.mask);
     }
-    
+
 private:
-    
-    std::vector<double> buffer;
+
+    ArenaVector<T> buffer;
+    int readIndex;
     int writeIndex;
+    int length;
+    int capacity;
+    int mask;
 };
 
-#endif /* CircularBuffer_hpp */
+//=======================================================================
+/** @returns the smallest power of two that is at least n */
+constexpr int nextPowerOfTwo (int n, int powerOfTwo = 1)
+{
+    return (powerOfTwo >= n) ? powerOfTwo : nextPowerOfTwo (n, powerOfTwo * 2);
+}
+
+//=======================================================================
+/** A CircularBuffer whose length is fixed at compile time, with its samples
+ * held in the object itself so that nothing is ever allocated. The buffer
+ * starts out full of zeros
+ */
+template <typename T, int Length>
+class StaticCircularBuffer
+{
+public:
+
+    static const int capacity = nextPowerOfTwo (Length);   /**< the length rounded up to a power of two */
+    static const int mask = capacity - 1;                   /**< wraps an index into the storage */
+
+    /** Constructor */
+    StaticCircularBuffer()
+     :  readIndex (0),
+        writeIndex (Length & mask)
+    {
+        buffer.fill (T());
+    }
+
+    /** Access the ith element in the buffer, where 0 is the oldest sample */
+    const T& operator[] (int i) const
+    {
+        return buffer[readIndex + i];
+    }
+
+    /** Set the value of the ith element in the buffer, where 0 is the oldest sample */
+    void setSample (int i, T v)
+    {
+        int index = (readIndex + i) & mask;
+        buffer[index] = v;
+        buffer[index + capacity] = v;
+    }
+
+    /** Add a new sample to the end of the buffer */
+    void addSampleToEnd (T v)
+    {
+        buffer[writeIndex] = v;
+        buffer[writeIndex + capacity] = v;
+        writeIndex = (writeIndex + 1) & mask;
+        readIndex = (readIndex + 1) & mask;
+    }
+
+    /** @returns a pointer to Length contiguous samples, oldest sample first. The
+     * pointer is invalidated by the next call to addSampleToEnd()
+     */
+    const T* data() const
+    {
+        return &buffer[readIndex];
+    }
+
+    /** @returns the number of samples held in the buffer */
+    static constexpr int size()
+    {
+        return Length;
+    }
+
+private:
+
+    std::array<T, 2 * capacity> buffer;
+    int readIndex;
+    int writeIndex;
+};
+
+template <typename T, int Length>
+const int StaticCircularBuffer<T, Length>::capacity;
+
+template <typename T, int Length>
+const int StaticCircularBuffer<T, Length>::mask;
+
+#endif /* CircularBuffer_h */
@@ -0,0 +1,1405 @@
+//=======================================================================
+/** @file DSPKernels.cpp
+ *  @brief Inner loops used by BTrack, with variants for different instruction sets
+ *  @author Adam Stark
+ *  @copyright Copyright (C) 2008-2014  Queen Mary University of London
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+//=======================================================================
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include "DSPKernels.h"
+
+// the vector variants are compiled with per-function target attributes, so that
+// the rest of the library can be built for the lowest common instruction set
+#if (defined (__GNUC__) || defined (__clang__)) && (defined (__x86_64__) || defined (__i386__))
+#define BTRACK_X86_KERNELS 1
+#include <immintrin.h>
+#define BTRACK_TARGET(isa) __attribute__((target (isa)))
+#endif
+
+//=======================================================================
+/** A set of kernel variants for one instruction set */
+struct KernelTable
+{
+    void (*applyWindow) (const double*, const double*, double*, int);
+    void (*magnitudes) (const double*, double*, int);
+    double (*spectralDifference) (const double*, double*, int, bool, bool);
+    void (*complexSpectralDifference) (const double*, double*, const double*, double*, int, bool);
+    void (*slidingDFT) (double*, double*, const double*, const double*, const double*, const double*, const double*, int, int);
+    void (*movingMean) (const double*, double*, int, int);
+    void (*subtractThreshold) (double*, const double*, int);
+    void (*combFilterBank) (const double*, const double*, double*, int, int);
+    double (*weightedMaximum) (const double*, const double*, int);
+    double (*sumOfSquares) (const double*, int);
+    double (*replaceSamples) (const double*, double*, int);
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////// Generic Kernels /////////////////////////////////////////
+
+//=======================================================================
+static void genericApplyWindow (const double* samples, const double* window, double* output, int numSamples)
+{
+    for (int i = 0; i < numSamples; i++)
+    {
+        output[i] = samples[i] * window[i];
+    }
+}
+
+//=======================================================================
+static void genericMagnitudes (const double* complexIn, double* magnitudes, int numBins)
+{
+    for (int i = 0; i < numBins; i++)
+    {
+        double re = complexIn[2 * i];
+        double im = complexIn[2 * i + 1];
+        magnitudes[i] = sqrt ((re * re) + (im * im));
+    }
+}
+
+//=======================================================================
+static double genericSpectralDifference (const double* magnitudes, double* previousMagnitudes, int numBins, bool halfWaveRectify, bool weightByBinNumber)
+{
+    double sum = 0;
+
+    for (int i = 0; i < numBins; i++)
+    {
+        double diff = magnitudes[i] - previousMagnitudes[i];
+
+        if (halfWaveRectify)
+        {
+            diff = diff > 0 ? diff : 0;
+        }
+        else
+        {
+            diff = fabs (diff);
+        }
+
+        if (weightByBinNumber)
+        {
+            diff = diff * ((double) (i + 1));
+        }
+
+        sum = sum + diff;
+
+        previousMagnitudes[i] = magnitudes[i];
+    }
+
+    return sum;
+}
+
+//=======================================================================
+static void genericComplexSpectralDifference (const double* magnitudes, double* previousMagnitudes, const double* cosPhaseDeviations, double* differences, int numBins, bool halfWaveRectify)
+{
+    for (int i = 0; i < numBins; i++)
+    {
+        double current = magnitudes[i];
+        double previous = previousMagnitudes[i];
+
+        if (!halfWaveRectify || ((current - previous) > 0))
+        {
+            differences[i] = sqrt ((current * current) + (previous * previous) - 2 * current * previous * cosPhaseDeviations[i]);
+        }
+        else
+        {
+            differences[i] = 0;
+        }
+
+        previousMagnitudes[i] = current;
+    }
+}
+
+//=======================================================================
+static void genericSlidingDFT (double* real, double* imag, const double* rotationReal, const double* rotationImag, const double* blockRotationReal, const double* blockRotationImag, const double* sampleChanges, int numSamples, int numBins)
+{
+    for (int k = 0; k < numBins; k++)
+    {
+        double c = rotationReal[k];
+        double s = rotationImag[k];
+        double twoC = 2 * c;
+
+        // a Goertzel recursion sums the changes, each rotated by the samples that follow it
+        double s1 = 0;
+        double s2 = 0;
+
+        for (int n = 0; n < numSamples; n++)
+        {
+            double s0 = (sampleChanges[n] - s2) + (twoC * s1);
+            s2 = s1;
+            s1 = s0;
+        }
+
+        double re = real[k];
+        double im = imag[k];
+
+        real[k] = ((re * blockRotationReal[k]) - (im * blockRotationImag[k])) + ((c * s1) - s2);
+        imag[k] = ((re * blockRotationImag[k]) + (im * blockRotationReal[k])) + (s * s1);
+    }
+}
+
+//=======================================================================
+static void genericMovingMean (const double* values, double* means, int numMeans, int windowLength)
+{
+    for (int i = 0; i < numMeans; i++)
+    {
+        double sum = 0;
+
+        for (int k = 0; k < windowLength; k++)
+        {
+            sum = sum + values[i + k];
+        }
+
+        means[i] = sum / windowLength;
+    }
+}
+
+//=======================================================================
+static void genericSubtractThreshold (double* values, const double* thresholds, int numValues)
+{
+    for (int i = 0; i < numValues; i++)
+    {
+        values[i] = values[i] - thresholds[i];
+
+        if (values[i] < 0)
+        {
+            values[i] = 0;
+        }
+    }
+}
+
+//=======================================================================
+static void genericCombFilterBank (const double* acf, const double* weighting, double* output, int numFilters, int numElements)
+{
+    for (int i = 0; i < numFilters; i++)
+    {
+        output[i] = 0;
+    }
+
+    for (int i = 2; i <= numFilters - 1; i++) // max beat period
+    {
+        for (int a = 1; a <= numElements; a++) // number of comb elements
+        {
+            for (int b = 1 - a; b <= a - 1; b++) // general state using normalisation of comb elements
+            {
+                output[i - 1] = output[i - 1] + (acf[(a * i + b) - 1] * weighting[i - 1]) / (2 * a - 1);
+            }
+        }
+    }
+}
+
+//=======================================================================
+static double genericWeightedMaximum (const double* values, const double* weights, int numValues)
+{
+    double max = 0;
+
+    for (int i = 0; i < numValues; i++)
+    {
+        double weightedValue = values[i] * weights[i];
+
+        if (weightedValue > max)
+        {
+            max = weightedValue;
+        }
+    }
+
+    return max;
+}
+
+//=======================================================================
+static double genericSumOfSquares (const double* samples, int numSamples)
+{
+    double sum = 0;
+
+    for (int i = 0; i < numSamples; i++)
+    {
+        sum = sum + (samples[i] * samples[i]);
+    }
+
+    return sum;
+}
+
+//=======================================================================
+static double genericReplaceSamples (const double* newSamples, double* samples, int numSamples)
+{
+    double change = 0;
+
+    for (int i = 0; i < numSamples; i++)
+    {
+        change = change + (newSamples[i] * newSamples[i]) - (samples[i] * samples[i]);
+        samples[i] = newSamples[i];
+    }
+
+    return change;
+}
+
+//=======================================================================
+static const KernelTable genericKernels =
+{
+    genericApplyWindow,
+    genericMagnitudes,
+    genericSpectralDifference,
+    genericComplexSpectralDifference,
+    genericSlidingDFT,
+    genericMovingMean,
+    genericSubtractThreshold,
+    genericCombFilterBank,
+    genericWeightedMaximum,
+    genericSumOfSquares,
+    genericReplaceSamples
+};
+
+#ifdef BTRACK_X86_KERNELS
+
+// some versions of gcc warn about the deliberately undefined registers inside their own intrinsics
+#if defined (__GNUC__) && !defined (__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////// SSE2 Kernels //////////////////////////////////////////
+
+//=======================================================================
+BTRACK_TARGET ("sse2")
+static void sse2ApplyWindow (const double* samples, const double* window, double* output, int numSamples)
+{
+    int i = 0;
+
+    for (; i + 2 <= numSamples; i += 2)
+    {
+        _mm_storeu_pd (output + i, _mm_mul_pd (_mm_loadu_pd (samples + i), _mm_loadu_pd (window + i)));
+    }
+
+    genericApplyWindow (samples + i, window + i, output + i, numSamples - i);
+}
+
+//=======================================================================
+BTRACK_TARGET ("sse2")
+static void sse2Magnitudes (const double* complexIn, double* magnitudes, int numBins)
+{
+    int i = 0;
+
+    for (; i + 2 <= numBins; i += 2)
+    {
+        __m128d a = _mm_loadu_pd (complexIn + 2 * i);
+        __m128d b = _mm_loadu_pd (complexIn + 2 * i + 2);
+        __m128d re = _mm_unpacklo_pd (a, b);
+        __m128d im = _mm_unpackhi_pd (a, b);
+        _mm_storeu_pd (magnitudes + i, _mm_sqrt_pd (_mm_add_pd (_mm_mul_pd (re, re), _mm_mul_pd (im, im))));
+    }
+
+    genericMagnitudes (complexIn + 2 * i, magnitudes + i, numBins - i);
+}
+
+//=======================================================================
+BTRACK_TARGET ("sse2")
+static double sse2SpectralDifference (const double* magnitudes, double* previousMagnitudes, int numBins, bool halfWaveRectify, bool weightByBinNumber)
+{
+    __m128d zero = _mm_setzero_pd();
+    __m128d signMask = _mm_set1_pd (-0.0);
+    __m128d binNumbers = _mm_set_pd (2.0, 1.0);
+    __m128d binStep = _mm_set1_pd (2.0);
+    __m128d sums = zero;
+    int i = 0;
+
+    for (; i + 2 <= numBins; i += 2)
+    {
+        __m128d current = _mm_loadu_pd (magnitudes + i);
+        __m128d diff = _mm_sub_pd (current, _mm_loadu_pd (previousMagnitudes + i));
+
+        diff = halfWaveRectify ? _mm_max_pd (diff, zero) : _mm_andnot_pd (signMask, diff);
+
+        if (weightByBinNumber)
+        {
+            diff = _mm_mul_pd (diff, binNumbers);
+            binNumbers = _mm_add_pd (binNumbers, binStep);
+        }
+
+        sums = _mm_add_pd (sums, diff);
+        _mm_storeu_pd (previousMagnitudes + i, current);
+    }
+
+    double lanes[2];
+    _mm_storeu_pd (lanes, sums);
+    double sum = lanes[0] + lanes[1];
+
+    for (; i < numBins; i++)
+    {
+        double diff = magnitudes[i] - previousMagnitudes[i];
+        diff = halfWaveRectify ? (diff > 0 ? diff : 0) : fabs (diff);
+        sum = sum + (weightByBinNumber ? diff * ((double) (i + 1)) : diff);
+        previousMagnitudes[i] = magnitudes[i];
+    }
+
+    return sum;
+}
+
+//=======================================================================
+BTRACK_TARGET ("sse2")
+static void sse2ComplexSpectralDifference (const double* magnitudes, double* previousMagnitudes, const double* cosPhaseDeviations, double* differences, int numBins, bool halfWaveRectify)
+{
+    __m128d zero = _mm_setzero_pd();
+    __m128d two = _mm_set1_pd (2.0);
+    int i = 0;
+
+    for (; i + 2 <= numBins; i += 2)
+    {
+        __m128d current = _mm_loadu_pd (magnitudes + i);
+        __m128d previous = _mm_loadu_pd (previousMagnitudes + i);
+
+        // the same operations in the same order as the generic variant, so each bin is identical
+        __m128d squares = _mm_add_pd (_mm_mul_pd (current, current), _mm_mul_pd (previous, previous));
+        __m128d product = _mm_mul_pd (_mm_mul_pd (_mm_mul_pd (two, current), previous), _mm_loadu_pd (cosPhaseDeviations + i));
+        __m128d csd = _mm_sqrt_pd (_mm_sub_pd (squares, product));
+
+        if (halfWaveRectify)
+        {
+            csd = _mm_and_pd (csd, _mm_cmpgt_pd (_mm_sub_pd (current, previous), zero));
+        }
+
+        _mm_storeu_pd (differences + i, csd);
+        _mm_storeu_pd (previousMagnitudes + i, current);
+    }
+
+    genericComplexSpectralDifference (magnitudes + i, previousMagnitudes + i, cosPhaseDeviations + i, differences + i, numBins - i, halfWaveRectify);
+}
+
+//=======================================================================
+BTRACK_TARGET ("sse2")
+static void sse2SlidingDFT (double* real, double* imag, const double* rotationReal, const double* rotationImag, const double* blockRotationReal, const double* blockRotationImag, const double* sampleChanges, int numSamples, int numBins)
+{
+    int k = 0;
+
+    // each step of the recursion has to wait for the last, so four vectors of bins are
+    // worked on at once, written out so that they are kept in registers
+    for (; k + 8 <= numBins; k += 8)
+    {
+        __m128d twoCa = _mm_add_pd (_mm_loadu_pd (rotationReal + k), _mm_loadu_pd (rotationReal + k));
+        __m128d twoCb = _mm_add_pd (_mm_loadu_pd (rotationReal + k + 2), _mm_loadu_pd (rotationReal + k + 2));
+        __m128d twoCc = _mm_add_pd (_mm_loadu_pd (rotationReal + k + 4), _mm_loadu_pd (rotationReal + k + 4));
+        __m128d twoCd = _mm_add_pd (_mm_loadu_pd (rotationReal + k + 6), _mm_loadu_pd (rotationReal + k + 6));
+        __m128d s1a = _mm_setzero_pd(), s1b = _mm_setzero_pd(), s1c = _mm_setzero_pd(), s1d = _mm_setzero_pd();
+        __m128d s2a = s1a, s2b = s1a, s2c = s1a, s2d = s1a;
+
+        for (int n = 0; n < numSamples; n++)
+        {
+            __m128d change = _mm_set1_pd (sampleChanges[n]);
+            __m128d s0a = _mm_add_pd (_mm_sub_pd (change, s2a), _mm_mul_pd (twoCa, s1a));
+            __m128d s0b = _mm_add_pd (_mm_sub_pd (change, s2b), _mm_mul_pd (twoCb, s1b));
+            __m128d s0c = _mm_add_pd (_mm_sub_pd (change, s2c), _mm_mul_pd (twoCc, s1c));
+            __m128d s0d = _mm_add_pd (_mm_sub_pd (change, s2d), _mm_mul_pd (twoCd, s1d));
+
+            s2a = s1a; s2b = s1b; s2c = s1c; s2d = s1d;
+            s1a = s0a; s1b = s0b; s1c = s0c; s1d = s0d;
+        }
+
+        __m128d s1[4] = {s1a, s1b, s1c, s1d};
+        __m128d s2[4] = {s2a, s2b, s2c, s2d};
+
+        // rotate the bins on by the block and add the recursion's sum
+        for (int v = 0; v < 4; v++)
+        {
+            int b = k + (2 * v);
+            __m128d c = _mm_loadu_pd (rotationReal + b);
+            __m128d s = _mm_loadu_pd (rotationImag + b);
+            __m128d bc = _mm_loadu_pd (blockRotationReal + b);
+            __m128d bs = _mm_loadu_pd (blockRotationImag + b);
+            __m128d re = _mm_loadu_pd (real + b);
+            __m128d im = _mm_loadu_pd (imag + b);
+
+            _mm_storeu_pd (real + b, _mm_add_pd (_mm_sub_pd (_mm_mul_pd (re, bc), _mm_mul_pd (im, bs)), _mm_sub_pd (_mm_mul_pd (c, s1[v]), s2[v])));
+            _mm_storeu_pd (imag + b, _mm_add_pd (_mm_add_pd (_mm_mul_pd (re, bs), _mm_mul_pd (im, bc)), _mm_mul_pd (s, s1[v])));
+        }
+    }
+
+    genericSlidingDFT (real + k, imag + k, rotationReal + k, rotationImag + k, blockRotationReal + k, blockRotationImag + k, sampleChanges, numSamples, numBins - k);
+}
+
+//=======================================================================
+BTRACK_TARGET ("sse2")
+static void sse2MovingMean (const double* values, double* means, int numMeans, int windowLength)
+{
+    __m128d length = _mm_set1_pd ((double) windowLength);
+    int i = 0;
+
+    // each lane is a different mean, so the values are added in the same order as the generic kernel
+    for (; i + 2 <= numMeans; i += 2)
+    {
+        __m128d sums = _mm_setzero_pd();
+
+        for (int k = 0; k < windowLength; k++)
+        {
+            sums = _mm_add_pd (sums, _mm_loadu_pd (values + i + k));
+        }
+
+        _mm_storeu_pd (means + i, _mm_div_pd (sums, length));
+    }
+
+    genericMovingMean (values + i, means + i, numMeans - i, windowLength);
+}
+
+//=======================================================================
+BTRACK_TARGET ("sse2")
+static void sse2SubtractThreshold (double* values, const double* thresholds, int numValues)
+{
+    __m128d zero = _mm_setzero_pd();
+    int i = 0;
+
+    for (; i + 2 <= numValues; i += 2)
+    {
+        __m128d diff = _mm_sub_pd (_mm_loadu_pd (values + i), _mm_loadu_pd (thresholds + i));
+        _mm_storeu_pd (values + i, _mm_max_pd (diff, zero));
+    }
+
+    genericSubtractThreshold (values + i, thresholds + i, numValues - i);
+}
+
+//=======================================================================
+BTRACK_TARGET ("sse2")
+static void sse2CombFilterBank (const double* acf, const double* weighting, double* output, int numFilters, int numElements)
+{
+    for (int i = 0; i < numFilters; i++)
+    {
+        output[i] = 0;
+    }
+
+    // each lane is a different filter, so the terms are added in the same order as the generic kernel
+    int i = 2;
+
+    for (; i + 2 <= numFilters; i += 2)
+    {
+        __m128d weights = _mm_loadu_pd (weighting + i - 1);
+        __m128d sums = _mm_setzero_pd();
+
+        for (int a = 1; a <= numElements; a++)
+        {
+            __m128d normalisation = _mm_set1_pd ((double) (2 * a - 1));
+
+            for (int b = 1 - a; b <= a - 1; b++)
+            {
+                __m128d taps = _mm_set_pd (acf[(a * (i + 1) + b) - 1], acf[(a * i + b) - 1]);
+                sums = _mm_add_pd (sums, _mm_div_pd (_mm_mul_pd (taps, weights), normalisation));
+            }
+        }
+
+        _mm_storeu_pd (output + i - 1, sums);
+    }
+
+    for (; i <= numFilters - 1; i++)
+    {
+        for (int a = 1; a <= numElements; a++)
+        {
+            for (int b = 1 - a; b <= a - 1; b++)
+            {
+                output[i - 1] = output[i - 1] + (acf[(a * i + b) - 1] * weighting[i - 1]) / (2 * a - 1);
+            }
+        }
+    }
+}
+
+//=======================================================================
+BTRACK_TARGET ("sse2")
+static double sse2WeightedMaximum (const double* values, const double* weights, int numValues)
+{
+    __m128d maxima = _mm_setzero_pd();
+    int i = 0;
+
+    for (; i + 2 <= numValues; i += 2)
+    {
+        maxima = _mm_max_pd (_mm_mul_pd (_mm_loadu_pd (values + i), _mm_loadu_pd (weights + i)), maxima);
+    }
+
+    double lanes[2];
+    _mm_storeu_pd (lanes, maxima);
+    double max = lanes[0] > lanes[1] ? lanes[0] : lanes[1];
+    double remainder = genericWeightedMaximum (values + i, weights + i, numValues - i);
+
+    return remainder > max ? remainder : max;
+}
+
+//=======================================================================
+BTRACK_TARGET ("sse2")
+static double sse2SumOfSquares (const double* samples, int numSamples)
+{
+    __m128d sums = _mm_setzero_pd();
+    int i = 0;
+
+    for (; i + 2 <= numSamples; i += 2)
+    {
+        __m128d x = _mm_loadu_pd (samples + i);
+        sums = _mm_add_pd (sums, _mm_mul_pd (x, x));
+    }
+
+    double lanes[2];
+    _mm_storeu_pd (lanes, sums);
+    double sum = 0;
+
+    for (int k = 0; k < 2; k++)
+    {
+        sum = sum + lanes[k];
+    }
+
+    return sum + genericSumOfSquares (samples + i, numSamples - i);
+}
+
+//=======================================================================
+BTRACK_TARGET ("sse2")
+static double sse2ReplaceSamples (const double* newSamples, double* samples, int numSamples)
+{
+    __m128d changes = _mm_setzero_pd();
+    int i = 0;
+
+    for (; i + 2 <= numSamples; i += 2)
+    {
+        __m128d x = _mm_loadu_pd (newSamples + i);
+        __m128d y = _mm_loadu_pd (samples + i);
+        changes = _mm_add_pd (changes, _mm_sub_pd (_mm_mul_pd (x, x), _mm_mul_pd (y, y)));
+        _mm_storeu_pd (samples + i, x);
+    }
+
+    double lanes[2];
+    _mm_storeu_pd (lanes, changes);
+    double change = 0;
+
+    for (int k = 0; k < 2; k++)
+    {
+        change = change + lanes[k];
+    }
+
+    return change + genericReplaceSamples (newSamples + i, samples + i, numSamples - i);
+}
+
+//=======================================================================
+static const KernelTable sse2Kernels =
+{
+    sse2ApplyWindow,
+    sse2Magnitudes,
+    sse2SpectralDifference,
+    sse2ComplexSpectralDifference,
+    sse2SlidingDFT,
+    sse2MovingMean,
+    sse2SubtractThreshold,
+    sse2CombFilterBank,
+    sse2WeightedMaximum,
+    sse2SumOfSquares,
+    sse2ReplaceSamples
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////// AVX2 Kernels //////////////////////////////////////////
+
+//=======================================================================
+BTRACK_TARGET ("avx2")
+static void avx2ApplyWindow (const double* samples, const double* window, double* output, int numSamples)
+{
+    int i = 0;
+
+    for (; i + 4 <= numSamples; i += 4)
+    {
+        _mm256_storeu_pd (output + i, _mm256_mul_pd (_mm256_loadu_pd (samples + i), _mm256_loadu_pd (window + i)));
+    }
+
+    sse2ApplyWindow (samples + i, window + i, output + i, numSamples - i);
+}
+
+//=======================================================================
+BTRACK_TARGET ("avx2")
+static void avx2Magnitudes (const double* complexIn, double* magnitudes, int numBins)
+{
+    int i = 0;
+
+    for (; i + 4 <= numBins; i += 4)
+    {
+        __m256d a = _mm256_loadu_pd (complexIn + 2 * i);
+        __m256d b = _mm256_loadu_pd (complexIn + 2 * i + 4);
+
+        // adding horizontal pairs of squares gives the bins in the order [0 2 1 3]
+        __m256d powers = _mm256_hadd_pd (_mm256_mul_pd (a, a), _mm256_mul_pd (b, b));
+        powers = _mm256_permute4x64_pd (powers, 0xD8);
+        _mm256_storeu_pd (magnitudes + i, _mm256_sqrt_pd (powers));
+    }
+
+    sse2Magnitudes (complexIn + 2 * i, magnitudes + i, numBins - i);
+}
+
+//=======================================================================
+BTRACK_TARGET ("avx2")
+static double avx2SpectralDifference (const double* magnitudes, double* previousMagnitudes, int numBins, bool halfWaveRectify, bool weightByBinNumber)
+{
+    __m256d zero = _mm256_setzero_pd();
+    __m256d signMask = _mm256_set1_pd (-0.0);
+    __m256d binNumbers = _mm256_set_pd (4.0, 3.0, 2.0, 1.0);
+    __m256d binStep = _mm256_set1_pd (4.0);
+    __m256d sums = zero;
+    int i = 0;
+
+    for (; i + 4 <= numBins; i += 4)
+    {
+        __m256d current = _mm256_loadu_pd (magnitudes + i);
+        __m256d diff = _mm256_sub_pd (current, _mm256_loadu_pd (previousMagnitudes + i));
+
+        diff = halfWaveRectify ? _mm256_max_pd (diff, zero) : _mm256_andnot_pd (signMask, diff);
+
+        if (weightByBinNumber)
+        {
+            diff = _mm256_mul_pd (diff, binNumbers);
+            binNumbers = _mm256_add_pd (binNumbers, binStep);
+        }
+
+        sums = _mm256_add_pd (sums, diff);
+        _mm256_storeu_pd (previousMagnitudes + i, current);
+    }
+
+    double lanes[4];
+    _mm256_storeu_pd (lanes, sums);
+    double sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+
+    for (; i < numBins; i++)
+    {
+        double diff = magnitudes[i] - previousMagnitudes[i];
+        diff = halfWaveRectify ? (diff > 0 ? diff : 0) : fabs (diff);
+        sum = sum + (weightByBinNumber ? diff * ((double) (i + 1)) : diff);
+        previousMagnitudes[i] = magnitudes[i];
+    }
+
+    return sum;
+}
+
+//=======================================================================
+BTRACK_TARGET ("avx2")
+static void avx2ComplexSpectralDifference (const double* magnitudes, double* previousMagnitudes, const double* cosPhaseDeviations, double* differences, int numBins, bool halfWaveRectify)
+{
+    __m256d zero = _mm256_setzero_pd();
+    __m256d two = _mm256_set1_pd (2.0);
+    int i = 0;
+
+    for (; i + 4 <= numBins; i += 4)
+    {
+        __m256d current = _mm256_loadu_pd (magnitudes + i);
+        __m256d previous = _mm256_loadu_pd (previousMagnitudes + i);
+
+        __m256d squares = _mm256_add_pd (_mm256_mul_pd (current, current), _mm256_mul_pd (previous, previous));
+        __m256d product = _mm256_mul_pd (_mm256_mul_pd (_mm256_mul_pd (two, current), previous), _mm256_loadu_pd (cosPhaseDeviations + i));
+        __m256d csd = _mm256_sqrt_pd (_mm256_sub_pd (squares, product));
+
+        if (halfWaveRectify)
+        {
+            csd = _mm256_and_pd (csd, _mm256_cmp_pd (_mm256_sub_pd (current, previous), zero, _CMP_GT_OQ));
+        }
+
+        _mm256_storeu_pd (differences + i, csd);
+        _mm256_storeu_pd (previousMagnitudes + i, current);
+    }
+
+    sse2ComplexSpectralDifference (magnitudes + i, previousMagnitudes + i, cosPhaseDeviations + i, differences + i, numBins - i, halfWaveRectify);
+}
+
+//=======================================================================
+BTRACK_TARGET ("avx2")
+static void avx2SlidingDFT (double* real, double* imag, const double* rotationReal, const double* rotationImag, const double* blockRotationReal, const double* blockRotationImag, const double* sampleChanges, int numSamples, int numBins)
+{
+    int k = 0;
+
+    for (; k + 16 <= numBins; k += 16)
+    {
+        __m256d twoCa = _mm256_add_pd (_mm256_loadu_pd (rotationReal + k), _mm256_loadu_pd (rotationReal + k));
+        __m256d twoCb = _mm256_add_pd (_mm256_loadu_pd (rotationReal + k + 4), _mm256_loadu_pd (rotationReal + k + 4));
+        __m256d twoCc = _mm256_add_pd (_mm256_loadu_pd (rotationReal + k + 8), _mm256_loadu_pd (rotationReal + k + 8));
+        __m256d twoCd = _mm256_add_pd (_mm256_loadu_pd (rotationReal + k + 12), _mm256_loadu_pd (rotationReal + k + 12));
+        __m256d s1a = _mm256_setzero_pd(), s1b = _mm256_setzero_pd(), s1c = _mm256_setzero_pd(), s1d = _mm256_setzero_pd();
+        __m256d s2a = s1a, s2b = s1a, s2c = s1a, s2d = s1a;
+
+        for (int n = 0; n < numSamples; n++)
+        {
+            __m256d change = _mm256_set1_pd (sampleChanges[n]);
+            __m256d s0a = _mm256_add_pd (_mm256_sub_pd (change, s2a), _mm256_mul_pd (twoCa, s1a));
+            __m256d s0b = _mm256_add_pd (_mm256_sub_pd (change, s2b), _mm256_mul_pd (twoCb, s1b));
+            __m256d s0c = _mm256_add_pd (_mm256_sub_pd (change, s2c), _mm256_mul_pd (twoCc, s1c));
+            __m256d s0d = _mm256_add_pd (_mm256_sub_pd (change, s2d), _mm256_mul_pd (twoCd, s1d));
+
+            s2a = s1a; s2b = s1b; s2c = s1c; s2d = s1d;
+            s1a = s0a; s1b = s0b; s1c = s0c; s1d = s0d;
+        }
+
+        __m256d s1[4] = {s1a, s1b, s1c, s1d};
+        __m256d s2[4] = {s2a, s2b, s2c, s2d};
+
+        // rotate the bins on by the block and add the recursion's sum
+        for (int v = 0; v < 4; v++)
+        {
+            int b = k + (4 * v);
+            __m256d c = _mm256_loadu_pd (rotationReal + b);
+            __m256d s = _mm256_loadu_pd (rotationImag + b);
+            __m256d bc = _mm256_loadu_pd (blockRotationReal + b);
+            __m256d bs = _mm256_loadu_pd (blockRotationImag + b);
+            __m256d re = _mm256_loadu_pd (real + b);
+            __m256d im = _mm256_loadu_pd (imag + b);
+
+            _mm256_storeu_pd (real + b, _mm256_add_pd (_mm256_sub_pd (_mm256_mul_pd (re, bc), _mm256_mul_pd (im, bs)), _mm256_sub_pd (_mm256_mul_pd (c, s1[v]), s2[v])));
+            _mm256_storeu_pd (imag + b, _mm256_add_pd (_mm256_add_pd (_mm256_mul_pd (re, bs), _mm256_mul_pd (im, bc)), _mm256_mul_pd (s, s1[v])));
+        }
+    }
+
+    sse2SlidingDFT (real + k, imag + k, rotationReal + k, rotationImag + k, blockRotationReal + k, blockRotationImag + k, sampleChanges, numSamples, numBins - k);
+}
+
+//=======================================================================
+BTRACK_TARGET ("avx2")
+static void avx2MovingMean (const double* values, double* means, int numMeans, int windowLength)
+{
+    __m256d length = _mm256_set1_pd ((double) windowLength);
+    int i = 0;
+
+    for (; i + 4 <= numMeans; i += 4)
+    {
+        __m256d sums = _mm256_setzero_pd();
+
+        for (int k = 0; k < windowLength; k++)
+        {
+            sums = _mm256_add_pd (sums, _mm256_loadu_pd (values + i + k));
+        }
+
+        _mm256_storeu_pd (means + i, _mm256_div_pd (sums, length));
+    }
+
+    sse2MovingMean (values + i, means + i, numMeans - i, windowLength);
+}
+
+//=======================================================================
+BTRACK_TARGET ("avx2")
+static void avx2SubtractThreshold (double* values, const double* thresholds, int numValues)
+{
+    __m256d zero = _mm256_setzero_pd();
+    int i = 0;
+
+    for (; i + 4 <= numValues; i += 4)
+    {
+        __m256d diff = _mm256_sub_pd (_mm256_loadu_pd (values + i), _mm256_loadu_pd (thresholds + i));
+        _mm256_storeu_pd (values + i, _mm256_max_pd (diff, zero));
+    }
+
+    sse2SubtractThreshold (values + i, thresholds + i, numValues - i);
+}
+
+//=======================================================================
+BTRACK_TARGET ("avx2")
+static void avx2CombFilterBank (const double* acf, const double* weighting, double* output, int numFilters, int numElements)
+{
+    for (int i = 0; i < numFilters; i++)
+    {
+        output[i] = 0;
+    }
+
+    int i = 2;
+
+    for (; i + 4 <= numFilters; i += 4)
+    {
+        __m256d weights = _mm256_loadu_pd (weighting + i - 1);
+        __m256d sums = _mm256_setzero_pd();
+        __m128i filters = _mm_set_epi32 (i + 3, i + 2, i + 1, i);
+
+        for (int a = 1; a <= numElements; a++)
+        {
+            __m256d normalisation = _mm256_set1_pd ((double) (2 * a - 1));
+            __m128i firstTaps = _mm_mullo_epi32 (filters, _mm_set1_epi32 (a));
+
+            for (int b = 1 - a; b <= a - 1; b++)
+            {
+                __m128i indices = _mm_add_epi32 (firstTaps, _mm_set1_epi32 (b - 1));
+                __m256d taps = _mm256_i32gather_pd (acf, indices, 8);
+                sums = _mm256_add_pd (sums, _mm256_div_pd (_mm256_mul_pd (taps, weights), normalisation));
+            }
+        }
+
+        _mm256_storeu_pd (output + i - 1, sums);
+    }
+
+    for (; i <= numFilters - 1; i++)
+    {
+        for (int a = 1; a <= numElements; a++)
+        {
+            for (int b = 1 - a; b <= a - 1; b++)
+            {
+                output[i - 1] = output[i - 1] + (acf[(a * i + b) - 1] * weighting[i - 1]) / (2 * a - 1);
+            }
+        }
+    }
+}
+
+//=======================================================================
+BTRACK_TARGET ("avx2")
+static double avx2WeightedMaximum (const double* values, const double* weights, int numValues)
+{
+    __m256d maxima = _mm256_setzero_pd();
+    int i = 0;
+
+    for (; i + 4 <= numValues; i += 4)
+    {
+        maxima = _mm256_max_pd (_mm256_mul_pd (_mm256_loadu_pd (values + i), _mm256_loadu_pd (weights + i)), maxima);
+    }
+
+    double lanes[4];
+    _mm256_storeu_pd (lanes, maxima);
+    double max = sse2WeightedMaximum (values + i, weights + i, numValues - i);
+
+    for (int k = 0; k < 4; k++)
+    {
+        max = lanes[k] > max ? lanes[k] : max;
+    }
+
+    return max;
+}
+
+//=======================================================================
+BTRACK_TARGET ("avx2")
+static double avx2SumOfSquares (const double* samples, int numSamples)
+{
+    __m256d sums = _mm256_setzero_pd();
+    int i = 0;
+
+    for (; i + 4 <= numSamples; i += 4)
+    {
+        __m256d x = _mm256_loadu_pd (samples + i);
+        sums = _mm256_add_pd (sums, _mm256_mul_pd (x, x));
+    }
+
+    double lanes[4];
+    _mm256_storeu_pd (lanes, sums);
+    double sum = 0;
+
+    for (int k = 0; k < 4; k++)
+    {
+        sum = sum + lanes[k];
+    }
+
+    return sum + sse2SumOfSquares (samples + i, numSamples - i);
+}
+
+//=======================================================================
+BTRACK_TARGET ("avx2")
+static double avx2ReplaceSamples (const double* newSamples, double* samples, int numSamples)
+{
+    __m256d changes = _mm256_setzero_pd();
+    int i = 0;
+
+    for (; i + 4 <= numSamples; i += 4)
+    {
+        __m256d x = _mm256_loadu_pd (newSamples + i);
+        __m256d y = _mm256_loadu_pd (samples + i);
+        changes = _mm256_add_pd (changes, _mm256_sub_pd (_mm256_mul_pd (x, x), _mm256_mul_pd (y, y)));
+        _mm256_storeu_pd (samples + i, x);
+    }
+
+    double lanes[4];
+    _mm256_storeu_pd (lanes, changes);
+    double change = 0;
+
+    for (int k = 0; k < 4; k++)
+    {
+        change = change + lanes[k];
+    }
+
+    return change + sse2ReplaceSamples (newSamples + i, samples + i, numSamples - i);
+}
+
+//=======================================================================
+static const KernelTable avx2Kernels =
+{
+    avx2ApplyWindow,
+    avx2Magnitudes,
+    avx2SpectralDifference,
+    avx2ComplexSpectralDifference,
+    avx2SlidingDFT,
+    avx2MovingMean,
+    avx2SubtractThreshold,
+    avx2CombFilterBank,
+    avx2WeightedMaximum,
+    avx2SumOfSquares,
+    avx2ReplaceSamples
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////// AVX-512 Kernels ////////////////////////////////////////
+
+//=======================================================================
+BTRACK_TARGET ("avx512f")
+static void avx512ApplyWindow (const double* samples, const double* window, double* output, int numSamples)
+{
+    int i = 0;
+
+    for (; i + 8 <= numSamples; i += 8)
+    {
+        _mm512_storeu_pd (output + i, _mm512_mul_pd (_mm512_loadu_pd (samples + i), _mm512_loadu_pd (window + i)));
+    }
+
+    avx2ApplyWindow (samples + i, window + i, output + i, numSamples - i);
+}
+
+//=======================================================================
+BTRACK_TARGET ("avx512f")
+static void avx512Magnitudes (const double* complexIn, double* magnitudes, int numBins)
+{
+    __m512i realIndices = _mm512_set_epi64 (14, 12, 10, 8, 6, 4, 2, 0);
+    __m512i imagIndices = _mm512_set_epi64 (15, 13, 11, 9, 7, 5, 3, 1);
+    int i = 0;
+
+    for (; i + 8 <= numBins; i += 8)
+    {
+        __m512d a = _mm512_loadu_pd (complexIn + 2 * i);
+        __m512d b = _mm512_loadu_pd (complexIn + 2 * i + 8);
+        __m512d squaresA = _mm512_mul_pd (a, a);
+        __m512d squaresB = _mm512_mul_pd (b, b);
+
+        // squaring before separating the real and imaginary parts stops the compiler from
+        // fusing the multiply and add, which would round differently from the other variants
+        __m512d re = _mm512_permutex2var_pd (squaresA, realIndices, squaresB);
+        __m512d im = _mm512_permutex2var_pd (squaresA, imagIndices, squaresB);
+        _mm512_storeu_pd (magnitudes + i, _mm512_sqrt_pd (_mm512_add_pd (re, im)));
+    }
+
+    avx2Magnitudes (complexIn + 2 * i, magnitudes + i, numBins - i);
+}
+
+//=======================================================================
+BTRACK_TARGET ("avx512f")
+static double avx512SpectralDifference (const double* magnitudes, double* previousMagnitudes, int numBins, bool halfWaveRectify, bool weightByBinNumber)
+{
+    __m512d zero = _mm512_setzero_pd();
+    __m512d binNumbers = _mm512_set_pd (8.0, 7.0, 6.0, 5.0, 4.0, 3.0, 2.0, 1.0);
+    __m512d binStep = _mm512_set1_pd (8.0);
+    __m512d sums = zero;
+    int i = 0;
+
+    for (; i + 8 <= numBins; i += 8)
+    {
+        __m512d current = _mm512_loadu_pd (magnitudes + i);
+        __m512d diff = _mm512_sub_pd (current, _mm512_loadu_pd (previousMagnitudes + i));
+
+        diff = halfWaveRectify ? _mm512_max_pd (diff, zero) : _mm512_abs_pd (diff);
+
+        if (weightByBinNumber)
+        {
+            diff = _mm512_mul_pd (diff, binNumbers);
+            binNumbers = _mm512_add_pd (binNumbers, binStep);
+        }
+
+        sums = _mm512_add_pd (sums, diff);
+        _mm512_storeu_pd (previousMagnitudes + i, current);
+    }
+
+    double sum = _mm512_reduce_add_pd (sums);
+
+    for (; i < numBins; i++)
+    {
+        double diff = magnitudes[i] - previousMagnitudes[i];
+        diff = halfWaveRectify ? (diff > 0 ? diff : 0) : fabs (diff);
+        sum = sum + (weightByBinNumber ? diff * ((double) (i + 1)) : diff);
+        previousMagnitudes[i] = magnitudes[i];
+    }
+
+    return sum;
+}
+
+//=======================================================================
+BTRACK_TARGET ("avx512f")
+static void avx512MovingMean (const double* values, double* means, int numMeans, int windowLength)
+{
+    __m512d length = _mm512_set1_pd ((double) windowLength);
+    int i = 0;
+
+    for (; i + 8 <= numMeans; i += 8)
+    {
+        __m512d sums = _mm512_setzero_pd();
+
+        for (int k = 0; k < windowLength; k++)
+        {
+            sums = _mm512_add_pd (sums, _mm512_loadu_pd (values + i + k));
+        }
+
+        _mm512_storeu_pd (means + i, _mm512_div_pd (sums, length));
+    }
+
+    avx2MovingMean (values + i, means + i, numMeans - i, windowLength);
+}
+
+//=======================================================================
+BTRACK_TARGET ("avx512f")
+static void avx512SubtractThreshold (double* values, const double* thresholds, int numValues)
+{
+    __m512d zero = _mm512_setzero_pd();
+    int i = 0;
+
+    for (; i + 8 <= numValues; i += 8)
+    {
+        __m512d diff = _mm512_sub_pd (_mm512_loadu_pd (values + i), _mm512_loadu_pd (thresholds + i));
+        _mm512_storeu_pd (values + i, _mm512_max_pd (diff, zero));
+    }
+
+    avx2SubtractThreshold (values + i, thresholds + i, numValues - i);
+}
+
+//=======================================================================
+BTRACK_TARGET ("avx512f")
+static void avx512CombFilterBank (const double* acf, const double* weighting, double* output, int numFilters, int numElements)
+{
+    for (int i = 0; i < numFilters; i++)
+    {
+        output[i] = 0;
+    }
+
+    int i = 2;
+
+    for (; i + 8 <= numFilters; i += 8)
+    {
+        __m512d weights = _mm512_loadu_pd (weighting + i - 1);
+        __m512d sums = _mm512_setzero_pd();
+        __m256i filters = _mm256_set_epi32 (i + 7, i + 6, i + 5, i + 4, i + 3, i + 2, i + 1, i);
+
+        for (int a = 1; a <= numElements; a++)
+        {
+            __m512d normalisation = _mm512_set1_pd ((double) (2 * a - 1));
+            __m256i firstTaps = _mm256_mullo_epi32 (filters, _mm256_set1_epi32 (a));
+
+            for (int b = 1 - a; b <= a - 1; b++)
+            {
+                __m256i indices = _mm256_add_epi32 (firstTaps, _mm256_set1_epi32 (b - 1));
+                __m512d taps = _mm512_i32gather_pd (indices, acf, 8);
+                sums = _mm512_add_pd (sums, _mm512_div_pd (_mm512_mul_pd (taps, weights), normalisation));
+            }
+        }
+
+        _mm512_storeu_pd (output + i - 1, sums);
+    }
+
+    for (; i <= numFilters - 1; i++)
+    {
+        for (int a = 1; a <= numElements; a++)
+        {
+            for (int b = 1 - a; b <= a - 1; b++)
+            {
+                output[i - 1] = output[i - 1] + (acf[(a * i + b) - 1] * weighting[i - 1]) / (2 * a - 1);
+            }
+        }
+    }
+}
+
+//=======================================================================
+BTRACK_TARGET ("avx512f")
+static double avx512WeightedMaximum (const double* values, const double* weights, int numValues)
+{
+    __m512d maxima = _mm512_setzero_pd();
+    int i = 0;
+
+    for (; i + 8 <= numValues; i += 8)
+    {
+        maxima = _mm512_max_pd (_mm512_mul_pd (_mm512_loadu_pd (values + i), _mm512_loadu_pd (weights + i)), maxima);
+    }
+
+    double max = _mm512_reduce_max_pd (maxima);
+    double remainder = avx2WeightedMaximum (values + i, weights + i, numValues - i);
+
+    return remainder > max ? remainder : max;
+}
+
+//=======================================================================
+BTRACK_TARGET ("avx512f")
+static double avx512SumOfSquares (const double* samples, int numSamples)
+{
+    __m512d sums = _mm512_setzero_pd();
+    int i = 0;
+
+    for (; i + 8 <= numSamples; i += 8)
+    {
+        __m512d x = _mm512_loadu_pd (samples + i);
+        sums = _mm512_add_pd (sums, _mm512_mul_pd (x, x));
+    }
+
+    double sum = _mm512_reduce_add_pd (sums);
+
+    return sum + avx2SumOfSquares (samples + i, numSamples - i);
+}
+
+//=======================================================================
+BTRACK_TARGET ("avx512f")
+static double avx512ReplaceSamples (const double* newSamples, double* samples, int numSamples)
+{
+    __m512d changes = _mm512_setzero_pd();
+    int i = 0;
+
+    for (; i + 8 <= numSamples; i += 8)
+    {
+        __m512d x = _mm512_loadu_pd (newSamples + i);
+        __m512d y = _mm512_loadu_pd (samples + i);
+        changes = _mm512_add_pd (changes, _mm512_sub_pd (_mm512_mul_pd (x, x), _mm512_mul_pd (y, y)));
+        _mm512_storeu_pd (samples + i, x);
+    }
+
+    double change = _mm512_reduce_add_pd (changes);
+
+    return change + avx2ReplaceSamples (newSamples + i, samples + i, numSamples - i);
+}
+
+//=======================================================================
+static const KernelTable avx512Kernels =
+{
+    avx512ApplyWindow,
+    avx512Magnitudes,
+    avx512SpectralDifference,
+    avx2ComplexSpectralDifference,   // with AVX-512 the compiler fuses the multiplies and adds, which rounds each bin differently
+    avx2SlidingDFT,                  // for the same reason
+    avx512MovingMean,
+    avx512SubtractThreshold,
+    avx512CombFilterBank,
+    avx512WeightedMaximum,
+    avx512SumOfSquares,
+    avx512ReplaceSamples
+};
+
+#if defined (__GNUC__) && !defined (__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif // BTRACK_X86_KERNELS
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////// Dispatch ////////////////////////////////////////////
+
+static const char* instructionSetNames[NumInstructionSets] = {"generic", "sse2", "avx2", "avx512"};
+
+static std::atomic<int> activeInstructionSet (-1);
+static std::atomic<const KernelTable*> activeKernels (NULL);
+
+//=======================================================================
+static const KernelTable* kernelsForInstructionSet (int instructionSet)
+{
+#ifdef BTRACK_X86_KERNELS
+    switch (instructionSet)
+    {
+        case SSE2InstructionSet:
+            return &sse2Kernels;
+        case AVX2InstructionSet:
+            return &avx2Kernels;
+        case AVX512InstructionSet:
+            return &avx512Kernels;
+        default:
+            break;
+    }
+#endif
+
+    return &genericKernels;
+}
+
+//=======================================================================
+static int chooseInstructionSet()
+{
+    int instructionSet = NumInstructionSets - 1;
+
+    // an environment variable can force a lower instruction set, e.g. for testing
+    const char* requested = getenv ("BTRACK_INSTRUCTION_SET");
+
+    if (requested != NULL)
+    {
+        for (int i = 0; i < NumInstructionSets; i++)
+        {
+            if (strcmp (requested, instructionSetNames[i]) == 0)
+            {
+                instructionSet = i;
+            }
+        }
+    }
+
+    while (!DSPKernels::isInstructionSetSupported (instructionSet))
+    {
+        instructionSet--;
+    }
+
+    return instructionSet;
+}
+
+//=======================================================================
+static const KernelTable& kernels()
+{
+    const KernelTable* table = activeKernels.load (std::memory_order_acquire);
+
+    if (table == NULL)
+    {
+        // if two threads get here together they make the same choice, so either store is fine
+        int instructionSet = chooseInstructionSet();
+        table = kernelsForInstructionSet (instructionSet);
+        activeInstructionSet.store (instructionSet, std::memory_order_relaxed);
+        activeKernels.store (table, std::memory_order_release);
+    }
+
+    return *table;
+}
+
+//=======================================================================
+int DSPKernels::getInstructionSet()
+{
+    kernels();
+    return activeInstructionSet.load (std::memory_order_relaxed);
+}
+
+//=======================================================================
+const char* DSPKernels::getInstructionSetName()
+{
+    return getInstructionSetName (getInstructionSet());
+}
+
+//=======================================================================
+const char* DSPKernels::getInstructionSetName (int instructionSet)
+{
+    if (instructionSet < 0 || instructionSet >= NumInstructionSets)
+    {
+        return "unknown";
+    }
+
+    return instructionSetNames[instructionSet];
+}
+
+//=======================================================================
+bool DSPKernels::isInstructionSetSupported (int instructionSet)
+{
+    if (instructionSet == GenericInstructionSet)
+    {
+        return true;
+    }
+
+#ifdef BTRACK_X86_KERNELS
+    __builtin_cpu_init();
+
+    switch (instructionSet)
+    {
+        case SSE2InstructionSet:
+            return __builtin_cpu_supports ("sse2");
+        case AVX2InstructionSet:
+            return __builtin_cpu_supports ("avx2");
+        case AVX512InstructionSet:
+            return __builtin_cpu_supports ("avx512f");
+        default:
+            break;
+    }
+#endif
+
+    return false;
+}
+
+//=======================================================================
+bool DSPKernels::setInstructionSet (int instructionSet)
+{
+    if (!isInstructionSetSupported (instructionSet))
+    {
+        return false;
+    }
+
+    activeInstructionSet.store (instructionSet, std::memory_order_relaxed);
+    activeKernels.store (kernelsForInstructionSet (instructionSet), std::memory_order_release);
+
+    return true;
+}
+
+//=======================================================================
+void DSPKernels::applyWindow (const double* samples, const double* window, double* output, int numSamples)
+{
+    kernels().applyWindow (samples, window, output, numSamples);
+}
+
+//=======================================================================
+void DSPKernels::magnitudes (const double* complexIn, double* magnitudes, int numBins)
+{
+    kernels().magnitudes (complexIn, magnitudes, numBins);
+}
+
+//=======================================================================
+double DSPKernels::spectralDifference (const double* magnitudes, double* previousMagnitudes, int numBins, bool halfWaveRectify, bool weightByBinNumber)
+{
+    return kernels().spectralDifference (magnitudes, previousMagnitudes, numBins, halfWaveRectify, weightByBinNumber);
+}
+
+//=======================================================================
+void DSPKernels::complexSpectralDifference (const double* magnitudes, double* previousMagnitudes, const double* cosPhaseDeviations, double* differences, int numBins, bool halfWaveRectify)
+{
+    kernels().complexSpectralDifference (magnitudes, previousMagnitudes, cosPhaseDeviations, differences, numBins, halfWaveRectify);
+}
+
+//=======================================================================
+double DSPKernels::sumMirroredSpectrum (const double* values, int frameSize)
+{
+    double sum = 0;
+
+    for (int i = 0; i <= frameSize / 2; i++)
+    {
+        sum = sum + values[i];
+    }
+
+    for (int i = (frameSize / 2) + 1; i < frameSize; i++)
+    {
+        sum = sum + values[frameSize - i];
+    }
+
+    return sum;
+}
+
+//=======================================================================
+void DSPKernels::slidingDFT (double* real, double* imag, const double* rotationReal, const double* rotationImag, const double* blockRotationReal, const double* blockRotationImag, const double* sampleChanges, int numSamples, int numBins)
+{
+    kernels().slidingDFT (real, imag, rotationReal, rotationImag, blockRotationReal, blockRotationImag, sampleChanges, numSamples, numBins);
+}
+
+//=======================================================================
+void DSPKernels::movingMean (const double* values, double* means, int numMeans, int windowLength)
+{
+    kernels().movingMean (values, means, numMeans, windowLength);
+}
+
+//=======================================================================
+void DSPKernels::subtractThreshold (double* values, const double* thresholds, int numValues)
+{
+    kernels().subtractThreshold (values, thresholds, numValues);
+}
+
+//=======================================================================
+void DSPKernels::combFilterBank (const double* acf, const double* weighting, double* output, int numFilters, int numElements)
+{
+    kernels().combFilterBank (acf, weighting, output, numFilters, numElements);
+}
+
+//=======================================================================
+double DSPKernels::weightedMaximum (const double* values, const double* weights, int numValues)
+{
+    return kernels().weightedMaximum (values, weights, numValues);
+}
+
+//=======================================================================
+double DSPKernels::sumOfSquares (const double* samples, int numSamples)
+{
+    return kernels().sumOfSquares (samples, numSamples);
+}
+
+//=======================================================================
+double DSPKernels::replaceSamples (const double* newSamples, double* samples, int numSamples)
+{
+    return kernels().replaceSamples (newSamples, samples, numSamples);
+}
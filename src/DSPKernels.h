@@ -0,0 +1,190 @@
+//=======================================================================
+/** @file DSPKernels.h
+ *  @brief Inner loops used by BTrack, with variants for different instruction sets
+ *  @author Adam Stark
+ *  @copyright Copyright (C) 2008-2014  Queen Mary University of London
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+//=======================================================================
+
+#ifndef DSPKernels_h
+#define DSPKernels_h
+
+//=======================================================================
+/** The instruction sets that the kernels have variants for */
+enum InstructionSet
+{
+    GenericInstructionSet,
+    SSE2InstructionSet,
+    AVX2InstructionSet,
+    AVX512InstructionSet,
+    NumInstructionSets
+};
+
+//=======================================================================
+/** The inner loops used when calculating the onset detection function and
+ * tracking beats. Each kernel has a variant for every instruction set, and the
+ * best variant that the processor supports is chosen the first time a kernel
+ * is used, so that one binary can run well on different processors.
+ *
+ * The choice can be overridden by setting the environment variable
+ * BTRACK_INSTRUCTION_SET to generic, sse2, avx2 or avx512 before the first
+ * kernel is used. A request for an instruction set that the processor doesn't
+ * support falls back to the best one that it does.
+ *
+ * The vector variants give the same results as the generic ones, except for
+ * the kernels that return a sum, which add their terms in a different order
+ * and so can differ in the last few bits.
+ */
+class DSPKernels
+{
+public:
+
+    //=======================================================================
+    /** @returns the instruction set that the kernels are currently using (see InstructionSet) */
+    static int getInstructionSet();
+
+    /** @returns the name of the instruction set that the kernels are currently using */
+    static const char* getInstructionSetName();
+
+    /** @returns the name of an instruction set (see InstructionSet) */
+    static const char* getInstructionSetName (int instructionSet);
+
+    /** @returns true if the processor that we are running on supports an instruction set (see InstructionSet) */
+    static bool isInstructionSetSupported (int instructionSet);
+
+    /** Choose the instruction set used by the kernels. This isn't thread safe with
+     * respect to processing, so it should be called before processing starts
+     * @param instructionSet the instruction set to use (see InstructionSet)
+     * @returns false, leaving the current choice unchanged, if the processor doesn't support the instruction set
+     */
+    static bool setInstructionSet (int instructionSet);
+
+    //=======================================================================
+    /** Multiply samples by a window
+     * @param samples the samples to window
+     * @param window the window
+     * @param output an array to hold the numSamples windowed samples
+     * @param numSamples the number of samples
+     */
+    static void applyWindow (const double* samples, const double* window, double* output, int numSamples);
+
+    /** Calculate the magnitudes of an array of complex values
+     * @param complexIn the interleaved real and imaginary parts of numBins complex values
+     * @param magnitudes an array to hold the numBins magnitudes
+     * @param numBins the number of complex values
+     */
+    static void magnitudes (const double* complexIn, double* magnitudes, int numBins);
+
+    /** Sum the differences between two magnitude spectra, then copy the current
+     * magnitudes over the previous magnitudes ready for the next frame
+     * @param magnitudes the current magnitude spectrum
+     * @param previousMagnitudes the previous magnitude spectrum
+     * @param numBins the number of bins to sum over
+     * @param halfWaveRectify if true only increases in magnitude are summed, otherwise the absolute differences are summed
+     * @param weightByBinNumber if true each difference is multiplied by its bin number plus one
+     * @returns the sum of differences
+     */
+    static double spectralDifference (const double* magnitudes, double* previousMagnitudes, int numBins, bool halfWaveRectify, bool weightByBinNumber);
+
+    /** Calculate the complex spectral difference of each bin, which is the distance between the
+     * bin and its prediction from the previous two frames, then copy the current magnitudes
+     * over the previous magnitudes ready for the next frame. The cosines of the phase
+     * deviations are passed in rather than calculated, so that each bin's difference is
+     * exactly the same as when it is calculated one bin at a time. The differences are
+     * returned rather than summed, so that the caller can sum them in whatever order it needs
+     * @param magnitudes the current magnitude spectrum
+     * @param previousMagnitudes the previous magnitude spectrum
+     * @param cosPhaseDeviations the cosine of the deviation of each bin's phase from its prediction
+     * @param differences an array to hold the difference of each bin, which may be cosPhaseDeviations itself
+     * @param numBins the number of bins
+     * @param halfWaveRectify if true the difference of bins whose magnitude has not increased is zero
+     */
+    static void complexSpectralDifference (const double* magnitudes, double* previousMagnitudes, const double* cosPhaseDeviations, double* differences, int numBins, bool halfWaveRectify);
+
+    /** Sum a value for every bin of the spectrum of a real frame, of which only bins 0 to
+     * frameSize/2 are held because the bins above mirror those below. The bins are summed
+     * one at a time from 0 to frameSize - 1, the same order as when every bin is held, so
+     * this has no vector variants
+     * @param values the values of bins 0 to frameSize/2
+     * @param frameSize the number of bins in the whole spectrum
+     * @returns the sum over every bin
+     */
+    static double sumMirroredSpectrum (const double* values, int frameSize);
+
+    /** Slide the DFT of a frame of audio along by a block of samples. Bin k of a frame of N
+     * samples is rotated by e^(2 pi i k numSamples / N), and the changes in the samples that
+     * entered the frame are added to it, each rotated by e^(2 pi i k / N) once for every sample
+     * from it to the end of the block. The changes are summed with a Goertzel recursion, which
+     * is accurate for blocks of up to a few tens of samples
+     * @param real the real parts of the bins, which are updated in place
+     * @param imag the imaginary parts of the bins, which are updated in place
+     * @param rotationReal the real part of each bin's rotation per sample
+     * @param rotationImag the imaginary part of each bin's rotation per sample
+     * @param blockRotationReal the real part of each bin's rotation per block of numSamples samples
+     * @param blockRotationImag the imaginary part of each bin's rotation per block of numSamples samples
+     * @param sampleChanges each sample that enters the frame minus the one that it replaces, oldest first
+     * @param numSamples the number of samples in the block
+     * @param numBins the number of bins
+     */
+    static void slidingDFT (double* real, double* imag, const double* rotationReal, const double* rotationImag, const double* blockRotationReal, const double* blockRotationImag, const double* sampleChanges, int numSamples, int numBins);
+
+    /** Calculate the mean of each run of windowLength consecutive values
+     * @param values the values to average, holding numMeans + windowLength - 1 values
+     * @param means an array to hold the numMeans means, where means[i] is the mean of values[i] to values[i + windowLength - 1]
+     * @param numMeans the number of means to calculate
+     * @param windowLength the number of values in each mean
+     */
+    static void movingMean (const double* values, double* means, int numMeans, int windowLength);
+
+    /** Subtract a threshold from each value, setting values that fall below zero to zero
+     * @param values the values, which are modified in place
+     * @param thresholds the threshold for each value
+     * @param numValues the number of values
+     */
+    static void subtractThreshold (double* values, const double* thresholds, int numValues);
+
+    /** Calculate the output of a bank of comb filters applied to an autocorrelation function
+     * @param acf the autocorrelation function, holding at least numElements * numFilters values
+     * @param weighting the weighting applied to the output of each comb filter
+     * @param output an array to hold the numFilters outputs
+     * @param numFilters the number of comb filters
+     * @param numElements the number of elements in each comb filter
+     */
+    static void combFilterBank (const double* acf, const double* weighting, double* output, int numFilters, int numElements);
+
+    /** @returns the largest product of a value and its weight, or zero if none are positive
+     * @param values the values
+     * @param weights the weight for each value
+     * @param numValues the number of values
+     */
+    static double weightedMaximum (const double* values, const double* weights, int numValues);
+
+    /** @returns the sum of the squares of some samples
+     * @param samples the samples
+     * @param numSamples the number of samples
+     */
+    static double sumOfSquares (const double* samples, int numSamples);
+
+    /** Overwrite samples with new ones
+     * @param newSamples the new samples
+     * @param samples the samples to overwrite
+     * @param numSamples the number of samples
+     * @returns the sum of the squares of the new samples minus that of the samples they replaced
+     */
+    static double replaceSamples (const double* newSamples, double* samples, int numSamples);
+};
+
+#endif /* DSPKernels_h */
@@ -0,0 +1,505 @@
+//=======================================================================
+/** @file FFT.cpp
+ *  @brief An interface for the real FFTs used by BTrack, and the backends that provide them
+ *  @author Adam Stark
+ *  @copyright Copyright (C) 2008-2014  Queen Mary University of London
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+//=======================================================================
+
+#include <algorithm>
+#include <chrono>
+#include "FFT.h"
+#include "BuiltinFFT.h"
+
+#ifdef USE_FFTW
+#include "fftw3.h"
+#endif
+
+#ifdef USE_KISS_FFT
+#include "kiss_fft.h"
+#endif
+
+//=======================================================================
+void RealFFT::performForwardTransforms (double* signals, double* spectra, int numTransforms)
+{
+    for (int k = 0; k < numTransforms; k++)
+    {
+        std::copy (signals + (k * size), signals + ((k + 1) * size), getTimeDomainBuffer());
+        performForwardTransform();
+        std::copy (getSpectrumBuffer(), getSpectrumBuffer() + (2 * ((size / 2) + 1)), spectra + (2 * k * size));
+    }
+}
+
+//=======================================================================
+/** The built in FFT, which transforms the buffers in place. Sizes that aren't a
+ * power of two are transformed with a direct DFT instead, which takes time
+ * proportional to the square of the size */
+class BuiltinRealFFT : public RealFFT
+{
+public:
+
+    BuiltinRealFFT (int size_, MemoryResource* memory)
+     :  RealFFT (size_, memory),
+        fft (memory),
+        dftTwiddles (memory)
+    {
+        if (BuiltinFFT::supportsSize (size))
+        {
+            fft.initialise (size);
+        }
+        else
+        {
+            const double pi = 3.14159265358979323846;
+
+            dftTwiddles.resize (2 * size);
+
+            for (int n = 0; n < size; n++)
+            {
+                dftTwiddles[2 * n] = cos ((2 * pi * n) / size);
+                dftTwiddles[2 * n + 1] = sin ((2 * pi * n) / size);
+            }
+        }
+    }
+
+    void performForwardTransform()
+    {
+        transform (getTimeDomainBuffer(), getSpectrumBuffer());
+    }
+
+    void performInverseTransform()
+    {
+        if (fft.getSize() > 0)
+        {
+            fft.performInverseRealFFT (getSpectrumBuffer(), getTimeDomainBuffer());
+        }
+        else
+        {
+            performInverseDFT (getSpectrumBuffer(), getTimeDomainBuffer());
+        }
+    }
+
+    void performForwardTransforms (double* signals, double* spectra, int numTransforms)
+    {
+        // the built in FFT can read and write anywhere, so there is nothing to copy
+        for (int k = 0; k < numTransforms; k++)
+        {
+            transform (signals + (k * size), spectra + (2 * k * size));
+        }
+    }
+
+    size_t memoryFootprint() const
+    {
+        return RealFFT::memoryFootprint() + fft.memoryFootprint() + (dftTwiddles.capacity() * sizeof (double));
+    }
+
+private:
+
+    /** Perform a forward transform with the FFT, or the direct DFT if the FFT can't be of this size */
+    void transform (const double* input, double* spectrum)
+    {
+        if (fft.getSize() > 0)
+        {
+            fft.performRealFFT (input, spectrum);
+        }
+        else
+        {
+            performDFT (input, spectrum);
+        }
+    }
+
+    /** Calculate the first (size/2)+1 bins directly, as the sum of each sample times e^(-2 pi j k n / size) */
+    void performDFT (const double* input, double* spectrum)
+    {
+        for (int k = 0; k <= size / 2; k++)
+        {
+            double re = 0;
+            double im = 0;
+            int index = 0;
+
+            for (int n = 0; n < size; n++)
+            {
+                re = re + (input[n] * dftTwiddles[2 * index]);
+                im = im - (input[n] * dftTwiddles[2 * index + 1]);
+
+                // (k * n) modulo the size, without the multiplication overflowing
+                index += k;
+                index = (index >= size) ? (index - size) : index;
+            }
+
+            spectrum[2 * k] = re;
+            spectrum[2 * k + 1] = im;
+        }
+    }
+
+    /** Calculate the unnormalised inverse transform directly, the bins above size/2 being the conjugates of those below */
+    void performInverseDFT (const double* spectrum, double* output)
+    {
+        int numBins = (size / 2) + 1;
+
+        for (int n = 0; n < size; n++)
+        {
+            double sum = spectrum[0];
+            int index = n;
+
+            for (int k = 1; k < numBins; k++)
+            {
+                double term = (spectrum[2 * k] * dftTwiddles[2 * index]) - (spectrum[2 * k + 1] * dftTwiddles[2 * index + 1]);
+
+                // the middle bin of an even size has no mirror image
+                sum = sum + ((2 * k == size) ? term : 2 * term);
+
+                index += n;
+                index = (index >= size) ? (index - size) : index;
+            }
+
+            output[n] = sum;
+        }
+    }
+
+    BuiltinFFT fft;                     /**< the built in real FFT, which has a size of zero if it can't be of this size */
+    ArenaVector<double> dftTwiddles;    /**< the interleaved values of e^(2 pi j n / size), for the direct DFT */
+};
+
+//=======================================================================
+const char* BuiltinFFTBackend::getName() const
+{
+    return "builtin";
+}
+
+//=======================================================================
+bool BuiltinFFTBackend::supportsSize (int size) const
+{
+    // other sizes can still be created, with the much slower direct DFT, for when no other backend supports them
+    return BuiltinFFT::supportsSize (size);
+}
+
+//=======================================================================
+std::unique_ptr<RealFFT> BuiltinFFTBackend::createFFT (int size)
+{
+    return createFFT (size, NULL);
+}
+
+//=======================================================================
+std::unique_ptr<RealFFT> BuiltinFFTBackend::createFFT (int size, MemoryResource* memory)
+{
+    return std::unique_ptr<RealFFT> (new BuiltinRealFFT (size, memory));
+}
+
+#ifdef USE_FFTW
+//=======================================================================
+/** FFTW's real to complex and complex to real transforms, planned on the FFT's own buffers */
+class FFTWRealFFT : public RealFFT
+{
+public:
+
+    FFTWRealFFT (int size_, MemoryResource* memory)
+     :  RealFFT (size_, memory)
+    {
+        fftw_complex* spectrumIn = reinterpret_cast<fftw_complex*> (getSpectrumBuffer());
+
+        forwardPlan = fftw_plan_dft_r2c_1d (size, getTimeDomainBuffer(), spectrumIn, FFTW_ESTIMATE);
+        inversePlan = fftw_plan_dft_c2r_1d (size, spectrumIn, getTimeDomainBuffer(), FFTW_ESTIMATE);
+    }
+
+    ~FFTWRealFFT()
+    {
+        fftw_destroy_plan (forwardPlan);
+        fftw_destroy_plan (inversePlan);
+    }
+
+    void performForwardTransform()
+    {
+        fftw_execute (forwardPlan);
+    }
+
+    void performInverseTransform()
+    {
+        fftw_execute (inversePlan);
+    }
+
+    void performForwardTransforms (double* signals, double* spectra, int numTransforms)
+    {
+        // the arrays are aligned as our own buffers are, so the plan can be executed on them directly
+        for (int k = 0; k < numTransforms; k++)
+        {
+            fftw_execute_dft_r2c (forwardPlan, signals + (k * size), reinterpret_cast<fftw_complex*> (spectra + (2 * k * size)));
+        }
+    }
+
+private:
+
+    fftw_plan forwardPlan;              /**< real to complex fftw plan */
+    fftw_plan inversePlan;              /**< complex to real fftw plan */
+};
+
+//=======================================================================
+const char* FFTWBackend::getName() const
+{
+    return "fftw";
+}
+
+//=======================================================================
+std::unique_ptr<RealFFT> FFTWBackend::createFFT (int size)
+{
+    return createFFT (size, NULL);
+}
+
+//=======================================================================
+std::unique_ptr<RealFFT> FFTWBackend::createFFT (int size, MemoryResource* memory)
+{
+    // fftw keeps its plans in its own memory, but the buffers come from the resource
+    return std::unique_ptr<RealFFT> (new FFTWRealFFT (size, memory));
+}
+#endif
+
+#ifdef USE_KISS_FFT
+//=======================================================================
+/** Kiss FFT's complex transforms, applied to signals with no imaginary part */
+class KissRealFFT : public RealFFT
+{
+public:
+
+    KissRealFFT (int size_, MemoryResource* memory_)
+     :  RealFFT (size_, memory_),
+        memory (memory_ != NULL ? memory_ : MemoryResource::getDefault()),
+        fftIn (size_, kiss_fft_cpx(), memory_),
+        fftOut (size_, kiss_fft_cpx(), memory_)
+    {
+        // ask Kiss FFT how much memory a configuration needs, then give it that much from the resource
+        configSize = 0;
+        kiss_fft_alloc (size, 0, NULL, &configSize);
+        
+        forwardConfig = kiss_fft_alloc (size, 0, memory->allocate (configSize), &configSize);
+        inverseConfig = kiss_fft_alloc (size, 1, memory->allocate (configSize), &configSize);
+    }
+
+    ~KissRealFFT()
+    {
+        memory->deallocate (forwardConfig, configSize);
+        memory->deallocate (inverseConfig, configSize);
+    }
+
+    void performForwardTransform()
+    {
+        const double* input = getTimeDomainBuffer();
+        double* spectrum = getSpectrumBuffer();
+
+        for (int i = 0; i < size; i++)
+        {
+            fftIn[i].r = input[i];
+            fftIn[i].i = 0.0;
+        }
+
+        kiss_fft (forwardConfig, &fftIn[0], &fftOut[0]);
+
+        for (int i = 0; i <= size / 2; i++)
+        {
+            spectrum[2 * i] = fftOut[i].r;
+            spectrum[2 * i + 1] = fftOut[i].i;
+        }
+    }
+
+    void performInverseTransform()
+    {
+        const double* spectrum = getSpectrumBuffer();
+        double* output = getTimeDomainBuffer();
+
+        // rebuild the full conjugate symmetric spectrum
+        for (int i = 0; i <= size / 2; i++)
+        {
+            fftIn[i].r = spectrum[2 * i];
+            fftIn[i].i = spectrum[2 * i + 1];
+        }
+
+        for (int i = (size / 2) + 1; i < size; i++)
+        {
+            fftIn[i].r = fftIn[size - i].r;
+            fftIn[i].i = -fftIn[size - i].i;
+        }
+
+        kiss_fft (inverseConfig, &fftIn[0], &fftOut[0]);
+
+        for (int i = 0; i < size; i++)
+        {
+            output[i] = fftOut[i].r;
+        }
+    }
+
+    size_t memoryFootprint() const
+    {
+        return RealFFT::memoryFootprint() + (2 * configSize) + ((fftIn.capacity() + fftOut.capacity()) * sizeof (kiss_fft_cpx));
+    }
+
+private:
+
+    MemoryResource* memory;             /**< where the configurations were allocated from */
+    size_t configSize;                  /**< the size of each configuration in bytes */
+    kiss_fft_cfg forwardConfig;         /**< Kiss FFT configuration for forward transforms */
+    kiss_fft_cfg inverseConfig;         /**< Kiss FFT configuration for inverse transforms */
+    ArenaVector<kiss_fft_cpx> fftIn;    /**< FFT input values, in complex form */
+    ArenaVector<kiss_fft_cpx> fftOut;   /**< FFT output values, in complex form */
+};
+
+//=======================================================================
+const char* KissFFTBackend::getName() const
+{
+    return "kiss";
+}
+
+//=======================================================================
+std::unique_ptr<RealFFT> KissFFTBackend::createFFT (int size)
+{
+    return createFFT (size, NULL);
+}
+
+//=======================================================================
+std::unique_ptr<RealFFT> KissFFTBackend::createFFT (int size, MemoryResource* memory)
+{
+    return std::unique_ptr<RealFFT> (new KissRealFFT (size, memory));
+}
+#endif
+
+//=======================================================================
+/** @returns the backend chosen at compile time */
+static std::shared_ptr<FFTBackend> createCompiledBackend()
+{
+#if defined (USE_FFTW)
+    return std::make_shared<FFTWBackend>();
+#elif defined (USE_KISS_FFT)
+    return std::make_shared<KissFFTBackend>();
+#else
+    return std::make_shared<BuiltinFFTBackend>();
+#endif
+}
+
+//=======================================================================
+/** @returns the storage for the default backend */
+static std::shared_ptr<FFTBackend>& defaultBackend()
+{
+    static std::shared_ptr<FFTBackend> backend = createCompiledBackend();
+    return backend;
+}
+
+//=======================================================================
+std::shared_ptr<FFTBackend> FFTBackend::getDefault()
+{
+    return std::atomic_load (&defaultBackend());
+}
+
+//=======================================================================
+void FFTBackend::setDefault (std::shared_ptr<FFTBackend> backend)
+{
+    if (backend)
+    {
+        std::atomic_store (&defaultBackend(), backend);
+    }
+}
+
+//=======================================================================
+std::vector<std::shared_ptr<FFTBackend> > FFTBackend::getAvailableBackends()
+{
+    std::vector<std::shared_ptr<FFTBackend> > backends;
+
+#ifdef USE_FFTW
+    backends.push_back (std::make_shared<FFTWBackend>());
+#endif
+
+#ifdef USE_KISS_FFT
+    backends.push_back (std::make_shared<KissFFTBackend>());
+#endif
+
+    backends.push_back (std::make_shared<BuiltinFFTBackend>());
+
+    return backends;
+}
+
+//=======================================================================
+std::shared_ptr<FFTBackend> FFTBackend::findFastestBackend (int size)
+{
+    std::vector<std::shared_ptr<FFTBackend> > backends = getAvailableBackends();
+
+    // the built in backend is last, and transforms sizes that no backend supports
+    std::shared_ptr<FFTBackend> fastest = backends.back();
+    double fastestTime = -1.;
+
+    for (size_t b = 0; b < backends.size(); b++)
+    {
+        if (!backends[b]->supportsSize (size))
+        {
+            continue;
+        }
+
+        std::unique_ptr<RealFFT> fft = backends[b]->createFFT (size);
+
+        for (int i = 0; i < size; i++)
+        {
+            fft->getTimeDomainBuffer()[i] = (i % 7) - 3;
+        }
+
+        // warm the caches up before timing
+        fft->performForwardTransform();
+
+        // take the best of several runs so that interruptions don't count against a backend
+        double bestTime = -1.;
+
+        for (int run = 0; run < 5; run++)
+        {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+            for (int i = 0; i < 20; i++)
+            {
+                fft->performForwardTransform();
+            }
+
+            double time = std::chrono::duration<double> (std::chrono::steady_clock::now() - start).count();
+
+            if ((bestTime < 0) || (time < bestTime))
+            {
+                bestTime = time;
+            }
+        }
+
+        if ((fastestTime < 0) || (bestTime < fastestTime))
+        {
+            fastestTime = bestTime;
+            fastest = backends[b];
+        }
+    }
+
+    return fastest;
+}
+
+//=======================================================================
+std::unique_ptr<RealFFT> FFTBackend::createFFTForSize (FFTBackend& preferred, int size, MemoryResource* memory)
+{
+    if (preferred.supportsSize (size))
+    {
+        return preferred.createFFT (size, memory);
+    }
+
+    std::vector<std::shared_ptr<FFTBackend> > backends = getAvailableBackends();
+
+    for (size_t b = 0; b < backends.size(); b++)
+    {
+        if (backends[b]->supportsSize (size))
+        {
+            return backends[b]->createFFT (size, memory);
+        }
+    }
+
+    // the built in backend transforms any size, if slowly
+    return BuiltinFFTBackend().createFFT (size, memory);
+}
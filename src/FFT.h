@@ -0,0 +1,268 @@
+//=======================================================================
+/** @file FFT.h
+ *  @brief An interface for the real FFTs used by BTrack, and the backends that provide them
+ *  @author Adam Stark
+ *  @copyright Copyright (C) 2008-2014  Queen Mary University of London
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+//=======================================================================
+
+#ifndef FFT_h
+#define FFT_h
+
+#include <vector>
+#include <memory>
+#include "MemoryArena.h"
+
+//=======================================================================
+/** An array of doubles whose first element is aligned for vector loads and stores */
+class AlignedBuffer
+{
+public:
+
+    /** Constructor
+     * @param memory where to allocate the values from, or NULL for the heap
+     */
+    AlignedBuffer (MemoryResource* memory = NULL)
+     :  storage (memory)
+    {
+
+    }
+
+    /** Resize the buffer, setting all values to zero */
+    void resize (int size)
+    {
+        // every MemoryResource aligns its blocks to bufferAlignment
+        storage.assign (size, 0.0);
+    }
+
+    /** @returns a pointer to the first value */
+    double* data()
+    {
+        return storage.data();
+    }
+
+    /** @returns the number of values in the buffer */
+    int size() const
+    {
+        return (int) storage.size();
+    }
+
+    /** Exchange the contents of this buffer with another, without allocating */
+    void swap (AlignedBuffer& other)
+    {
+        storage.swap (other.storage);
+    }
+
+private:
+
+    ArenaVector<double> storage;    /**< the values */
+};
+
+//=======================================================================
+/** A forward and inverse FFT of real signals of one size. Signals are written to
+ * and read from the time domain buffer, and spectra to and from the spectrum
+ * buffer, both of which are allocated when the FFT is created, so transforms
+ * never allocate.
+ *
+ * The spectrum buffer holds interleaved real and imaginary parts. A forward
+ * transform fills in the first (N/2)+1 bins, but the buffer has room for all N
+ * bins so that callers can fill in the rest by conjugate symmetry in place.
+ * As with FFTW, transforms are unnormalised, so an inverse transform of a
+ * forward transform returns the signal multiplied by N.
+ */
+class RealFFT
+{
+public:
+
+    /** Constructor
+     * @param size_ the number of real samples in each transform
+     * @param memory where to allocate the buffers from, or NULL for the heap
+     */
+    RealFFT (int size_, MemoryResource* memory = NULL)
+     :  size (size_),
+        timeDomain (memory),
+        spectrum (memory)
+    {
+        timeDomain.resize (size);
+        spectrum.resize (2 * size);
+    }
+
+    /** Destructor */
+    virtual ~RealFFT()
+    {
+
+    }
+
+    /** @returns the number of real samples in each transform */
+    int getSize() const
+    {
+        return size;
+    }
+
+    /** @returns the buffer of getSize() real samples that is transformed */
+    double* getTimeDomainBuffer()
+    {
+        return timeDomain.data();
+    }
+
+    /** @returns the buffer of interleaved real and imaginary parts of getSize() complex bins */
+    double* getSpectrumBuffer()
+    {
+        return spectrum.data();
+    }
+
+    /** Transform the time domain buffer, putting the first (N/2)+1 bins in the spectrum buffer */
+    virtual void performForwardTransform() = 0;
+
+    /** Transform the first (N/2)+1 bins of the spectrum buffer, putting the result in the
+     * time domain buffer. The contents of the spectrum buffer may be overwritten
+     */
+    virtual void performInverseTransform() = 0;
+
+    /** Perform forward transforms on a run of signals held outside the FFT's own buffers.
+     * The default copies each signal through the time domain and spectrum buffers
+     * @param signals numTransforms signals of getSize() samples, one after the other. Both arrays must be aligned as an AlignedBuffer is
+     * @param spectra an array to hold numTransforms spectra, one every 2 * getSize() values
+     * @param numTransforms the number of signals to transform
+     */
+    virtual void performForwardTransforms (double* signals, double* spectra, int numTransforms);
+
+    /** @returns the number of bytes allocated for the buffers and any tables of this FFT.
+     * Implementations that allocate more than the two buffers should add their own memory
+     */
+    virtual size_t memoryFootprint() const
+    {
+        return (timeDomain.size() + spectrum.size()) * sizeof (double);
+    }
+
+protected:
+
+    int size;                       /**< the number of real samples in each transform */
+    AlignedBuffer timeDomain;       /**< the real samples */
+    AlignedBuffer spectrum;         /**< the interleaved complex bins */
+};
+
+//=======================================================================
+/** Creates FFTs of a particular implementation. One backend can be shared by
+ * any number of BTrack and OnsetDetectionFunction instances, each of which
+ * creates its own FFTs from it, so a backend can be chosen once for the
+ * machine and then used everywhere. Implement this, along with RealFFT, to
+ * supply an FFT of your own
+ */
+class FFTBackend
+{
+public:
+
+    /** Destructor */
+    virtual ~FFTBackend()
+    {
+
+    }
+
+    /** @returns the name of the backend */
+    virtual const char* getName() const = 0;
+
+    /** @returns true if createFFT() can be given this size. Backends whose FFTs only work for
+     * some sizes (e.g. powers of two) should override this, as the default accepts every size
+     * @param size the number of real samples in each transform
+     */
+    virtual bool supportsSize (int size) const
+    {
+        (void) size;
+        return true;
+    }
+
+    /** Create an FFT. This allocates memory, so it should not be called on the audio thread
+     * @param size the number of real samples in each transform, which will be one that supportsSize() accepts
+     */
+    virtual std::unique_ptr<RealFFT> createFFT (int size) = 0;
+
+    /** Create an FFT whose buffers are allocated from a MemoryResource. Backends that don't
+     * override this allocate from the heap instead
+     * @param size the number of real samples in each transform, which will be one that supportsSize() accepts
+     * @param memory where to allocate the buffers from
+     */
+    virtual std::unique_ptr<RealFFT> createFFT (int size, MemoryResource* memory)
+    {
+        (void) memory;
+        return createFFT (size);
+    }
+
+    //=======================================================================
+    /** @returns the backend used by new instances that aren't given one. Initially this is the
+     * backend chosen at compile time (FFTW with USE_FFTW, Kiss FFT with USE_KISS_FFT and
+     * otherwise the built in FFT)
+     */
+    static std::shared_ptr<FFTBackend> getDefault();
+
+    /** Set the backend used by new instances that aren't given one */
+    static void setDefault (std::shared_ptr<FFTBackend> backend);
+
+    /** @returns all of the backends that were compiled in */
+    static std::vector<std::shared_ptr<FFTBackend> > getAvailableBackends();
+
+    /** Time each of the available backends that support a size on this machine
+     * @param size the transform size to time
+     * @returns the backend with the fastest forward transform
+     */
+    static std::shared_ptr<FFTBackend> findFastestBackend (int size);
+
+    /** Create an FFT from a backend if it supports the size, and otherwise from the first available
+     * backend that does. The built in backend transforms every size, so there is always one
+     * @param preferred the backend to use if it can
+     * @param size the number of real samples in each transform
+     * @param memory where to allocate the buffers from
+     */
+    static std::unique_ptr<RealFFT> createFFTForSize (FFTBackend& preferred, int size, MemoryResource* memory);
+};
+
+//=======================================================================
+/** The built in FFT (see BuiltinFFT), which is always available. Sizes that aren't a
+ * power of two are transformed with a direct DFT, which is much slower */
+class BuiltinFFTBackend : public FFTBackend
+{
+public:
+    const char* getName() const;
+    bool supportsSize (int size) const;
+    std::unique_ptr<RealFFT> createFFT (int size);
+    std::unique_ptr<RealFFT> createFFT (int size, MemoryResource* memory);
+};
+
+#ifdef USE_FFTW
+//=======================================================================
+/** FFTs provided by FFTW */
+class FFTWBackend : public FFTBackend
+{
+public:
+    const char* getName() const;
+    std::unique_ptr<RealFFT> createFFT (int size);
+    std::unique_ptr<RealFFT> createFFT (int size, MemoryResource* memory);
+};
+#endif
+
+#ifdef USE_KISS_FFT
+//=======================================================================
+/** FFTs provided by Kiss FFT */
+class KissFFTBackend : public FFTBackend
+{
+public:
+    const char* getName() const;
+    std::unique_ptr<RealFFT> createFFT (int size);
+    std::unique_ptr<RealFFT> createFFT (int size, MemoryResource* memory);
+};
+#endif
+
+#endif /* FFT_h */
@@ -0,0 +1,318 @@
+//=======================================================================
+/** @file FixedPoint.cpp
+ *  @brief Integer arithmetic and an integer FFT for the fixed point beat tracker
+ *  @author Adam Stark
+ *  @copyright Copyright (C) 2008-2014  Queen Mary University of London
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+//=======================================================================
+
+#include <algorithm>
+#include "FixedPoint.h"
+
+//=======================================================================
+/** sin (pi i / 512) in Q31 for the first quarter of a cycle, clamped to the largest Q31 value */
+static const int32_t quarterSineTable[257] =
+{
+    0, 13176712, 26352928, 39528151, 52701887, 65873638,
+    79042909, 92209205, 105372028, 118530885, 131685278, 144834714,
+    157978697, 171116733, 184248325, 197372981, 210490206, 223599506,
+    236700388, 249792358, 262874923, 275947592, 289009871, 302061269,
+    315101295, 328129457, 341145265, 354148230, 367137861, 380113669,
+    393075166, 406021865, 418953276, 431868915, 444768294, 457650927,
+    470516330, 483364019, 496193509, 509004318, 521795963, 534567963,
+    547319836, 560051104, 572761285, 585449903, 598116479, 610760536,
+    623381598, 635979190, 648552838, 661102068, 673626408, 686125387,
+    698598533, 711045377, 723465451, 735858287, 748223418, 760560380,
+    772868706, 785147934, 797397602, 809617249, 821806413, 833964638,
+    846091463, 858186435, 870249095, 882278992, 894275671, 906238681,
+    918167572, 930061894, 941921200, 953745043, 965532978, 977284562,
+    988999351, 1000676905, 1012316784, 1023918550, 1035481766, 1047005996,
+    1058490808, 1069935768, 1081340445, 1092704411, 1104027237, 1115308496,
+    1126547765, 1137744621, 1148898640, 1160009405, 1171076495, 1182099496,
+    1193077991, 1204011567, 1214899813, 1225742318, 1236538675, 1247288478,
+    1257991320, 1268646800, 1279254516, 1289814068, 1300325060, 1310787095,
+    1321199781, 1331562723, 1341875533, 1352137822, 1362349204, 1372509294,
+    1382617710, 1392674072, 1402678000, 1412629117, 1422527051, 1432371426,
+    1442161874, 1451898025, 1461579514, 1471205974, 1480777044, 1490292364,
+    1499751576, 1509154322, 1518500250, 1527789007, 1537020244, 1546193612,
+    1555308768, 1564365367, 1573363068, 1582301533, 1591180426, 1599999411,
+    1608758157, 1617456335, 1626093616, 1634669676, 1643184191, 1651636841,
+    1660027308, 1668355276, 1676620432, 1684822463, 1692961062, 1701035922,
+    1709046739, 1716993211, 1724875040, 1732691928, 1740443581, 1748129707,
+    1755750017, 1763304224, 1770792044, 1778213194, 1785567396, 1792854372,
+    1800073849, 1807225553, 1814309216, 1821324572, 1828271356, 1835149306,
+    1841958164, 1848697674, 1855367581, 1861967634, 1868497586, 1874957189,
+    1881346202, 1887664383, 1893911494, 1900087301, 1906191570, 1912224073,
+    1918184581, 1924072871, 1929888720, 1935631910, 1941302225, 1946899451,
+    1952423377, 1957873796, 1963250501, 1968553292, 1973781967, 1978936331,
+    1984016189, 1989021350, 1993951625, 1998806829, 2003586779, 2008291295,
+    2012920201, 2017473321, 2021950484, 2026351522, 2030676269, 2034924562,
+    2039096241, 2043191150, 2047209133, 2051150040, 2055013723, 2058800036,
+    2062508835, 2066139983, 2069693342, 2073168777, 2076566160, 2079885360,
+    2083126254, 2086288720, 2089372638, 2092377892, 2095304370, 2098151960,
+    2100920556, 2103610054, 2106220352, 2108751352, 2111202959, 2113575080,
+    2115867626, 2118080511, 2120213651, 2122266967, 2124240380, 2126133817,
+    2127947206, 2129680480, 2131333572, 2132906420, 2134398966, 2135811153,
+    2137142927, 2138394240, 2139565043, 2140655293, 2141664948, 2142593971,
+    2143442326, 2144209982, 2144896910, 2145503083, 2146028480, 2146473080,
+    2146836866, 2147119825, 2147321946, 2147443222, 2147483647
+};
+
+/** 2^(2^-i) in Q30, for i from 1 to 16 */
+static const int32_t rootsOfTwo[16] =
+{
+    1518500250, 1276901417, 1170923762, 1121280436, 1097253708, 1085434106, 1079572136, 1076653033,
+    1075196443, 1074468888, 1074105294, 1073923544, 1073832680, 1073787251, 1073764537, 1073753181
+};
+
+static const int32_t log2OfEQ16 = 94548;        /**< log2 (e) in Q16 */
+static const int32_t lnOf2Q16 = 45426;          /**< ln (2) in Q16 */
+
+//=======================================================================
+/** @returns sin (pi position / 2^31) in Q31 for positions in the first quarter of a cycle */
+static int32_t quarterSine (uint32_t position)
+{
+    uint32_t index = position >> 22;
+    int64_t fraction = position & 0x3FFFFF;
+
+    if (fraction == 0)
+    {
+        return quarterSineTable[index];
+    }
+
+    int64_t step = (int64_t) quarterSineTable[index + 1] - quarterSineTable[index];
+
+    return (int32_t) (quarterSineTable[index] + ((step * fraction) >> 22));
+}
+
+//=======================================================================
+int32_t FixedPoint::sine (uint32_t phase)
+{
+    uint32_t quadrant = phase >> 30;
+    uint32_t position = phase & 0x3FFFFFFF;
+
+    // the other three quarters are reflections of the first
+    switch (quadrant)
+    {
+        case 0:
+            return quarterSine (position);
+        case 1:
+            return quarterSine ((1u << 30) - position);
+        case 2:
+            return -quarterSine (position);
+        default:
+            return -quarterSine ((1u << 30) - position);
+    }
+}
+
+//=======================================================================
+int32_t FixedPoint::cosine (uint32_t phase)
+{
+    return sine (phase + (1u << 30));
+}
+
+//=======================================================================
+int32_t FixedPoint::log2 (uint32_t x)
+{
+    int highestBit = numBits (x) - 1;
+
+    // the integer part comes from the highest set bit, leaving a mantissa in [1, 2) as Q30
+    uint64_t mantissa = (highestBit > 30) ? (x >> (highestBit - 30)) : ((uint64_t) x << (30 - highestBit));
+
+    int32_t fraction = 0;
+
+    // each squaring of the mantissa doubles its logarithm, revealing one more bit of the fraction
+    for (int bit = 15; bit >= 0; bit--)
+    {
+        mantissa = (mantissa * mantissa) >> 30;
+
+        if (mantissa >= (2u << 30))
+        {
+            mantissa >>= 1;
+            fraction |= 1 << bit;
+        }
+    }
+
+    return ((highestBit - 16) * 65536) + fraction;
+}
+
+//=======================================================================
+int32_t FixedPoint::exp2 (int32_t x)
+{
+    if (x >= (1 << 16))
+    {
+        return INT32_MAX;
+    }
+
+    // split into a whole number of doublings and a fraction in [0, 1)
+    int32_t wholePart = x >> 16;
+    int32_t fraction = x & 0xFFFF;
+
+    uint64_t result = 1u << 30;
+
+    for (int i = 0; i < 16; i++)
+    {
+        if (fraction & (0x8000 >> i))
+        {
+            result = ((result * rootsOfTwo[i]) + (1u << 29)) >> 30;
+        }
+    }
+
+    if (wholePart < -30)
+    {
+        return 0;
+    }
+
+    if (wholePart < 0)
+    {
+        result >>= -wholePart;
+    }
+
+    return saturate ((int64_t) result);
+}
+
+//=======================================================================
+int32_t FixedPoint::negativeExponential (int32_t x)
+{
+    int64_t power = -(((int64_t) x * log2OfEQ16) >> 16);
+
+    if (power < -(31 << 16))
+    {
+        return 0;
+    }
+
+    return exp2 ((int32_t) power);
+}
+
+//=======================================================================
+int32_t FixedPoint::naturalLog (uint32_t x)
+{
+    return (int32_t) (((int64_t) log2 (x) * lnOf2Q16) >> 16);
+}
+
+//=======================================================================
+uint32_t FixedPoint::squareRoot (uint64_t x)
+{
+    uint64_t root = 0;
+    uint64_t bit = (uint64_t) 1 << 62;
+
+    while (bit > x)
+    {
+        bit >>= 2;
+    }
+
+    // find the root one bit at a time, from the most significant
+    while (bit != 0)
+    {
+        if (x >= root + bit)
+        {
+            x -= root + bit;
+            root = (root >> 1) + bit;
+        }
+        else
+        {
+            root >>= 1;
+        }
+
+        bit >>= 2;
+    }
+
+    return (uint32_t) root;
+}
+
+//=======================================================================
+FixedPointFFT::FixedPointFFT (MemoryResource* memory)
+ :  size (0),
+    bitReversed (memory),
+    twiddles (memory)
+{
+
+}
+
+//=======================================================================
+void FixedPointFFT::initialise (int size_)
+{
+    size = size_;
+
+    int numStages = FixedPoint::numBits ((uint64_t) size) - 1;
+
+    bitReversed.resize (size);
+
+    for (int i = 0; i < size; i++)
+    {
+        int reversed = 0;
+
+        for (int b = 0; b < numStages; b++)
+        {
+            reversed |= ((i >> b) & 1) << (numStages - 1 - b);
+        }
+
+        bitReversed[i] = reversed;
+    }
+
+    // the twiddle factors e^(-2 pi i k / N) for the first half of the cycle
+    twiddles.resize (2 * std::max (size / 2, 1));
+
+    for (int k = 0; k < size / 2; k++)
+    {
+        uint32_t phase = (uint32_t) (((uint64_t) k << 32) / size);
+
+        twiddles[2 * k] = FixedPoint::cosine (phase);
+        twiddles[2 * k + 1] = -FixedPoint::sine (phase);
+    }
+}
+
+//=======================================================================
+void FixedPointFFT::performFFT (int32_t* data)
+{
+    for (int i = 0; i < size; i++)
+    {
+        int j = bitReversed[i];
+
+        if (j > i)
+        {
+            std::swap (data[2 * i], data[2 * j]);
+            std::swap (data[2 * i + 1], data[2 * j + 1]);
+        }
+    }
+
+    for (int span = 1; span < size; span *= 2)
+    {
+        int twiddleStep = size / (2 * span);
+
+        for (int start = 0; start < size; start += 2 * span)
+        {
+            for (int j = 0; j < span; j++)
+            {
+                int32_t* a = &data[2 * (start + j)];
+                int32_t* b = &data[2 * (start + j + span)];
+
+                int64_t wr = twiddles[2 * j * twiddleStep];
+                int64_t wi = twiddles[2 * j * twiddleStep + 1];
+
+                // the rotated value, rounded back to Q31
+                int64_t tr = ((b[0] * wr) - (b[1] * wi) + (1 << 30)) >> 31;
+                int64_t ti = ((b[0] * wi) + (b[1] * wr) + (1 << 30)) >> 31;
+
+                // halving at every stage keeps the values within range
+                b[0] = FixedPoint::saturate ((a[0] - tr) >> 1);
+                b[1] = FixedPoint::saturate ((a[1] - ti) >> 1);
+                a[0] = FixedPoint::saturate ((a[0] + tr) >> 1);
+                a[1] = FixedPoint::saturate ((a[1] + ti) >> 1);
+            }
+        }
+    }
+}
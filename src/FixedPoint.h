@@ -0,0 +1,134 @@
+//=======================================================================
+/** @file FixedPoint.h
+ *  @brief Integer arithmetic and an integer FFT for the fixed point beat tracker
+ *  @author Adam Stark
+ *  @copyright Copyright (C) 2008-2014  Queen Mary University of London
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+//=======================================================================
+
+#ifndef FixedPoint_h
+#define FixedPoint_h
+
+#include <stdint.h>
+#include "MemoryArena.h"
+
+//=======================================================================
+/** The integer functions used by the fixed point beat tracker, for processors
+ * without a floating point unit. Nothing here uses floating point, and every
+ * result is defined exactly, so the same input gives the same output on any
+ * processor. Values are described by their Q format, where a QN value x
+ * stands for x / 2^N.
+ */
+class FixedPoint
+{
+public:
+
+    //=======================================================================
+    /** @returns sin (2 pi phase / 2^32) in Q31, read from a quarter wave table
+     * with linear interpolation between its entries
+     * @param phase the phase, where 2^32 is a whole cycle
+     */
+    static int32_t sine (uint32_t phase);
+
+    /** @returns cos (2 pi phase / 2^32) in Q31 (see sine())
+     * @param phase the phase, where 2^32 is a whole cycle
+     */
+    static int32_t cosine (uint32_t phase);
+
+    /** @returns the base 2 logarithm of a positive Q16 value, in Q16
+     * @param x the value, which must be greater than zero
+     */
+    static int32_t log2 (uint32_t x);
+
+    /** @returns 2 to the power of a Q16 value, in Q30. Values above zero saturate
+     * @param x the power, which should be at most zero
+     */
+    static int32_t exp2 (int32_t x);
+
+    /** @returns e to the power of minus a Q16 value, in Q30
+     * @param x the value to negate and exponentiate, which should be at least zero
+     */
+    static int32_t negativeExponential (int32_t x);
+
+    /** @returns the natural logarithm of a positive Q16 value, in Q16
+     * @param x the value, which must be greater than zero
+     */
+    static int32_t naturalLog (uint32_t x);
+
+    /** @returns the integer part of the square root of a value */
+    static uint32_t squareRoot (uint64_t x);
+
+    /** @returns a value clamped to the range of a 32 bit integer */
+    static int32_t saturate (int64_t x)
+    {
+        return (x > INT32_MAX) ? INT32_MAX : ((x < INT32_MIN) ? INT32_MIN : (int32_t) x);
+    }
+
+    /** @returns the number of bits needed to hold a value, i.e. one more than the index of its highest set bit */
+    static int numBits (uint64_t x)
+    {
+        int bits = 0;
+
+        while (x != 0)
+        {
+            x >>= 1;
+            bits++;
+        }
+
+        return bits;
+    }
+};
+
+//=======================================================================
+/** A radix 2 complex FFT of Q31 values. Each stage halves the values so that
+ * nothing can overflow, so the output is the FFT of the input divided by the
+ * size. The twiddle factors come from the sine table of FixedPoint, so no
+ * floating point is used to set the FFT up either
+ */
+class FixedPointFFT
+{
+public:
+
+    /** Constructor. initialise() must be called before any transforms are performed
+     * @param memory where to allocate the tables from, or NULL for the heap
+     */
+    FixedPointFFT (MemoryResource* memory = NULL);
+
+    /** Set up the tables for a transform size
+     * @param size_ the number of complex values in each transform, which must be a power of two
+     */
+    void initialise (int size_);
+
+    /** @returns the number of complex values in each transform */
+    int getSize() const
+    {
+        return size;
+    }
+
+    /** Transform values in place
+     * @param data the interleaved real and imaginary parts of getSize() Q31 complex values,
+     * which are replaced by those of the spectrum divided by getSize()
+     */
+    void performFFT (int32_t* data);
+
+private:
+
+    int size;                           /**< the number of complex values in each transform */
+    ArenaVector<int> bitReversed;       /**< the bit reversed index of each value */
+    ArenaVector<int32_t> twiddles;      /**< the interleaved Q31 cosines and negated sines of the twiddle factors */
+};
+
+#endif /* FixedPoint_h */
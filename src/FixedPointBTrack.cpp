@@ -0,0 +1,538 @@
+//=======================================================================
+/** @file FixedPointBTrack.cpp
+ *  @brief A fixed point version of BTrack for processors without a floating point unit
+ *  @author Adam Stark
+ *  @copyright Copyright (C) 2008-2014  Queen Mary University of London
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+//=======================================================================
+
+#include <algorithm>
+#include "FixedPointBTrack.h"
+
+//=======================================================================
+/** 60 seconds times the sampling frequency, for converting between beat periods and tempi */
+static const int64_t samplesPerMinute = 60 * 44100;
+
+/** The largest onset detection function sample, which leaves the headroom that the
+ * autocorrelation needs to be calculated in 64 bits */
+static const int32_t maxOnsetDetectionFunctionSample = 1 << 26;
+
+//=======================================================================
+/** @returns numerator / denominator rounded to the nearest integer, for positive values */
+static int64_t roundedDivision (int64_t numerator, int64_t denominator)
+{
+    return ((2 * numerator) + denominator) / (2 * denominator);
+}
+
+//=======================================================================
+FixedPointBTrack::FixedPointBTrack (int hopSize_, int frameSize_, int onsetDetectionFunctionType, MemoryResource* memory_)
+ :  odf (hopSize_, frameSize_, onsetDetectionFunctionType, memory_),
+    onsetDF (memory_),
+    cumulativeScore (memory_),
+    pastWeights (memory_),
+    futureWeights (memory_),
+    futureCumulativeScore (memory_)
+{
+    int rayparam = 43;
+    
+    // initialise parameters
+    tightness = 5;
+    alpha = 966367642;  // 0.9 in Q30
+    estimatedTempo = 120 << 16;
+    
+    m0 = 10;
+    beatCounter = -1;
+    
+    beatDueInFrame = false;
+    latestCumulativeScoreValue = 0;
+    weightsBeatPeriod = 0;
+    
+    // create rayleigh weighting vector, n / r^2 * exp (-n^2 / 2r^2)
+    for (int n = 0; n < 128; n++)
+    {
+        int32_t exponent = (int32_t) (((int64_t) (n * n) << 16) / (2 * rayparam * rayparam));
+        weightingVector[n] = (int32_t) (((int64_t) FixedPoint::negativeExponential (exponent) * n) / (rayparam * rayparam));
+    }
+    
+    // initialise prev_delta
+    for (int i = 0; i < 41; i++)
+    {
+        prevDelta[i] = 1 << 30;
+    }
+    
+    // create tempo transition matrix. The Gaussian's scale factor is left out, as it is the same
+    // for every element and so makes no difference once delta is normalised
+    int m_sig = 41 / 8;
+    
+    for (int i = 0; i < 41; i++)
+    {
+        for (int j = 0; j < 41; j++)
+        {
+            int32_t exponent = ((j - i) * (j - i) << 16) / (2 * m_sig * m_sig);
+            tempoTransitionMatrix[i][j] = FixedPoint::negativeExponential (exponent);
+        }
+    }
+    
+    // the comb filter outputs at the beat period, and half the beat period, of each tempo
+    // in the resampled onset detection function, which is always at a hop size of 512
+    for (int i = 0; i < 41; i++)
+    {
+        tempoObservationLags[i][0] = (int) roundedDivision (samplesPerMinute, 512 * ((2 * i) + 80));
+        tempoObservationLags[i][1] = (int) roundedDivision (samplesPerMinute, 512 * ((4 * i) + 160));
+    }
+    
+    setHopSize (hopSize_);
+}
+
+//=======================================================================
+void FixedPointBTrack::setHopSize (int hopSize_)
+{
+    hopSize = hopSize_;
+    onsetDFBufferSize = (512 * 512) / hopSize;     // calculate df buffer size
+    
+    beatPeriod = (int) roundedDivision (samplesPerMinute, hopSize * 120);
+    
+    onsetDF.resize (onsetDFBufferSize);
+    cumulativeScore.resize (onsetDFBufferSize);
+    
+    // the beat period is always well within the buffer, so these have room for any window
+    pastWeights.resize (onsetDFBufferSize + 1);
+    futureWeights.resize (onsetDFBufferSize);
+    futureCumulativeScore.resize (2 * onsetDFBufferSize);
+    
+    // initialise df_buffer to zeros, with a one at every beat
+    for (int i = 0; i < onsetDFBufferSize; i++)
+    {
+        onsetDF.setSample (i, ((i % beatPeriod) == 0) ? (1 << 16) : 0);
+        cumulativeScore.setSample (i, 0);
+    }
+    
+    calculateBeatPeriodWeights();
+}
+
+//=======================================================================
+void FixedPointBTrack::calculateBeatPeriodWeights()
+{
+    if (beatPeriod == weightsBeatPeriod)
+    {
+        return;
+    }
+    
+    weightsBeatPeriod = beatPeriod;
+    
+    // past window, exp (-(tightness * log (-v / beatPeriod))^2 / 2) for v from -2 * beatPeriod to -beatPeriod / 2
+    int pastWindowSize = (2 * beatPeriod) - ((beatPeriod + 1) / 2) + 1;
+    int v = -2 * beatPeriod;
+    
+    for (int i = 0; i < pastWindowSize; i++)
+    {
+        uint32_t ratio = (uint32_t) (((int64_t) -v << 16) / beatPeriod);
+        int64_t logRatio = (int64_t) tightness * FixedPoint::naturalLog (ratio);
+        
+        pastWeights[i] = FixedPoint::negativeExponential (FixedPoint::saturate ((logRatio * logRatio) >> 17));
+        v++;
+    }
+    
+    // future window, exp (-(v - beatPeriod / 2)^2 / (2 * (beatPeriod / 2)^2)) for v from 1 to beatPeriod
+    for (int i = 0; i < beatPeriod; i++)
+    {
+        int64_t distance = ((int64_t) (i + 1) << 16) - ((int64_t) beatPeriod << 15);
+        int64_t exponent = ((2 * distance * distance) / ((int64_t) beatPeriod * beatPeriod)) >> 16;
+        
+        futureWeights[i] = FixedPoint::negativeExponential (FixedPoint::saturate (exponent));
+    }
+}
+
+//=======================================================================
+int FixedPointBTrack::getHopSize() const
+{
+    return hopSize;
+}
+
+//=======================================================================
+bool FixedPointBTrack::beatDueInCurrentFrame() const
+{
+    return beatDueInFrame;
+}
+
+//=======================================================================
+int32_t FixedPointBTrack::getCurrentTempoEstimate() const
+{
+    return estimatedTempo;
+}
+
+//=======================================================================
+int32_t FixedPointBTrack::getLatestCumulativeScoreValue() const
+{
+    return latestCumulativeScoreValue;
+}
+
+//=======================================================================
+void FixedPointBTrack::processAudioFrame (const int16_t* frame)
+{
+    processOnsetDetectionFunctionSample (odf.calculateOnsetDetectionFunctionSample (frame));
+}
+
+//=======================================================================
+void FixedPointBTrack::processOnsetDetectionFunctionSample (int32_t newSample)
+{
+    // we need to ensure that the onset detection function sample is positive, and
+    // small enough for the tempo calculation not to overflow
+    int64_t sample = (newSample < 0) ? -(int64_t) newSample : newSample;
+    sample = std::min (sample, (int64_t) maxOnsetDetectionFunctionSample);
+    
+    // add a tiny constant (about 0.0001) to the sample to stop it from ever going
+    // to zero. this is to avoid problems further down the line
+    sample = sample + 7;
+    
+    beatDueInFrame = false;
+    
+    m0--;
+    beatCounter--;
+    
+    // add new sample at the end
+    onsetDF.addSampleToEnd ((int32_t) sample);
+    
+    // update cumulative score
+    updateCumulativeScore ((int32_t) sample);
+    
+    // if we are halfway between beats
+    if (m0 == 0)
+    {
+        predictBeat();
+    }
+    
+    // if we are at a beat
+    if (beatCounter == 0)
+    {
+        beatDueInFrame = true;  // indicate a beat should be output
+        
+        // recalculate the tempo
+        resampleOnsetDetectionFunction();
+        calculateTempo();
+    }
+}
+
+//=======================================================================
+void FixedPointBTrack::resampleOnsetDetectionFunction()
+{
+    const int32_t* history = onsetDF.data();
+    
+    if (onsetDFBufferSize == 512)
+    {
+        std::copy (history, history + 512, resampledOnsetDF);
+        return;
+    }
+    
+    // linear interpolation, with the first and last samples of both lined up
+    for (int i = 0; i < 512; i++)
+    {
+        int64_t position = ((int64_t) i * (onsetDFBufferSize - 1) << 16) / 511;
+        int index = (int) (position >> 16);
+        int64_t fraction = position & 0xFFFF;
+        
+        int64_t value = history[index];
+        
+        if (fraction != 0)
+        {
+            value += ((history[index + 1] - value) * fraction) >> 16;
+        }
+        
+        resampledOnsetDF[i] = (int32_t) value;
+    }
+}
+
+//=======================================================================
+void FixedPointBTrack::calculateTempo()
+{
+    // adaptive threshold on input
+    adaptiveThreshold (resampledOnsetDF, 512);
+    
+    // calculate auto-correlation function of detection function
+    calculateBalancedACF();
+    
+    // calculate output of comb filterbank
+    calculateOutputOfCombFilterBank();
+    
+    // adaptive threshold on rcf
+    adaptiveThreshold (combFilterBankOutput, 128);
+    
+    // calculate tempo observation vector from beat period observation vector
+    for (int i = 0; i < 41; i++)
+    {
+        tempoObservationVector[i] = combFilterBankOutput[tempoObservationLags[i][0] - 1] + combFilterBankOutput[tempoObservationLags[i][1] - 1];
+    }
+    
+    int64_t maxval;
+    int64_t curval;
+    
+    for (int j = 0; j < 41; j++)
+    {
+        maxval = -1;
+        
+        for (int i = 0; i < 41; i++)
+        {
+            curval = ((int64_t) prevDelta[i] * tempoTransitionMatrix[i][j]) >> 30;
+            
+            if (curval > maxval)
+            {
+                maxval = curval;
+            }
+        }
+        
+        delta[j] = maxval * tempoObservationVector[j];
+    }
+    
+    // normalise delta to Q30, first scaling it down so that the division can't overflow
+    int64_t largest = *std::max_element (delta, delta + 41);
+    int shift = std::max (FixedPoint::numBits ((uint64_t) std::max (largest, (int64_t) 0)) - 32, 0);
+    int64_t sum = 0;
+    
+    for (int j = 0; j < 41; j++)
+    {
+        delta[j] = delta[j] >> shift;
+        
+        if (delta[j] > 0)
+        {
+            sum = sum + delta[j];
+        }
+    }
+    
+    if (sum > 0)
+    {
+        for (int j = 0; j < 41; j++)
+        {
+            delta[j] = (delta[j] << 30) / sum;
+        }
+    }
+    
+    int maxind = -1;
+    maxval = -1;
+    
+    for (int j = 0; j < 41; j++)
+    {
+        if (delta[j] > maxval)
+        {
+            maxval = delta[j];
+            maxind = j;
+        }
+        
+        prevDelta[j] = (int32_t) delta[j];
+    }
+    
+    int64_t samplesPerBeat = (int64_t) ((2 * maxind) + 80) * hopSize;
+    
+    beatPeriod = (int) roundedDivision (samplesPerMinute, samplesPerBeat);
+    
+    if (beatPeriod > 0)
+    {
+        estimatedTempo = (int32_t) roundedDivision (samplesPerMinute << 16, (int64_t) hopSize * beatPeriod);
+    }
+    
+    calculateBeatPeriodWeights();
+}
+
+//=======================================================================
+void FixedPointBTrack::adaptiveThreshold (int32_t* x, int N)
+{
+    int i = 0;
+    int k,t = 0;
+    
+    int p_post = 7;
+    int p_pre = 8;
+    
+    t = std::min (N, p_post);   // what is smaller, p_post of df size. This is to avoid accessing outside of arrays
+    
+    // find threshold for first 't' samples, where a full average cannot be computed yet
+    for (i = 0; i <= t; i++)
+    {
+        k = std::min ((i + p_pre), N);
+        threshold[i] = calculateMeanOfArray (x, 1, k);
+    }
+    
+    // find threshold for bulk of samples across a moving average from [i-p_pre,i+p_post]
+    for (i = t + 1; i < N - p_post; i++)
+    {
+        threshold[i] = calculateMeanOfArray (x, i - p_pre, i + p_post);
+    }
+    
+    // for last few samples calculate threshold, again, not enough samples to do as above
+    for (i = N - p_post; i < N; i++)
+    {
+        k = std::max ((i - p_post), 1);
+        threshold[i] = calculateMeanOfArray (x, k, N);
+    }
+    
+    // subtract the threshold from the detection function and check that it is not less than 0
+    for (i = 0; i < N; i++)
+    {
+        x[i] = (x[i] > threshold[i]) ? (x[i] - threshold[i]) : 0;
+    }
+}
+
+//=======================================================================
+int32_t FixedPointBTrack::calculateMeanOfArray (const int32_t* array, int startIndex, int endIndex)
+{
+    int64_t sum = 0;
+    int length = endIndex - startIndex;
+    
+    // find sum
+    for (int i = startIndex; i < endIndex; i++)
+    {
+        sum = sum + array[i];
+    }
+    
+    if (length > 0)
+    {
+        return (int32_t) (sum / length);    // average and return
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+//=======================================================================
+int32_t FixedPointBTrack::weightedMaximum (const int32_t* values, const int32_t* weights, int numValues)
+{
+    int64_t max = 0;
+    
+    for (int i = 0; i < numValues; i++)
+    {
+        int64_t weightedValue = ((int64_t) values[i] * weights[i]) >> 30;
+        
+        if (weightedValue > max)
+        {
+            max = weightedValue;
+        }
+    }
+    
+    return (int32_t) max;
+}
+
+//=======================================================================
+void FixedPointBTrack::calculateBalancedACF()
+{
+    int64_t balancedACF[512];
+    int64_t largest = 0;
+    
+    // calculated directly, as with integers this is both exact and cheaper to set up than an FFT
+    for (int lag = 0; lag < 512; lag++)
+    {
+        int64_t sum = 0;
+        
+        for (int n = 0; n < 512 - lag; n++)
+        {
+            sum += (int64_t) resampledOnsetDF[n] * resampledOnsetDF[n + lag];
+        }
+        
+        // divide by the number of terms to deal with scale bias towards small lags
+        balancedACF[lag] = sum / (512 - lag);
+        largest = std::max (largest, balancedACF[lag]);
+    }
+    
+    // scale every lag by the same power of two so that the largest fits in Q30
+    int shift = std::max (FixedPoint::numBits ((uint64_t) largest) - 30, 0);
+    
+    for (int lag = 0; lag < 512; lag++)
+    {
+        acf[lag] = (int32_t) (balancedACF[lag] >> shift);
+    }
+}
+
+//=======================================================================
+void FixedPointBTrack::calculateOutputOfCombFilterBank()
+{
+    int numFilters = 128;
+    int numElements = 4;
+    
+    for (int i = 0; i < numFilters; i++)
+    {
+        combFilterBankOutput[i] = 0;
+    }
+    
+    for (int i = 2; i <= numFilters - 1; i++) // max beat period
+    {
+        int64_t sum = 0;
+        
+        for (int a = 1; a <= numElements; a++) // number of comb elements
+        {
+            for (int b = 1 - a; b <= a - 1; b++) // general state using normalisation of comb elements
+            {
+                sum = sum + ((int64_t) acf[(a * i + b) - 1] * weightingVector[i - 1]) / (2 * a - 1);
+            }
+        }
+        
+        combFilterBankOutput[i - 1] = (int32_t) (sum >> 30);
+    }
+}
+
+//=======================================================================
+void FixedPointBTrack::updateCumulativeScore (int32_t odfSample)
+{
+    int start = onsetDFBufferSize - (2 * beatPeriod);
+    int end = onsetDFBufferSize - ((beatPeriod + 1) / 2);
+    int winsize = end - start + 1;
+    
+    // calculate new cumulative score value
+    const int32_t* history = cumulativeScore.data();
+    int32_t max = weightedMaximum (&history[start], &pastWeights[0], winsize);
+    
+    latestCumulativeScoreValue = (int32_t) ((((int64_t) ((1 << 30) - alpha) * odfSample) + ((int64_t) alpha * max)) >> 30);
+    
+    cumulativeScore.addSampleToEnd (latestCumulativeScoreValue);
+}
+
+//=======================================================================
+void FixedPointBTrack::predictBeat()
+{
+    int windowSize = beatPeriod;
+    
+    // copy cumscore to first part of fcumscore
+    std::copy (cumulativeScore.data(), cumulativeScore.data() + onsetDFBufferSize, futureCumulativeScore.begin());
+    
+    int start = onsetDFBufferSize - (2 * beatPeriod);
+    int end = onsetDFBufferSize - ((beatPeriod + 1) / 2);
+    int pastwinsize = end - start + 1;
+    
+    // calculate future cumulative score
+    for (int i = onsetDFBufferSize; i < (onsetDFBufferSize + windowSize); i++)
+    {
+        start = i - (2 * beatPeriod);
+        
+        futureCumulativeScore[i] = weightedMaximum (&futureCumulativeScore[start], &pastWeights[0], pastwinsize);
+    }
+    
+    // predict beat
+    int64_t max = 0;
+    int n = 0;
+    
+    for (int i = onsetDFBufferSize; i < (onsetDFBufferSize + windowSize); i++)
+    {
+        int64_t wcumscore = ((int64_t) futureCumulativeScore[i] * futureWeights[n]) >> 30;
+        
+        if (wcumscore > max)
+        {
+            max = wcumscore;
+            beatCounter = n;
+        }
+        
+        n++;
+    }
+    
+    // set next prediction time
+    m0 = beatCounter + ((beatPeriod + 1) / 2);
+}
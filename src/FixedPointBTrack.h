@@ -0,0 +1,169 @@
+//=======================================================================
+/** @file FixedPointBTrack.h
+ *  @brief A fixed point version of BTrack for processors without a floating point unit
+ *  @author Adam Stark
+ *  @copyright Copyright (C) 2008-2014  Queen Mary University of London
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+//=======================================================================
+
+#ifndef FixedPointBTrack_h
+#define FixedPointBTrack_h
+
+#include "FixedPointOnsetDetectionFunction.h"
+#include "CircularBuffer.h"
+
+//=======================================================================
+/** The BTrack algorithm in integer arithmetic, for processors without a floating
+ * point unit. It follows BTrack step by step: the cumulative score recursion,
+ * beat prediction, balanced autocorrelation, comb filter bank and tempo
+ * transition model are all the same, but every value is a fixed point integer
+ * and the weighting windows are built from the tables in FixedPoint rather
+ * than with exp() and log().
+ *
+ * Nothing is rounded differently from one processor to another, so a given
+ * input always produces exactly the same beats, which allows the results on
+ * the target to be checked against reference vectors made on a desktop.
+ * The results are close to, but not the same as, those of BTrack: the
+ * onset detection function is resampled linearly rather than with
+ * libsamplerate, and the autocorrelation is calculated directly rather than
+ * with an FFT.
+ *
+ * Onset detection function and cumulative score values are Q16, and tempi
+ * are given in beats per minute as Q16.
+ */
+class FixedPointBTrack
+{
+public:
+
+    /** Constructor
+     * @param hopSize_ the hop size in audio samples
+     * @param frameSize_ the frame size in audio samples, which must be a power of two
+     * @param onsetDetectionFunctionType the type of onset detection function to use (see FixedPointOnsetDetectionFunctionType)
+     * @param memory_ where to allocate the buffers from, or NULL for the heap. The resource must outlive this instance
+     */
+    FixedPointBTrack (int hopSize_ = 512, int frameSize_ = 1024, int onsetDetectionFunctionType = FixedPointSpectralDifferenceHWR, MemoryResource* memory_ = NULL);
+
+    //=======================================================================
+    /** Process a hop of audio
+     * @param frame a pointer to an array containing hopSize Q15 audio samples
+     */
+    void processAudioFrame (const int16_t* frame);
+
+    /** Add new onset detection function sample to buffer and apply beat tracking
+     * @param sample an onset detection function sample in Q16
+     */
+    void processOnsetDetectionFunctionSample (int32_t sample);
+
+    //=======================================================================
+    /** @returns the current hop size being used by the beat tracker */
+    int getHopSize() const;
+
+    /** @returns true if a beat should occur in the current audio frame */
+    bool beatDueInCurrentFrame() const;
+
+    /** @returns the current tempo estimate in beats per minute, in Q16 */
+    int32_t getCurrentTempoEstimate() const;
+
+    /** @returns the most recent value of the cumulative score function, in Q16 */
+    int32_t getLatestCumulativeScoreValue() const;
+
+private:
+
+    /** Initialise with hop size and set all array sizes accordingly
+     * @param hopSize_ the hop size in audio samples
+     */
+    void setHopSize (int hopSize_);
+
+    /** Calculates the windows used by the cumulative score and beat prediction for the current beat period */
+    void calculateBeatPeriodWeights();
+
+    /** Resamples the onset detection function from an arbitrary number of samples to 512 */
+    void resampleOnsetDetectionFunction();
+
+    /** Updates the cumulative score function with a new onset detection function sample
+     * @param odfSample an onset detection function sample
+     */
+    void updateCumulativeScore (int32_t odfSample);
+
+    /** Predicts the next beat, based upon the internal program state */
+    void predictBeat();
+
+    /** Calculates the current tempo expressed as the beat period in detection function samples */
+    void calculateTempo();
+
+    /** Calculates an adaptive threshold which is used to remove low level energy from detection
+     * function and emphasise peaks
+     * @param x a pointer to an array containing onset detection function samples
+     * @param N the length of the array, x
+     */
+    void adaptiveThreshold (int32_t* x, int N);
+
+    /** Calculates the mean of values in an array between index locations [startIndex,endIndex)
+     * @param array a pointer to an array that contains the values we wish to find the mean from
+     * @param startIndex the start index from which we would like to calculate the mean
+     * @param endIndex the index one past the last value in the mean
+     * @returns the mean of the sub-section of the array
+     */
+    static int32_t calculateMeanOfArray (const int32_t* array, int startIndex, int endIndex);
+
+    /** @returns the largest of a run of values, each multiplied by a Q30 weight
+     * @param values the values
+     * @param weights the Q30 weights
+     * @param numValues the number of values
+     */
+    static int32_t weightedMaximum (const int32_t* values, const int32_t* weights, int numValues);
+
+    /** Calculates the balanced autocorrelation of the resampled onset detection function */
+    void calculateBalancedACF();
+
+    /** Calculates the output of the comb filter bank */
+    void calculateOutputOfCombFilterBank();
+
+    //=======================================================================
+    FixedPointOnsetDetectionFunction odf;   /**< calculates the onset detection function from audio */
+
+    CircularBuffer<int32_t> onsetDF;        /**< to hold onset detection function */
+    CircularBuffer<int32_t> cumulativeScore; /**< to hold cumulative score */
+    ArenaVector<int32_t> pastWeights;       /**< Q30 log-Gaussian weighting of past cumulative score values */
+    ArenaVector<int32_t> futureWeights;     /**< Q30 Gaussian weighting of predicted cumulative score values */
+    ArenaVector<int32_t> futureCumulativeScore; /**< to hold the cumulative score followed by its prediction */
+
+    int32_t resampledOnsetDF[512];          /**< to hold resampled detection function */
+    int32_t acf[512];                       /**< to hold autocorrelation function */
+    int32_t threshold[512];                 /**< to hold the adaptive threshold */
+    int32_t weightingVector[128];           /**< to hold Q30 weighting vector */
+    int32_t combFilterBankOutput[128];      /**< to hold comb filter output */
+    int32_t tempoObservationVector[41];     /**< to hold tempo version of comb filter output */
+    int64_t delta[41];                      /**< to hold final tempo candidate array */
+    int32_t prevDelta[41];                  /**< Q30 previous delta */
+    int32_t tempoTransitionMatrix[41][41];  /**< Q30 tempo transition matrix */
+    int tempoObservationLags[41][2];        /**< the two comb filter outputs that make up each tempo observation */
+
+    //=======================================================================
+    int32_t alpha;                          /**< Q30 mix between the current detection function sample and the cumulative score's "momentum" */
+    int tightness;                          /**< the tightness of the weighting used to calculate cumulative score */
+    int beatPeriod;                         /**< the beat period, in detection function samples */
+    int weightsBeatPeriod;                  /**< the beat period that the weights were last calculated for */
+    int32_t estimatedTempo;                 /**< the current tempo estimation in beats per minute, in Q16 */
+    int32_t latestCumulativeScoreValue;     /**< holds the latest value of the cumulative score function */
+    int m0;                                 /**< indicates when the next point to predict the next beat is */
+    int beatCounter;                        /**< keeps track of when the next beat is - will be zero when the beat is due */
+    int hopSize;                            /**< the hop size being used by the algorithm */
+    int onsetDFBufferSize;                  /**< the onset detection function buffer size */
+    bool beatDueInFrame;                    /**< indicates whether a beat is due in the current frame */
+};
+
+#endif /* FixedPointBTrack_h */
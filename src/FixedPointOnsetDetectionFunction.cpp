@@ -0,0 +1,136 @@
+//=======================================================================
+/** @file FixedPointOnsetDetectionFunction.cpp
+ *  @brief A class for calculating onset detection functions in fixed point
+ *  @author Adam Stark
+ *  @copyright Copyright (C) 2008-2014  Queen Mary University of London
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+//=======================================================================
+
+#include <algorithm>
+#include "FixedPointOnsetDetectionFunction.h"
+
+//=======================================================================
+FixedPointOnsetDetectionFunction::FixedPointOnsetDetectionFunction (int hopSize_, int frameSize_, int onsetDetectionFunctionType_, MemoryResource* memory_)
+ :  frameSize (frameSize_),
+    hopSize (hopSize_),
+    onsetDetectionFunctionType (onsetDetectionFunctionType_),
+    fft (memory_),
+    frame (frameSize_, 0, memory_),
+    window (frameSize_, 0, memory_),
+    complexOut (memory_),
+    magSpec (memory_),
+    prevMagSpec (memory_),
+    prevEnergySum (0)
+{
+    // Hanning window, 0.5 * (1 - cos (2 pi n / (N - 1))), with the cosine taken from the sine table
+    for (int n = 0; n < frameSize; n++)
+    {
+        uint32_t phase = (uint32_t) (((uint64_t) n << 32) / (uint64_t) std::max (frameSize - 1, 1));
+        int64_t value = ((int64_t) INT32_MAX + 1 - FixedPoint::cosine (phase)) >> 17;
+        
+        window[n] = (int16_t) std::min (value, (int64_t) INT16_MAX);
+    }
+    
+    if (onsetDetectionFunctionType == FixedPointSpectralDifferenceHWR)
+    {
+        fft.initialise (frameSize);
+        complexOut.resize (2 * frameSize);
+        magSpec.resize ((frameSize / 2) + 1);
+        prevMagSpec.resize ((frameSize / 2) + 1);
+    }
+}
+
+//=======================================================================
+int32_t FixedPointOnsetDetectionFunction::calculateOnsetDetectionFunctionSample (const int16_t* buffer)
+{
+    // shift audio samples back in frame by hop size
+    for (int i = 0; i < (frameSize - hopSize); i++)
+    {
+        frame[i] = frame[i + hopSize];
+    }
+    
+    // add new samples to frame from input buffer
+    for (int i = 0; i < hopSize; i++)
+    {
+        frame[frameSize - hopSize + i] = buffer[i];
+    }
+    
+    if (onsetDetectionFunctionType == FixedPointEnergyDifference)
+    {
+        return energyDifference();
+    }
+    else
+    {
+        return spectralDifferenceHWR();
+    }
+}
+
+//=======================================================================
+int32_t FixedPointOnsetDetectionFunction::energyDifference()
+{
+    int64_t sum = 0;
+    
+    for (int i = 0; i < frameSize; i++)
+    {
+        sum += (int32_t) frame[i] * frame[i];
+    }
+    
+    // sample is first order difference in energy
+    int64_t sample = sum - prevEnergySum;
+    
+    prevEnergySum = sum;
+    
+    // only keep increases in energy, converting from Q30 to Q16
+    return (sample > 0) ? FixedPoint::saturate (sample >> 14) : 0;
+}
+
+//=======================================================================
+int32_t FixedPointOnsetDetectionFunction::spectralDifferenceHWR()
+{
+    // window the frame, taking the Q30 products to Q31
+    for (int i = 0; i < frameSize; i++)
+    {
+        complexOut[2 * i] = (int32_t) frame[i] * window[i] * 2;
+        complexOut[2 * i + 1] = 0;
+    }
+    
+    fft.performFFT (&complexOut[0]);
+    
+    int numBins = (frameSize / 2) + 1;
+    int64_t sum = 0;
+    
+    for (int i = 0; i < numBins; i++)
+    {
+        int64_t re = complexOut[2 * i];
+        int64_t im = complexOut[2 * i + 1];
+        
+        magSpec[i] = FixedPoint::squareRoot ((uint64_t) (re * re) + (uint64_t) (im * im));
+        
+        // only add up positive differences
+        int64_t diff = (int64_t) magSpec[i] - prevMagSpec[i];
+        
+        if (diff > 0)
+        {
+            // the bins above (N/2)+1 mirror those below, so count everything but DC and Nyquist twice
+            sum += ((i == 0) || (i == numBins - 1)) ? diff : 2 * diff;
+        }
+        
+        prevMagSpec[i] = magSpec[i];
+    }
+    
+    // convert the sum of Q31 magnitudes to Q16
+    return FixedPoint::saturate (sum >> 15);
+}
@@ -0,0 +1,100 @@
+//=======================================================================
+/** @file FixedPointOnsetDetectionFunction.h
+ *  @brief A class for calculating onset detection functions in fixed point
+ *  @author Adam Stark
+ *  @copyright Copyright (C) 2008-2014  Queen Mary University of London
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+//=======================================================================
+
+#ifndef FixedPointOnsetDetectionFunction_h
+#define FixedPointOnsetDetectionFunction_h
+
+#include "FixedPoint.h"
+
+//=======================================================================
+/** The onset detection functions that can be calculated in fixed point */
+enum FixedPointOnsetDetectionFunctionType
+{
+    FixedPointEnergyDifference,         /**< the half-wave rectified energy difference, which needs no FFT */
+    FixedPointSpectralDifferenceHWR     /**< the half-wave rectified spectral difference */
+};
+
+//=======================================================================
+/** Calculates onset detection function samples from 16 bit audio using integer
+ * arithmetic only, for processors without a floating point unit. Samples are
+ * Q15 and the detection function is returned in Q16, and the results are the
+ * same on every processor. The Hanning window is built from the sine table of
+ * FixedPoint rather than by calling cos()
+ */
+class FixedPointOnsetDetectionFunction
+{
+public:
+
+    /** Constructor
+     * @param hopSize_ the hop size in audio samples
+     * @param frameSize_ the frame size in audio samples, which must be a power of two
+     * @param onsetDetectionFunctionType_ the type of onset detection function to use (see FixedPointOnsetDetectionFunctionType)
+     * @param memory_ where to allocate the buffers from, or NULL for the heap. The resource must outlive this instance
+     */
+    FixedPointOnsetDetectionFunction (int hopSize_, int frameSize_, int onsetDetectionFunctionType_ = FixedPointSpectralDifferenceHWR, MemoryResource* memory_ = NULL);
+
+    /** Process a hop of audio
+     * @param buffer hopSize Q15 audio samples, which are added to the end of the current frame
+     * @returns the onset detection function sample in Q16
+     */
+    int32_t calculateOnsetDetectionFunctionSample (const int16_t* buffer);
+
+    /** @returns the hop size in audio samples */
+    int getHopSize() const
+    {
+        return hopSize;
+    }
+
+    /** @returns the frame size in audio samples */
+    int getFrameSize() const
+    {
+        return frameSize;
+    }
+
+    /** @returns the type of onset detection function (see FixedPointOnsetDetectionFunctionType) */
+    int getOnsetDetectionFunctionType() const
+    {
+        return onsetDetectionFunctionType;
+    }
+
+private:
+
+    /** Calculate the energy difference detection function sample from the current frame */
+    int32_t energyDifference();
+
+    /** Calculate the spectral difference (half wave rectified) detection function sample from the current frame */
+    int32_t spectralDifferenceHWR();
+
+    int frameSize;                      /**< audio framesize */
+    int hopSize;                        /**< audio hopsize */
+    int onsetDetectionFunctionType;     /**< type of detection function */
+
+    FixedPointFFT fft;                  /**< the FFT of a single frame */
+    ArenaVector<int16_t> frame;         /**< Q15 audio frame */
+    ArenaVector<int16_t> window;        /**< Q15 Hanning window */
+    ArenaVector<int32_t> complexOut;    /**< the interleaved Q31 spectrum, divided by the frame size */
+    ArenaVector<uint32_t> magSpec;      /**< Q31 magnitude spectrum of the first (frameSize/2)+1 bins */
+    ArenaVector<uint32_t> prevMagSpec;  /**< previous magnitude spectrum */
+
+    int64_t prevEnergySum;              /**< the previous energy sum, in Q30 */
+};
+
+#endif /* FixedPointOnsetDetectionFunction_h */
@@ -0,0 +1,288 @@
+//=======================================================================
+/** @file MemoryArena.h
+ *  @brief Sources of memory for the buffers held by BTrack instances
+ *  @author Adam Stark
+ *  @copyright Copyright (C) 2008-2014  Queen Mary University of London
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+//=======================================================================
+
+#ifndef MemoryArena_h
+#define MemoryArena_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <new>
+#include <vector>
+#include <memory>
+#include <type_traits>
+
+//=======================================================================
+/** The alignment of every buffer, which is the size of a cache line */
+const size_t bufferAlignment = 64;
+
+//=======================================================================
+/** A source of memory for buffers, in the manner of C++17's std::pmr::memory_resource.
+ * Derive from this to place the buffers of BTrack and OnsetDetectionFunction instances
+ * in memory of your choosing
+ */
+class MemoryResource
+{
+public:
+
+    /** Destructor */
+    virtual ~MemoryResource()
+    {
+
+    }
+
+    /** @returns a block of at least numBytes bytes, aligned to bufferAlignment
+     * @param numBytes the number of bytes needed
+     */
+    virtual void* allocate (size_t numBytes) = 0;
+
+    /** Return a block obtained from allocate()
+     * @param block the block
+     * @param numBytes the number of bytes that were asked for
+     */
+    virtual void deallocate (void* block, size_t numBytes) = 0;
+
+    /** @returns the resource used when none is given, which allocates from the heap */
+    static MemoryResource* getDefault();
+};
+
+//=======================================================================
+/** A MemoryResource that allocates each block from the heap */
+class HeapMemoryResource : public MemoryResource
+{
+public:
+
+    void* allocate (size_t numBytes)
+    {
+        // over-allocate so that the block can be aligned, keeping the original pointer just before it
+        void* original = malloc (numBytes + bufferAlignment + sizeof (void*));
+
+        if (original == NULL)
+        {
+            throw std::bad_alloc();
+        }
+
+        uintptr_t address = reinterpret_cast<uintptr_t> (original) + sizeof (void*);
+        address = (address + bufferAlignment - 1) & ~(uintptr_t) (bufferAlignment - 1);
+
+        void** block = reinterpret_cast<void**> (address);
+        block[-1] = original;
+
+        return block;
+    }
+
+    void deallocate (void* block, size_t)
+    {
+        if (block != NULL)
+        {
+            free (static_cast<void**> (block)[-1]);
+        }
+    }
+};
+
+//=======================================================================
+inline MemoryResource* MemoryResource::getDefault()
+{
+    static HeapMemoryResource heap;
+    return &heap;
+}
+
+//=======================================================================
+/** A MemoryResource that hands out consecutive pieces of one contiguous block of memory,
+ * so that all of the buffers of the instances that share it sit together. Memory is only
+ * reclaimed when the arena is destroyed, so the buffers that are replaced when a hop or
+ * frame size changes are not reused. Once the block is used up, further blocks come from
+ * the heap.
+ *
+ * The block can be supplied by the caller, which allows it to be backed by huge pages
+ * (e.g. from mmap() with MAP_HUGETLB on Linux), or allocated by the arena itself.
+ * An arena isn't thread safe, so the instances that share one should be created and
+ * reconfigured from one thread at a time.
+ */
+class MemoryArena : public MemoryResource
+{
+public:
+
+    /** Constructor that allocates the block from the heap
+     * @param numBytes the size of the block
+     */
+    MemoryArena (size_t numBytes)
+     :  ownedBlock (numBytes + bufferAlignment),
+        overflowCount (0)
+    {
+        setBlock (ownedBlock.data(), ownedBlock.size());
+    }
+
+    /** Constructor that uses a block supplied by the caller, which must outlive the arena
+     * and every instance that uses it
+     * @param block the start of the block
+     * @param numBytes the size of the block
+     */
+    MemoryArena (void* block, size_t numBytes)
+     :  overflowCount (0)
+    {
+        setBlock (static_cast<char*> (block), numBytes);
+    }
+
+    void* allocate (size_t numBytes)
+    {
+        // keep every piece a whole number of cache lines so that no two buffers share a line
+        size_t roundedBytes = (numBytes + bufferAlignment - 1) & ~(bufferAlignment - 1);
+
+        if ((roundedBytes > (size_t) (end - next)) || (roundedBytes == 0))
+        {
+            overflowCount++;
+            return heap.allocate (numBytes);
+        }
+
+        void* piece = next;
+        next += roundedBytes;
+
+        return piece;
+    }
+
+    void deallocate (void* block, size_t numBytes)
+    {
+        char* piece = static_cast<char*> (block);
+
+        // pieces of the block are only reclaimed with the whole arena
+        if ((piece < start) || (piece >= end))
+        {
+            heap.deallocate (block, numBytes);
+        }
+    }
+
+    /** @returns the number of bytes of the block that have been handed out */
+    size_t getBytesUsed() const
+    {
+        return next - start;
+    }
+
+    /** @returns the number of bytes of the block that are still free */
+    size_t getBytesAvailable() const
+    {
+        return end - next;
+    }
+
+    /** @returns the number of allocations that didn't fit in the block and came from the heap instead */
+    int getOverflowCount() const
+    {
+        return overflowCount;
+    }
+
+private:
+
+    MemoryArena (const MemoryArena&);
+    MemoryArena& operator= (const MemoryArena&);
+
+    /** Start handing out pieces from the first aligned address in a block */
+    void setBlock (char* block, size_t numBytes)
+    {
+        uintptr_t address = reinterpret_cast<uintptr_t> (block);
+        uintptr_t aligned = (address + bufferAlignment - 1) & ~(uintptr_t) (bufferAlignment - 1);
+
+        start = reinterpret_cast<char*> (aligned);
+        next = start;
+        end = block + numBytes;
+
+        if (end < start)
+        {
+            end = start;
+        }
+    }
+
+    std::vector<char> ownedBlock;       /**< the block, when the arena allocated it */
+    char* start;                        /**< the first aligned byte of the block */
+    char* next;                         /**< the start of the next piece to hand out */
+    char* end;                          /**< one past the last byte of the block */
+    int overflowCount;                  /**< the number of allocations that came from the heap */
+    HeapMemoryResource heap;            /**< where allocations go once the block is used up */
+};
+
+//=======================================================================
+/** A standard library allocator that takes its memory from a MemoryResource. The resource
+ * moves with the contents of a container when containers are swapped or moved
+ */
+template <typename T>
+class ArenaAllocator
+{
+public:
+
+    typedef T value_type;
+    typedef std::true_type propagate_on_container_copy_assignment;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    /** Constructor
+     * @param resource_ where to allocate from, or NULL for the heap
+     */
+    ArenaAllocator (MemoryResource* resource_ = NULL)
+     :  resource (resource_ != NULL ? resource_ : MemoryResource::getDefault())
+    {
+
+    }
+
+    template <typename U>
+    ArenaAllocator (const ArenaAllocator<U>& other)
+     :  resource (other.getResource())
+    {
+
+    }
+
+    T* allocate (size_t n)
+    {
+        return static_cast<T*> (resource->allocate (n * sizeof (T)));
+    }
+
+    void deallocate (T* p, size_t n)
+    {
+        resource->deallocate (p, n * sizeof (T));
+    }
+
+    /** @returns the resource that memory is allocated from */
+    MemoryResource* getResource() const
+    {
+        return resource;
+    }
+
+private:
+
+    MemoryResource* resource;           /**< where memory is allocated from */
+};
+
+template <typename T, typename U>
+bool operator== (const ArenaAllocator<T>& a, const ArenaAllocator<U>& b)
+{
+    return a.getResource() == b.getResource();
+}
+
+template <typename T, typename U>
+bool operator!= (const ArenaAllocator<T>& a, const ArenaAllocator<U>& b)
+{
+    return a.getResource() != b.getResource();
+}
+
+//=======================================================================
+/** A vector whose elements are allocated from a MemoryResource */
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T> >;
+
+#endif /* MemoryArena_h */
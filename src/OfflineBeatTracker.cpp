@@ -0,0 +1,150 @@
+//=======================================================================
+/** @file OfflineBeatTracker.cpp
+ *  @brief Coarse to fine beat tracking of complete signals
+ *  @author Adam Stark
+ *  @copyright Copyright (C) 2008-2014  Queen Mary University of London
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+//=======================================================================
+
+#include <math.h>
+#include <algorithm>
+#include "OfflineBeatTracker.h"
+
+//=======================================================================
+OfflineBeatTracker::OfflineBeatTracker (int coarseHopSize_, int fineHopSize_)
+ :  coarseHopSize (coarseHopSize_),
+    fineHopSize (fineHopSize_),
+    fineODF (fineHopSize_, 2 * fineHopSize_)
+{
+
+}
+
+//=======================================================================
+void OfflineBeatTracker::processSignal (const double* signal, long numSamples)
+{
+    beats.clear();
+    coarseBeats.clear();
+    tempi.clear();
+
+    // the coarse pass runs BTrack over the whole signal, with a detection function that
+    // needs no phase calculations as the fine pass takes care of the precision
+    BTrack tracker (coarseHopSize, 2 * coarseHopSize);
+    tracker.setQualityLevel (SpectralDifferenceQuality);
+    std::vector<double> hop (coarseHopSize);
+
+    long numHops = numSamples / coarseHopSize;
+
+    for (long i = 0; i < numHops; i++)
+    {
+        std::copy (signal + (i * coarseHopSize), signal + ((i + 1) * coarseHopSize), hop.begin());
+
+        tracker.processAudioFrame (&hop[0]);
+
+        if (tracker.beatDueInCurrentFrame())
+        {
+            coarseBeats.push_back (i * coarseHopSize);
+            tempi.push_back (tracker.getCurrentTempoEstimate());
+        }
+    }
+
+    // the fine pass only looks at the audio around each beat
+    for (size_t i = 0; i < coarseBeats.size(); i++)
+    {
+        beats.push_back (refineBeat (signal, numSamples, coarseBeats[i]));
+    }
+}
+
+//=======================================================================
+long OfflineBeatTracker::refineBeat (const double* signal, long numSamples, long beat)
+{
+    int frameSize = 2 * fineHopSize;
+
+    // the fine onset detection function sample k is calculated from the frame ending at
+    // (k + 1) * fineHopSize and belongs to position k * fineHopSize, as in BTrack
+    long firstSample = std::max (beat - coarseHopSize, 0L) / fineHopSize;
+    long lastSample = (beat + coarseHopSize) / fineHopSize;
+
+    // two frames before the window prime the previous spectra of the detection function
+    long k = firstSample - 2;
+
+    long bestPosition = beat;
+    double bestScore = 0;
+
+    for (; k <= lastSample; k++)
+    {
+        long frameStart = ((k + 1) * fineHopSize) - frameSize;
+
+        if (frameStart < 0)
+        {
+            continue;
+        }
+
+        if (frameStart + frameSize > numSamples)
+        {
+            break;
+        }
+
+        double sample = fineODF.calculateFromFrame (signal + frameStart);
+
+        if (k < firstSample)
+        {
+            continue;
+        }
+
+        // prefer peaks close to the coarse beat, which is accurate to about a coarse hop
+        long position = k * fineHopSize;
+        double distance = (double) (position - beat) / coarseHopSize;
+        double score = sample * exp (-0.5 * distance * distance);
+
+        if (score > bestScore)
+        {
+            bestScore = score;
+            bestPosition = position;
+        }
+    }
+
+    return bestPosition;
+}
+
+//=======================================================================
+const std::vector<long>& OfflineBeatTracker::getBeats() const
+{
+    return beats;
+}
+
+//=======================================================================
+const std::vector<long>& OfflineBeatTracker::getCoarseBeats() const
+{
+    return coarseBeats;
+}
+
+//=======================================================================
+const std::vector<double>& OfflineBeatTracker::getTempi() const
+{
+    return tempi;
+}
+
+//=======================================================================
+int OfflineBeatTracker::getCoarseHopSize() const
+{
+    return coarseHopSize;
+}
+
+//=======================================================================
+int OfflineBeatTracker::getFineHopSize() const
+{
+    return fineHopSize;
+}
@@ -0,0 +1,93 @@
+//=======================================================================
+/** @file OfflineBeatTracker.h
+ *  @brief Coarse to fine beat tracking of complete signals
+ *  @author Adam Stark
+ *  @copyright Copyright (C) 2008-2014  Queen Mary University of London
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+//=======================================================================
+
+#ifndef OfflineBeatTracker_h
+#define OfflineBeatTracker_h
+
+#include <vector>
+#include "BTrack.h"
+
+//=======================================================================
+/** Tracks the beats of a complete signal, such as a file, in two passes. BTrack
+ * is first run over the whole signal at a coarse hop size, using the spectral
+ * difference detection function (see SpectralDifferenceQuality), which finds the
+ * tempo and the approximate beat positions cheaply. Each beat is then moved to the
+ * strongest nearby peak of an onset detection function calculated at a fine hop
+ * size, but only in a small window around the beat. The beats come out with
+ * roughly the precision of running BTrack at the fine hop size, for a fraction
+ * of the cost.
+ *
+ * Beat positions are given in samples from the start of the signal, in the
+ * same way as BTrack::getBeatTimeInSeconds() gives them in seconds.
+ */
+class OfflineBeatTracker
+{
+public:
+
+    /** Constructor
+     * @param coarseHopSize_ the hop size used to track beats over the whole signal
+     * @param fineHopSize_ the hop size of the onset detection function used to refine each beat
+     */
+    OfflineBeatTracker (int coarseHopSize_ = 1024, int fineHopSize_ = 128);
+
+    /** Track the beats of a signal, replacing the results of any previous signal
+     * @param signal the audio samples
+     * @param numSamples the number of samples in the signal
+     */
+    void processSignal (const double* signal, long numSamples);
+
+    //=======================================================================
+    /** @returns the refined beat positions, in samples */
+    const std::vector<long>& getBeats() const;
+
+    /** @returns the beat positions found by the coarse pass, in samples */
+    const std::vector<long>& getCoarseBeats() const;
+
+    /** @returns the tempo estimate, in beats per minute, at each beat */
+    const std::vector<double>& getTempi() const;
+
+    /** @returns the coarse hop size in samples */
+    int getCoarseHopSize() const;
+
+    /** @returns the fine hop size in samples */
+    int getFineHopSize() const;
+
+private:
+
+    /** Moves a beat to the strongest nearby peak of the fine onset detection function
+     * @param signal the audio samples
+     * @param numSamples the number of samples in the signal
+     * @param beat the coarse beat position, in samples
+     * @returns the refined beat position, in samples
+     */
+    long refineBeat (const double* signal, long numSamples, long beat);
+
+    int coarseHopSize;                  /**< the hop size of the coarse pass */
+    int fineHopSize;                    /**< the hop size of the fine onset detection function */
+
+    OnsetDetectionFunction fineODF;     /**< calculates the onset detection function around each beat */
+
+    std::vector<long> beats;            /**< the refined beat positions */
+    std::vector<long> coarseBeats;      /**< the beat positions found by the coarse pass */
+    std::vector<double> tempi;          /**< the tempo estimate at each beat */
+};
+
+#endif /* OfflineBeatTracker_h */
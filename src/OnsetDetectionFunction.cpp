@@ -20,29 +20,79 @@
 //=======================================================================
 
 #include <math.h>
+#include <algorithm>
 #include "OnsetDetectionFunction.h"
+#include "DSPKernels.h"
+#include "ScopedNoDenormals.h"
+
+//=======================================================================
+/** Multiply samples by a window */
+static void applyWindow (const double* samples, const double* window, double* output, int numSamples)
+{
+    DSPKernels::applyWindow (samples, window, output, numSamples);
+}
+
+//=======================================================================
+/** Multiply single precision samples by a window */
+static void applyWindow (const float* samples, const double* window, double* output, int numSamples)
+{
+    for (int i = 0; i < numSamples; i++)
+    {
+        output[i] = samples[i] * window[i];
+    }
+}
+
+//=======================================================================
+/** Fill in the bins above (N/2)+1 of a spectrum of a real signal, which are the conjugates of those below */
+static void mirrorUpperBins (double* spectrum, int frameSize)
+{
+    for (int i = (frameSize/2)+1; i < frameSize; i++)
+    {
+        spectrum[2 * i] = spectrum[2 * (frameSize - i)];
+        spectrum[2 * i + 1] = -spectrum[2 * (frameSize - i) + 1];
+    }
+}
+
+//=======================================================================
+/** @returns an array of interleaved real and imaginary parts as an array of complex values */
+static double (*asComplex (double* spectrum))[2]
+{
+    return reinterpret_cast<double (*)[2]> (spectrum);
+}
 
 //=======================================================================
 OnsetDetectionFunction::OnsetDetectionFunction (int hopSize_,int frameSize_)
- :  onsetDetectionFunctionType (ComplexSpectralDifferenceHWR), windowType (HanningWindow)
+ :  OnsetDetectionFunction (hopSize_, frameSize_, ComplexSpectralDifferenceHWR, HanningWindow)
 {
-    // indicate that we have not initialised yet
-	initialised = false;
-	
-	// set pi
-	pi = 3.14159265358979;
-	
-	// initialise with arguments to constructor
-	initialise (hopSize_, frameSize_, ComplexSpectralDifferenceHWR, HanningWindow);
+    
 }
 
 //=======================================================================
-OnsetDetectionFunction::OnsetDetectionFunction(int hopSize_,int frameSize_,int onsetDetectionFunctionType_,int windowType_)
- :  onsetDetectionFunctionType (ComplexSpectralDifferenceHWR), windowType (HanningWindow)
+OnsetDetectionFunction::OnsetDetectionFunction(int hopSize_,int frameSize_,int onsetDetectionFunctionType_,int windowType_, MemoryResource* memory_)
+ :  onsetDetectionFunctionType (ComplexSpectralDifferenceHWR), windowType (HanningWindow),
+    memory (memory_ != NULL ? memory_ : MemoryResource::getDefault()),
+    fftBackend (FFTBackend::getDefault()),
+    complexOut (NULL),
+    frame (memory),
+    slidingDFT (memory),
+    slidingDFTEnabled (false),
+    bandLimited (false),
+    bandBins (memory),
+    bandRotations (memory),
+    window (memory),
+    silenceThreshold (0.0),
+    phaseMagnitudeFloor (0.0),
+    blockCapacity (0),
+    blockSignal (memory),
+    blockIn (memory),
+    blockOut (memory),
+    magSpec (memory),
+    prevMagSpec (memory),
+    phase (memory),
+    prevPhase (memory),
+    prevPhase2 (memory),
+    phaseDeviations (memory)
 {	
-	// indicate that we have not initialised yet
-	initialised = false;
-	
 	// set pi
 	pi = 3.14159265358979;	
 	
@@ -54,10 +104,7 @@ OnsetDetectionFunction::OnsetDetectionFunction(int hopSize_,int frameSize_,int o
 //=======================================================================
 OnsetDetectionFunction::~OnsetDetectionFunction()
 {
-    if (initialised)
-    {
-        freeFFT();
-    }
+    
 }
 
 //=======================================================================
@@ -85,6 +132,7 @@ void OnsetDetectionFunction::initialise(int hopSize_,int frameSize_,int onsetDet
     phase.resize (frameSize);
     prevPhase.resize (frameSize);
     prevPhase2.resize (frameSize);
+    phaseDeviations.resize ((frameSize/2) + 1);
 	
 	
 	// set the window to the specified type
@@ -119,6 +167,33 @@ void OnsetDetectionFunction::initialise(int hopSize_,int frameSize_,int onsetDet
 	}
 	
 	prevEnergySum = 0.0;	// initialise previous energy sum value to zero
+    
+    frameStart = 0;
+    frameEnergy = 0.0;
+    peakFrameEnergy = 0.0;
+    hopsUntilEnergyResummation = energyResummationInterval();
+    hopsUntilSpectrumResync = 0;
+    
+    if (slidingDFTEnabled)
+    {
+        initialiseSlidingDFT();
+    }
+    
+    // a full range follows the frame size, a narrower one is kept within it
+    if (bandLimited)
+    {
+        setBinRange (firstBin, lastBin);
+    }
+    else
+    {
+        firstBin = 0;
+        lastBin = frameSize/2;
+    }
+    
+    numSilentHops = 0;
+    silentFrame = false;
+    spectrumIsCurrent = false;
+    energySum = 0.0;
 	
     initialiseFFT();
 }
@@ -126,74 +201,724 @@ void OnsetDetectionFunction::initialise(int hopSize_,int frameSize_,int onsetDet
 //=======================================================================
 void OnsetDetectionFunction::initialiseFFT()
 {
-    if (initialised) // if we have already initialised FFT plan
+    // the spectrum buffer has room for all frameSize bins, so the upper half can be mirrored in place.
+    // a backend that can't transform this frame size is kept for later sizes, but another is used for now
+    fft = FFTBackend::createFFTForSize (*fftBackend, frameSize, memory);
+    complexOut = asComplex (fft->getSpectrumBuffer());
+    
+    // the block buffers depend on the frame size
+    allocateBlockBuffers();
+}
+
+//=======================================================================
+void OnsetDetectionFunction::allocateBlockBuffers()
+{
+    if (blockCapacity <= 0)
+    {
+        return;
+    }
+    
+    blockSignal.resize ((frameSize - hopSize) + (blockCapacity * hopSize));
+    blockIn.resize (frameSize * blockCapacity);
+    blockOut.resize (2 * frameSize * blockCapacity);
+}
+
+//=======================================================================
+void OnsetDetectionFunction::setFFTBackend (std::shared_ptr<FFTBackend> backend)
+{
+    if (!backend || (backend == fftBackend))
+    {
+        return;
+    }
+    
+    fftBackend = backend;
+    
+    // the detection function state is kept, only the FFT changes
+    fft = FFTBackend::createFFTForSize (*fftBackend, frameSize, memory);
+    complexOut = asComplex (fft->getSpectrumBuffer());
+    spectrumIsCurrent = false;
+}
+
+//=======================================================================
+std::shared_ptr<FFTBackend> OnsetDetectionFunction::getFFTBackend() const
+{
+    return fftBackend;
+}
+
+//=======================================================================
+MemoryResource* OnsetDetectionFunction::getMemoryResource() const
+{
+    return memory;
+}
+
+//=======================================================================
+size_t OnsetDetectionFunction::memoryFootprint() const
+{
+    size_t numValues = frame.capacity() + window.capacity() + blockSignal.capacity() + bandBins.capacity() + bandRotations.capacity()
+                     + magSpec.capacity() + prevMagSpec.capacity()
+                     + phase.capacity() + prevPhase.capacity() + prevPhase2.capacity() + phaseDeviations.capacity()
+                     + blockIn.size() + blockOut.size();
+    
+    size_t bytes = sizeof (OnsetDetectionFunction) + (numValues * sizeof (double)) + slidingDFT.memoryFootprint();
+    
+    if (fft)
+    {
+        bytes += fft->memoryFootprint();
+    }
+    
+    return bytes;
+}
+
+//=======================================================================
+void OnsetDetectionFunction::prepareBlockProcessing (int maxHopsPerBlock)
+{
+    if (maxHopsPerBlock == blockCapacity)
+    {
+        return;
+    }
+    
+    blockCapacity = std::max (maxHopsPerBlock, 0);
+    allocateBlockBuffers();
+}
+
+//=======================================================================
+void OnsetDetectionFunction::calculateBlock (const double* samples, int numHops, double* odfOut)
+{
+    ScopedNoDenormals noDenormals;
+    
+    calculateBlockOfSamples (samples, numHops, odfOut);
+}
+
+//=======================================================================
+void OnsetDetectionFunction::calculateBlock (const float* samples, int numHops, float* odfOut)
+{
+    ScopedNoDenormals noDenormals;
+    
+    calculateBlockOfSamples (samples, numHops, odfOut);
+}
+
+//=======================================================================
+template <typename T>
+void OnsetDetectionFunction::calculateBlockOfSamples (const T* samples, int numHops, T* odfOut)
+{
+    if (blockCapacity <= 0)
+    {
+        calculateHopsOneAtATime (samples, numHops, odfOut);
+        return;
+    }
+    
+    int historySize = frameSize - hopSize;
+    bool needsSpectrum = usesSpectrum();
+    
+    lineariseFrame();
+    
+    while (numHops > 0)
+    {
+        int numFrames = std::min (numHops, blockCapacity);
+        
+        // lay the end of the previous frame and all of the new hops out contiguously, so
+        // that each frame in the block is just an offset into the same signal
+        for (int i = 0; i < historySize; i++)
+        {
+            blockSignal[i] = frame[i + hopSize];
+        }
+        
+        for (int i = 0; i < numFrames * hopSize; i++)
+        {
+            blockSignal[historySize + i] = samples[i];
+        }
+        
+        // there is no need to transform the block if every frame in it is silent
+        bool allFramesSilent = false;
+        
+        if (silenceThreshold > 0)
+        {
+            int numSilentHopsBefore = numSilentHops;
+            allFramesSilent = true;
+            
+            for (int k = 0; k < numFrames; k++)
+            {
+                allFramesSilent = countSilentHop (DSPKernels::sumOfSquares (&blockSignal[historySize + (k * hopSize)], hopSize)) && allFramesSilent;
+            }
+            
+            numSilentHops = numSilentHopsBefore;
+        }
+        
+        if (needsSpectrum && !allFramesSilent)
+        {
+            performBlockFFT (numFrames);
+        }
+        
+        // the difference stage depends on the previous frame, so it has to run in order
+        for (int k = 0; k < numFrames; k++)
+        {
+            // skip silent frames as calculateOnsetDetectionFunctionSample() does
+            if (silenceThreshold > 0)
+            {
+                silentFrame = countSilentHop (DSPKernels::sumOfSquares (&blockSignal[historySize + (k * hopSize)], hopSize));
+                
+                if (silentFrame)
+                {
+                    odfOut[k] = 0;
+                    continue;
+                }
+            }
+            
+            silentFrame = false;
+            
+            if (needsSpectrum)
+            {
+                useBlockSpectrum (k);
+            }
+            else
+            {
+                energySum = sumOfSquares (&blockSignal[k * hopSize]);
+            }
+            
+            odfOut[k] = (T) calculateDetectionFunction();
+        }
+        
+        // point back at the single frame spectrum
+        complexOut = asComplex (fft->getSpectrumBuffer());
+        spectrumIsCurrent = false;
+        
+        // keep the last frame so that hop by hop processing can carry on from here
+        for (int i = 0; i < frameSize; i++)
+        {
+            frame[i] = blockSignal[((numFrames - 1) * hopSize) + i];
+        }
+        
+        samples += numFrames * hopSize;
+        odfOut += numFrames;
+        numHops -= numFrames;
+    }
+    
+    // the running energy and the sliding DFT are recalculated from the new frame at the next hop
+    hopsUntilEnergyResummation = 0;
+    hopsUntilSpectrumResync = 0;
+}
+
+//=======================================================================
+template <typename T>
+void OnsetDetectionFunction::calculateHopsOneAtATime (const T* samples, int numHops, T* odfOut)
+{
+    int historySize = frameSize - hopSize;
+    
+    lineariseFrame();
+    
+    for (int k = 0; k < numHops; k++)
+    {
+        const T* hop = samples + (k * hopSize);
+        
+        for (int i = 0; i < historySize; i++)
+        {
+            frame[i] = frame[i + hopSize];
+        }
+        
+        for (int i = 0; i < hopSize; i++)
+        {
+            frame[historySize + i] = hop[i];
+        }
+        
+        if (silenceThreshold > 0)
+        {
+            silentFrame = countSilentHop (DSPKernels::sumOfSquares (&frame[historySize], hopSize));
+            
+            if (silentFrame)
+            {
+                spectrumIsCurrent = false;
+                odfOut[k] = 0;
+                continue;
+            }
+        }
+        
+        silentFrame = false;
+        odfOut[k] = (T) analyseFrame (&frame[0]);
+    }
+    
+    // the running energy and the sliding DFT are recalculated from the new frame at the next hop
+    hopsUntilEnergyResummation = 0;
+    hopsUntilSpectrumResync = 0;
+}
+
+//=======================================================================
+bool OnsetDetectionFunction::countSilentHop (double hopEnergy)
+{
+    if (hopEnergy <= (silenceThreshold * hopSize))
+    {
+        // stop counting once the frame is known to be silent so that the count can't overflow
+        if ((numSilentHops * hopSize) < (frameSize + hopSize))
+        {
+            numSilentHops++;
+        }
+    }
+    else
+    {
+        numSilentHops = 0;
+    }
+    
+    // the analysis can be skipped once the whole frame is silent and one silent frame has
+    // already been analysed, so that the previous spectrum reflects the silence
+    return (numSilentHops * hopSize) >= (frameSize + hopSize);
+}
+
+//=======================================================================
+void OnsetDetectionFunction::performBlockFFT (int numFrames)
+{
+    int fsize2 = (frameSize/2);
+    
+    // window every frame and swap its two halves, as in performFFT()
+    for (int k = 0; k < numFrames; k++)
+    {
+        const double* samples = &blockSignal[k * hopSize];
+        double* frameIn = blockIn.data() + (k * frameSize);
+        
+        applyWindow (samples + fsize2, &window[fsize2], frameIn, fsize2);
+        applyWindow (samples, &window[0], frameIn + fsize2, fsize2);
+    }
+    
+    fft->performForwardTransforms (blockIn.data(), blockOut.data(), numFrames);
+    
+    for (int k = 0; k < numFrames; k++)
+    {
+        mirrorUpperBins (blockOut.data() + (2 * k * frameSize), frameSize);
+    }
+}
+
+//=======================================================================
+const double* OnsetDetectionFunction::interleavedSpectrum() const
+{
+    return complexOut[0];
+}
+
+//=======================================================================
+void OnsetDetectionFunction::useBlockSpectrum (int k)
+{
+    // the detection functions read complexOut, so point it at this frame's spectrum
+    complexOut = asComplex (blockOut.data() + (2 * k * frameSize));
+}
+
+//=======================================================================
+void OnsetDetectionFunction::setOnsetDetectionFunctionType (int onsetDetectionFunctionType_)
+{
+	onsetDetectionFunctionType = onsetDetectionFunctionType_; // set detection function type
+}
+
+//=======================================================================
+void OnsetDetectionFunction::setSilenceThreshold (double meanSquareThreshold)
+{
+    silenceThreshold = meanSquareThreshold;
+}
+
+//=======================================================================
+double OnsetDetectionFunction::getSilenceThreshold() const
+{
+    return silenceThreshold;
+}
+
+//=======================================================================
+bool OnsetDetectionFunction::frameWasSilent() const
+{
+    return silentFrame;
+}
+
+//=======================================================================
+void OnsetDetectionFunction::setPhaseMagnitudeFloor (double relativeFloor)
+{
+    phaseMagnitudeFloor = relativeFloor;
+}
+
+//=======================================================================
+double OnsetDetectionFunction::getPhaseMagnitudeFloor() const
+{
+    return phaseMagnitudeFloor;
+}
+
+//=======================================================================
+void OnsetDetectionFunction::setSlidingDFT (bool enabled)
+{
+    slidingDFTEnabled = enabled;
+    hopsUntilSpectrumResync = 0;
+    
+    if (slidingDFTEnabled)
+    {
+        initialiseSlidingDFT();
+    }
+}
+
+//=======================================================================
+bool OnsetDetectionFunction::isSlidingDFTEnabled() const
+{
+    return slidingDFTEnabled;
+}
+
+//=======================================================================
+void OnsetDetectionFunction::initialiseSlidingDFT()
+{
+    slidingDFT.setFrameSize (frameSize, hopSize);
+    
+    // the windows that are a constant minus a cosine
+    switch (windowType)
+    {
+        case RectangularWindow:
+            slidingDFT.setWindow (1.0, 0.0);
+            break;
+        case HanningWindow:
+            slidingDFT.setWindow (0.5, 0.5);
+            break;
+        case HammingWindow:
+            slidingDFT.setWindow (0.54, 0.46);
+            break;
+        default:
+            break;
+    }
+}
+
+//=======================================================================
+void OnsetDetectionFunction::setBinRange (int firstBin_, int lastBin_)
+{
+    int maxBin = frameSize/2;
+    
+    firstBin = std::min (std::max (firstBin_, 0), maxBin);
+    lastBin = std::min (std::max (lastBin_, firstBin), maxBin);
+    bandLimited = (firstBin > 0) || (lastBin < maxBin);
+    
+    initialiseBandDFT();
+}
+
+//=======================================================================
+int OnsetDetectionFunction::getFirstBin() const
+{
+    return firstBin;
+}
+
+//=======================================================================
+int OnsetDetectionFunction::getLastBin() const
+{
+    return lastBin;
+}
+
+//=======================================================================
+void OnsetDetectionFunction::initialiseBandDFT()
+{
+    if (!prunesTransform())
+    {
+        return;
+    }
+    
+    // the vector kernels work through 16 bins at a time, and fewer bins than that are much
+    // slower, each bin's recursion being a chain of dependent steps, so the band is padded
+    int numBandBins = (((lastBin - firstBin) + 1 + 15) / 16) * 16;
+    
+    bandBins.resize (2 * numBandBins);
+    bandRotations.resize (4 * numBandBins);
+    
+    // each sample moves a bin's phase on by 2 pi k / N, as in the sliding DFT
+    for (int i = 0; i < numBandBins; i++)
+    {
+        double angle = (2 * pi * (firstBin + i)) / frameSize;
+        
+        bandRotations[i] = cos (angle);
+        bandRotations[numBandBins + i] = sin (angle);
+        bandRotations[(2 * numBandBins) + i] = cos (angle * bandDFTBlockSize);
+        bandRotations[(3 * numBandBins) + i] = sin (angle * bandDFTBlockSize);
+    }
+}
+
+//=======================================================================
+const double* OnsetDetectionFunction::getCurrentSpectrum() const
+{
+    return spectrumIsCurrent ? interleavedSpectrum() : NULL;
+}
+
+//=======================================================================
+int OnsetDetectionFunction::getFrameSize() const
+{
+    return frameSize;
+}
+
+//=======================================================================
+int OnsetDetectionFunction::getOnsetDetectionFunctionType() const
+{
+    return onsetDetectionFunctionType;
+}
+
+//=======================================================================
+int OnsetDetectionFunction::getWindowType() const
+{
+    return windowType;
+}
+
+//=======================================================================
+void OnsetDetectionFunction::copyAudioHistory (const OnsetDetectionFunction& other)
+{
+    int numSamples = std::min (frameSize, other.frameSize);
+    
+    lineariseFrame();
+    
+    // align the newest samples of both frames, the other's oldest sample being at its frameStart
+    for (int i = 1; i <= numSamples; i++)
+    {
+        frame[frameSize - i] = other.frame[(other.frameStart + other.frameSize - i) % other.frameSize];
+    }
+    
+    hopsUntilEnergyResummation = 0;
+    hopsUntilSpectrumResync = 0;
+}
+
+//=======================================================================
+void OnsetDetectionFunction::swap (OnsetDetectionFunction& other)
+{
+    std::swap (frameSize, other.frameSize);
+    std::swap (hopSize, other.hopSize);
+    std::swap (onsetDetectionFunctionType, other.onsetDetectionFunctionType);
+    std::swap (windowType, other.windowType);
+    std::swap (memory, other.memory);
+    
+    fftBackend.swap (other.fftBackend);
+    fft.swap (other.fft);
+    std::swap (complexOut, other.complexOut);
+    
+    std::swap (blockCapacity, other.blockCapacity);
+    blockSignal.swap (other.blockSignal);
+    blockIn.swap (other.blockIn);
+    blockOut.swap (other.blockOut);
+    
+    std::swap (silenceThreshold, other.silenceThreshold);
+    std::swap (phaseMagnitudeFloor, other.phaseMagnitudeFloor);
+    std::swap (numSilentHops, other.numSilentHops);
+    std::swap (silentFrame, other.silentFrame);
+    std::swap (spectrumIsCurrent, other.spectrumIsCurrent);
+    std::swap (energySum, other.energySum);
+    
+    frame.swap (other.frame);
+    std::swap (frameStart, other.frameStart);
+    std::swap (frameEnergy, other.frameEnergy);
+    std::swap (peakFrameEnergy, other.peakFrameEnergy);
+    std::swap (hopsUntilEnergyResummation, other.hopsUntilEnergyResummation);
+    slidingDFT.swap (other.slidingDFT);
+    std::swap (slidingDFTEnabled, other.slidingDFTEnabled);
+    std::swap (hopsUntilSpectrumResync, other.hopsUntilSpectrumResync);
+    std::swap (firstBin, other.firstBin);
+    std::swap (lastBin, other.lastBin);
+    std::swap (bandLimited, other.bandLimited);
+    bandBins.swap (other.bandBins);
+    bandRotations.swap (other.bandRotations);
+    window.swap (other.window);
+    std::swap (prevEnergySum, other.prevEnergySum);
+    magSpec.swap (other.magSpec);
+    prevMagSpec.swap (other.prevMagSpec);
+    phase.swap (other.phase);
+    prevPhase.swap (other.prevPhase);
+    prevPhase2.swap (other.prevPhase2);
+    phaseDeviations.swap (other.phaseDeviations);
+}
+
+//=======================================================================
+double OnsetDetectionFunction::calculateOnsetDetectionFunctionSample (double* buffer)
+{	
+    ScopedNoDenormals noDenormals;
+    
+    bool needsSpectrum = usesSpectrum();
+    bool slideSpectrum = slidesSpectrum();
+    
+    if (needsSpectrum)
+    {
+        lineariseFrame();
+        
+        // the oldest hop of the frame is about to be overwritten, so slide the DFT past it first
+        if (slideSpectrum && (hopsUntilSpectrumResync > 0))
+        {
+            hopsUntilSpectrumResync--;
+            
+            if (hopsUntilSpectrumResync > 0)
+            {
+                slidingDFT.slide (buffer, &frame[0], hopSize);
+            }
+        }
+        
+        // shift audio samples back in frame by hop size
+        for (int i = 0; i < (frameSize-hopSize);i++)
+        {
+            frame[i] = frame[i+hopSize];
+        }
+        
+        // add new samples to frame from input buffer
+        int j = 0;
+        for (int i = (frameSize-hopSize);i < frameSize;i++)
+        {
+            frame[i] = buffer[j];
+            j++;
+        }
+        
+        // the running energy isn't kept up to date here, so recalculate it if it is needed
+        hopsUntilEnergyResummation = 0;
+    }
+    else
+    {
+        // only the energy is needed, so overwrite the oldest hop rather than shifting the frame
+        addHopToFrame (buffer);
+        hopsUntilSpectrumResync = 0;
+    }
+    
+    if (silenceThreshold > 0)
+    {
+        // the running energy covers the whole frame, so the hop is summed on its own, with the
+        // same kernel as the running energy and block processing use
+        if (countSilentHop (DSPKernels::sumOfSquares (buffer, hopSize)))
+        {
+            silentFrame = true;
+            spectrumIsCurrent = false;
+            return 0.0;
+        }
+    }
+    
+    silentFrame = false;
+    
+    if (!needsSpectrum)
+    {
+        energySum = frameEnergy;
+        spectrumIsCurrent = false;
+        return calculateDetectionFunction();
+    }
+    
+    if (slideSpectrum)
+    {
+        return analyseFrameWithSlidingDFT();
+    }
+    
+    return analyseFrame (&frame[0]);
+}
+
+//=======================================================================
+double OnsetDetectionFunction::analyseFrameWithSlidingDFT()
+{
+    // rounding errors build up in the sliding DFT, so every so often set it from the whole frame
+    if (hopsUntilSpectrumResync <= 0)
     {
-        freeFFT();
+        std::copy (&frame[0], &frame[0] + frameSize, fft->getTimeDomainBuffer());
+        fft->performForwardTransform();
+        
+        slidingDFT.setSpectrum (complexOut[0]);
+        hopsUntilSpectrumResync = spectrumResyncInterval();
     }
     
-#ifdef USE_FFTW
-    complexIn = (fftw_complex*) fftw_malloc (sizeof(fftw_complex) * frameSize);		// complex array to hold fft data
-    complexOut = (fftw_complex*) fftw_malloc (sizeof(fftw_complex) * frameSize);	// complex array to hold fft data
-    p = fftw_plan_dft_1d (frameSize, complexIn, complexOut, FFTW_FORWARD, FFTW_ESTIMATE);	// FFT plan initialisation
-#endif
+    slidingDFT.getWindowedSpectrum (complexOut[0], true);
+    mirrorUpperBins (complexOut[0], frameSize);
+    spectrumIsCurrent = true;
+    
+    return calculateDetectionFunction();
+}
+
+//=======================================================================
+double OnsetDetectionFunction::calculateFromFrame (const double* inputFrame)
+{
+    ScopedNoDenormals noDenormals;
+    
+    silentFrame = false;
     
-#ifdef USE_KISS_FFT
-    complexOut.resize (frameSize);
+    return analyseFrame (inputFrame);
+}
+
+//=======================================================================
+double OnsetDetectionFunction::calculateFromFrame (const float* inputFrame)
+{
+    ScopedNoDenormals noDenormals;
     
-    for (int i = 0; i < frameSize;i++)
+    silentFrame = false;
+    
+    return analyseFrame (inputFrame);
+}
+
+//=======================================================================
+template <typename T>
+double OnsetDetectionFunction::analyseFrame (const T* samples)
+{
+    // the time domain detection functions don't need a spectrum
+    if (!usesSpectrum())
     {
-        complexOut[i].resize(2);
+        energySum = sumOfSquares (samples);
+        spectrumIsCurrent = false;
+    }
+    else if (prunesTransform())
+    {
+        // only the bins in the range are calculated
+        performBandDFT (samples);
+        spectrumIsCurrent = false;
+    }
+    else
+    {
+        performFFT (samples);
+        spectrumIsCurrent = true;
     }
     
-    fftIn = new kiss_fft_cpx[frameSize];
-    fftOut = new kiss_fft_cpx[frameSize];
-    cfg = kiss_fft_alloc (frameSize, 0, 0, 0);
-#endif
+    return calculateDetectionFunction();
+}
 
-    initialised = true;
+//=======================================================================
+double OnsetDetectionFunction::calculateOnsetDetectionFunctionSampleFromSpectrum (const double* real, const double* imag)
+{
+    ScopedNoDenormals noDenormals;
+    
+    int numBins = (frameSize/2) + 1;
+    
+    // take the first (N/2)+1 bins as given
+    for (int i = 0; i < numBins; i++)
+    {
+        complexOut[i][0] = real[i];
+        complexOut[i][1] = imag[i];
+    }
+    
+    // the spectrum of a real signal is conjugate symmetric above (N/2)+1
+    mirrorUpperBins (complexOut[0], frameSize);
+    
+    silentFrame = false;
+    spectrumIsCurrent = true;
+    
+    if ((onsetDetectionFunctionType == EnergyEnvelope) || (onsetDetectionFunctionType == EnergyDifference))
+    {
+        energySum = spectrumEnergy();
+    }
+    
+    return calculateDetectionFunction();
 }
 
 //=======================================================================
-void OnsetDetectionFunction::freeFFT()
+double OnsetDetectionFunction::calculateOnsetDetectionFunctionSampleFromPolarSpectrum (const double* magnitude, const double* phaseValues)
 {
-#ifdef USE_FFTW
-    fftw_destroy_plan (p);
-    fftw_free (complexIn);
-    fftw_free (complexOut);
-#endif
+    ScopedNoDenormals noDenormals;
+    
+    int numBins = (frameSize/2) + 1;
+    
+    for (int i = 0; i < numBins; i++)
+    {
+        complexOut[i][0] = magnitude[i] * cos (phaseValues[i]);
+        complexOut[i][1] = magnitude[i] * sin (phaseValues[i]);
+    }
+    
+    mirrorUpperBins (complexOut[0], frameSize);
     
-#ifdef USE_KISS_FFT
-    free (cfg);
-    delete [] fftIn;
-    delete [] fftOut;
-#endif
+    silentFrame = false;
+    spectrumIsCurrent = true;
+    
+    if ((onsetDetectionFunctionType == EnergyEnvelope) || (onsetDetectionFunctionType == EnergyDifference))
+    {
+        energySum = spectrumEnergy();
+    }
+    
+    return calculateDetectionFunction();
 }
 
 //=======================================================================
-void OnsetDetectionFunction::setOnsetDetectionFunctionType (int onsetDetectionFunctionType_)
+double OnsetDetectionFunction::calculateDetectionFunction()
 {
-	onsetDetectionFunctionType = onsetDetectionFunctionType_; // set detection function type
-}
-
-//=======================================================================
-double OnsetDetectionFunction::calculateOnsetDetectionFunctionSample (double* buffer)
-{	
 	double odfSample;
-		
-	// shift audio samples back in frame by hop size
-	for (int i = 0; i < (frameSize-hopSize);i++)
-	{
-		frame[i] = frame[i+hopSize];
-	}
+    
+    if (bandLimited && usesSpectrum())
+    {
+        return bandDetectionFunction();
+    }
 	
-	// add new samples to frame from input buffer
-	int j = 0;
-	for (int i = (frameSize-hopSize);i < frameSize;i++)
-	{
-		frame[i] = buffer[j];
-		j++;
-	}
-		
 	switch (onsetDetectionFunctionType)
     {
 		case EnergyEnvelope:
@@ -267,63 +992,149 @@ double OnsetDetectionFunction::calculateOnsetDetectionFunctionSample (double* bu
 
 
 //=======================================================================
-void OnsetDetectionFunction::performFFT()
+template <typename T>
+void OnsetDetectionFunction::performFFT (const T* samples)
 {
     int fsize2 = (frameSize/2);
+    double* fftIn = fft->getTimeDomainBuffer();
     
-#ifdef USE_FFTW
-	// window frame and copy to complex array, swapping the first and second half of the signal
-	for (int i = 0;i < fsize2;i++)
-	{
-		complexIn[i][0] = frame[i + fsize2] * window[i + fsize2];
-		complexIn[i][1] = 0.0;
-		complexIn[i+fsize2][0] = frame[i] * window[i];
-		complexIn[i+fsize2][1] = 0.0;
-	}
+	// window frame, swapping the first and second half of the signal
+	applyWindow (samples + fsize2, &window[fsize2], fftIn, fsize2);
+	applyWindow (samples, &window[0], fftIn + fsize2, fsize2);
 	
 	// perform the fft
-	fftw_execute (p);
-#endif
+	fft->performForwardTransform();
+    
+    // only the first (N/2)+1 bins are calculated, so mirror them to get the rest
+    mirrorUpperBins (complexOut[0], frameSize);
+}
+
+//=======================================================================
+template <typename T>
+void OnsetDetectionFunction::performBandDFT (const T* samples)
+{
+    int fsize2 = (frameSize/2);
+    double* fftIn = fft->getTimeDomainBuffer();
+    
+    // window frame, swapping the first and second half of the signal as performFFT() does
+    applyWindow (samples + fsize2, &window[fsize2], fftIn, fsize2);
+    applyWindow (samples, &window[0], fftIn + fsize2, fsize2);
+    
+    int numBandBins = (int) bandBins.size() / 2;
+    double* real = &bandBins[0];
+    double* imag = real + numBandBins;
+    const double* rotationReal = &bandRotations[0];
+    const double* rotationImag = rotationReal + numBandBins;
+    const double* blockRotationReal = rotationReal + (2 * numBandBins);
+    const double* blockRotationImag = rotationReal + (3 * numBandBins);
+    
+    std::fill (real, real + (2 * numBandBins), 0.0);
+    
+    // sliding the whole frame into empty bins gives its DFT. whole blocks use the block
+    // rotation, and any samples left over are added one at a time
+    int i = 0;
     
-#ifdef USE_KISS_FFT
-    for (int i = 0; i < fsize2; i++)
+    while (i < frameSize)
     {
-        fftIn[i].r = frame[i + fsize2] * window[i + fsize2];
-        fftIn[i].i = 0.0;
-        fftIn[i + fsize2].r = frame[i] * window[i];
-        fftIn[i + fsize2].i = 0.0;
+        bool wholeBlock = (frameSize - i) >= bandDFTBlockSize;
+        int numSamples = wholeBlock ? bandDFTBlockSize : 1;
+        
+        DSPKernels::slidingDFT (real, imag, rotationReal, rotationImag,
+                                wholeBlock ? blockRotationReal : rotationReal,
+                                wholeBlock ? blockRotationImag : rotationImag,
+                                fftIn + i, numSamples, numBandBins);
+        
+        i += numSamples;
     }
     
-    // execute kiss fft
-    kiss_fft (cfg, fftIn, fftOut);
-    
-    // store real and imaginary parts of FFT
-    for (int i = 0; i < frameSize; i++)
+    for (int k = 0; k <= (lastBin - firstBin); k++)
     {
-        complexOut[i][0] = fftOut[i].r;
-        complexOut[i][1] = fftOut[i].i;
+        complexOut[firstBin + k][0] = real[k];
+        complexOut[firstBin + k][1] = imag[k];
     }
-#endif
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////// Methods for Detection Functions /////////////////////////////////
 
+//=======================================================================
+double OnsetDetectionFunction::bandDetectionFunction()
+{
+    int numBins = (frameSize/2) + 1;
+    bool needsPhase = (onsetDetectionFunctionType == PhaseDeviation) || (onsetDetectionFunctionType == ComplexSpectralDifference)
+                   || (onsetDetectionFunctionType == ComplexSpectralDifferenceHWR);
+    
+    // compute magnitude values of the bins in the range only
+    DSPKernels::magnitudes (complexOut[firstBin], &magSpec[firstBin], (lastBin - firstBin) + 1);
+    
+    if (needsPhase)
+    {
+        calculatePhaseDeviations();
+    }
+    
+    double sum = 0;
+    
+    for (int i = firstBin; i <= lastBin; i++)
+    {
+        double current = magSpec[i];
+        double previous = prevMagSpec[i];
+        double diff = current - previous;
+        
+        // the bins above frameSize/2 mirror those below, so each bin between DC and frameSize/2
+        // counts twice, and for the high frequency weighting the pair of them count (i+1) + (N-i+1)
+        bool edgeBin = (i == 0) || (i == numBins - 1);
+        double weight = edgeBin ? 1.0 : 2.0;
+        double highFrequencyWeight = edgeBin ? (double) (i+1) : (double) (frameSize + 2);
+        
+        switch (onsetDetectionFunctionType)
+        {
+            case SpectralDifference:
+                sum = sum + (weight * fabs (diff));
+                break;
+            case SpectralDifferenceHWR:
+                sum = sum + (diff > 0 ? weight * diff : 0);
+                break;
+            case PhaseDeviation:
+                sum = sum + (current > 0.1 ? weight * fabs (princarg (phaseDeviations[i])) : 0);
+                break;
+            case ComplexSpectralDifference:
+            case ComplexSpectralDifferenceHWR:
+            {
+                // bins below the phase magnitude floor have no deviation, and cos (0) is exactly 1
+                double cosDeviation = (phaseDeviations[i] == 0) ? 1.0 : cos (phaseDeviations[i]);
+                
+                if ((onsetDetectionFunctionType == ComplexSpectralDifference) || (diff > 0))
+                {
+                    sum = sum + (weight * sqrt ((current * current) + (previous * previous) - 2 * current * previous * cosDeviation));
+                }
+                
+                break;
+            }
+            case HighFrequencyContent:
+                sum = sum + (highFrequencyWeight * current);
+                break;
+            case HighFrequencySpectralDifference:
+                sum = sum + (highFrequencyWeight * fabs (diff));
+                break;
+            case HighFrequencySpectralDifferenceHWR:
+                sum = sum + (diff > 0 ? highFrequencyWeight * diff : 0);
+                break;
+            default:
+                break;
+        }
+        
+        // store values for next calculation
+        prevMagSpec[i] = current;
+    }
+    
+    return sum;
+}
+
 //=======================================================================
 double OnsetDetectionFunction::energyEnvelope()
 {
-	double sum;
-	
-	sum = 0;	// initialise sum
-	
-	// sum the squares of the samples
-	for (int i = 0;i < frameSize;i++)
-	{
-		sum = sum + (frame[i] * frame[i]);
-	}
-	
-	return sum;		// return sum
+	return energySum;
 }
 
 //=======================================================================
@@ -332,13 +1143,7 @@ double OnsetDetectionFunction::energyDifference()
 	double sum;
 	double sample;
 	
-	sum = 0;	// initialise sum
-	
-	// sum the squares of the samples
-	for (int i = 0; i < frameSize; i++)
-	{
-		sum = sum + (frame[i] * frame[i]);
-	}
+	sum = energySum;
 	
 	sample = sum - prevEnergySum;	// sample is first order difference in energy
 	
@@ -357,128 +1162,62 @@ double OnsetDetectionFunction::energyDifference()
 //=======================================================================
 double OnsetDetectionFunction::spectralDifference()
 {
-	double diff;
-	double sum;
-	
-	// perform the FFT
-	performFFT();
-	
 	// compute first (N/2)+1 mag values
-	for (int i = 0;i < (frameSize/2)+1;i++)
-	{
-		magSpec[i] = sqrt (pow (complexOut[i][0], 2) + pow (complexOut[i][1], 2));
-	}
+	DSPKernels::magnitudes (interleavedSpectrum(), &magSpec[0], (frameSize/2)+1);
+	
 	// mag spec symmetric above (N/2)+1 so copy previous values
 	for (int i = (frameSize/2)+1; i < frameSize; i++)
 	{
 		magSpec[i] = magSpec[frameSize-i];
 	}
 	
-	sum = 0;	// initialise sum to zero
-
-	for (int i = 0; i < frameSize; i++)
-	{
-		// calculate difference
-		diff = magSpec[i] - prevMagSpec[i];
-		
-		// ensure all difference values are positive
-		if (diff < 0)
-		{
-			diff = diff*-1;
-		}
-		
-		// add difference to sum
-		sum = sum + diff;
-		
-		// store magnitude spectrum bin for next detection function sample calculation
-		prevMagSpec[i] = magSpec[i];
-	}
-	
-	return sum;		
+	// sum the absolute differences, storing the magnitude spectrum for the next detection function sample calculation
+	return DSPKernels::spectralDifference (&magSpec[0], &prevMagSpec[0], frameSize, false, false);
 }
 
 //=======================================================================
 double OnsetDetectionFunction::spectralDifferenceHWR()
 {
-	double diff;
-	double sum;
-	
-	// perform the FFT
-	performFFT();
-	
 	// compute first (N/2)+1 mag values
-	for (int i = 0;i < (frameSize/2) + 1; i++)
-	{
-		magSpec[i] = sqrt (pow (complexOut[i][0],2) + pow (complexOut[i][1],2));
-	}
+	DSPKernels::magnitudes (interleavedSpectrum(), &magSpec[0], (frameSize/2)+1);
+	
 	// mag spec symmetric above (N/2)+1 so copy previous values
 	for (int i = (frameSize/2)+1;i < frameSize;i++)
 	{
 		magSpec[i] = magSpec[frameSize-i];
 	}
 	
-	sum = 0;	// initialise sum to zero
-	
-	for (int i = 0;i < frameSize;i++)
-	{
-		// calculate difference
-		diff = magSpec[i] - prevMagSpec[i];
-		
-		// only add up positive differences
-		if (diff > 0)
-		{
-			// add difference to sum
-			sum = sum+diff;
-		}
-		
-		// store magnitude spectrum bin for next detection function sample calculation
-		prevMagSpec[i] = magSpec[i];
-	}
-	
-	return sum;		
+	// only add up positive differences, storing the magnitude spectrum for the next detection function sample calculation
+	return DSPKernels::spectralDifference (&magSpec[0], &prevMagSpec[0], frameSize, true, false);
 }
 
 
 //=======================================================================
 double OnsetDetectionFunction::phaseDeviation()
 {
-	double dev,pdev;
+	double pdev;
 	double sum;
-	
-	// perform the FFT
-	performFFT();
+	int numBins = (frameSize/2) + 1;
 	
 	sum = 0; // initialise sum to zero
 	
-	// compute phase values from fft output and sum deviations
-	for (int i = 0;i < frameSize;i++)
+	// compute magnitude values from fft output
+	DSPKernels::magnitudes (interleavedSpectrum(), &magSpec[0], numBins);
+	
+	calculatePhaseDeviations();
+	
+	// the deviations of the bins above frameSize/2 are the negatives of those below, so
+	// each bin between DC and frameSize/2 counts twice
+	for (int i = 0;i < numBins;i++)
 	{
-		// calculate phase value
-		phase[i] = atan2 (complexOut[i][1], complexOut[i][0]);
-		
-		// calculate magnitude value
-		magSpec[i] = sqrt (pow (complexOut[i][0],2) + pow (complexOut[i][1],2));
-		
-		
 		// if bin is not just a low energy bin then examine phase deviation
 		if (magSpec[i] > 0.1)
 		{
-			dev = phase[i] - (2*prevPhase[i]) + prevPhase2[i];	// phase deviation
-			pdev = princarg (dev);	// wrap into [-pi,pi] range
-		
-			// make all values positive
-			if (pdev < 0)	
-			{
-				pdev = pdev*-1;
-			}
-						
+			pdev = fabs (princarg (phaseDeviations[i]));	// wrap into [-pi,pi] range and make positive
+			
 			// add to sum
-			sum = sum + pdev;
+			sum = sum + (((i == 0) || (i == numBins - 1)) ? pdev : 2 * pdev);
 		}
-				
-		// store values for next calculation
-		prevPhase2[i] = prevPhase[i];
-		prevPhase[i] = phase[i];
 	}
 	
 	return sum;		
@@ -487,87 +1226,94 @@ double OnsetDetectionFunction::phaseDeviation()
 //=======================================================================
 double OnsetDetectionFunction::complexSpectralDifference()
 {
-	double phaseDeviation;
-	double sum;
-	double csd;
+	return complexSpectralDifferenceSum (false);
+}
+
+//=======================================================================
+double OnsetDetectionFunction::complexSpectralDifferenceHWR()
+{
+	return complexSpectralDifferenceSum (true);
+}
+
+//=======================================================================
+double OnsetDetectionFunction::complexSpectralDifferenceSum (bool halfWaveRectify)
+{
+	int numBins = (frameSize/2) + 1;
 	
-	// perform the FFT
-	performFFT();
+	// compute magnitude values from fft output
+	DSPKernels::magnitudes (interleavedSpectrum(), &magSpec[0], numBins);
 	
-	sum = 0; // initialise sum to zero
+	calculatePhaseDeviations();
 	
-	// compute phase values from fft output and sum deviations
-	for (int i = 0;i < frameSize;i++)
+	for (int i = 0;i < numBins;i++)
 	{
-		// calculate phase value
-		phase[i] = atan2 (complexOut[i][1], complexOut[i][0]);
-		
-		// calculate magnitude value
-		magSpec[i] = sqrt (pow (complexOut[i][0],2) + pow(complexOut[i][1],2));
-		
-		// phase deviation
-		phaseDeviation = phase[i] - (2 * prevPhase[i]) + prevPhase2[i];
-		
-        // calculate complex spectral difference for the current spectral bin
-		csd = sqrt (pow (magSpec[i], 2) + pow (prevMagSpec[i], 2) - 2 * magSpec[i] * prevMagSpec[i] * cos (phaseDeviation));
-			
-		// add to sum
-		sum = sum + csd;
-		
-		// store values for next calculation
-		prevPhase2[i] = prevPhase[i];
-		prevPhase[i] = phase[i];
+		// bins below the phase magnitude floor have no deviation, and cos (0) is exactly 1
+		phaseDeviations[i] = (phaseDeviations[i] == 0) ? 1.0 : cos (phaseDeviations[i]);
+	}
+	
+	// each bin's difference replaces the cosine of its deviation. The bins above frameSize/2
+	// mirror those below, with the same magnitudes and the cosines of negated deviations, so
+	// they have the same differences, and every bin is summed in order as if it were held
+	DSPKernels::complexSpectralDifference (&magSpec[0], &prevMagSpec[0], &phaseDeviations[0], &phaseDeviations[0], numBins, halfWaveRectify);
+	double sum = DSPKernels::sumMirroredSpectrum (&phaseDeviations[0], frameSize);
+	
+	// store the mirrored magnitudes for next calculation
+	for (int i = numBins;i < frameSize;i++)
+	{
+		magSpec[i] = magSpec[frameSize-i];
 		prevMagSpec[i] = magSpec[i];
 	}
 	
-	return sum;		
+	return sum;
 }
 
 //=======================================================================
-double OnsetDetectionFunction::complexSpectralDifferenceHWR()
+void OnsetDetectionFunction::calculatePhaseDeviations()
 {
-	double phaseDeviation;
-	double sum;
-	double magnitudeDifference;
-	double csd;
-	
-	// perform the FFT
-	performFFT();
+	int numBins = (frameSize/2) + 1;
+	double magnitudeFloor = 0;
 	
-	sum = 0; // initialise sum to zero
+	if (phaseMagnitudeFloor > 0)
+	{
+		magnitudeFloor = phaseMagnitudeFloor * (*std::max_element (&magSpec[firstBin], &magSpec[lastBin] + 1));
+	}
 	
-	// compute phase values from fft output and sum deviations
-	for (int i = 0;i < frameSize;i++)
+	for (int i = firstBin;i <= lastBin;i++)
 	{
-		// calculate phase value
-		phase[i] = atan2 (complexOut[i][1], complexOut[i][0]);
-		
-		// calculate magnitude value
-		magSpec[i] = sqrt (pow (complexOut[i][0],2) + pow(complexOut[i][1],2));
+		if (magSpec[i] < magnitudeFloor)
+		{
+			// a quiet bin is assumed to follow its predicted phase, so it has no deviation
+			phase[i] = princarg ((2 * prevPhase[i]) - prevPhase2[i]);
+			phaseDeviations[i] = 0;
+		}
+		else
+		{
+			// calculate phase value
+			phase[i] = atan2 (complexOut[i][1], complexOut[i][0]);
+			
+			// phase deviation
+			phaseDeviations[i] = phase[i] - (2 * prevPhase[i]) + prevPhase2[i];
+		}
 		
-        // phase deviation
-        phaseDeviation = phase[i] - (2 * prevPhase[i]) + prevPhase2[i];
-        
-        // calculate magnitude difference (real part of Euclidean distance between complex frames)
-        magnitudeDifference = magSpec[i] - prevMagSpec[i];
-        
-        // if we have a positive change in magnitude, then include in sum, otherwise ignore (half-wave rectification)
-        if (magnitudeDifference > 0)
-        {
-            // calculate complex spectral difference for the current spectral bin
-            csd = sqrt (pow (magSpec[i], 2) + pow (prevMagSpec[i], 2) - 2 * magSpec[i] * prevMagSpec[i] * cos (phaseDeviation));
-        
-            // add to sum
-            sum = sum + csd;
-        }
-        
 		// store values for next calculation
 		prevPhase2[i] = prevPhase[i];
 		prevPhase[i] = phase[i];
-		prevMagSpec[i] = magSpec[i];
 	}
 	
-	return sum;		
+	// the spectrum is conjugate symmetric and atan2 is odd in its first argument, so the
+	// phases above frameSize/2 are exactly the negatives of those below. these are only
+	// needed by the full spectrum
+	if (bandLimited)
+	{
+		return;
+	}
+	
+	for (int i = numBins;i < frameSize;i++)
+	{
+		phase[i] = -phase[frameSize-i];
+		prevPhase[i] = -prevPhase[frameSize-i];
+		prevPhase2[i] = -prevPhase2[frameSize-i];
+	}
 }
 
 
@@ -576,18 +1322,13 @@ double OnsetDetectionFunction::highFrequencyContent()
 {
 	double sum;
 	
-	// perform the FFT
-	performFFT();
-	
 	sum = 0; // initialise sum to zero
 	
-	// compute phase values from fft output and sum deviations
+	// compute magnitude values from fft output
+	DSPKernels::magnitudes (interleavedSpectrum(), &magSpec[0], frameSize);
+	
 	for (int i = 0; i < frameSize; i++)
 	{		
-		// calculate magnitude value
-		magSpec[i] = sqrt (pow (complexOut[i][0],2) + pow (complexOut[i][1],2));
-		
-		
 		sum = sum + (magSpec[i] * ((double) (i+1)));
 		
 		// store values for next calculation
@@ -600,67 +1341,21 @@ double OnsetDetectionFunction::highFrequencyContent()
 //=======================================================================
 double OnsetDetectionFunction::highFrequencySpectralDifference()
 {
-	double sum;
-	double mag_diff;
-	
-	// perform the FFT
-	performFFT();
-	
-	sum = 0; // initialise sum to zero
-	
-	// compute phase values from fft output and sum deviations
-	for (int i = 0;i < frameSize;i++)
-	{		
-		// calculate magnitude value
-		magSpec[i] = sqrt (pow (complexOut[i][0],2) + pow (complexOut[i][1],2));
-		
-		// calculate difference
-		mag_diff = magSpec[i] - prevMagSpec[i];
-		
-		if (mag_diff < 0)
-		{
-			mag_diff = -mag_diff;
-		}
-		
-		sum = sum + (mag_diff * ((double) (i+1)));
-		
-		// store values for next calculation
-		prevMagSpec[i] = magSpec[i];
-	}
+	// compute magnitude values from fft output
+	DSPKernels::magnitudes (interleavedSpectrum(), &magSpec[0], frameSize);
 	
-	return sum;		
+	// sum the absolute differences weighted by bin number, storing values for next calculation
+	return DSPKernels::spectralDifference (&magSpec[0], &prevMagSpec[0], frameSize, false, true);
 }
 
 //=======================================================================
 double OnsetDetectionFunction::highFrequencySpectralDifferenceHWR()
 {
-	double sum;
-	double mag_diff;
-	
-	// perform the FFT
-	performFFT();
-	
-	sum = 0; // initialise sum to zero
-	
-	// compute phase values from fft output and sum deviations
-	for (int i = 0;i < frameSize;i++)
-	{		
-		// calculate magnitude value
-		magSpec[i] = sqrt (pow (complexOut[i][0],2) + pow (complexOut[i][1],2));
-		
-		// calculate difference
-		mag_diff = magSpec[i] - prevMagSpec[i];
-		
-		if (mag_diff > 0)
-		{
-			sum = sum + (mag_diff * ((double) (i+1)));
-		}
-
-		// store values for next calculation
-		prevMagSpec[i] = magSpec[i];
-	}
+	// compute magnitude values from fft output
+	DSPKernels::magnitudes (interleavedSpectrum(), &magSpec[0], frameSize);
 	
-	return sum;		
+	// only add up positive differences weighted by bin number, storing values for next calculation
+	return DSPKernels::spectralDifference (&magSpec[0], &prevMagSpec[0], frameSize, true, true);
 }
 
 
@@ -765,6 +1460,114 @@ void OnsetDetectionFunction::calculateRectangularWindow()
 ////////////////////////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////// Other Handy Methods //////////////////////////////////////////
 
+//=======================================================================
+template <typename T>
+double OnsetDetectionFunction::sumOfSquares (const T* samples)
+{
+	double sum = 0;
+	
+	// sum the squares of the samples
+	for (int i = 0; i < frameSize; i++)
+	{
+		sum = sum + (samples[i] * samples[i]);
+	}
+	
+	return sum;
+}
+
+//=======================================================================
+void OnsetDetectionFunction::addHopToFrame (const double* buffer)
+{
+    // the hop replaces the oldest samples in the frame, which may wrap around its end
+    int firstPart = std::min (hopSize, frameSize - frameStart);
+    
+    frameEnergy += DSPKernels::replaceSamples (buffer, &frame[frameStart], firstPart);
+    frameEnergy += DSPKernels::replaceSamples (buffer + firstPart, &frame[0], hopSize - firstPart);
+    
+    frameStart = (frameStart + hopSize) % frameSize;
+    
+    // rounding errors build up in the running sum, so every so often sum the frame again.
+    // the errors are relative to the loudest frame, so a frame that is much quieter than
+    // that is summed again straight away
+    hopsUntilEnergyResummation--;
+    peakFrameEnergy = std::max (peakFrameEnergy, frameEnergy);
+    
+    if ((hopsUntilEnergyResummation <= 0) || (frameEnergy < (peakFrameEnergy * 1e-6)))
+    {
+        frameEnergy = DSPKernels::sumOfSquares (&frame[0], frameSize);
+        peakFrameEnergy = frameEnergy;
+        hopsUntilEnergyResummation = energyResummationInterval();
+    }
+}
+
+//=======================================================================
+void OnsetDetectionFunction::lineariseFrame()
+{
+    if (frameStart != 0)
+    {
+        std::rotate (&frame[0], &frame[frameStart], &frame[0] + frameSize);
+        frameStart = 0;
+    }
+}
+
+//=======================================================================
+int OnsetDetectionFunction::energyResummationInterval() const
+{
+    // the number of hops in which the whole frame is replaced 16 times
+    return 16 * ((frameSize + hopSize - 1) / hopSize);
+}
+
+//=======================================================================
+int OnsetDetectionFunction::spectrumResyncInterval() const
+{
+    // the rounding errors in the sliding DFT grow with the number of samples slid, so it is set
+    // again once the whole frame has been replaced 16 times, at the cost of one FFT per 16 frames
+    return 16 * ((frameSize + hopSize - 1) / hopSize);
+}
+
+//=======================================================================
+bool OnsetDetectionFunction::slidesSpectrum() const
+{
+    bool windowIsCosine = (windowType == RectangularWindow) || (windowType == HanningWindow) || (windowType == HammingWindow);
+    
+    return slidingDFTEnabled && windowIsCosine && usesSpectrum();
+}
+
+//=======================================================================
+bool OnsetDetectionFunction::prunesTransform() const
+{
+    int log2FrameSize = 0;
+    
+    while ((1 << (log2FrameSize + 1)) <= frameSize)
+    {
+        log2FrameSize++;
+    }
+    
+    // a Goertzel pass over the frame costs each bin about as much as an FFT costs per
+    // log2 (frameSize) / 4 bins, so beyond 2 log2 (frameSize) bins a fast FFT is quicker
+    return bandLimited && (((lastBin - firstBin) + 1) <= (2 * log2FrameSize));
+}
+
+//=======================================================================
+bool OnsetDetectionFunction::usesSpectrum() const
+{
+    return (onsetDetectionFunctionType != EnergyEnvelope) && (onsetDetectionFunctionType != EnergyDifference);
+}
+
+//=======================================================================
+double OnsetDetectionFunction::spectrumEnergy()
+{
+	double sum = 0;
+	
+	// we only have the spectrum, so use Parseval's theorem
+	for (int i = 0; i < frameSize; i++)
+	{
+		sum = sum + (complexOut[i][0] * complexOut[i][0]) + (complexOut[i][1] * complexOut[i][1]);
+	}
+	
+	return sum / frameSize;
+}
+
 //=======================================================================
 double OnsetDetectionFunction::princarg(double phaseVal)
 {	
@@ -22,15 +22,10 @@
 #ifndef __ONSETDETECTIONFUNCTION_H
 #define __ONSETDETECTIONFUNCTION_H
 
-#ifdef USE_FFTW
-#include "fftw3.h"
-#endif
-
-#ifdef USE_KISS_FFT
-#include "kiss_fft.h"
-#endif
-
+#include "FFT.h"
+#include "SlidingDFT.h"
 #include <vector>
+#include <memory>
 
 //=======================================================================
 /** The type of onset detection function to calculate */
@@ -78,12 +73,24 @@ public:
      * @param frameSize_ the frame size in audio samples
      * @param onsetDetectionFunctionType_ the type of onset detection function to use - (see OnsetDetectionFunctionType)
      * @param windowType the type of window to use (see WindowType)
+     * @param memory_ where to allocate all of the buffers from (e.g. a MemoryArena), or NULL for the heap.
+     * The resource must outlive this instance
+     */
+	OnsetDetectionFunction (int hopSize_, int frameSize_, int onsetDetectionFunctionType_, int windowType_, MemoryResource* memory_ = NULL);
+    
+    /** Move constructor. The FFT and buffers are taken over rather than copied
+     * @param other the instance to move from, which can only be destroyed or assigned to afterwards
      */
-	OnsetDetectionFunction (int hopSize_, int frameSize_, int onsetDetectionFunctionType_, int windowType_);
+    OnsetDetectionFunction (OnsetDetectionFunction&& other) = default;
     
     /** Destructor */
 	~OnsetDetectionFunction();
     
+    /** Move assignment. The FFT and buffers are taken over rather than copied
+     * @param other the instance to move from, which can only be destroyed or assigned to afterwards
+     */
+    OnsetDetectionFunction& operator= (OnsetDetectionFunction&& other) = default;
+    
     /** Initialisation function for only updating hop size and frame size (and not window type 
      * or onset detection function type
      * @param hopSize_ the hop size in audio samples
@@ -105,17 +112,236 @@ public:
      */
 	double calculateOnsetDetectionFunctionSample (double* buffer);
     
+    /** Calculate a detection function sample from a complete frame of audio, for hosts that
+     * deliver overlapping frames themselves. The frame is windowed directly from the given
+     * array rather than being copied into an internal history buffer, so the hop size is
+     * only used by calculateOnsetDetectionFunctionSample()
+     * @param inputFrame a pointer to an array containing frameSize audio samples
+     * @returns the onset detection function sample
+     */
+    double calculateFromFrame (const double* inputFrame);
+    
+    /** Calculate a detection function sample from a complete frame of audio (see calculateFromFrame())
+     * @param inputFrame a pointer to an array containing frameSize audio samples
+     * @returns the onset detection function sample
+     */
+    double calculateFromFrame (const float* inputFrame);
+    
+    /** Allocate the buffers used by calculateBlock(). This should be called away from the
+     * audio thread. Until it has been called, calculateBlock() analyses the hops one at a time
+     * rather than allocating anything
+     * @param maxHopsPerBlock the number of hops transformed together. Longer blocks are processed in parts
+     */
+    void prepareBlockProcessing (int maxHopsPerBlock);
+    
+    /** Calculate detection function samples for several consecutive hops of audio at once.
+     * All of the frames are windowed and transformed together before the detection function
+     * is calculated for each in turn, which is quicker than calling
+     * calculateOnsetDetectionFunctionSample() once per hop. The results are the same, and the two
+     * can be mixed freely. Silent frames (see setSilenceThreshold()) give zero as they do hop by
+     * hop, and the transform of a block is skipped if all of its frames are silent
+     * @param samples a pointer to an array containing numHops * hopSize audio samples
+     * @param numHops the number of hops in the array
+     * @param odfOut a pointer to an array that receives numHops onset detection function samples
+     */
+    void calculateBlock (const double* samples, int numHops, double* odfOut);
+    
+    /** Calculate detection function samples for several consecutive hops of audio at once (see calculateBlock())
+     * @param samples a pointer to an array containing numHops * hopSize audio samples
+     * @param numHops the number of hops in the array
+     * @param odfOut a pointer to an array that receives numHops onset detection function samples
+     */
+    void calculateBlock (const float* samples, int numHops, float* odfOut);
+    
+    /** Calculate a detection function sample from a spectrum that has already been computed,
+     * for example by a host that needs the spectrum for other features. This skips the internal
+     * windowing and FFT. The spectrum should be the unnormalised FFT of a windowed frame of the
+     * configured frame size. EnergyEnvelope and EnergyDifference are calculated from the
+     * spectrum using Parseval's theorem, so they measure the energy of the windowed frame
+     * @param real the real parts of the first (frameSize/2)+1 FFT bins
+     * @param imag the imaginary parts of the first (frameSize/2)+1 FFT bins
+     * @returns the onset detection function sample
+     */
+    double calculateOnsetDetectionFunctionSampleFromSpectrum (const double* real, const double* imag);
+    
+    /** Calculate a detection function sample from a spectrum in magnitude and phase form (see
+     * calculateOnsetDetectionFunctionSampleFromSpectrum())
+     * @param magnitude the magnitudes of the first (frameSize/2)+1 FFT bins
+     * @param phaseValues the phases, in radians, of the first (frameSize/2)+1 FFT bins
+     * @returns the onset detection function sample
+     */
+    double calculateOnsetDetectionFunctionSampleFromPolarSpectrum (const double* magnitude, const double* phaseValues);
+    
     /** Set the detection function type 
      * @param onsetDetectionFunctionType_ the type of onset detection function to use - (see OnsetDetectionFunctionType)
      */
 	void setOnsetDetectionFunctionType (int onsetDetectionFunctionType_);
+    
+    /** Set the level below which audio is treated as silence. Once a whole frame is silent, the
+     * FFT and detection function stages are skipped and calculateOnsetDetectionFunctionSample()
+     * returns zero until the audio rises above the threshold again
+     * @param meanSquareThreshold the mean squared sample value of a hop at or below which the hop is
+     * silent, or zero (the default) to always calculate the detection function
+     */
+    void setSilenceThreshold (double meanSquareThreshold);
+    
+    /** @returns the mean squared sample value at or below which a hop is silent (see setSilenceThreshold()) */
+    double getSilenceThreshold() const;
+    
+    /** @returns true if the most recent frame was treated as silence, and so was not analysed */
+    bool frameWasSilent() const;
+    
+    /** Skip the phase calculations of quiet bins in the phase deviation and complex spectral
+     * difference detection functions. Bins far below the loudest bin of the frame add almost
+     * nothing to these, so instead of calculating their phases with atan2, each is assumed to
+     * follow the phase predicted from the previous two frames. This keeps their phase history
+     * going, so that a bin that becomes loud is predicted from recent phases
+     * @param relativeFloor the fraction of the largest magnitude in the frame below which a bin's
+     * phase isn't calculated, e.g. 0.001 for 60 dB below the peak, or zero (the default) to
+     * calculate every phase
+     */
+    void setPhaseMagnitudeFloor (double relativeFloor);
+    
+    /** @returns the fraction of the largest magnitude below which phases aren't calculated */
+    double getPhaseMagnitudeFloor() const;
+    
+    /** Keep the spectrum up to date as each hop comes in with a sliding DFT rather than
+     * calculating an FFT of the whole frame every hop. A hop costs time proportional to the hop
+     * size times the frame size, so this is only quicker for hops of a few tens of samples (with
+     * frames of 1024 samples, hops of up to about 64). The window is applied in the frequency
+     * domain, which gives the periodic form of the window, so the detection function differs
+     * slightly from that calculated with an FFT. Only the rectangular, Hanning and Hamming windows
+     * can be applied this way; with the others an FFT is always used, as it is by calculateBlock().
+     * This allocates memory, so it should not be called on the audio thread
+     * @param enabled true to use the sliding DFT, false (the default) to use an FFT every hop
+     */
+    void setSlidingDFT (bool enabled);
+    
+    /** @returns true if the sliding DFT has been enabled (see setSlidingDFT()) */
+    bool isSlidingDFTEnabled() const;
+    
+    /** Calculate the spectral detection functions from a range of bins only, e.g. the low
+     * frequencies that kick drums occupy. The sums are the same as over the full spectrum with
+     * every bin outside the range left out. Only the bins in the range are calculated: when there
+     * are few enough of them (no more than 2 log2 (frameSize)), they are transformed directly
+     * with a Goertzel recursion instead of an FFT, and the spectrum isn't available from
+     * getCurrentSpectrum(). The range is kept when the frame size changes, unless it is the full
+     * range, which then grows or shrinks with the frame. This allocates memory, so it should not
+     * be called on the audio thread
+     * @param firstBin_ the lowest bin to include, from 0 (DC) upwards
+     * @param lastBin_ the highest bin to include, up to frameSize/2
+     */
+    void setBinRange (int firstBin_, int lastBin_);
+    
+    /** @returns the lowest bin included in the spectral detection functions (see setBinRange()) */
+    int getFirstBin() const;
+    
+    /** @returns the highest bin included in the spectral detection functions (see setBinRange()) */
+    int getLastBin() const;
+    
+    /** @returns the spectrum of the most recent frame as interleaved real and imaginary parts
+     * of all frameSize bins, or NULL if that frame was analysed without one (a time domain
+     * detection function, a silent frame, a block of frames or a pruned transform, see
+     * setBinRange()). The spectrum is overwritten
+     * by the next frame
+     */
+    const double* getCurrentSpectrum() const;
+    
+    /** @returns the frame size in audio samples */
+    int getFrameSize() const;
+    
+    /** @returns the type of onset detection function being calculated (see OnsetDetectionFunctionType) */
+    int getOnsetDetectionFunctionType() const;
+    
+    /** @returns the type of window being used (see WindowType) */
+    int getWindowType() const;
+    
+    /** Copies the most recent audio samples held by another instance into this one, so that
+     * a newly created instance does not start from an empty frame
+     * @param other the instance to copy audio history from
+     */
+    void copyAudioHistory (const OnsetDetectionFunction& other);
+    
+    /** Set the FFT implementation used to calculate spectra. The backend can be shared with
+     * other instances. If it doesn't support the frame size (see FFTBackend::supportsSize()), the
+     * FFT comes from another backend until the frame size changes to one that it supports. This
+     * creates a new FFT, so it should not be called on the audio thread
+     * @param backend the backend to create the FFT from (see FFTBackend)
+     */
+    void setFFTBackend (std::shared_ptr<FFTBackend> backend);
+    
+    /** @returns the FFT implementation used to calculate spectra */
+    std::shared_ptr<FFTBackend> getFFTBackend() const;
+    
+    /** @returns the resource that the buffers are allocated from */
+    MemoryResource* getMemoryResource() const;
+    
+    /** @returns the number of bytes used by this instance, counting the object itself and
+     * all of the buffers and FFTs that it has allocated */
+    size_t memoryFootprint() const;
+    
+    /** Exchanges the complete state of this instance with another, including FFTs and
+     * buffers. No memory is allocated or freed, so this is safe to call on the audio thread
+     * @param other the instance to swap with
+     */
+    void swap (OnsetDetectionFunction& other);
 	
 private:
 	
-    /** Perform the FFT on the data in 'frame' */
-	void performFFT();
+    /** Calculate the detection function sample for a complete frame of audio
+     * @param samples a pointer to an array containing frameSize audio samples
+     */
+    template <typename T>
+    double analyseFrame (const T* samples);
+    
+    /** Window a frame of audio and perform the FFT on it
+     * @param samples a pointer to an array containing frameSize audio samples
+     */
+    template <typename T>
+	void performFFT (const T* samples);
+    
+    /** Window a frame of audio and calculate only the bins in the range set by setBinRange(),
+     * placing them in the spectrum as performFFT() would
+     * @param samples a pointer to an array containing frameSize audio samples
+     */
+    template <typename T>
+    void performBandDFT (const T* samples);
+    
+    /** Calculate the detection function sample for the frame from the sliding DFT, transforming
+     * the whole frame instead when the sliding DFT is due to be set again */
+    double analyseFrameWithSlidingDFT();
+    
+    /** Calculate detection function samples for consecutive hops of audio (see calculateBlock()) */
+    template <typename T>
+    void calculateBlockOfSamples (const T* samples, int numHops, T* odfOut);
+    
+    /** @returns the current spectrum as interleaved real and imaginary parts */
+    const double* interleavedSpectrum() const;
+    
+    /** Calculate detection function samples for consecutive hops of audio without the block
+     * buffers, adding each hop to the frame and analysing it in turn (see calculateBlock()) */
+    template <typename T>
+    void calculateHopsOneAtATime (const T* samples, int numHops, T* odfOut);
+    
+    /** Count a hop towards a run of silent hops
+     * @param hopEnergy the sum of the squares of the samples in the hop
+     * @returns true if the whole frame is now silent and its analysis can be skipped
+     */
+    bool countSilentHop (double hopEnergy);
+    
+    /** Window and transform the first numFrames frames held in blockSignal */
+    void performBlockFFT (int numFrames);
+    
+    /** Make the spectrum of the kth frame of the block the current spectrum */
+    void useBlockSpectrum (int k);
+    
+    /** Calculate the detection function sample of the selected type from the current spectrum and frame energy */
+    double calculateDetectionFunction();
 
     //=======================================================================
+    /** Calculate the detection function sample of the selected spectral type from the bins in the range set by setBinRange() */
+    double bandDetectionFunction();
+    
     /** Calculate energy envelope detection function sample */
 	double energyEnvelope();
     
@@ -137,6 +363,17 @@ private:
     /** Calculate complex spectral difference detection function sample (half-wave rectified) */
 	double complexSpectralDifferenceHWR();
     
+    /** Calculate either complex spectral difference detection function sample
+     * @param halfWaveRectify if true only bins whose magnitude has increased are included
+     */
+    double complexSpectralDifferenceSum (bool halfWaveRectify);
+    
+    /** Calculates the phase of each bin in the range set by setBinRange() and its deviation
+     * from the phase predicted by the previous two frames, holding the deviations in
+     * phaseDeviations, and moves the phases along ready for the next frame. The magnitudes of
+     * the bins in the range must already be in magSpec, for the phase magnitude floor */
+    void calculatePhaseDeviations();
+    
     /** Calculate high frequency content detection function sample */
 	double highFrequencyContent();
     
@@ -163,6 +400,49 @@ private:
 	void calculateTukeyWindow();
 
     //=======================================================================
+    /** @returns the sum of the squares of the samples in a frame of audio
+     * @param samples a pointer to an array containing frameSize audio samples
+     */
+    template <typename T>
+    double sumOfSquares (const T* samples);
+    
+    /** @returns the energy of the frame calculated from the current spectrum */
+    double spectrumEnergy();
+    
+    /** Overwrite the oldest hop in the frame with a new one and update the running frame
+     * energy, which takes time proportional to the hop size rather than the frame size.
+     * The frame is left as a circular buffer whose oldest sample is at frameStart
+     * @param buffer a pointer to an array containing hopSize audio samples
+     */
+    void addHopToFrame (const double* buffer);
+    
+    /** Rotate the frame so that its oldest sample is first */
+    void lineariseFrame();
+    
+    /** @returns the number of hops between recalculations of the running frame energy */
+    int energyResummationInterval() const;
+    
+    /** @returns the number of hops between setting the sliding DFT from an FFT of the whole frame */
+    int spectrumResyncInterval() const;
+    
+    /** @returns true if the selected detection function is calculated from a spectrum */
+    bool usesSpectrum() const;
+    
+    /** @returns true if the spectrum of each hop is calculated with the sliding DFT */
+    bool slidesSpectrum() const;
+    
+    /** Size the sliding DFT for the frame and set its window to the selected one */
+    void initialiseSlidingDFT();
+    
+    /** @returns true if the bins in the range set by setBinRange() are calculated directly rather than with an FFT */
+    bool prunesTransform() const;
+    
+    /** Precalculate the rotations of the bins in the range for the pruned transform, if it is used */
+    void initialiseBandDFT();
+    
+    /** The number of samples added to the bins of the pruned transform in one pass, beyond which the Goertzel recursion loses accuracy */
+    static const int bandDFTBlockSize = 64;
+    
 	/** Set phase values between [-pi, pi] 
      * @param phaseVal the phase value to process
      * @returns the wrapped phase value
@@ -170,7 +450,7 @@ private:
 	double princarg(double phaseVal);
 	
     void initialiseFFT();
-    void freeFFT();
+    void allocateBlockBuffers();
 	
 	double pi;							/**< pi, the constant */
 	
@@ -178,35 +458,52 @@ private:
 	int hopSize;						/**< audio hopsize */
 	int onsetDetectionFunctionType;		/**< type of detection function */
     int windowType;                     /**< type of window used in calculations */
+    
+    MemoryResource* memory;             /**< where the buffers are allocated from */
 
     //=======================================================================
-#ifdef USE_FFTW
-	fftw_plan p;						/**< fftw plan */
-	fftw_complex* complexIn;			/**< to hold complex fft values for input */
-	fftw_complex* complexOut;			/**< to hold complex fft values for output */
-#endif
-    
-#ifdef USE_KISS_FFT
-    kiss_fft_cfg cfg;                   /**< Kiss FFT configuration */
-    kiss_fft_cpx* fftIn;                /**< FFT input samples, in complex form */
-    kiss_fft_cpx* fftOut;               /**< FFT output samples, in complex form */
-    std::vector<std::vector<double> > complexOut;
-#endif
-	
-    //=======================================================================
-	bool initialised;					/**< flag indicating whether buffers and FFT plans are initialised */
+    std::shared_ptr<FFTBackend> fftBackend; /**< the FFT implementation */
+    std::unique_ptr<RealFFT> fft;       /**< the FFT of a single frame */
+    double (*complexOut)[2];            /**< the current spectrum, pointing into the FFT's spectrum buffer or a block of spectra */
 
-    std::vector<double> frame;          /**< audio frame */
-    std::vector<double> window;         /**< window */
+    ArenaVector<double> frame;          /**< audio frame */
+    int frameStart;                     /**< the index of the oldest sample in the frame, which is only non-zero for the time domain detection functions */
+    double frameEnergy;                 /**< the running sum of the squares of the samples in the frame */
+    double peakFrameEnergy;             /**< the largest running frame energy since the frame was last summed */
+    int hopsUntilEnergyResummation;     /**< the number of hops before the frame energy is summed again, to bound rounding errors */
+    SlidingDFT slidingDFT;              /**< the spectrum of the unwindowed frame, kept up to date hop by hop */
+    bool slidingDFTEnabled;             /**< indicates that the sliding DFT is used rather than an FFT every hop */
+    int hopsUntilSpectrumResync;        /**< the number of hops before the sliding DFT is set from an FFT again, to bound rounding errors */
+    
+    int firstBin;                       /**< the lowest bin included in the spectral detection functions */
+    int lastBin;                        /**< the highest bin included in the spectral detection functions */
+    bool bandLimited;                   /**< indicates that the bins included are fewer than 0 to frameSize/2 */
+    ArenaVector<double> bandBins;       /**< the real then the imaginary parts of the bins in the range, for the pruned transform */
+    ArenaVector<double> bandRotations;  /**< the real and imaginary parts of each bin's rotation per sample, then per block of samples */
+    
+    ArenaVector<double> window;         /**< window */
 	
 	double prevEnergySum;				/**< to hold the previous energy sum value */
+    
+    double silenceThreshold;            /**< mean squared sample value at or below which a hop is silent */
+    double phaseMagnitudeFloor;         /**< fraction of the largest magnitude below which a bin's phase is predicted rather than calculated */
+    int numSilentHops;                  /**< the number of consecutive silent hops */
+    bool silentFrame;                   /**< indicates that the current frame was skipped as silence */
+    bool spectrumIsCurrent;             /**< indicates that complexOut holds the spectrum of the current frame */
+    double energySum;                   /**< the energy of the current frame, for the time domain detection functions */
+	
+    int blockCapacity;                  /**< the number of hops that calculateBlock() transforms together */
+    ArenaVector<double> blockSignal;    /**< the audio for a block of frames, stored contiguously */
+    AlignedBuffer blockIn;              /**< to hold the windowed frames of a block */
+    AlignedBuffer blockOut;             /**< to hold the interleaved spectra of a block of frames */
 	
-    std::vector<double> magSpec;        /**< magnitude spectrum */
-    std::vector<double> prevMagSpec;    /**< previous magnitude spectrum */
+    ArenaVector<double> magSpec;        /**< magnitude spectrum */
+    ArenaVector<double> prevMagSpec;    /**< previous magnitude spectrum */
 	
-    std::vector<double> phase;          /**< FFT phase values */
-    std::vector<double> prevPhase;      /**< previous phase values */
-    std::vector<double> prevPhase2;     /**< second order previous phase values */
+    ArenaVector<double> phase;          /**< FFT phase values */
+    ArenaVector<double> prevPhase;      /**< previous phase values */
+    ArenaVector<double> prevPhase2;     /**< second order previous phase values */
+    ArenaVector<double> phaseDeviations; /**< the phase deviation of bins 0 to frameSize/2, or its cosine, or its complex spectral difference */
 
 };
 
@@ -0,0 +1,139 @@
+//=======================================================================
+/** @file OnsetPicker.cpp
+ *  @brief Picks onsets from an onset detection function as it is calculated
+ *  @author Adam Stark
+ *  @copyright Copyright (C) 2008-2014  Queen Mary University of London
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+//=======================================================================
+
+#include <algorithm>
+#include "OnsetPicker.h"
+
+//=======================================================================
+OnsetPicker::OnsetPicker (MemoryResource* memory_)
+ :  history (memory_),
+    relativeThreshold (1.0),
+    minimumValue (0.0),
+    minimumInterval (3),
+    latestOnsetStrength (0.0)
+{
+    setWindow (2, 8);
+}
+
+//=======================================================================
+void OnsetPicker::setWindow (int lookAhead_, int numPastSamples_)
+{
+    // a peak has to rise from the sample before it
+    lookAhead = std::max (lookAhead_, 0);
+    numPastSamples = std::max (numPastSamples_, 1);
+
+    history.resize (numPastSamples + 1 + lookAhead);
+    reset();
+}
+
+//=======================================================================
+void OnsetPicker::setThreshold (double relativeThreshold_, double minimumValue_)
+{
+    relativeThreshold = relativeThreshold_;
+    minimumValue = minimumValue_;
+}
+
+//=======================================================================
+void OnsetPicker::setMinimumInterval (int numSamples)
+{
+    minimumInterval = std::max (numSamples, 1);
+    samplesSinceOnset = std::min (samplesSinceOnset, minimumInterval);
+}
+
+//=======================================================================
+void OnsetPicker::reset()
+{
+    for (int i = 0; i < history.size(); i++)
+    {
+        history.setSample (i, 0.0);
+    }
+
+    samplesSinceOnset = minimumInterval;
+    latestOnsetStrength = 0.0;
+}
+
+//=======================================================================
+bool OnsetPicker::processSample (double sample)
+{
+    history.addSampleToEnd (sample);
+
+    // stop counting once another onset is allowed so that the count can't overflow
+    samplesSinceOnset = std::min (samplesSinceOnset + 1, minimumInterval);
+
+    const double* x = history.data();
+    double value = x[numPastSamples];
+
+    // the tested sample has to rise from the one before it and not be
+    // exceeded by any of the samples that have come in since
+    if (value <= x[numPastSamples - 1])
+    {
+        return false;
+    }
+
+    for (int i = 1; i <= lookAhead; i++)
+    {
+        if (x[numPastSamples + i] > value)
+        {
+            return false;
+        }
+    }
+
+    // the moving mean threshold, over the samples either side of the peak
+    int numSamples = history.size();
+    double mean = 0;
+
+    for (int i = 0; i < numSamples; i++)
+    {
+        mean += x[i];
+    }
+
+    mean /= numSamples;
+
+    double strength = value - mean;
+
+    if ((strength <= (relativeThreshold * mean)) || (value <= minimumValue) || (samplesSinceOnset < minimumInterval))
+    {
+        return false;
+    }
+
+    samplesSinceOnset = 0;
+    latestOnsetStrength = strength;
+
+    return true;
+}
+
+//=======================================================================
+int OnsetPicker::getLookAhead() const
+{
+    return lookAhead;
+}
+
+//=======================================================================
+double OnsetPicker::getLatestOnsetStrength() const
+{
+    return latestOnsetStrength;
+}
+
+//=======================================================================
+size_t OnsetPicker::memoryFootprint() const
+{
+    return history.memoryFootprint();
+}
@@ -0,0 +1,93 @@
+//=======================================================================
+/** @file OnsetPicker.h
+ *  @brief Picks onsets from an onset detection function as it is calculated
+ *  @author Adam Stark
+ *  @copyright Copyright (C) 2008-2014  Queen Mary University of London
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+//=======================================================================
+
+#ifndef OnsetPicker_h
+#define OnsetPicker_h
+
+#include "CircularBuffer.h"
+
+//=======================================================================
+/** Finds onsets in an onset detection function one sample at a time. As in
+ * BTrack's adaptive threshold, each sample is compared against the mean of the
+ * samples around it, but only a few samples after it are waited for, so an
+ * onset is reported that many samples after it happened. A sample is an onset
+ * when it is a peak, it is far enough above the local mean, and enough samples
+ * have passed since the previous onset.
+ */
+class OnsetPicker
+{
+public:
+
+    /** Constructor
+     * @param memory_ where to allocate the history from, or NULL for the heap. The resource must outlive this instance
+     */
+    OnsetPicker (MemoryResource* memory_ = NULL);
+
+    /** Set the number of samples either side of each sample that the threshold is calculated
+     * from, clearing the history. This allocates memory, so it should not be called on the audio thread
+     * @param lookAhead_ the number of later samples, which is the delay before an onset is reported
+     * @param numPastSamples_ the number of earlier samples
+     */
+    void setWindow (int lookAhead_, int numPastSamples_);
+
+    /** Set how far above the local mean a peak has to be to be an onset
+     * @param relativeThreshold_ the amount above the mean, as a multiple of the mean
+     * @param minimumValue_ the value that an onset has to be above, so that small peaks in silence are ignored
+     */
+    void setThreshold (double relativeThreshold_, double minimumValue_);
+
+    /** Set the smallest number of samples between two onsets
+     * @param numSamples the minimum number of samples between onsets
+     */
+    void setMinimumInterval (int numSamples);
+
+    /** Clear the history, so that the next onset can come straight away */
+    void reset();
+
+    //=======================================================================
+    /** Add a new onset detection function sample
+     * @param sample the onset detection function sample
+     * @returns true if the sample getLookAhead() samples before this one was an onset
+     */
+    bool processSample (double sample);
+
+    /** @returns the delay in samples between an onset and processSample() reporting it */
+    int getLookAhead() const;
+
+    /** @returns the amount by which the most recent onset was above the local mean */
+    double getLatestOnsetStrength() const;
+
+    /** @returns the number of bytes allocated for the history */
+    size_t memoryFootprint() const;
+
+private:
+
+    CircularBuffer<double> history;         /**< the most recent samples, with the sample being tested numPastSamples from the start */
+    int lookAhead;                          /**< the number of samples after the tested one */
+    int numPastSamples;                     /**< the number of samples before the tested one */
+    double relativeThreshold;               /**< how far above the mean an onset has to be, as a multiple of the mean */
+    double minimumValue;                    /**< the value an onset has to be above */
+    int minimumInterval;                    /**< the smallest number of samples between onsets */
+    int samplesSinceOnset;                  /**< the number of samples since the previous onset */
+    double latestOnsetStrength;             /**< the amount the most recent onset was above the local mean */
+};
+
+#endif /* OnsetPicker_h */
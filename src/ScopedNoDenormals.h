@@ -0,0 +1,84 @@
+//=======================================================================
+/** @file ScopedNoDenormals.h
+ *  @brief Turns off denormal (subnormal) floating point arithmetic for a scope
+ *  @author Adam Stark
+ *  @copyright Copyright (C) 2008-2014  Queen Mary University of London
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+//=======================================================================
+
+#ifndef ScopedNoDenormals_h
+#define ScopedNoDenormals_h
+
+#if defined (__SSE__) || defined (_M_X64) || (defined (_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define BTRACK_DENORMALS_MXCSR 1
+#elif defined (__aarch64__) && (defined (__GNUC__) || defined (__clang__))
+#define BTRACK_DENORMALS_FPCR 1
+#endif
+
+//=======================================================================
+/** Flushes denormal results to zero, and treats denormal inputs as zero, from
+ * construction until destruction, after which the previous floating point mode
+ * is restored. Fades to silence leave very small values in the recursive parts
+ * of the onset detection functions, and on many processors arithmetic on
+ * denormals is tens of times slower, so every processing call of BTrack and
+ * OnsetDetectionFunction runs inside one of these.
+ *
+ * On x86 the FTZ and DAZ bits of the MXCSR register are set, and on 64 bit ARM
+ * the FZ bit of the FPCR register. Elsewhere this does nothing.
+ */
+class ScopedNoDenormals
+{
+public:
+
+    /** Constructor, which turns denormals off */
+    ScopedNoDenormals()
+    {
+#if BTRACK_DENORMALS_MXCSR
+        previousMode = _mm_getcsr();
+        _mm_setcsr (previousMode | flushToZero | denormalsAreZero);
+#elif BTRACK_DENORMALS_FPCR
+        __asm__ __volatile__ ("mrs %0, fpcr" : "=r" (previousMode));
+        __asm__ __volatile__ ("msr fpcr, %0" : : "r" (previousMode | flushToZero));
+#endif
+    }
+
+    /** Destructor, which restores the previous floating point mode */
+    ~ScopedNoDenormals()
+    {
+#if BTRACK_DENORMALS_MXCSR
+        _mm_setcsr (previousMode);
+#elif BTRACK_DENORMALS_FPCR
+        __asm__ __volatile__ ("msr fpcr, %0" : : "r" (previousMode));
+#endif
+    }
+
+private:
+
+    ScopedNoDenormals (const ScopedNoDenormals&);
+    ScopedNoDenormals& operator= (const ScopedNoDenormals&);
+
+#if BTRACK_DENORMALS_MXCSR
+    static const unsigned int flushToZero = 0x8000;         /**< the FTZ bit of MXCSR */
+    static const unsigned int denormalsAreZero = 0x0040;    /**< the DAZ bit of MXCSR */
+    unsigned int previousMode;                              /**< the MXCSR value to restore */
+#elif BTRACK_DENORMALS_FPCR
+    static const unsigned long long flushToZero = 1ULL << 24; /**< the FZ bit of FPCR */
+    unsigned long long previousMode;                        /**< the FPCR value to restore */
+#endif
+};
+
+#endif /* ScopedNoDenormals_h */
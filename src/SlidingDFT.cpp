@@ -0,0 +1,181 @@
+//=======================================================================
+/** @file SlidingDFT.cpp
+ *  @brief Updates the spectrum of a frame of audio as samples enter and leave it
+ *  @author Adam Stark
+ *  @copyright Copyright (C) 2008-2014  Queen Mary University of London
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+//=======================================================================
+
+#include <math.h>
+#include <algorithm>
+#include "SlidingDFT.h"
+#include "DSPKernels.h"
+
+//=======================================================================
+SlidingDFT::SlidingDFT (MemoryResource* memory_)
+ :  frameSize (0),
+    blockSize (1),
+    windowConstant (1.0),
+    windowCosine (0.0),
+    real (memory_),
+    imag (memory_),
+    rotationReal (memory_),
+    rotationImag (memory_),
+    blockRotationReal (memory_),
+    blockRotationImag (memory_)
+{
+
+}
+
+//=======================================================================
+void SlidingDFT::setFrameSize (int frameSize_, int hopSize)
+{
+    const double pi = 3.14159265358979323846;
+
+    frameSize = frameSize_;
+    blockSize = std::min (std::max (hopSize, 1), (int) maxBlockSize);
+
+    int numBins = (frameSize / 2) + 1;
+
+    real.assign (numBins, 0.0);
+    imag.assign (numBins, 0.0);
+    rotationReal.resize (numBins);
+    rotationImag.resize (numBins);
+    blockRotationReal.resize (numBins);
+    blockRotationImag.resize (numBins);
+
+    // moving the frame along one sample moves each bin's phase on by 2 pi k / N
+    for (int k = 0; k < numBins; k++)
+    {
+        double angle = (2 * pi * k) / frameSize;
+
+        rotationReal[k] = cos (angle);
+        rotationImag[k] = sin (angle);
+        blockRotationReal[k] = cos (angle * blockSize);
+        blockRotationImag[k] = sin (angle * blockSize);
+    }
+}
+
+//=======================================================================
+void SlidingDFT::setWindow (double a0, double a1)
+{
+    windowConstant = a0;
+    windowCosine = a1;
+}
+
+//=======================================================================
+void SlidingDFT::setSpectrum (const double* spectrum)
+{
+    int numBins = (frameSize / 2) + 1;
+
+    for (int k = 0; k < numBins; k++)
+    {
+        real[k] = spectrum[2 * k];
+        imag[k] = spectrum[2 * k + 1];
+    }
+}
+
+//=======================================================================
+void SlidingDFT::slide (const double* newSamples, const double* oldSamples, int numSamples)
+{
+    double changes[maxBlockSize];
+
+    int numBins = (frameSize / 2) + 1;
+
+    // only the difference between the samples entering and leaving matters. whole blocks use
+    // the precalculated block rotation, and any samples left over are added one at a time
+    while (numSamples > 0)
+    {
+        bool wholeBlock = numSamples >= blockSize;
+        int numChanges = wholeBlock ? blockSize : 1;
+
+        for (int i = 0; i < numChanges; i++)
+        {
+            changes[i] = newSamples[i] - oldSamples[i];
+        }
+
+        const double* rotatedReal = wholeBlock ? &blockRotationReal[0] : &rotationReal[0];
+        const double* rotatedImag = wholeBlock ? &blockRotationImag[0] : &rotationImag[0];
+
+        DSPKernels::slidingDFT (&real[0], &imag[0], &rotationReal[0], &rotationImag[0], rotatedReal, rotatedImag, changes, numChanges, numBins);
+
+        newSamples += numChanges;
+        oldSamples += numChanges;
+        numSamples -= numChanges;
+    }
+}
+
+//=======================================================================
+void SlidingDFT::getWindowedSpectrum (double* spectrum, bool swapHalves) const
+{
+    int numBins = (frameSize / 2) + 1;
+
+    // multiplying by the cosine in time mixes each bin with its neighbours. the bins either
+    // side of 0 and frameSize/2 are the conjugates of the bins just inside them
+    double neighbourWeight = 0.5 * windowCosine;
+
+    for (int k = 0; k < numBins; k++)
+    {
+        int below = (k > 0) ? (k - 1) : 1;
+        int above = (k + 1 < numBins) ? (k + 1) : (frameSize - (k + 1));
+        double belowImag = (k == 0) ? -imag[below] : imag[below];
+        double aboveImag = (k + 1 < numBins) ? imag[above] : -imag[above];
+
+        double re = (windowConstant * real[k]) - (neighbourWeight * (real[below] + real[above]));
+        double im = (windowConstant * imag[k]) - (neighbourWeight * (belowImag + aboveImag));
+
+        // swapping the two halves of the frame delays it by N/2 samples, negating the odd bins
+        if (swapHalves && ((k % 2) == 1))
+        {
+            re = -re;
+            im = -im;
+        }
+
+        spectrum[2 * k] = re;
+        spectrum[2 * k + 1] = im;
+    }
+}
+
+//=======================================================================
+int SlidingDFT::getFrameSize() const
+{
+    return frameSize;
+}
+
+//=======================================================================
+size_t SlidingDFT::memoryFootprint() const
+{
+    size_t numValues = real.capacity() + imag.capacity() + rotationReal.capacity() + rotationImag.capacity()
+                     + blockRotationReal.capacity() + blockRotationImag.capacity();
+
+    return numValues * sizeof (double);
+}
+
+//=======================================================================
+void SlidingDFT::swap (SlidingDFT& other)
+{
+    std::swap (frameSize, other.frameSize);
+    std::swap (blockSize, other.blockSize);
+    std::swap (windowConstant, other.windowConstant);
+    std::swap (windowCosine, other.windowCosine);
+
+    real.swap (other.real);
+    imag.swap (other.imag);
+    rotationReal.swap (other.rotationReal);
+    rotationImag.swap (other.rotationImag);
+    blockRotationReal.swap (other.blockRotationReal);
+    blockRotationImag.swap (other.blockRotationImag);
+}
@@ -0,0 +1,114 @@
+//=======================================================================
+/** @file SlidingDFT.h
+ *  @brief Updates the spectrum of a frame of audio as samples enter and leave it
+ *  @author Adam Stark
+ *  @copyright Copyright (C) 2008-2014  Queen Mary University of London
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+//=======================================================================
+
+#ifndef SlidingDFT_h
+#define SlidingDFT_h
+
+#include "MemoryArena.h"
+
+//=======================================================================
+/** Keeps the DFT of the most recent frame of audio up to date as samples enter and
+ * leave it, rather than recalculating the whole transform. For each hop, every bin is
+ * rotated once and the changes in the samples are added to it with a Goertzel
+ * recursion, so a hop takes time proportional to the hop size times the frame size.
+ * With hop sizes of a few tens of samples this is cheaper than an FFT per hop.
+ *
+ * The DFT held is that of the unwindowed frame. Windows that are a constant minus
+ * one cosine (rectangular, Hann and Hamming) are applied afterwards in the frequency
+ * domain, where each is a three tap filter across the bins.
+ *
+ * Rounding errors build up in the bins, which are rotated every hop and never
+ * recalculated, so the DFT should be set again from a full transform of the frame
+ * every so often (see setSpectrum()).
+ */
+class SlidingDFT
+{
+public:
+
+    /** Constructor
+     * @param memory_ where to allocate the bins from, or NULL for the heap. The resource must outlive this instance
+     */
+    SlidingDFT (MemoryResource* memory_ = NULL);
+
+    /** Set the frame size, clearing the DFT. This allocates memory, so it should not be called on the audio thread
+     * @param frameSize_ the number of samples in the frame, which should be even
+     * @param hopSize the number of samples that the frame is usually moved along by, which the
+     * rotations are precalculated for
+     */
+    void setFrameSize (int frameSize_, int hopSize);
+
+    /** Set the window applied by getWindowedSpectrum(), which is a0 - a1 cos (2 pi n / N) for sample n
+     * of a frame of N samples, e.g. 0.5 and 0.5 for a Hann window or 1 and 0 for no window
+     * @param a0 the constant part of the window
+     * @param a1 the size of the cosine part of the window
+     */
+    void setWindow (double a0, double a1);
+
+    /** Set the DFT to that of a frame
+     * @param spectrum the interleaved real and imaginary parts of the first (frameSize/2)+1 bins of
+     * the unnormalised FFT of the unwindowed frame, oldest sample first
+     */
+    void setSpectrum (const double* spectrum);
+
+    /** Move the frame along by some samples
+     * @param newSamples the samples entering the frame, oldest first
+     * @param oldSamples the samples leaving the frame, which are the oldest numSamples samples in it
+     * @param numSamples the number of samples to move along by
+     */
+    void slide (const double* newSamples, const double* oldSamples, int numSamples);
+
+    /** Calculate the spectrum of the windowed frame
+     * @param spectrum an array to hold the interleaved real and imaginary parts of the first (frameSize/2)+1 bins
+     * @param swapHalves if true, give the spectrum of the frame with its two halves swapped, as the FFT of
+     * OnsetDetectionFunction is calculated
+     */
+    void getWindowedSpectrum (double* spectrum, bool swapHalves) const;
+
+    /** @returns the frame size */
+    int getFrameSize() const;
+
+    /** @returns the number of bytes allocated for the bins and rotations */
+    size_t memoryFootprint() const;
+
+    /** Exchanges the complete state of this instance with another, without allocating memory
+     * @param other the instance to swap with
+     */
+    void swap (SlidingDFT& other);
+
+private:
+
+    /** The largest number of samples added to the bins in one pass, beyond which the Goertzel recursion loses accuracy */
+    static const int maxBlockSize = 64;
+
+    int frameSize;                          /**< the number of samples in the frame */
+    int blockSize;                          /**< the number of samples added to the bins in one pass */
+    double windowConstant;                  /**< the constant part of the window */
+    double windowCosine;                    /**< the size of the cosine part of the window */
+
+    ArenaVector<double> real;               /**< the real part of bins 0 to frameSize/2 of the unwindowed frame */
+    ArenaVector<double> imag;               /**< the imaginary part of bins 0 to frameSize/2 of the unwindowed frame */
+    ArenaVector<double> rotationReal;       /**< the real part of the rotation that each bin goes through per sample */
+    ArenaVector<double> rotationImag;       /**< the imaginary part of the rotation that each bin goes through per sample */
+    ArenaVector<double> blockRotationReal;  /**< the real part of the rotation that each bin goes through per block */
+    ArenaVector<double> blockRotationImag;  /**< the imaginary part of the rotation that each bin goes through per block */
+};
+
+#endif /* SlidingDFT_h */
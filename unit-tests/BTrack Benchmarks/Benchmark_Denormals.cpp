@@ -0,0 +1,84 @@
+//======================================================================
+/** Measures how long BTrack takes per hop through a fade to silence,
+ * relative to loud audio. Timings depend on the machine and on what else
+ * it is doing, so this reports the ratio rather than checking it. A ratio
+ * close to 1 means that denormals aren't slowing the fade down.
+ */
+//======================================================================
+
+// build it from the repository root alongside the sources, e.g.
+//
+//  gcc -O2 -c libs/kiss_fft130/kiss_fft.c
+//  g++ -O2 -DUSE_KISS_FFT -Isrc -Ilibs/kiss_fft130 src/*.cpp kiss_fft.o
+//      "unit-tests/BTrack Benchmarks/Benchmark_Denormals.cpp" -lsamplerate -o benchmark_denormals
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include "../../src/BTrack.h"
+
+//======================================================================
+/** @returns the median of some hop times */
+static double medianTime(std::vector<double> times)
+{
+    std::nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+    return times[times.size() / 2];
+}
+
+//======================================================================
+int main()
+{
+    BTrack b(512, 1024);
+
+    std::vector<double> frame(512);
+    std::vector<double> loudTimes, quietTimes;
+    double worstRatio = 0;
+
+    // a slow exponential fade from full scale to below the smallest denormal, then digital silence
+    int numLoudHops = 300;
+    int numFadeHops = 2000;
+    int numSilentHops = 500;
+    double gain = 1.0;
+    double fadePerSample = exp(log(1e-320) / (numFadeHops * 512.0));
+
+    for (int n = 0;n < numLoudHops + numFadeHops + numSilentHops;n++)
+    {
+        for (int i = 0;i < 512;i++)
+        {
+            if (n >= numLoudHops)
+            {
+                gain = (n < numLoudHops + numFadeHops) ? gain * fadePerSample : 0.0;
+            }
+
+            frame[i] = gain * (((random() % 2000) / 1000.0) - 1.0);
+        }
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        b.processAudioFrame(&frame[0]);
+        double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        if (n >= 50 && n < numLoudHops)
+        {
+            loudTimes.push_back(time);
+        }
+        else if (n >= numLoudHops)
+        {
+            quietTimes.push_back(time);
+
+            // compare each stretch of 100 hops with the loud audio
+            if (quietTimes.size() == 100)
+            {
+                worstRatio = std::max(worstRatio, medianTime(quietTimes) / medianTime(loudTimes));
+                quietTimes.clear();
+            }
+        }
+    }
+
+    printf("median hop time with loud audio: %.2f us\n", medianTime(loudTimes) * 1e6);
+    printf("slowest quiet stretch relative to loud audio: %.2f\n", worstRatio);
+
+    return 0;
+}
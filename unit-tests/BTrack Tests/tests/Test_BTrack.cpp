@@ -5,7 +5,18 @@
 #include <boost/test/unit_test.hpp>
 
 #include <iostream>
+#include <algorithm>
+#include <cfloat>
 #include "../../../src/BTrack.h"
+#include "../../../src/DSPKernels.h"
+#include "../../../src/BuiltinFFT.h"
+#include "../../../src/FFT.h"
+#include "../../../src/FixedPointBTrack.h"
+#include "../../../src/BTrackStatic.h"
+#include "../../../src/ScopedNoDenormals.h"
+#include "../../../src/OfflineBeatTracker.h"
+#include "../../../src/BeatSynchronousFeatures.h"
+#include "../../../src/OnsetPicker.h"
 
 //======================================================================
 //==================== CHECKING INITIALISATION =========================
@@ -251,4 +262,2314 @@ BOOST_AUTO_TEST_SUITE_END()
 
 
 
+//======================================================================
+//======================= CIRCULAR BUFFER ==============================
+//======================================================================
+BOOST_AUTO_TEST_SUITE(circularBuffer)
+
+//======================================================================
+BOOST_AUTO_TEST_CASE(samplesAreOrderedOldestFirst)
+{
+    CircularBuffer<double> buffer;
+    
+    buffer.resize(10);
+    
+    for (int i = 0;i < 25;i++)
+    {
+        buffer.addSampleToEnd(i);
+    }
+    
+    BOOST_CHECK_EQUAL(buffer.size(), 10);
+    
+    for (int i = 0;i < 10;i++)
+    {
+        BOOST_CHECK_EQUAL(buffer[i], 15 + i);
+    }
+}
+
+//======================================================================
+BOOST_AUTO_TEST_CASE(dataIsContiguousAfterWrapping)
+{
+    CircularBuffer<double> buffer;
+    
+    buffer.resize(6);
+    
+    for (int n = 0;n < 20;n++)
+    {
+        buffer.addSampleToEnd(n);
+        
+        const double* history = buffer.data();
+        
+        for (int i = 0;i < 6;i++)
+        {
+            BOOST_CHECK_EQUAL(history[i], buffer[i]);
+        }
+        
+        BOOST_CHECK_EQUAL(history[5], n);
+    }
+}
+
+//======================================================================
+BOOST_AUTO_TEST_CASE(setSampleIsVisibleInBothCopies)
+{
+    CircularBuffer<double> buffer;
+    
+    buffer.resize(8);
+    
+    buffer.setSample(7, 3.0);
+    
+    for (int i = 0;i < 7;i++)
+    {
+        buffer.addSampleToEnd(0.0);
+        
+        BOOST_CHECK_EQUAL(buffer[6 - i], 3.0);
+        BOOST_CHECK_EQUAL(buffer.data()[6 - i], 3.0);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+//======================================================================
+//======================================================================
+
+
+
+
+//======================================================================
+//================ CHANGING HOP SIZE WHILST TRACKING ===================
+//======================================================================
+BOOST_AUTO_TEST_SUITE(changingHopSize)
+
+//======================================================================
+BOOST_AUTO_TEST_CASE(trackingContinuesAcrossHopSizeChange)
+{
+    BTrack b(512);
+    
+    int beatPeriod = 43;
+    
+    for (int i = 0;i < 5000;i++)
+    {
+        b.processOnsetDetectionFunctionSample((i % beatPeriod == 0) ? 1000 : 0.0);
+    }
+    
+    BOOST_CHECK(b.prepareHopAndFrameSize(256, 512));
+    
+    // the change is only applied once processing resumes
+    BOOST_CHECK_EQUAL(b.getHopSize(), 512);
+    
+    // halving the hop size doubles the beat period in detection function samples
+    beatPeriod = 86;
+    
+    int numBeats = 0;
+    int correct = 0;
+    int maxInterval = 0;
+    int currentInterval = 0;
+    
+    for (int i = 0;i < 10000;i++)
+    {
+        b.processOnsetDetectionFunctionSample((i % beatPeriod == 0) ? 1000 : 0.0);
+        
+        currentInterval++;
+        
+        if (b.beatDueInCurrentFrame())
+        {
+            numBeats++;
+            
+            // skip the partial interval before the first beat
+            if (numBeats > 1)
+            {
+                maxInterval = std::max(maxInterval, currentInterval);
+                
+                if (currentInterval == beatPeriod)
+                {
+                    correct++;
+                }
+            }
+            
+            currentInterval = 0;
+        }
+    }
+    
+    BOOST_CHECK_EQUAL(b.getHopSize(), 256);
+    
+    // compare against the tempo of the input, allowing for the 2 BPM spacing of the tempo estimates
+    double tempo = 60.0 / ((256.0 / 44100.0) * beatPeriod);
+    
+    BOOST_CHECK_CLOSE(b.getCurrentTempoEstimate(), tempo, 2.5);
+    
+    // check that there is no long gap in the beats while the tracker adjusts
+    BOOST_CHECK(maxInterval < (beatPeriod * 5) / 4);
+    
+    // check that the number of correct beats is larger than 95%
+    // of the total number of beats
+    BOOST_CHECK(((double)correct) > (((double)(numBeats - 1))*0.95));
+}
+
+//======================================================================
+/** An FFT that counts its forward transforms */
+class TransformCountingFFT : public RealFFT
+{
+public:
+    TransformCountingFFT(int size_, int& count_) : RealFFT(size_), count(count_)
+    {
+        fft.initialise(size_);
+    }
+    
+    void performForwardTransform()
+    {
+        fft.performRealFFT(getTimeDomainBuffer(), getSpectrumBuffer());
+        count++;
+    }
+    
+    void performInverseTransform()
+    {
+        fft.performInverseRealFFT(getSpectrumBuffer(), getTimeDomainBuffer());
+    }
+    
+    BuiltinFFT fft;
+    int& count;
+};
+
+//======================================================================
+/** A backend that counts the forward transforms of the FFTs of one size */
+class TransformCountingBackend : public FFTBackend
+{
+public:
+    TransformCountingBackend(int countedSize_) : countedSize(countedSize_), numTransforms(0), numOtherTransforms(0) {}
+    
+    const char* getName() const
+    {
+        return "transform counting";
+    }
+    
+    std::unique_ptr<RealFFT> createFFT(int size)
+    {
+        return std::unique_ptr<RealFFT>(new TransformCountingFFT(size, (size == countedSize) ? numTransforms : numOtherTransforms));
+    }
+    
+    int countedSize;
+    int numTransforms;
+    int numOtherTransforms;
+};
+
+//======================================================================
+BOOST_AUTO_TEST_CASE(silenceGatingContinuesAcrossHopSizeChange)
+{
+    BTrack b(512);
+    
+    // the detection function's FFTs are of the frame size, the tempo estimate's are larger
+    std::shared_ptr<TransformCountingBackend> backend = std::make_shared<TransformCountingBackend>(512);
+    b.setFFTBackend(backend);
+    b.setSilenceThreshold(1e-10);
+    
+    BOOST_CHECK(b.prepareHopAndFrameSize(256, 512));
+    
+    std::vector<double> frame(256, 0.0);
+    
+    for (int i = 0;i < 200;i++)
+    {
+        b.processAudioFrame(&frame[0]);
+    }
+    
+    BOOST_CHECK_EQUAL(b.getHopSize(), 256);
+    
+    // only the hops before the whole frame is known to be silent are transformed
+    BOOST_CHECK(backend->numTransforms <= 3);
+    
+    // and audio above the threshold is transformed again
+    int numSilentTransforms = backend->numTransforms;
+    
+    for (int i = 0;i < 256;i++)
+    {
+        frame[i] = ((random() % 2000) / 1000.0) - 1.0;
+    }
+    
+    b.processAudioFrame(&frame[0]);
+    
+    BOOST_CHECK_EQUAL(backend->numTransforms, numSilentTransforms + 1);
+}
+
+//======================================================================
+BOOST_AUTO_TEST_CASE(qualityLevelContinuesAcrossHopSizeChange)
+{
+    BTrack b(512);
+    
+    std::shared_ptr<TransformCountingBackend> backend = std::make_shared<TransformCountingBackend>(512);
+    b.setFFTBackend(backend);
+    
+    // the quality level changes after the change is prepared but before it is applied
+    BOOST_CHECK(b.prepareHopAndFrameSize(256, 512));
+    b.setQualityLevel(EnergyDifferenceQuality);
+    
+    std::vector<double> frame(256, 0.0);
+    
+    for (int i = 0;i < 200;i++)
+    {
+        for (int j = 0;j < 256;j++)
+        {
+            frame[j] = ((random() % 2000) / 1000.0) - 1.0;
+        }
+        
+        b.processAudioFrame(&frame[0]);
+    }
+    
+    BOOST_CHECK_EQUAL(b.getHopSize(), 256);
+    
+    // the energy difference needs no FFT
+    BOOST_CHECK_EQUAL(backend->numTransforms, 0);
+    
+    // and the configured detection function returns at full quality
+    b.setQualityLevel(FullQuality);
+    b.processAudioFrame(&frame[0]);
+    
+    BOOST_CHECK_EQUAL(backend->numTransforms, 1);
+}
+
+//======================================================================
+BOOST_AUTO_TEST_CASE(advancingFramesSpansTheBufferAtTheNewHopSize)
+{
+    BTrack b(512);
+    BTrack reference(128, 256);
+    
+    BOOST_CHECK(b.prepareHopAndFrameSize(128, 256));
+    b.processOnsetDetectionFunctionSample(1.0);
+    
+    BOOST_CHECK_EQUAL(b.getHopSize(), 128);
+    
+    // a skip longer than the buffer at either hop size rewrites the whole cumulative score
+    int numBeats = b.advanceFrames(10000, 1.0);
+    reference.advanceFrames(10000, 1.0);
+    
+    BOOST_CHECK(numBeats > 50);
+    BOOST_CHECK_CLOSE(b.getLatestCumulativeScoreValue(), reference.getLatestCumulativeScoreValue(), 1e-6);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+//======================================================================
+//======================================================================
+
+
+
+
+//======================================================================
+//===================== SILENCE AND SKIPPED FRAMES =====================
+//======================================================================
+BOOST_AUTO_TEST_SUITE(silenceAndSkippedFrames)
+
+//======================================================================
+BOOST_AUTO_TEST_CASE(advancingFramesContinuesBeatsAtCurrentPeriod)
+{
+    BTrack b(512);
+    
+    int beatPeriod = 43;
+    
+    for (int i = 0;i < 5000;i++)
+    {
+        b.processOnsetDetectionFunctionSample((i % beatPeriod == 0) ? 1000 : 0.0);
+    }
+    
+    int numBeats = b.advanceFrames(beatPeriod * 20);
+    
+    // beats carry on through the gap at the tracked tempo
+    BOOST_CHECK(numBeats >= 19 && numBeats <= 21);
+    
+    // and tracking resumes afterwards without long gaps
+    int maxInterval = 0;
+    int currentInterval = 0;
+    
+    for (int i = 0;i < 5000;i++)
+    {
+        b.processOnsetDetectionFunctionSample((i % beatPeriod == 0) ? 1000 : 0.0);
+        
+        currentInterval++;
+        
+        if (b.beatDueInCurrentFrame())
+        {
+            maxInterval = std::max(maxInterval, currentInterval);
+            currentInterval = 0;
+        }
+    }
+    
+    BOOST_CHECK(maxInterval < 100);
+}
+
+//======================================================================
+BOOST_AUTO_TEST_CASE(advancingOneFrameAtATimeMatchesOneLargeAdvance)
+{
+    BTrack a(512);
+    BTrack b(512);
+    
+    for (int i = 0;i < 3000;i++)
+    {
+        double sample = (i % 40 == 0) ? 1000 : 0.0;
+        a.processOnsetDetectionFunctionSample(sample);
+        b.processOnsetDetectionFunctionSample(sample);
+    }
+    
+    int numBeats = 0;
+    
+    for (int i = 0;i < 1000;i++)
+    {
+        numBeats += a.advanceFrames(1);
+    }
+    
+    BOOST_CHECK_EQUAL(numBeats, b.advanceFrames(1000));
+    BOOST_CHECK_EQUAL(a.beatDueInCurrentFrame(), b.beatDueInCurrentFrame());
+    BOOST_CHECK_CLOSE(a.getLatestCumulativeScoreValue(), b.getLatestCumulativeScoreValue(), 1e-6);
+}
+
+//======================================================================
+BOOST_AUTO_TEST_CASE(silentAudioStillProducesBeats)
+{
+    BTrack b(512);
+    
+    b.setSilenceThreshold(1e-10);
+    
+    std::vector<double> frame(512, 0.0);
+    
+    int numBeats = 0;
+    
+    for (int i = 0;i < 2000;i++)
+    {
+        b.processAudioFrame(&frame[0]);
+        
+        if (b.beatDueInCurrentFrame())
+        {
+            numBeats++;
+        }
+    }
+    
+    BOOST_CHECK(numBeats > (2000/100));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+//======================================================================
+//======================================================================
+
+
+
+
+//======================================================================
+//=========================== LOCKED TEMPO =============================
+//======================================================================
+BOOST_AUTO_TEST_SUITE(lockedTempo)
+
+//======================================================================
+BOOST_AUTO_TEST_CASE(lockedTempoIsNotReestimated)
+{
+    BTrack b(512);
+    
+    // a beat period of 43 detection function samples
+    double tempo = 60.0 / ((512.0 / 44100.0) * 43);
+    
+    b.lockTempo(tempo);
+    
+    BOOST_CHECK_CLOSE(b.getCurrentTempoEstimate(), tempo, 1e-6);
+    
+    long numSamples = 20000;
+    
+    // onsets at a different tempo don't change the tempo
+    for (int i = 0;i < numSamples;i++)
+    {
+        b.processOnsetDetectionFunctionSample((i % 35 == 0) ? 1000 : 0.0);
+    }
+    
+    BOOST_CHECK_CLOSE(b.getCurrentTempoEstimate(), tempo, 1e-6);
+    
+    // but the beat phase is still tracked
+    int numBeats = 0;
+    int correct = 0;
+    int currentInterval = 0;
+    
+    for (int i = 0;i < numSamples;i++)
+    {
+        b.processOnsetDetectionFunctionSample((i % 43 == 0) ? 1000 : 0.0);
+        
+        currentInterval++;
+        
+        if (b.beatDueInCurrentFrame())
+        {
+            numBeats++;
+            
+            if (currentInterval == 43)
+            {
+                correct++;
+            }
+            
+            currentInterval = 0;
+        }
+    }
+    
+    BOOST_CHECK(((double)correct) > (((double)numBeats)*0.99));
+    
+    // once unlocked the tempo follows the input again
+    b.unlockTempo();
+    
+    for (int i = 0;i < numSamples;i++)
+    {
+        b.processOnsetDetectionFunctionSample((i % 35 == 0) ? 1000 : 0.0);
+    }
+    
+    BOOST_CHECK(b.getCurrentTempoEstimate() > tempo * 1.1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+//======================================================================
+//======================================================================
+
+
+
+
+//======================================================================
+//========================= TEMPO ONLY MODE ============================
+//======================================================================
+BOOST_AUTO_TEST_SUITE(tempoOnlyMode)
+
+//======================================================================
+BOOST_AUTO_TEST_CASE(tempoIsEstimatedWithoutBeats)
+{
+    BTrack beatTracker(512);
+    BTrack tempoTracker(512);
+    
+    tempoTracker.enableTempoOnlyMode(64);
+    
+    int numBeats = 0;
+    
+    for (int i = 0;i < 20000;i++)
+    {
+        double sample = (i % 50 == 0) ? 1000 : 0.0;
+        
+        beatTracker.processOnsetDetectionFunctionSample(sample);
+        tempoTracker.processOnsetDetectionFunctionSample(sample);
+        
+        if (tempoTracker.beatDueInCurrentFrame())
+        {
+            numBeats++;
+        }
+    }
+    
+    BOOST_CHECK_EQUAL(numBeats, 0);
+    BOOST_CHECK_CLOSE(tempoTracker.getCurrentTempoEstimate(), beatTracker.getCurrentTempoEstimate(), 1.0);
+}
+
+//======================================================================
+BOOST_AUTO_TEST_CASE(tempoIsUpdatedOnTheFixedClock)
+{
+    BTrack b(512);
+    
+    b.enableTempoOnlyMode(10);
+    
+    for (int i = 0;i < 2000;i++)
+    {
+        b.processOnsetDetectionFunctionSample((i % 50 == 0) ? 1000 : 0.0);
+    }
+    
+    double tempo = b.getCurrentTempoEstimate();
+    
+    // after a sudden tempo change, the estimate moves within a few updates
+    // even though no beats are being predicted
+    for (int i = 0;i < 1000;i++)
+    {
+        b.processOnsetDetectionFunctionSample((i % 36 == 0) ? 1000 : 0.0);
+    }
+    
+    BOOST_CHECK(b.getCurrentTempoEstimate() > tempo * 1.2);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+//======================================================================
+//======================================================================
+
+
+
+
+//======================================================================
+//========================= PROCESSING BUDGET ==========================
+//======================================================================
+BOOST_AUTO_TEST_SUITE(processingBudget)
+
+//======================================================================
+BOOST_AUTO_TEST_CASE(governorReducesQualityWhenOverBudget)
+{
+    CPUBudgetGovernor governor(NumQualityLevels);
+    
+    governor.setBudget(0.001);
+    
+    for (int i = 0;i < 1000;i++)
+    {
+        governor.addMeasurement(0.01);
+    }
+    
+    BOOST_CHECK_EQUAL(governor.getLevel(), NumQualityLevels - 1);
+    
+    // close to the budget, the level is held rather than oscillating
+    int changes = 0;
+    
+    for (int i = 0;i < 5000;i++)
+    {
+        if (governor.addMeasurement(0.0008))
+        {
+            changes++;
+        }
+    }
+    
+    BOOST_CHECK_EQUAL(changes, 0);
+    
+    // well under budget, the quality is increased again
+    for (int i = 0;i < 5000;i++)
+    {
+        governor.addMeasurement(0.0001);
+    }
+    
+    BOOST_CHECK_EQUAL(governor.getLevel(), 0);
+}
+
+//======================================================================
+BOOST_AUTO_TEST_CASE(governorStopsAtTheFirstLevelWithinBudget)
+{
+    // only the highest quality level is over budget
+    CPUBudgetGovernor governor(4);
+    double costs[4] = {1.5, 0.9, 0.5, 0.3};
+    
+    governor.setBudget(1.0);
+    
+    int lowestQuality = 0;
+    
+    for (int i = 0;i < 2000;i++)
+    {
+        governor.addMeasurement(costs[governor.getLevel()]);
+        lowestQuality = std::max(lowestQuality, governor.getLevel());
+    }
+    
+    BOOST_CHECK_EQUAL(governor.getLevel(), 1);
+    BOOST_CHECK_EQUAL(lowestQuality, 1);
+}
+
+//======================================================================
+BOOST_AUTO_TEST_CASE(allQualityLevelsTrackBeats)
+{
+    for (int level = 0;level < NumQualityLevels;level++)
+    {
+        BTrack b(512);
+        
+        b.setQualityLevel(level);
+        BOOST_CHECK_EQUAL(b.getQualityLevel(), level);
+        
+        std::vector<double> frame(512);
+        int numBeats = 0;
+        long t = 0;
+        
+        for (int i = 0;i < 2000;i++)
+        {
+            // a click every 22050 samples (120 bpm)
+            for (int n = 0;n < 512;n++, t++)
+            {
+                frame[n] = ((t % 22050) < 64) ? 1.0 : 0.0;
+            }
+            
+            b.processAudioFrame(&frame[0]);
+            
+            if (b.beatDueInCurrentFrame())
+            {
+                numBeats++;
+            }
+        }
+        
+        BOOST_CHECK(numBeats > (2000/100));
+        BOOST_CHECK_CLOSE(b.getCurrentTempoEstimate(), 120.0, 5.0);
+    }
+}
+
+//======================================================================
+BOOST_AUTO_TEST_CASE(everyFrameInputIsMeasured)
+{
+    // no frame can be processed within the budget, so each input steps down to the lowest quality
+    BTrack spectrumInput(512);
+    BTrack polarSpectrumInput(512);
+    BTrack framedInput(512);
+    
+    spectrumInput.setProcessingBudget(1e-12);
+    polarSpectrumInput.setProcessingBudget(1e-12);
+    framedInput.setProcessingBudget(1e-12);
+    
+    std::vector<double> real(513, 1.0), imag(513, 0.0);
+    std::vector<double> frame(1024, 0.0);
+    
+    for (int i = 0;i < 2000;i++)
+    {
+        spectrumInput.processSpectrumFrame(&real[0], &imag[0]);
+        polarSpectrumInput.processPolarSpectrumFrame(&real[0], &imag[0]);
+        framedInput.processOverlappingFrame(&frame[0]);
+    }
+    
+    BOOST_CHECK_EQUAL(spectrumInput.getQualityLevel(), NumQualityLevels - 1);
+    BOOST_CHECK_EQUAL(polarSpectrumInput.getQualityLevel(), NumQualityLevels - 1);
+    BOOST_CHECK_EQUAL(framedInput.getQualityLevel(), NumQualityLevels - 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+//======================================================================
+//======================================================================
+
+
+
+
+//======================================================================
+//========================== SPECTRUM INPUT ============================
+//======================================================================
+BOOST_AUTO_TEST_SUITE(spectrumInput)
+
+//======================================================================
+BOOST_AUTO_TEST_CASE(suppliedSpectrumMatchesInternalFFT)
+{
+    int hopSize = 64;
+    int frameSize = 128;
+    double pi = 3.14159265358979;
+    
+    int types[3] = {SpectralDifferenceHWR, ComplexSpectralDifferenceHWR, EnergyEnvelope};
+    
+    for (int t = 0;t < 3;t++)
+    {
+        OnsetDetectionFunction timeDomain(hopSize, frameSize, types[t], HanningWindow);
+        OnsetDetectionFunction frequencyDomain(hopSize, frameSize, types[t], HanningWindow);
+        
+        std::vector<double> frame(frameSize, 0.0);
+        std::vector<double> hop(hopSize);
+        std::vector<double> real(frameSize/2 + 1);
+        std::vector<double> imag(frameSize/2 + 1);
+        
+        for (int n = 0;n < 20;n++)
+        {
+            for (int i = 0;i < hopSize;i++)
+            {
+                hop[i] = ((random() % 2000) / 1000.0) - 1.0;
+            }
+            
+            // keep our own copy of the frame
+            for (int i = 0;i < frameSize - hopSize;i++)
+            {
+                frame[i] = frame[i + hopSize];
+            }
+            
+            for (int i = 0;i < hopSize;i++)
+            {
+                frame[frameSize - hopSize + i] = hop[i];
+            }
+            
+            // take the DFT of the windowed frame, with the two halves swapped as the
+            // onset detection function does
+            for (int k = 0;k <= frameSize/2;k++)
+            {
+                real[k] = 0;
+                imag[k] = 0;
+                
+                for (int i = 0;i < frameSize;i++)
+                {
+                    int j = (i + frameSize/2) % frameSize;
+                    double x = frame[j] * 0.5 * (1 - cos(2 * pi * (j / (double)(frameSize - 1))));
+                    
+                    real[k] += x * cos(2 * pi * k * i / frameSize);
+                    imag[k] -= x * sin(2 * pi * k * i / frameSize);
+                }
+            }
+            
+            double expected = timeDomain.calculateOnsetDetectionFunctionSample(&hop[0]);
+            double actual = frequencyDomain.calculateOnsetDetectionFunctionSampleFromSpectrum(&real[0], &imag[0]);
+            
+            if (types[t] == EnergyEnvelope)
+            {
+                // the energy of the windowed frame is always less than that of the frame
+                BOOST_CHECK(actual <= expected + 1e-9);
+            }
+            else
+            {
+                BOOST_CHECK_CLOSE(actual, expected, 1e-4);
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+//======================================================================
+//======================================================================
+
+
+
+
+//======================================================================
+//========================= PRE-FRAMED INPUT ===========================
+//======================================================================
+BOOST_AUTO_TEST_SUITE(preFramedInput)
+
+//======================================================================
+BOOST_AUTO_TEST_CASE(framedInputMatchesHopInput)
+{
+    int hopSize = 256;
+    int frameSize = 1024;
+    
+    OnsetDetectionFunction hopInput(hopSize, frameSize, ComplexSpectralDifferenceHWR, HanningWindow);
+    OnsetDetectionFunction frameInput(hopSize, frameSize, ComplexSpectralDifferenceHWR, HanningWindow);
+    
+    std::vector<double> signal(frameSize + hopSize * 40, 0.0);
+    
+    for (size_t i = frameSize;i < signal.size();i++)
+    {
+        signal[i] = ((random() % 2000) / 1000.0) - 1.0;
+    }
+    
+    // the signal starts with a frame of silence, matching the initial state of the hop input
+    for (int n = 1;n <= 40;n++)
+    {
+        // the hop input sees the newest hop, the frame input sees the whole frame ending there
+        double expected = hopInput.calculateOnsetDetectionFunctionSample(&signal[frameSize + (n-1)*hopSize]);
+        
+        std::vector<float> frame(signal.begin() + n*hopSize, signal.begin() + n*hopSize + frameSize);
+        double actual = frameInput.calculateFromFrame(&frame[0]);
+        
+        // single precision input, so allow for rounding
+        BOOST_CHECK_CLOSE(actual, expected, 1e-3);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+//======================================================================
+//======================================================================
+
+
+//======================================================================
+//=========================== BLOCK PROCESSING =========================
+//======================================================================
+BOOST_AUTO_TEST_SUITE(blockProcessing)
+
+//======================================================================
+BOOST_AUTO_TEST_CASE(blockOutputMatchesHopByHopOutput)
+{
+    int hopSize = 256;
+    int frameSize = 1024;
+    int numHops = 37;
+    int types[] = {ComplexSpectralDifferenceHWR, EnergyDifference};
+    
+    std::vector<double> signal(hopSize * (numHops + 10));
+    
+    for (size_t i = 0;i < signal.size();i++)
+    {
+        signal[i] = ((random() % 2000) / 1000.0) - 1.0;
+    }
+    
+    for (int t = 0;t < 2;t++)
+    {
+        OnsetDetectionFunction hopByHop(hopSize, frameSize, types[t], HanningWindow);
+        OnsetDetectionFunction block(hopSize, frameSize, types[t], HanningWindow);
+        
+        // a block length that doesn't divide the number of hops, so a partial block is processed
+        block.prepareBlockProcessing(8);
+        
+        std::vector<double> blockOutput(numHops);
+        block.calculateBlock(&signal[0], numHops, &blockOutput[0]);
+        
+        for (int n = 0;n < numHops;n++)
+        {
+            double expected = hopByHop.calculateOnsetDetectionFunctionSample(&signal[n*hopSize]);
+            BOOST_CHECK_CLOSE(blockOutput[n], expected, 1e-6);
+        }
+        
+        // hop by hop processing carries on from the end of the block
+        for (int n = numHops;n < numHops + 10;n++)
+        {
+            double expected = hopByHop.calculateOnsetDetectionFunctionSample(&signal[n*hopSize]);
+            BOOST_CHECK_CLOSE(block.calculateOnsetDetectionFunctionSample(&signal[n*hopSize]), expected, 1e-6);
+        }
+    }
+}
+
+//======================================================================
+BOOST_AUTO_TEST_CASE(blockOutputGatesSilenceWithOrWithoutPreparation)
+{
+    int hopSize = 256;
+    int frameSize = 1024;
+    int numHops = 48;
+    
+    // noise followed by a silent stretch of several frames
+    std::vector<double> signal(hopSize * numHops, 0.0);
+    
+    for (size_t i = 0;i < signal.size();i++)
+    {
+        if (i < (size_t) (12 * hopSize))
+        {
+            signal[i] = ((random() % 2000) / 1000.0) - 1.0;
+        }
+    }
+    
+    for (int prepared = 0;prepared < 2;prepared++)
+    {
+        OnsetDetectionFunction hopByHop(hopSize, frameSize, ComplexSpectralDifferenceHWR, HanningWindow);
+        OnsetDetectionFunction block(hopSize, frameSize, ComplexSpectralDifferenceHWR, HanningWindow);
+        
+        hopByHop.setSilenceThreshold(1e-10);
+        block.setSilenceThreshold(1e-10);
+        
+        // without preparation the hops are analysed one at a time
+        if (prepared)
+        {
+            block.prepareBlockProcessing(8);
+        }
+        
+        std::vector<double> blockOutput(numHops);
+        block.calculateBlock(&signal[0], numHops, &blockOutput[0]);
+        
+        int numSilentFrames = 0;
+        
+        for (int n = 0;n < numHops;n++)
+        {
+            double expected = hopByHop.calculateOnsetDetectionFunctionSample(&signal[n*hopSize]);
+            
+            if (hopByHop.frameWasSilent())
+            {
+                numSilentFrames++;
+                BOOST_CHECK_EQUAL(blockOutput[n], 0.0);
+            }
+            
+            BOOST_CHECK_CLOSE(blockOutput[n], expected, 1e-6);
+        }
+        
+        BOOST_CHECK(numSilentFrames > 8);
+        BOOST_CHECK(block.frameWasSilent());
+        
+        // nothing was allocated for the block if it wasn't prepared
+        if (!prepared)
+        {
+            OnsetDetectionFunction unused(hopSize, frameSize, ComplexSpectralDifferenceHWR, HanningWindow);
+            BOOST_CHECK_EQUAL(block.memoryFootprint(), unused.memoryFootprint());
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+//======================================================================
+//======================================================================
+
+
+//======================================================================
+//========================== INSTRUCTION SETS ==========================
+//======================================================================
+BOOST_AUTO_TEST_SUITE(instructionSets)
+
+//======================================================================
+BOOST_AUTO_TEST_CASE(genericInstructionSetCanAlwaysBeChosen)
+{
+    int original = DSPKernels::getInstructionSet();
+    
+    BOOST_CHECK(DSPKernels::isInstructionSetSupported(original));
+    BOOST_CHECK(DSPKernels::setInstructionSet(GenericInstructionSet));
+    BOOST_CHECK_EQUAL(DSPKernels::getInstructionSet(), GenericInstructionSet);
+    BOOST_CHECK_EQUAL(std::string(DSPKernels::getInstructionSetName()), "generic");
+    
+    DSPKernels::setInstructionSet(original);
+}
+
+//======================================================================
+BOOST_AUTO_TEST_CASE(allSupportedInstructionSetsMatchGenericKernels)
+{
+    int original = DSPKernels::getInstructionSet();
+    
+    // lengths that aren't multiples of any vector width, so the remainders are exercised too
+    int n = 517;
+    std::vector<double> a(2 * n), b(2 * n), w(2 * n);
+    
+    for (int i = 0;i < 2 * n;i++)
+    {
+        a[i] = ((random() % 2000) / 1000.0) - 1.0;
+        b[i] = ((random() % 2000) / 1000.0) - 1.0;
+        w[i] = (random() % 1000) / 1000.0;
+    }
+    
+    std::vector<double> windowed[NumInstructionSets], magnitudes[NumInstructionSets], means[NumInstructionSets], thresholded[NumInstructionSets], comb[NumInstructionSets], slid[NumInstructionSets], complexDifference[NumInstructionSets];
+    double difference[NumInstructionSets], maximum[NumInstructionSets], energy[NumInstructionSets], energyChange[NumInstructionSets];
+    
+    for (int set = 0;set < NumInstructionSets;set++)
+    {
+        if (!DSPKernels::setInstructionSet(set))
+        {
+            continue;
+        }
+        
+        windowed[set].resize(n);
+        DSPKernels::applyWindow(&a[0], &w[0], &windowed[set][0], n);
+        
+        magnitudes[set].resize(n);
+        DSPKernels::magnitudes(&a[0], &magnitudes[set][0], n);
+        
+        std::vector<double> previous(b.begin(), b.begin() + n);
+        difference[set] = DSPKernels::spectralDifference(&w[0], &previous[0], n, true, true);
+        
+        std::vector<double> previousMagnitudes(w.begin() + n, w.end());
+        complexDifference[set].resize(n);
+        DSPKernels::complexSpectralDifference(&w[0], &previousMagnitudes[0], &a[0], &complexDifference[set][0], n, true);
+        BOOST_CHECK(std::equal(previousMagnitudes.begin(), previousMagnitudes.end(), w.begin()));
+        
+        // the bins are held as the real parts followed by the imaginary parts
+        slid[set].assign(a.begin(), a.end());
+        DSPKernels::slidingDFT(&slid[set][0], &slid[set][n], &w[0], &w[n], &b[0], &b[n], &a[0], 20, n);
+        
+        means[set].resize(n - 14);
+        DSPKernels::movingMean(&a[0], &means[set][0], n - 14, 15);
+        
+        thresholded[set] = a;
+        DSPKernels::subtractThreshold(&thresholded[set][0], &b[0], n);
+        
+        comb[set].resize(128);
+        DSPKernels::combFilterBank(&w[0], &w[512], &comb[set][0], 128, 4);
+        
+        maximum[set] = DSPKernels::weightedMaximum(&a[0], &w[0], n);
+        
+        energy[set] = DSPKernels::sumOfSquares(&a[0], n);
+        
+        std::vector<double> replaced(b.begin(), b.begin() + n);
+        energyChange[set] = DSPKernels::replaceSamples(&a[0], &replaced[0], n);
+        BOOST_CHECK(std::equal(replaced.begin(), replaced.end(), a.begin()));
+        
+        if (set != GenericInstructionSet)
+        {
+            BOOST_CHECK(windowed[set] == windowed[GenericInstructionSet]);
+            BOOST_CHECK(magnitudes[set] == magnitudes[GenericInstructionSet]);
+            BOOST_CHECK(slid[set] == slid[GenericInstructionSet]);
+            BOOST_CHECK(means[set] == means[GenericInstructionSet]);
+            BOOST_CHECK(thresholded[set] == thresholded[GenericInstructionSet]);
+            BOOST_CHECK(comb[set] == comb[GenericInstructionSet]);
+            BOOST_CHECK(complexDifference[set] == complexDifference[GenericInstructionSet]);
+            BOOST_CHECK_EQUAL(maximum[set], maximum[GenericInstructionSet]);
+            
+            // the sum is taken in a different order
+            BOOST_CHECK_CLOSE(difference[set], difference[GenericInstructionSet], 1e-9);
+            BOOST_CHECK_CLOSE(energy[set], energy[GenericInstructionSet], 1e-9);
+            BOOST_CHECK_CLOSE(energyChange[set], energyChange[GenericInstructionSet], 1e-9);
+        }
+    }
+    
+    DSPKernels::setInstructionSet(original);
+}
+
+//======================================================================
+BOOST_AUTO_TEST_CASE(phaseDetectionFunctionsMatchSummingEveryBin)
+{
+    // the phase based detection functions only analyse the lower half of the spectrum, so check
+    // them against the sum over every bin. The complex spectral differences are summed in the
+    // same order, so they match exactly, while the phase deviation counts mirrored bins twice
+    int frameSize = 1024;
+    int types[3] = {PhaseDeviation, ComplexSpectralDifference, ComplexSpectralDifferenceHWR};
+    
+    for (int t = 0;t < 3;t++)
+    {
+        OnsetDetectionFunction odf(512, frameSize, types[t], HanningWindow);
+        
+        std::vector<double> hop(512);
+        std::vector<double> magnitude(frameSize, 0.0), previousMagnitude(frameSize, 0.0);
+        std::vector<double> previousPhase(frameSize, 0.0), previousPhase2(frameSize, 0.0);
+        
+        for (int i = 0;i < 50;i++)
+        {
+            for (int j = 0;j < 512;j++)
+            {
+                hop[j] = ((random() % 2000) / 1000.0) - 1.0;
+            }
+            
+            double sample = odf.calculateOnsetDetectionFunctionSample(&hop[0]);
+            const double* spectrum = odf.getCurrentSpectrum();
+            BOOST_REQUIRE(spectrum != NULL);
+            
+            double expected = 0;
+            
+            for (int k = 0;k < frameSize;k++)
+            {
+                double re = spectrum[2 * k];
+                double im = spectrum[2 * k + 1];
+                magnitude[k] = sqrt(re * re + im * im);
+                
+                double phase = atan2(im, re);
+                double deviation = phase - (2 * previousPhase[k]) + previousPhase2[k];
+                
+                if (types[t] == PhaseDeviation)
+                {
+                    if (magnitude[k] > 0.1)
+                    {
+                        expected += fabs(remainder(deviation, 2 * M_PI));
+                    }
+                }
+                else if (types[t] == ComplexSpectralDifference || magnitude[k] > previousMagnitude[k])
+                {
+                    expected += sqrt(pow(magnitude[k], 2) + pow(previousMagnitude[k], 2) - 2 * magnitude[k] * previousMagnitude[k] * cos(deviation));
+                }
+                
+                previousPhase2[k] = previousPhase[k];
+                previousPhase[k] = phase;
+                previousMagnitude[k] = magnitude[k];
+            }
+            
+            if (types[t] == PhaseDeviation)
+            {
+                BOOST_CHECK_CLOSE(sample, expected, 1e-9);
+            }
+            else
+            {
+                BOOST_CHECK_EQUAL(sample, expected);
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+//======================================================================
+//======================================================================
+
+
+//======================================================================
+//============================= BUILTIN FFT ============================
+//======================================================================
+BOOST_AUTO_TEST_SUITE(builtinFFT)
+
+//======================================================================
+BOOST_AUTO_TEST_CASE(forwardTransformMatchesDirectDFT)
+{
+    for (int N = 4;N <= 2048;N *= 2)
+    {
+        BuiltinFFT fft;
+        fft.initialise(N);
+        
+        std::vector<double> x(N), spectrum(N + 2);
+        
+        for (int i = 0;i < N;i++)
+        {
+            x[i] = ((random() % 2000) / 1000.0) - 1.0;
+        }
+        
+        fft.performRealFFT(&x[0], &spectrum[0]);
+        
+        for (int k = 0;k <= N/2;k++)
+        {
+            double re = 0;
+            double im = 0;
+            
+            for (int n = 0;n < N;n++)
+            {
+                re += x[n] * cos(-2 * M_PI * k * n / N);
+                im += x[n] * sin(-2 * M_PI * k * n / N);
+            }
+            
+            BOOST_CHECK_SMALL(spectrum[2*k] - re, 1e-9 * N);
+            BOOST_CHECK_SMALL(spectrum[2*k+1] - im, 1e-9 * N);
+        }
+    }
+}
+
+//======================================================================
+BOOST_AUTO_TEST_CASE(inverseTransformReturnsScaledSignal)
+{
+    int N = 1024;
+    
+    BuiltinFFT fft;
+    fft.initialise(N);
+    
+    std::vector<double> x(N), spectrum(N + 2), y(N);
+    
+    for (int i = 0;i < N;i++)
+    {
+        x[i] = ((random() % 2000) / 1000.0) - 1.0;
+    }
+    
+    fft.performRealFFT(&x[0], &spectrum[0]);
+    fft.performInverseRealFFT(&spectrum[0], &y[0]);
+    
+    // the transforms are unnormalised, as with FFTW
+    for (int i = 0;i < N;i++)
+    {
+        BOOST_CHECK_SMALL(y[i] / N - x[i], 1e-12);
+    }
+}
+
+//======================================================================
+BOOST_AUTO_TEST_CASE(sizesThatAreNotPowersOfTwoUseADirectDFT)
+{
+    BOOST_CHECK(BuiltinFFT::supportsSize(512));
+    BOOST_CHECK(!BuiltinFFT::supportsSize(600));
+    BOOST_CHECK(!BuiltinFFT::supportsSize(2));
+    
+    // the radix 2 tables can't be laid out for this size, so nothing is set up
+    BuiltinFFT unsupported;
+    unsupported.initialise(600);
+    BOOST_CHECK_EQUAL(unsupported.getSize(), 0);
+    
+    for (int N = 600;N <= 601;N++)
+    {
+        std::unique_ptr<RealFFT> fft = BuiltinFFTBackend().createFFT(N);
+        
+        std::vector<double> x(N);
+        
+        for (int i = 0;i < N;i++)
+        {
+            x[i] = ((random() % 2000) / 1000.0) - 1.0;
+        }
+        
+        std::copy(x.begin(), x.end(), fft->getTimeDomainBuffer());
+        fft->performForwardTransform();
+        
+        for (int k = 0;k <= N/2;k++)
+        {
+            double re = 0;
+            double im = 0;
+            
+            for (int n = 0;n < N;n++)
+            {
+                re += x[n] * cos(-2 * M_PI * k * n / N);
+                im += x[n] * sin(-2 * M_PI * k * n / N);
+            }
+            
+            BOOST_CHECK_SMALL(fft->getSpectrumBuffer()[2*k] - re, 1e-9 * N);
+            BOOST_CHECK_SMALL(fft->getSpectrumBuffer()[2*k+1] - im, 1e-9 * N);
+        }
+        
+        fft->performInverseTransform();
+        
+        for (int i = 0;i < N;i++)
+        {
+            BOOST_CHECK_SMALL(fft->getTimeDomainBuffer()[i] / N - x[i], 1e-12);
+        }
+    }
+    
+    // a hop of 300 gives a frame of 600 samples
+    BTrack b(300);
+    b.setFFTBackend(std::make_shared<BuiltinFFTBackend>());
+    
+    std::vector<double> frame(300);
+    int numBeats = 0;
+    
+    for (int n = 0;n < 2000;n++)
+    {
+        for (int i = 0;i < 300;i++)
+        {
+            frame[i] = ((n % 74) == 0) ? ((random() % 2000) / 1000.0) - 1.0 : 0.0;
+        }
+        
+        b.processAudioFrame(&frame[0]);
+        
+        numBeats += b.beatDueInCurrentFrame() ? 1 : 0;
+    }
+    
+    BOOST_CHECK(numBeats > 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+//======================================================================
+//=========================== FFT BACKENDS =============================
+//======================================================================
+BOOST_AUTO_TEST_SUITE(fftBackends)
+
+//======================================================================
+/** An FFT that counts the transforms it performs */
+class CountingFFT : public RealFFT
+{
+public:
+    CountingFFT(int size_, int& count_) : RealFFT(size_), count(count_)
+    {
+        fft.initialise(size_);
+    }
+    
+    void performForwardTransform()
+    {
+        fft.performRealFFT(getTimeDomainBuffer(), getSpectrumBuffer());
+        count++;
+    }
+    
+    void performInverseTransform()
+    {
+        fft.performInverseRealFFT(getSpectrumBuffer(), getTimeDomainBuffer());
+        count++;
+    }
+    
+    BuiltinFFT fft;
+    int& count;
+};
+
+//======================================================================
+/** A backend that creates CountingFFTs */
+class CountingBackend : public FFTBackend
+{
+public:
+    CountingBackend() : numFFTsCreated(0), numTransforms(0) {}
+    
+    const char* getName() const
+    {
+        return "counting";
+    }
+    
+    std::unique_ptr<RealFFT> createFFT(int size)
+    {
+        numFFTsCreated++;
+        return std::unique_ptr<RealFFT>(new CountingFFT(size, numTransforms));
+    }
+    
+    int numFFTsCreated;
+    int numTransforms;
+};
+
+//======================================================================
+/** A backend whose FFTs are only of powers of two, as with the built in FFT that they use */
+class PowerOfTwoBackend : public CountingBackend
+{
+public:
+    bool supportsSize(int size) const
+    {
+        return BuiltinFFT::supportsSize(size);
+    }
+};
+
+//======================================================================
+BOOST_AUTO_TEST_CASE(availableBackendsMatchBuiltinFFT)
+{
+    int N = 1024;
+    
+    std::vector<double> x(N);
+    
+    for (int i = 0;i < N;i++)
+    {
+        x[i] = ((random() % 2000) / 1000.0) - 1.0;
+    }
+    
+    std::unique_ptr<RealFFT> reference = BuiltinFFTBackend().createFFT(N);
+    std::copy(x.begin(), x.end(), reference->getTimeDomainBuffer());
+    reference->performForwardTransform();
+    
+    std::vector<std::shared_ptr<FFTBackend> > backends = FFTBackend::getAvailableBackends();
+    
+    BOOST_CHECK(!backends.empty());
+    
+    for (size_t b = 0;b < backends.size();b++)
+    {
+        std::unique_ptr<RealFFT> fft = backends[b]->createFFT(N);
+        
+        BOOST_CHECK_EQUAL(fft->getSize(), N);
+        BOOST_CHECK_EQUAL(((uintptr_t) fft->getTimeDomainBuffer()) % 16, 0);
+        BOOST_CHECK_EQUAL(((uintptr_t) fft->getSpectrumBuffer()) % 16, 0);
+        
+        std::copy(x.begin(), x.end(), fft->getTimeDomainBuffer());
+        fft->performForwardTransform();
+        
+        // Kiss FFT works in single precision
+        for (int k = 0;k <= N/2;k++)
+        {
+            BOOST_CHECK_SMALL(fft->getSpectrumBuffer()[2*k] - reference->getSpectrumBuffer()[2*k], 1e-3);
+            BOOST_CHECK_SMALL(fft->getSpectrumBuffer()[2*k+1] - reference->getSpectrumBuffer()[2*k+1], 1e-3);
+        }
+        
+        fft->performInverseTransform();
+        
+        for (int i = 0;i < N;i++)
+        {
+            BOOST_CHECK_SMALL(fft->getTimeDomainBuffer()[i] / N - x[i], 1e-5);
+        }
+    }
+    
+    BOOST_CHECK(FFTBackend::findFastestBackend(N) != nullptr);
+}
+
+//======================================================================
+BOOST_AUTO_TEST_CASE(sharedBackendIsUsedByEveryInstance)
+{
+    std::shared_ptr<CountingBackend> backend = std::make_shared<CountingBackend>();
+    
+    BTrack b1(256, 512);
+    BTrack b2(256, 512);
+    BTrack reference(256, 512);
+    
+    b1.setFFTBackend(backend);
+    b2.setFFTBackend(backend);
+    reference.setFFTBackend(std::make_shared<BuiltinFFTBackend>());
+    
+    // one FFT for the detection function and one for the tempo estimate in each instance
+    BOOST_CHECK_EQUAL(backend->numFFTsCreated, 4);
+    
+    std::vector<double> frame(256);
+    
+    for (int n = 0;n < 1000;n++)
+    {
+        for (int i = 0;i < 256;i++)
+        {
+            frame[i] = ((n % 43) == 0) ? ((random() % 2000) / 1000.0) - 1.0 : 0.0;
+        }
+        
+        b1.processAudioFrame(&frame[0]);
+        reference.processAudioFrame(&frame[0]);
+        
+        BOOST_CHECK_EQUAL(b1.beatDueInCurrentFrame(), reference.beatDueInCurrentFrame());
+        BOOST_CHECK_EQUAL(b1.getLatestCumulativeScoreValue(), reference.getLatestCumulativeScoreValue());
+    }
+    
+    BOOST_CHECK(backend->numTransforms >= 1000);
+}
+
+//======================================================================
+BOOST_AUTO_TEST_CASE(backendsAreOnlyGivenSizesThatTheySupport)
+{
+    BOOST_CHECK(BuiltinFFTBackend().supportsSize(1024));
+    BOOST_CHECK(!BuiltinFFTBackend().supportsSize(600));
+    
+    // timing only creates FFTs of the sizes that each backend supports
+    std::shared_ptr<FFTBackend> fastest = FFTBackend::findFastestBackend(600);
+    BOOST_REQUIRE(fastest != nullptr);
+    
+    std::shared_ptr<PowerOfTwoBackend> backend = std::make_shared<PowerOfTwoBackend>();
+    
+    // the detection function falls back to another backend for a frame of 600 samples,
+    // but keeps the one it was given for when the frame size changes
+    OnsetDetectionFunction odf(300, 600);
+    odf.setFFTBackend(backend);
+    
+    BOOST_CHECK_EQUAL(backend->numFFTsCreated, 0);
+    BOOST_CHECK(odf.getFFTBackend() == backend);
+    
+    std::vector<double> hop(300);
+    
+    for (int i = 0;i < 300;i++)
+    {
+        hop[i] = ((random() % 2000) / 1000.0) - 1.0;
+    }
+    
+    BOOST_CHECK(odf.calculateOnsetDetectionFunctionSample(&hop[0]) > 0);
+    
+    odf.initialise(256, 512);
+    
+    BOOST_CHECK_EQUAL(backend->numFFTsCreated, 1);
+    
+    odf.calculateOnsetDetectionFunctionSample(&hop[0]);
+    
+    BOOST_CHECK_EQUAL(backend->numTransforms, 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+//======================================================================
+//=========================== MEMORY ARENAS ============================
+//======================================================================
+BOOST_AUTO_TEST_SUITE(memoryArenas)
+
+//======================================================================
+BOOST_AUTO_TEST_CASE(arenaHandsOutAlignedPiecesOfTheBlock)
+{
+    std::vector<char> block(1000);
+    
+    // deliberately misaligned
+    MemoryArena arena(&block[3], 997);
+    
+    char* first = (char*) arena.allocate(100);
+    char* second = (char*) arena.allocate(8);
+    
+    BOOST_CHECK_EQUAL(((uintptr_t) first) % bufferAlignment, 0);
+    BOOST_CHECK_EQUAL(((uintptr_t) second) % bufferAlignment, 0);
+    BOOST_CHECK(first >= &block[3]);
+    BOOST_CHECK(second >= first + 100);
+    BOOST_CHECK(second + 8 <= &block[0] + block.size());
+    BOOST_CHECK_EQUAL(arena.getOverflowCount(), 0);
+    
+    // too big for what is left, so it comes from the heap
+    char* third = (char*) arena.allocate(2000);
+    
+    BOOST_CHECK_EQUAL(((uintptr_t) third) % bufferAlignment, 0);
+    BOOST_CHECK_EQUAL(arena.getOverflowCount(), 1);
+    
+    arena.deallocate(third, 2000);
+    arena.deallocate(first, 100);
+}
+
+//======================================================================
+BOOST_AUTO_TEST_CASE(trackersInAnArenaMatchTrackersOnTheHeap)
+{
+    MemoryArena arena(1 << 20);
+    
+    BTrack b1(512, 1024, &arena);
+    BTrack b2(512, 1024, &arena);
+    BTrack reference(512, 1024);
+    
+    size_t bytesPerTracker = arena.getBytesUsed() / 2;
+    
+    BOOST_CHECK(bytesPerTracker > 0);
+    BOOST_CHECK_EQUAL(arena.getOverflowCount(), 0);
+    
+    std::vector<double> frame(512);
+    
+    for (int n = 0;n < 500;n++)
+    {
+        for (int i = 0;i < 512;i++)
+        {
+            frame[i] = ((n % 43) == 0) ? ((random() % 2000) / 1000.0) - 1.0 : 0.0;
+        }
+        
+        // a change of hop size part way through allocates its new buffers from the arena too
+        if (n == 250)
+        {
+            b1.updateHopAndFrameSize(256, 512);
+            reference.updateHopAndFrameSize(256, 512);
+        }
+        
+        b1.processAudioFrame(&frame[0]);
+        reference.processAudioFrame(&frame[0]);
+        
+        BOOST_CHECK_EQUAL(b1.beatDueInCurrentFrame(), reference.beatDueInCurrentFrame());
+        BOOST_CHECK_EQUAL(b1.getLatestCumulativeScoreValue(), reference.getLatestCumulativeScoreValue());
+    }
+    
+    BOOST_CHECK(arena.getBytesUsed() > 2 * bytesPerTracker);
+    BOOST_CHECK_EQUAL(arena.getOverflowCount(), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+//======================================================================
+//======================================================================
+
+//======================================================================
+//=========================== MOVING TRACKERS ==========================
+//======================================================================
+BOOST_AUTO_TEST_SUITE(movingTrackers)
+
+//======================================================================
+BOOST_AUTO_TEST_CASE(trackersInAVectorMatchTrackersThatStayPut)
+{
+    std::vector<BTrack> trackers;
+    BTrack reference1(512, 1024);
+    BTrack reference2(512, 1024);
+    
+    // without reserving, each new tracker moves the ones already in the vector
+    trackers.push_back(BTrack(512, 1024));
+    trackers.push_back(BTrack(512, 1024));
+    
+    std::vector<double> frame(512);
+    
+    for (int n = 0;n < 500;n++)
+    {
+        for (int i = 0;i < 512;i++)
+        {
+            frame[i] = ((n % 43) == 0) ? ((random() % 2000) / 1000.0) - 1.0 : 0.0;
+        }
+        
+        if (n == 100)
+        {
+            trackers.push_back(BTrack(512, 1024));
+            
+            // move assignment replaces one tracker with another that has been running
+            trackers[1] = std::move(trackers[0]);
+            trackers[0] = BTrack(512, 1024);
+            
+            reference2 = BTrack(512, 1024);
+        }
+        
+        // a change of hop size that has been prepared but not applied moves with the tracker
+        if (n == 250)
+        {
+            trackers[1].prepareHopAndFrameSize(256, 512);
+            reference1.prepareHopAndFrameSize(256, 512);
+            
+            trackers.push_back(BTrack(512, 1024));
+        }
+        
+        trackers[0].processAudioFrame(&frame[0]);
+        trackers[1].processAudioFrame(&frame[0]);
+        reference1.processAudioFrame(&frame[0]);
+        reference2.processAudioFrame(&frame[0]);
+        
+        BOOST_CHECK_EQUAL(trackers[1].beatDueInCurrentFrame(), reference1.beatDueInCurrentFrame());
+        BOOST_CHECK_EQUAL(trackers[1].getLatestCumulativeScoreValue(), reference1.getLatestCumulativeScoreValue());
+        BOOST_CHECK_EQUAL(trackers[0].getLatestCumulativeScoreValue(), reference2.getLatestCumulativeScoreValue());
+    }
+    
+    BOOST_CHECK_EQUAL(trackers[1].getHopSize(), 256);
+}
+
+//======================================================================
+BOOST_AUTO_TEST_CASE(memoryFootprintAccountsForTheArena)
+{
+    MemoryArena arena(1 << 20);
+    
+    BTrack b(512, 1024, &arena);
+    
+    size_t bytesUsed = arena.getBytesUsed();
+    size_t footprint = b.memoryFootprint();
+    
+    // the arena rounds every allocation up to a whole number of cache lines
+    BOOST_CHECK(footprint > sizeof(BTrack));
+    BOOST_CHECK(footprint - sizeof(BTrack) <= bytesUsed);
+    BOOST_CHECK(footprint - sizeof(BTrack) > (bytesUsed * 9) / 10);
+    
+    // the retired detection function is kept until the next change
+    b.updateHopAndFrameSize(256, 512);
+    
+    BOOST_CHECK(b.memoryFootprint() > footprint);
+    
+    // moving hands everything over
+    BTrack moved(std::move(b));
+    
+    BOOST_CHECK(moved.memoryFootprint() > footprint);
+    BOOST_CHECK(b.memoryFootprint() < sizeof(BTrack) + 1024);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+//======================================================================
+//======================================================================
+
+//======================================================================
+//============================ FIXED POINT =============================
+//======================================================================
+BOOST_AUTO_TEST_SUITE(fixedPoint)
+
+//======================================================================
+/** Fills a hop with the same noise on every machine, loud every 43rd hop and quiet otherwise */
+static void fillFixedPointHop(std::vector<int16_t>& hop, std::vector<double>& doubleHop, uint32_t& seed, int n)
+{
+    for (size_t i = 0;i < hop.size();i++)
+    {
+        seed = (seed * 1664525u) + 1013904223u;
+        int32_t noise = ((int32_t) (seed >> 16)) - 32768;
+        
+        hop[i] = (int16_t) (((n % 43) == 0) ? noise : (noise / 512));
+        doubleHop[i] = hop[i] / 32768.0;
+    }
+}
+
+//======================================================================
+BOOST_AUTO_TEST_CASE(fftOfAnImpulseIsExactlyFlat)
+{
+    FixedPointFFT fft;
+    fft.initialise(64);
+    
+    std::vector<int32_t> data(128, 0);
+    data[0] = 1 << 30;
+    
+    fft.performFFT(&data[0]);
+    
+    // the output is divided by the size
+    for (int k = 0;k < 64;k++)
+    {
+        BOOST_CHECK_EQUAL(data[2 * k], (1 << 30) / 64);
+        BOOST_CHECK_EQUAL(data[2 * k + 1], 0);
+    }
+}
+
+//======================================================================
+BOOST_AUTO_TEST_CASE(trackerMatchesReferenceVectors)
+{
+    // made with this implementation, and expected to be reproduced exactly on any processor
+    const int referenceBeats[2][5] = {{40, 82, 128, 172, 215}, {40, 86, 129, 172, 215}};
+    const uint32_t referenceChecksums[2] = {1387351654u, 54004617u};
+    
+    for (int type = FixedPointEnergyDifference;type <= FixedPointSpectralDifferenceHWR;type++)
+    {
+        FixedPointBTrack b(512, 1024, type);
+        
+        std::vector<int16_t> hop(512);
+        std::vector<double> doubleHop(512);
+        uint32_t seed = 1;
+        uint32_t checksum = 0;
+        std::vector<int> beats;
+        
+        for (int n = 0;n < 1000;n++)
+        {
+            fillFixedPointHop(hop, doubleHop, seed, n);
+            b.processAudioFrame(&hop[0]);
+            
+            checksum = (checksum * 31u) + (uint32_t) b.getLatestCumulativeScoreValue();
+            
+            if (b.beatDueInCurrentFrame())
+            {
+                beats.push_back(n);
+            }
+        }
+        
+        BOOST_REQUIRE(beats.size() >= 5);
+        BOOST_CHECK_EQUAL_COLLECTIONS(beats.begin(), beats.begin() + 5, referenceBeats[type], referenceBeats[type] + 5);
+        BOOST_CHECK_EQUAL(checksum, referenceChecksums[type]);
+        BOOST_CHECK_EQUAL(b.getCurrentTempoEstimate(), 7697455);
+    }
+}
+
+//======================================================================
+BOOST_AUTO_TEST_CASE(trackerAgreesWithDoublePrecisionTracker)
+{
+    FixedPointBTrack fixedPoint(512, 1024, FixedPointSpectralDifferenceHWR);
+    BTrack reference(512, 1024);
+    
+    std::vector<int16_t> hop(512);
+    std::vector<double> doubleHop(512);
+    uint32_t seed = 7;
+    int numBeats = 0;
+    int numMatchingBeats = 0;
+    
+    for (int n = 0;n < 2000;n++)
+    {
+        fillFixedPointHop(hop, doubleHop, seed, n);
+        
+        fixedPoint.processAudioFrame(&hop[0]);
+        reference.processAudioFrame(&doubleHop[0]);
+        
+        if (reference.beatDueInCurrentFrame())
+        {
+            numBeats++;
+            
+            if (fixedPoint.beatDueInCurrentFrame())
+            {
+                numMatchingBeats++;
+            }
+        }
+    }
+    
+    BOOST_CHECK(numBeats > 40);
+    BOOST_CHECK(numMatchingBeats >= numBeats - 2);
+    BOOST_CHECK_CLOSE(fixedPoint.getCurrentTempoEstimate() / 65536.0, reference.getCurrentTempoEstimate(), 0.5);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+//======================================================================
+//======================= STATIC TRACKER ===============================
+//======================================================================
+BOOST_AUTO_TEST_SUITE(staticTracker)
+
+//======================================================================
+BOOST_AUTO_TEST_CASE(staticTrackerMatchesBTrack)
+{
+    std::vector<BTrackStatic<512, 1024> > trackers(2);
+    BTrack reference(512, 1024);
+    OnsetDetectionFunction odf(512, 1024);
+    
+    // the static tracker always uses the built in FFT
+    std::shared_ptr<FFTBackend> builtin = std::make_shared<BuiltinFFTBackend>();
+    reference.setFFTBackend(builtin);
+    odf.setFFTBackend(builtin);
+    
+    std::vector<double> frame(512);
+    int numBeats = 0;
+    
+    for (int n = 0;n < 1500;n++)
+    {
+        for (int i = 0;i < 512;i++)
+        {
+            frame[i] = ((n % 43) < 2) ? ((random() % 2000) / 1000.0) - 1.0 : ((random() % 200) / 1000.0) - 0.1;
+        }
+        
+        BOOST_CHECK_EQUAL(trackers[1].calculateOnsetDetectionFunctionSample(&frame[0]), odf.calculateOnsetDetectionFunctionSample(&frame[0]));
+        
+        trackers[0].processAudioFrame(&frame[0]);
+        reference.processAudioFrame(&frame[0]);
+        
+        BOOST_CHECK_EQUAL(trackers[0].beatDueInCurrentFrame(), reference.beatDueInCurrentFrame());
+        BOOST_CHECK_CLOSE(trackers[0].getLatestCumulativeScoreValue(), reference.getLatestCumulativeScoreValue(), 1e-3);
+        
+        if (reference.beatDueInCurrentFrame())
+        {
+            numBeats++;
+        }
+    }
+    
+    BOOST_CHECK(numBeats > 20);
+    BOOST_CHECK_EQUAL(trackers[0].getCurrentTempoEstimate(), reference.getCurrentTempoEstimate());
+    
+    // copies carry on exactly where the original left off
+    BTrackStatic<512, 1024> copy = trackers[0];
+    
+    for (int n = 0;n < 200;n++)
+    {
+        trackers[0].processOnsetDetectionFunctionSample((n % 43) == 0 ? 10.0 : 0.0);
+        copy.processOnsetDetectionFunctionSample((n % 43) == 0 ? 10.0 : 0.0);
+        
+        BOOST_CHECK_EQUAL(copy.getLatestCumulativeScoreValue(), trackers[0].getLatestCumulativeScoreValue());
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+//======================================================================
+//===================== RUNNING FRAME ENERGY ===========================
+//======================================================================
+BOOST_AUTO_TEST_SUITE(runningFrameEnergy)
+
+//======================================================================
+BOOST_AUTO_TEST_CASE(runningEnergyMatchesSummingTheFrame)
+{
+    int hopSize = 384;
+    int frameSize = 1024;
+    
+    OnsetDetectionFunction running(hopSize, frameSize, EnergyEnvelope, HanningWindow);
+    OnsetDetectionFunction summed(hopSize, frameSize, EnergyEnvelope, HanningWindow);
+    
+    std::vector<double> signal;
+    std::vector<double> hop(hopSize);
+    
+    for (int n = 0;n < 400;n++)
+    {
+        // loud and quiet passages, so that rounding errors left by the loud ones would show
+        double level = ((n / 50) % 2 == 0) ? 1000.0 : 0.001;
+        
+        for (int i = 0;i < hopSize;i++)
+        {
+            hop[i] = level * (((random() % 2000) / 1000.0) - 1.0);
+            signal.push_back(hop[i]);
+        }
+        
+        // switching to a spectral detection function and back keeps the frame in order
+        if (n == 130)
+        {
+            running.setOnsetDetectionFunctionType(ComplexSpectralDifference);
+        }
+        else if (n == 140)
+        {
+            running.setOnsetDetectionFunctionType(EnergyEnvelope);
+        }
+        
+        double sample = running.calculateOnsetDetectionFunctionSample(&hop[0]);
+        
+        if (n >= 3 && (n < 130 || n >= 140))
+        {
+            double expected = summed.calculateFromFrame(&signal[signal.size() - frameSize]);
+            BOOST_CHECK_CLOSE(sample, expected, 1e-6);
+        }
+    }
+    
+    // the frame is handed over in order even when the newest samples have wrapped around
+    OnsetDetectionFunction copy(hopSize, frameSize, EnergyEnvelope, HanningWindow);
+    copy.copyAudioHistory(running);
+    
+    std::fill(hop.begin(), hop.end(), 0.0);
+    
+    BOOST_CHECK_CLOSE(copy.calculateOnsetDetectionFunctionSample(&hop[0]), running.calculateOnsetDetectionFunctionSample(&hop[0]), 1e-6);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+//======================================================================
+//============================ DENORMALS ===============================
+//======================================================================
+BOOST_AUTO_TEST_SUITE(denormals)
+
+#if BTRACK_DENORMALS_MXCSR || BTRACK_DENORMALS_FPCR
+//======================================================================
+BOOST_AUTO_TEST_CASE(denormalsAreFlushedOnlyInsideTheScope)
+{
+    volatile double smallest = DBL_MIN;
+    
+    {
+        ScopedNoDenormals noDenormals;
+        
+        BOOST_CHECK_EQUAL(smallest / 4, 0.0);
+    }
+    
+    BOOST_CHECK(smallest / 4 > 0.0);
+}
+#endif
+
+//======================================================================
+BOOST_AUTO_TEST_CASE(detectionFunctionIsNeverDenormalThroughAFade)
+{
+    BTrack b(512, 1024);
+    OnsetDetectionFunction odf(512, 1024);
+    
+    std::vector<double> frame(512);
+    
+    // a slow exponential fade from full scale to below the smallest denormal, then digital silence
+    // (see "unit-tests/BTrack Benchmarks" for how long each hop takes through the same fade)
+    int numLoudHops = 300;
+    int numFadeHops = 2000;
+    int numSilentHops = 500;
+    double gain = 1.0;
+    double fadePerSample = exp(log(1e-320) / (numFadeHops * 512.0));
+    
+    for (int n = 0;n < numLoudHops + numFadeHops + numSilentHops;n++)
+    {
+        for (int i = 0;i < 512;i++)
+        {
+            if (n >= numLoudHops)
+            {
+                gain = (n < numLoudHops + numFadeHops) ? gain * fadePerSample : 0.0;
+            }
+            
+            frame[i] = gain * (((random() % 2000) / 1000.0) - 1.0);
+        }
+        
+        b.processAudioFrame(&frame[0]);
+        
+        double sample = odf.calculateOnsetDetectionFunctionSample(&frame[0]);
+        BOOST_CHECK(std::fpclassify(sample) != FP_SUBNORMAL);
+        BOOST_CHECK(std::fpclassify(b.getLatestCumulativeScoreValue()) != FP_SUBNORMAL);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+//======================================================================
+//========================= OFFLINE TRACKING ===========================
+//======================================================================
+BOOST_AUTO_TEST_SUITE(offlineTracking)
+
+//======================================================================
+BOOST_AUTO_TEST_CASE(refinedBeatsAreWithinAFineHopOfTheClicks)
+{
+    // clicks at 120 bpm over quiet noise, starting part way into the first beat
+    long numSamples = 44100 * 20;
+    long period = 22050;
+    long offset = 5000;
+    
+    std::vector<double> signal(numSamples);
+    
+    for (long i = 0;i < numSamples;i++)
+    {
+        signal[i] = 0.01 * (((random() % 2000) / 1000.0) - 1.0);
+        
+        if (i >= offset && ((i - offset) % period) < 64)
+        {
+            signal[i] += ((random() % 2000) / 1000.0) - 1.0;
+        }
+    }
+    
+    OfflineBeatTracker tracker(1024, 128);
+    tracker.processSignal(&signal[0], numSamples);
+    
+    const std::vector<long>& beats = tracker.getBeats();
+    
+    BOOST_CHECK(beats.size() > 30);
+    BOOST_CHECK_EQUAL(beats.size(), tracker.getCoarseBeats().size());
+    BOOST_CHECK_EQUAL(beats.size(), tracker.getTempi().size());
+    
+    int numCoarseBeatsOutsideAFineHop = 0;
+    
+    // skip the first few seconds, in which the coarse pass is still finding the beat
+    for (size_t i = 0;i < beats.size();i++)
+    {
+        if (beats[i] < 44100 * 5)
+        {
+            continue;
+        }
+        
+        long error = ((beats[i] - offset + (period / 2)) % period) - (period / 2);
+        long coarseError = ((tracker.getCoarseBeats()[i] - offset + (period / 2)) % period) - (period / 2);
+        
+        BOOST_CHECK(labs(error) <= 128);
+        
+        // the coarse beat period is a whole number of coarse hops
+        BOOST_CHECK_CLOSE(tracker.getTempi()[i], 120.0, 3.0);
+        
+        if (labs(coarseError) > 128)
+        {
+            numCoarseBeatsOutsideAFineHop++;
+        }
+    }
+    
+    // the refinement made a difference
+    BOOST_CHECK(numCoarseBeatsOutsideAFineHop > 10);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+//======================================================================
+//===================== BEAT SYNCHRONOUS FEATURES ======================
+//======================================================================
+BOOST_AUTO_TEST_SUITE(beatSynchronousFeatures)
+
+//======================================================================
+BOOST_AUTO_TEST_CASE(featuresAreAveragedOverEachBeat)
+{
+    // a 220 Hz tone, which is an A, with clicks at 120 bpm
+    int hopSize = 512;
+    int numHops = 1500;
+    long period = 22050;
+    
+    BTrack b(hopSize, 1024);
+    
+    BeatSynchronousFeatures features(1024, 44100);
+    int chroma = features.addChroma();
+    int lowBand = features.addBand(150, 300);
+    int highBand = features.addBand(5000, 10000);
+    int meanMagnitude = features.addMeanMagnitude();
+    int strength = features.addOnsetDetectionFunctionStrength();
+    
+    BOOST_CHECK_EQUAL(features.getNumFeatures(), 16);
+    
+    b.setBeatSynchronousFeatures(&features);
+    
+    std::vector<double> hop(hopSize);
+    long n = 0;
+    int numBeats = 0;
+    int numFramesInBeats = 0;
+    
+    for (int i = 0;i < numHops;i++)
+    {
+        for (int j = 0;j < hopSize;j++, n++)
+        {
+            hop[j] = 0.3 * sin(2 * M_PI * 220 * n / 44100.0);
+            
+            if ((n % period) < 64)
+            {
+                hop[j] += ((random() % 2000) / 1000.0) - 1.0;
+            }
+        }
+        
+        b.processAudioFrame(&hop[0]);
+        
+        if (b.beatDueInCurrentFrame())
+        {
+            const std::vector<double>& beatFeatures = features.getBeatFeatures();
+            
+            int loudestPitchClass = (int) (std::max_element(beatFeatures.begin() + chroma, beatFeatures.begin() + chroma + 12) - beatFeatures.begin()) - chroma;
+            
+            BOOST_CHECK_EQUAL(loudestPitchClass, 9);
+            BOOST_CHECK(beatFeatures[lowBand] > 10 * beatFeatures[highBand]);
+            BOOST_CHECK(beatFeatures[meanMagnitude] > 0);
+            BOOST_CHECK(beatFeatures[strength] > 0);
+            
+            numBeats++;
+            numFramesInBeats += features.getNumFramesInBeat();
+            
+            // the frame a beat falls in starts the next beat, so every earlier frame has been counted once
+            BOOST_CHECK_EQUAL(numFramesInBeats, i);
+            
+            // skip the first beat, which starts wherever the tracker started
+            if (numBeats > 4)
+            {
+                BOOST_CHECK(abs(features.getNumFramesInBeat() - 43) <= 2);
+            }
+        }
+    }
+    
+    BOOST_CHECK(numBeats > 20);
+}
+
+//======================================================================
+BOOST_AUTO_TEST_CASE(chromaWrapsNotesBelowMidiNoteZero)
+{
+    // bin 1 is at 5.4 Hz, which rounds to MIDI note -7, an F
+    BeatSynchronousFeatures features(8192, 44100);
+    int chroma = features.addChroma(1.0, 4000);
+    
+    BOOST_CHECK_EQUAL(features.getNumFeatures(), 12);
+    
+    std::vector<double> spectrum(2 * 8192, 0.0);
+    spectrum[2] = 1.0;
+    
+    features.addFrame(&spectrum[0], 0.0);
+    features.endBeat();
+    
+    const std::vector<double>& beatFeatures = features.getBeatFeatures();
+    
+    for (int i = 0;i < 12;i++)
+    {
+        BOOST_CHECK_EQUAL(beatFeatures[chroma + i] > 0, i == 5);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+//======================================================================
+//=========================== ONSET PICKING ============================
+//======================================================================
+BOOST_AUTO_TEST_SUITE(onsetPicking)
+
+//======================================================================
+BOOST_AUTO_TEST_CASE(onsetsAreReportedAfterTheLookAhead)
+{
+    // clicks at irregular intervals over quiet noise
+    int hopSize = 512;
+    int numHops = 1000;
+    
+    std::vector<long> clicks;
+    
+    for (long position = 10000;position < (long) (numHops - 10) * hopSize;position += 6000 + (random() % 20000))
+    {
+        clicks.push_back(position);
+    }
+    
+    BTrack b(hopSize, 1024);
+    b.enableOnsetDetection(2);
+    
+    BOOST_CHECK_EQUAL(b.getOnsetDelay(), 2);
+    
+    std::vector<double> hop(hopSize);
+    std::vector<long> onsetFrames;
+    size_t nextClick = 0;
+    
+    for (int i = 0;i < numHops;i++)
+    {
+        for (int j = 0;j < hopSize;j++)
+        {
+            long n = (long) i * hopSize + j;
+            
+            hop[j] = 0.01 * (((random() % 2000) / 1000.0) - 1.0);
+            
+            if (nextClick < clicks.size() && n >= clicks[nextClick] && n < clicks[nextClick] + 64)
+            {
+                hop[j] += ((random() % 2000) / 1000.0) - 1.0;
+            }
+            
+            if (nextClick < clicks.size() && n == clicks[nextClick] + 63)
+            {
+                nextClick++;
+            }
+        }
+        
+        b.processAudioFrame(&hop[0]);
+        
+        // the noise starting is an onset too, so skip it
+        if (b.onsetDueInCurrentFrame() && i > 10)
+        {
+            onsetFrames.push_back(i - b.getOnsetDelay());
+        }
+    }
+    
+    BOOST_REQUIRE_EQUAL(onsetFrames.size(), clicks.size());
+    
+    for (size_t i = 0;i < clicks.size();i++)
+    {
+        BOOST_CHECK(labs(onsetFrames[i] - (clicks[i] / hopSize)) <= 1);
+    }
+    
+    // the delay follows the look ahead
+    b.enableOnsetDetection(0);
+    BOOST_CHECK_EQUAL(b.getOnsetDelay(), 0);
+    BOOST_CHECK(!b.onsetDueInCurrentFrame());
+}
+
+//======================================================================
+BOOST_AUTO_TEST_CASE(onsetConfirmedWhileAdvancingFramesIsReportedAtTheEnd)
+{
+    BTrack b(512);
+    b.enableOnsetDetection(2);
+    
+    for (int i = 0;i < 50;i++)
+    {
+        b.processOnsetDetectionFunctionSample(1.0);
+    }
+    
+    // the peak is the last frame before a constant run, so it is confirmed part way through the run
+    b.processOnsetDetectionFunctionSample(100.0);
+    b.advanceFrames(10, 1.0);
+    
+    BOOST_CHECK(b.onsetDueInCurrentFrame());
+    BOOST_CHECK_EQUAL(b.getOnsetDelay(), 10);
+    
+    b.advanceFrames(10, 1.0);
+    
+    BOOST_CHECK(!b.onsetDueInCurrentFrame());
+    BOOST_CHECK_EQUAL(b.getOnsetDelay(), 2);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+//======================================================================
+//======================== PHASE MAGNITUDE FLOOR =======================
+//======================================================================
+BOOST_AUTO_TEST_SUITE(phaseMagnitudeFloor)
+
+//======================================================================
+BOOST_AUTO_TEST_CASE(quietBinsCanBeSkippedWithoutChangingTheBeats)
+{
+    // a kick drum on every beat at 118 bpm under two steady tones, so most bins are quiet
+    int hopSize = 512;
+    int numHops = 1500;
+    double period = 44100 * 60.0 / 118;
+    
+    std::vector<double> signal(hopSize * numHops);
+    
+    for (long n = 0;n < (long) signal.size();n++)
+    {
+        double beatPosition = fmod(n, period);
+        signal[n] = sin(2 * M_PI * 55 * beatPosition / 44100) * exp(-beatPosition / 3000.0);
+        signal[n] += 0.2 * sin(2 * M_PI * 220 * n / 44100.0) + 0.1 * sin(2 * M_PI * 330 * n / 44100.0);
+        signal[n] += 0.0001 * (((random() % 2000) / 1000.0) - 1.0);
+    }
+    
+    BTrack exact(hopSize, 1024);
+    BTrack gated(hopSize, 1024);
+    gated.setPhaseMagnitudeFloor(0.0001);
+    
+    int numBeats = 0;
+    
+    for (int i = 0;i < numHops;i++)
+    {
+        exact.processAudioFrame(&signal[i * hopSize]);
+        gated.processAudioFrame(&signal[i * hopSize]);
+        
+        BOOST_CHECK_EQUAL(gated.beatDueInCurrentFrame(), exact.beatDueInCurrentFrame());
+        
+        if (exact.beatDueInCurrentFrame())
+        {
+            numBeats++;
+        }
+    }
+    
+    BOOST_CHECK(numBeats > 20);
+    BOOST_CHECK_CLOSE(gated.getCurrentTempoEstimate(), exact.getCurrentTempoEstimate(), 1e-9);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+//======================================================================
+//============================ SLIDING DFT =============================
+//======================================================================
+BOOST_AUTO_TEST_SUITE(slidingDFT)
+
+//======================================================================
+BOOST_AUTO_TEST_CASE(slidingSpectrumMatchesTransformingEachFrame)
+{
+    int hopSize = 32;
+    int frameSize = 1024;
+    int numHops = 1200;
+    
+    // enough hops for the sliding DFT to be set from an FFT again part way through
+    std::vector<double> signal(hopSize * numHops);
+    
+    for (int n = 0;n < (int) signal.size();n++)
+    {
+        double level = ((n / 6000) % 2 == 0) ? 1.0 : 0.01;
+        signal[n] = level * (sin(2 * M_PI * 440 * n / 44100.0) + (((random() % 2000) / 1000.0) - 1.0));
+    }
+    
+    // without a window the sliding DFT is the same transform as the FFT. the built in FFT
+    // is double precision whichever FFT library is the default
+    std::shared_ptr<FFTBackend> builtin = std::make_shared<BuiltinFFTBackend>();
+    
+    OnsetDetectionFunction fft(hopSize, frameSize, SpectralDifference, RectangularWindow);
+    OnsetDetectionFunction sliding(hopSize, frameSize, SpectralDifference, RectangularWindow);
+    fft.setFFTBackend(builtin);
+    sliding.setFFTBackend(builtin);
+    sliding.setSlidingDFT(true);
+    
+    // with a window, the sliding DFT gives the spectrum of the frame under the periodic Hann window
+    OnsetDetectionFunction slidingHanning(hopSize, frameSize, ComplexSpectralDifferenceHWR, HanningWindow);
+    slidingHanning.setFFTBackend(builtin);
+    slidingHanning.setSlidingDFT(true);
+    
+    std::unique_ptr<RealFFT> reference = BuiltinFFTBackend().createFFT(frameSize);
+    
+    for (int i = 0;i < numHops;i++)
+    {
+        double* hop = &signal[i * hopSize];
+        
+        double expected = fft.calculateOnsetDetectionFunctionSample(hop);
+        double sample = sliding.calculateOnsetDetectionFunctionSample(hop);
+        slidingHanning.calculateOnsetDetectionFunctionSample(hop);
+        
+        if (i < frameSize / hopSize)
+        {
+            continue;
+        }
+        
+        BOOST_CHECK_CLOSE(sample, expected, 1e-6);
+        
+        // the halves of the frame are swapped before the FFT, as the detection function does
+        const double* frame = &signal[((i + 1) * hopSize) - frameSize];
+        double* in = reference->getTimeDomainBuffer();
+        
+        for (int n = 0;n < frameSize;n++)
+        {
+            in[(n + frameSize / 2) % frameSize] = frame[n] * 0.5 * (1 - cos(2 * M_PI * n / frameSize));
+        }
+        
+        reference->performForwardTransform();
+        
+        const double* spectra[2] = {sliding.getCurrentSpectrum(), slidingHanning.getCurrentSpectrum()};
+        const double* expectedSpectra[2] = {fft.getCurrentSpectrum(), reference->getSpectrumBuffer()};
+        
+        for (int s = 0;s < 2;s++)
+        {
+            BOOST_REQUIRE(spectra[s] != NULL);
+            
+            double maxError = 0;
+            double peak = 0;
+            
+            for (int k = 0;k < frameSize + 2;k++)
+            {
+                maxError = std::max(maxError, fabs(spectra[s][k] - expectedSpectra[s][k]));
+                peak = std::max(peak, fabs(expectedSpectra[s][k]));
+            }
+            
+            BOOST_CHECK(maxError <= 1e-9 * peak);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+//======================================================================
+//============================= BIN RANGE ==============================
+//======================================================================
+BOOST_AUTO_TEST_SUITE(binRange)
+
+//======================================================================
+BOOST_AUTO_TEST_CASE(bandsAddUpToTheFullSpectrumAndThePrunedTransformMatchesTheFFT)
+{
+    int hopSize = 512;
+    int frameSize = 1024;
+    int numHops = 60;
+    int splitBin = 10;
+    
+    std::vector<double> signal(hopSize * numHops);
+    
+    for (int n = 0;n < (int) signal.size();n++)
+    {
+        double level = ((n / 4000) % 2 == 0) ? 1.0 : 0.1;
+        signal[n] = level * (sin(2 * M_PI * 60 * n / 44100.0) + (((random() % 2000) / 1000.0) - 1.0));
+    }
+    
+    std::shared_ptr<FFTBackend> builtin = std::make_shared<BuiltinFFTBackend>();
+    
+    std::vector<double> real(frameSize / 2 + 1);
+    std::vector<double> imag(frameSize / 2 + 1);
+    
+    for (int type = SpectralDifference;type <= HighFrequencySpectralDifferenceHWR;type++)
+    {
+        OnsetDetectionFunction full(hopSize, frameSize, type, HanningWindow);
+        full.setFFTBackend(builtin);
+        
+        // the low bins are few enough to be transformed directly
+        OnsetDetectionFunction low(hopSize, frameSize, type, HanningWindow);
+        low.setFFTBackend(builtin);
+        low.setBinRange(0, splitBin - 1);
+        
+        OnsetDetectionFunction lowFromSpectrum(hopSize, frameSize, type, HanningWindow);
+        lowFromSpectrum.setBinRange(0, splitBin - 1);
+        
+        OnsetDetectionFunction high(hopSize, frameSize, type, HanningWindow);
+        high.setBinRange(splitBin, frameSize / 2);
+        
+        BOOST_CHECK_EQUAL(low.getLastBin(), splitBin - 1);
+        BOOST_CHECK_EQUAL(full.getLastBin(), frameSize / 2);
+        
+        for (int i = 0;i < numHops;i++)
+        {
+            double* hop = &signal[i * hopSize];
+            
+            double expected = full.calculateOnsetDetectionFunctionSample(hop);
+            double lowSample = low.calculateOnsetDetectionFunctionSample(hop);
+            
+            // only the bins in the range have been calculated
+            BOOST_CHECK(low.getCurrentSpectrum() == NULL);
+            
+            const double* spectrum = full.getCurrentSpectrum();
+            BOOST_REQUIRE(spectrum != NULL);
+            
+            for (int k = 0;k <= frameSize / 2;k++)
+            {
+                real[k] = spectrum[2 * k];
+                imag[k] = spectrum[2 * k + 1];
+            }
+            
+            double lowExpected = lowFromSpectrum.calculateOnsetDetectionFunctionSampleFromSpectrum(&real[0], &imag[0]);
+            double highSample = high.calculateOnsetDetectionFunctionSampleFromSpectrum(&real[0], &imag[0]);
+            
+            BOOST_CHECK_SMALL(lowSample - lowExpected, 1e-9 * std::max(1.0, lowExpected));
+            BOOST_CHECK_SMALL((lowExpected + highSample) - expected, 1e-9 * std::max(1.0, expected));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+//======================================================================
+//======================================================================
+
+
+
+
 #endif